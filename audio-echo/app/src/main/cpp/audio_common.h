@@ -30,12 +30,21 @@
 #define AUDIO_SAMPLE_CHANNELS 1
 
 /*
- * Sample Buffer Controls...
+ * Sample Buffer Controls... ( may be overridden from the build, e.g. by
+ * the host pipeline simulator in audio-echo/host )
  */
+#ifndef RECORD_DEVICE_KICKSTART_BUF_COUNT
 #define RECORD_DEVICE_KICKSTART_BUF_COUNT 2
+#endif
+#ifndef PLAY_KICKSTART_BUFFER_COUNT
 #define PLAY_KICKSTART_BUFFER_COUNT 3
+#endif
+#ifndef DEVICE_SHADOW_BUFFER_QUEUE_LEN
 #define DEVICE_SHADOW_BUFFER_QUEUE_LEN 4
+#endif
+#ifndef BUF_COUNT
 #define BUF_COUNT 16
+#endif
 
 struct SampleFormat {
   uint32_t sampleRate_;
@@ -49,13 +58,27 @@ extern void ConvertToSLSampleFormat(SLAndroidDataFormat_PCM_EX* pFormat,
 
 /*
  * GetSystemTicks(void):  return the time in micro sec
+ * ( ECHO_EXTERNAL_CLOCK: provided by the build, e.g. the host simulator )
  */
+#ifdef ECHO_EXTERNAL_CLOCK
+uint64_t GetSystemTicks(void);
+#else
 __inline__ uint64_t GetSystemTicks(void) {
   struct timeval Time;
   gettimeofday(&Time, NULL);
 
   return (static_cast<uint64_t>(1000000) * Time.tv_sec + Time.tv_usec);
 }
+#endif
+
+/*
+ * GetSystemTimeNs(void): monotonic time in nano sec, for timing blocks
+ */
+__inline__ uint64_t GetSystemTimeNs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(1000000000) * now.tv_sec + now.tv_nsec;
+}
 
 #define SLASSERT(x)                   \
   do {                                \
@@ -15,89 +15,92 @@
  */
 #include "audio_effect.h"
 #include "audio_common.h"
+#include "audio_mix.h"
+#include <algorithm>
 #include <climits>
+#include <cmath>
 #include <cstring>
+#include <thread>
 
 /*
  * Mixing Audio in integer domain to avoid FP calculation
- *   (FG * ( MixFactor * 16 ) + BG * ( (1.0f-MixFactor) * 16 )) / 16
+ *   (FG * ( MixFactor * 128 ) + BG * ( (1.0f-MixFactor) * 128 )) >> 7
  */
-static const int32_t kFloatToIntMapFactor = 128;
+static const int32_t kFloatToIntMapFactor = kMixFactorOne;
 static const uint32_t kMsPerSec = 1000;
+
 /**
  * Constructor for AudioDelay
- * @param sampleRate
+ * @param sampleRate in milliHertz
  * @param channelCount
  * @param format
  * @param delayTimeInMs
+ * @param decayWeight
+ * @param maxDelayTimeInMs longest delay setDelayTime() may ask for
  */
 AudioDelay::AudioDelay(int32_t sampleRate, int32_t channelCount,
                        SLuint32 format, size_t delayTimeInMs,
-                       float decayWeight)
-    : AudioFormat(sampleRate, channelCount, format),
+                       float decayWeight, size_t maxDelayTimeInMs)
+    : AudioEffectNode(sampleRate, channelCount, format),
       delayTime_(delayTimeInMs),
       decayWeight_(decayWeight) {
-  feedbackFactor_ = static_cast<int32_t>(decayWeight_ * kFloatToIntMapFactor);
-  liveAudioFactor_ = kFloatToIntMapFactor - feedbackFactor_;
-  allocateBuffer();
+  uint32_t bytePerSample = format_ / 8;
+  assert(bytePerSample == 2 || bytePerSample == 4);
+
+  // allocate and zero out the delay line once for the longest delay
+  // ( 0 means silent audio )
+  lineFrames_ = std::max<size_t>(msToFrames(std::max(delayTimeInMs,
+                                                     maxDelayTimeInMs)), 1);
+  size_t lineBytes = lineFrames_ * channelCount_ * bytePerSample;
+  buffer_ = new uint8_t[lineBytes];
+  assert(buffer_);
+  memset(buffer_, 0, lineBytes);
+  curPos_ = 0;
+
+  params_.init(makeParams(delayTime_, decayWeight_));
 }
 
 /**
  * Destructor
  */
-AudioDelay::~AudioDelay() {
-  if (buffer_) delete static_cast<uint8_t*>(buffer_);
+AudioDelay::~AudioDelay() { delete[] buffer_; }
+
+/**
+ * delay in frames for the given time
+ */
+uint32_t AudioDelay::msToFrames(size_t ms) const {
+  // sampleRate_ is in milliHertz
+  float floatDelayTime = (float)ms / kMsPerSec;
+  float fNumFrames = floatDelayTime * (float)sampleRate_ / kMsPerSec;
+  return static_cast<uint32_t>(fNumFrames + 0.5f);
+}
+
+AudioDelay::DelayParams AudioDelay::makeParams(size_t delayTimeInMs,
+                                               float weight) const {
+  DelayParams params;
+  params.delayFrames_ = static_cast<uint32_t>(
+      std::min<size_t>(msToFrames(delayTimeInMs), lineFrames_));
+  params.feedbackFactor_ =
+      static_cast<int16_t>(weight * kFloatToIntMapFactor + 0.5f);
+  params.liveAudioFactor_ = kFloatToIntMapFactor - params.feedbackFactor_;
+  params.feedbackWeight_ = weight;
+  params.liveAudioWeight_ = 1.0f - weight;
+  return params;
 }
 
 /**
  * Configure for delay time ( in miliseconds ), dynamically adjustable
  * @param delayTimeInMS in miliseconds
- * @return true if delay time is set successfully
+ * @return true if delay time is set successfully, false if it is longer
+ *         than the delay line ( the longest delay is used then )
  */
 bool AudioDelay::setDelayTime(size_t delayTimeInMS) {
+  std::lock_guard<std::mutex> lock(paramLock_);
   if (delayTimeInMS == delayTime_) return true;
 
-  std::lock_guard<std::mutex> lock(lock_);
-
-  if (buffer_) {
-    delete static_cast<uint8_t*>(buffer_);
-    buffer_ = nullptr;
-  }
-
   delayTime_ = delayTimeInMS;
-  allocateBuffer();
-  return buffer_ != nullptr;
-}
-
-/**
- * Internal helper function to allocate buffer for the delay
- *  - calculate the buffer size for the delay time
- *  - allocate and zero out buffer (0 means silent audio)
- *  - configure bufSize_ to be size of audioFrames
- */
-void AudioDelay::allocateBuffer(void) {
-  float floatDelayTime = (float)delayTime_ / kMsPerSec;
-  float fNumFrames = floatDelayTime * (float)sampleRate_ / kMsPerSec;
-  size_t sampleCount = static_cast<uint32_t>(fNumFrames + 0.5f) * channelCount_;
-
-  uint32_t bytePerSample = format_ / 8;
-  assert(bytePerSample <= 4 && bytePerSample);
-
-  uint32_t bytePerFrame = channelCount_ * bytePerSample;
-
-  // get bufCapacity in bytes
-  bufCapacity_ = sampleCount * bytePerSample;
-  bufCapacity_ =
-      ((bufCapacity_ + bytePerFrame - 1) / bytePerFrame) * bytePerFrame;
-
-  buffer_ = new uint8_t[bufCapacity_];
-  assert(buffer_);
-
-  memset(buffer_, 0, bufCapacity_);
-  curPos_ = 0;
-
-  // bufSize_ is in Frames ( not samples, not bytes )
-  bufSize_ = bufCapacity_ / bytePerFrame;
+  params_.publish(makeParams(delayTime_, decayWeight_));
+  return msToFrames(delayTimeInMS) <= lineFrames_;
 }
 
 size_t AudioDelay::getDelayTime(void) const { return delayTime_; }
@@ -111,14 +114,72 @@ size_t AudioDelay::getDelayTime(void) const { return delayTime_; }
  */
 void AudioDelay::setDecayWeight(float weight) {
   if (weight > 0.0f && weight < 1.0f) {
-    float feedback = (weight * kFloatToIntMapFactor + 0.5f);
-    feedbackFactor_ = static_cast<int32_t>(feedback);
-    liveAudioFactor_ = kFloatToIntMapFactor - feedbackFactor_;
+    std::lock_guard<std::mutex> lock(paramLock_);
+    decayWeight_ = weight;
+    params_.publish(makeParams(delayTime_, decayWeight_));
   }
 }
 
 float AudioDelay::getDecayWeight(void) const { return decayWeight_; }
 
+void AudioDelay::getStats(AudioDelayStats* stats) const {
+  stats->blocks_ = blocks_.load(std::memory_order_relaxed);
+  stats->frames_ = frames_.load(std::memory_order_relaxed);
+  stats->totalNs_ = totalNs_.load(std::memory_order_relaxed);
+  stats->maxNs_ = maxNs_.load(std::memory_order_relaxed);
+  stats->paramSwaps_ = paramSwaps_.load(std::memory_order_relaxed);
+}
+
+void AudioDelay::updateStats(uint64_t startNs, int32_t numFrames) {
+  // single writer ( the audio thread ): plain read-modify-write is enough
+  uint64_t elapsed = GetSystemTimeNs() - startNs;
+  blocks_.store(blocks_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  frames_.store(frames_.load(std::memory_order_relaxed) + numFrames,
+                std::memory_order_relaxed);
+  totalNs_.store(totalNs_.load(std::memory_order_relaxed) + elapsed,
+                 std::memory_order_relaxed);
+  if (elapsed > maxNs_.load(std::memory_order_relaxed)) {
+    maxNs_.store(elapsed, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * Run numFrames of live audio through the circular delay line: the frame
+ * written delayFrames ago comes out, the mix of it and the live frame goes
+ * in. Work is cut at the line wrap points and into pieces no longer than
+ * the delay, so a piece never reads what it writes itself.
+ */
+template <typename T, typename MixFunc>
+void AudioDelay::runDelayLine(T* liveAudio, int32_t numFrames, MixFunc mix) {
+  DelayParams params;
+  if (params_.read(&params)) {
+    paramSwaps_.fetch_add(1, std::memory_order_relaxed);
+  }
+  size_t delayFrames = params.delayFrames_;
+  if (!delayFrames || !params.feedbackFactor_) {
+    return;
+  }
+
+  T* line = reinterpret_cast<T*>(buffer_);
+  size_t readPos = (curPos_ + lineFrames_ - delayFrames) % lineFrames_;
+  size_t remaining = static_cast<size_t>(numFrames);
+  while (remaining) {
+    size_t frames = std::min(std::min(remaining, delayFrames),
+                             std::min(lineFrames_ - readPos,
+                                      lineFrames_ - curPos_));
+    mix(liveAudio, line + readPos * channelCount_, line + curPos_ * channelCount_,
+        static_cast<int32_t>(frames * channelCount_), params);
+
+    liveAudio += frames * channelCount_;
+    remaining -= frames;
+    readPos += frames;
+    if (readPos == lineFrames_) readPos = 0;
+    curPos_ += frames;
+    if (curPos_ == lineFrames_) curPos_ = 0;
+  }
+}
+
 /**
  * process() filter live audio with "echo" effect:
  *   delay time is run-time adjustable
@@ -126,45 +187,217 @@ float AudioDelay::getDecayWeight(void) const { return decayWeight_; }
  *   in this sample, hardcoded to .5
  *
  * @param liveAudio is recorded audio stream
- * @param channelCount for liveAudio, must be 2 for stereo
  * @param numFrames is length of liveAudio in Frames ( not in byte )
  */
 void AudioDelay::process(int16_t* liveAudio, int32_t numFrames) {
-  if (feedbackFactor_ == 0 || bufSize_ < numFrames) {
-    return;
-  }
+  assert(format_ == SL_PCMSAMPLEFORMAT_FIXED_16);
+  uint64_t start = GetSystemTimeNs();
+  runDelayLine(liveAudio, numFrames,
+               [](int16_t* live, const int16_t* delayed, int16_t* feedback,
+                  int32_t count, const DelayParams& params) {
+                 mixEchoI16(live, delayed, feedback, count,
+                            params.feedbackFactor_, params.liveAudioFactor_);
+               });
+  updateStats(start, numFrames);
+}
 
-  if (!lock_.try_lock()) {
-    return;
+/**
+ * process() for float audio ( 32 bit samples in [-1.0, 1.0] )
+ */
+void AudioDelay::process(float* liveAudio, int32_t numFrames) {
+  assert(format_ == SL_PCMSAMPLEFORMAT_FIXED_32);
+  uint64_t start = GetSystemTimeNs();
+  runDelayLine(liveAudio, numFrames,
+               [](float* live, const float* delayed, float* feedback,
+                  int32_t count, const DelayParams& params) {
+                 mixEchoF32(live, delayed, feedback, count,
+                            params.feedbackWeight_, params.liveAudioWeight_);
+               });
+  updateStats(start, numFrames);
+}
+
+void AudioDelay::process(AudioBlock* block) {
+  assert(block->channels_ == channelCount_);
+  process(block->samples_, block->frames_);
+}
+
+/**
+ * BiquadEq
+ */
+static const float kPi = 3.14159265358979f;
+
+BiquadEq::BiquadEq(int32_t sampleRate, int32_t channelCount, SLuint32 format,
+                   FilterType type, float freqInHz, float q, float gainInDb)
+    : AudioEffectNode(sampleRate, channelCount, format) {
+  assert(format_ == SL_PCMSAMPLEFORMAT_FIXED_16);
+  assert(channelCount_ <= kMaxChannels);
+  coefs_.init(makeCoefs(type, freqInHz, q, gainInDb));
+}
+
+BiquadEq::Coefs BiquadEq::makeCoefs(FilterType type, float freqInHz, float q,
+                                    float gainInDb) const {
+  // sampleRate_ is in milliHertz
+  float w0 = 2.0f * kPi * freqInHz * kMsPerSec / sampleRate_;
+  float cosW0 = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * q);
+  float a = powf(10.0f, gainInDb / 40.0f);
+  float sqrtA2Alpha = 2.0f * sqrtf(a) * alpha;
+
+  float b0, b1, b2, a0, a1, a2;
+  switch (type) {
+    case LOW_PASS:
+      b1 = 1.0f - cosW0;
+      b0 = b2 = b1 / 2.0f;
+      a0 = 1.0f + alpha, a1 = -2.0f * cosW0, a2 = 1.0f - alpha;
+      break;
+    case HIGH_PASS:
+      b1 = -(1.0f + cosW0);
+      b0 = b2 = -b1 / 2.0f;
+      a0 = 1.0f + alpha, a1 = -2.0f * cosW0, a2 = 1.0f - alpha;
+      break;
+    case PEAKING:
+      b0 = 1.0f + alpha * a, b1 = -2.0f * cosW0, b2 = 1.0f - alpha * a;
+      a0 = 1.0f + alpha / a, a1 = -2.0f * cosW0, a2 = 1.0f - alpha / a;
+      break;
+    case LOW_SHELF:
+      b0 = a * ((a + 1) - (a - 1) * cosW0 + sqrtA2Alpha);
+      b1 = 2 * a * ((a - 1) - (a + 1) * cosW0);
+      b2 = a * ((a + 1) - (a - 1) * cosW0 - sqrtA2Alpha);
+      a0 = (a + 1) + (a - 1) * cosW0 + sqrtA2Alpha;
+      a1 = -2 * ((a - 1) + (a + 1) * cosW0);
+      a2 = (a + 1) + (a - 1) * cosW0 - sqrtA2Alpha;
+      break;
+    case HIGH_SHELF:
+    default:
+      b0 = a * ((a + 1) + (a - 1) * cosW0 + sqrtA2Alpha);
+      b1 = -2 * a * ((a - 1) + (a + 1) * cosW0);
+      b2 = a * ((a + 1) + (a - 1) * cosW0 - sqrtA2Alpha);
+      a0 = (a + 1) - (a - 1) * cosW0 + sqrtA2Alpha;
+      a1 = 2 * ((a - 1) - (a + 1) * cosW0);
+      a2 = (a + 1) - (a - 1) * cosW0 - sqrtA2Alpha;
+      break;
   }
+  Coefs coefs = {b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+  return coefs;
+}
 
-  if (numFrames + curPos_ > bufSize_) {
-    curPos_ = 0;
+void BiquadEq::setFilter(FilterType type, float freqInHz, float q,
+                         float gainInDb) {
+  std::lock_guard<std::mutex> lock(paramLock_);
+  coefs_.publish(makeCoefs(type, freqInHz, q, gainInDb));
+}
+
+void BiquadEq::process(AudioBlock* block) {
+  Coefs c;
+  coefs_.read(&c);
+  int32_t channels = block->channels_;
+  assert(channels <= kMaxChannels);
+  for (int32_t ch = 0; ch < channels; ch++) {
+    float x1 = x1_[ch], x2 = x2_[ch], y1 = y1_[ch], y2 = y2_[ch];
+    int16_t* samples = block->samples_ + ch;
+    for (int32_t idx = 0; idx < block->frames_; idx++) {
+      float x0 = samples[idx * channels];
+      float y0 = c.b0_ * x0 + c.b1_ * x1 + c.b2_ * x2 - c.a1_ * y1 - c.a2_ * y2;
+      x2 = x1, x1 = x0;
+      y2 = y1, y1 = y0;
+      float out = y0 > SHRT_MAX ? SHRT_MAX : (y0 < SHRT_MIN ? SHRT_MIN : y0);
+      samples[idx * channels] = static_cast<int16_t>(lrintf(out));
+    }
+    // flush denormals out of the recursion once the input goes silent
+    x1_[ch] = x1, x2_[ch] = x2;
+    y1_[ch] = fabsf(y1) < 1e-15f ? 0.0f : y1;
+    y2_[ch] = fabsf(y2) < 1e-15f ? 0.0f : y2;
   }
+}
 
-  // process every sample
-  int32_t sampleCount = channelCount_ * numFrames;
-  int16_t* samples = &static_cast<int16_t*>(buffer_)[curPos_ * channelCount_];
-  for (size_t idx = 0; idx < sampleCount; idx++) {
-#if 1
-    int32_t curSample =
-        (samples[idx] * feedbackFactor_ + liveAudio[idx] * liveAudioFactor_) /
-        kFloatToIntMapFactor;
-    if (curSample > SHRT_MAX)
-      curSample = SHRT_MAX;
-    else if (curSample < SHRT_MIN)
-      curSample = SHRT_MIN;
- 
-    liveAudio[idx] = samples[idx];
-    samples[idx] = static_cast<int16_t>(curSample);
-#else
-    // Pure delay
-    int16_t tmp = liveAudio[idx];
-    liveAudio[idx] = samples[idx];
-    samples[idx] = tmp;
-#endif
+/**
+ * AudioGain
+ */
+static const int32_t kGainShift = 12;
+static const int32_t kGainOne = 1 << kGainShift;
+
+AudioGain::AudioGain(int32_t sampleRate, int32_t channelCount, SLuint32 format,
+                     float gain)
+    : AudioEffectNode(sampleRate, channelCount, format), gainFactor_(kGainOne) {
+  assert(format_ == SL_PCMSAMPLEFORMAT_FIXED_16);
+  setGain(gain);
+}
+
+void AudioGain::setGain(float gain) {
+  if (gain < 0.0f) gain = 0.0f;
+  if (gain > 16.0f) gain = 16.0f;
+  gainFactor_.store(static_cast<int32_t>(gain * kGainOne + 0.5f),
+                    std::memory_order_relaxed);
+}
+
+float AudioGain::getGain(void) const {
+  return static_cast<float>(gainFactor_.load(std::memory_order_relaxed)) /
+         kGainOne;
+}
+
+void AudioGain::process(AudioBlock* block) {
+  int32_t factor = gainFactor_.load(std::memory_order_relaxed);
+  if (factor == kGainOne) return;
+
+  int16_t* samples = block->samples_;
+  int32_t count = block->frames_ * block->channels_;
+  for (int32_t idx = 0; idx < count; idx++) {
+    int32_t scaled = (samples[idx] * factor) >> kGainShift;
+    scaled = scaled > SHRT_MAX ? SHRT_MAX : scaled;
+    scaled = scaled < SHRT_MIN ? SHRT_MIN : scaled;
+    samples[idx] = static_cast<int16_t>(scaled);
   }
+}
 
-  curPos_ += numFrames;
-  lock_.unlock();
+/**
+ * AudioLimiter
+ */
+AudioLimiter::AudioLimiter(int32_t sampleRate, int32_t channelCount,
+                           SLuint32 format, float thresholdInDb,
+                           float releaseTimeInMs)
+    : AudioEffectNode(sampleRate, channelCount, format) {
+  assert(format_ == SL_PCMSAMPLEFORMAT_FIXED_16);
+  params_.init(makeParams(thresholdInDb, releaseTimeInMs));
+}
+
+AudioLimiter::LimitParams AudioLimiter::makeParams(
+    float thresholdInDb, float releaseTimeInMs) const {
+  LimitParams params;
+  if (thresholdInDb > 0.0f) thresholdInDb = 0.0f;
+  params.threshold_ = SHRT_MAX * powf(10.0f, thresholdInDb / 20.0f);
+  // envelope falls by 1/e every releaseTimeInMs
+  float releaseFrames = releaseTimeInMs * sampleRate_ / kMsPerSec / kMsPerSec;
+  params.releaseCoef_ =
+      releaseFrames > 1.0f ? expf(-1.0f / releaseFrames) : 0.0f;
+  return params;
+}
+
+void AudioLimiter::setLimit(float thresholdInDb, float releaseTimeInMs) {
+  std::lock_guard<std::mutex> lock(paramLock_);
+  params_.publish(makeParams(thresholdInDb, releaseTimeInMs));
+}
+
+void AudioLimiter::process(AudioBlock* block) {
+  LimitParams params;
+  params_.read(&params);
+
+  // one envelope for all channels keeps the stereo image
+  int32_t channels = block->channels_;
+  int16_t* samples = block->samples_;
+  float envelope = envelope_;
+  for (int32_t frame = 0; frame < block->frames_; frame++) {
+    float peak = 0.0f;
+    for (int32_t ch = 0; ch < channels; ch++) {
+      peak = std::max(peak, fabsf(samples[ch]));
+    }
+    envelope = std::max(peak, envelope * params.releaseCoef_);
+    if (envelope > params.threshold_) {
+      float gain = params.threshold_ / envelope;
+      for (int32_t ch = 0; ch < channels; ch++) {
+        samples[ch] = static_cast<int16_t>(samples[ch] * gain);
+      }
+    }
+    samples += channels;
+  }
+  envelope_ = envelope;
 }
@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <atomic>
 #include <mutex>
+#include <thread>
 
 class AudioFormat {
  protected:
@@ -34,33 +35,221 @@ class AudioFormat {
   virtual ~AudioFormat() {}
 };
 
+/**
+ * One block of interleaved int16 audio handed through the effect graph.
+ */
+struct AudioBlock {
+  int16_t *samples_;
+  int32_t frames_;
+  int32_t channels_;
+};
+
+/**
+ * A node of the effect graph ( see audio_effect_graph.h ). process() runs
+ * on the audio thread and works in place: it must not allocate, lock or
+ * block. Setters are called from other threads and hand their results to
+ * the audio thread through ParamExchange.
+ */
+class AudioEffectNode : public AudioFormat {
+ public:
+  virtual void process(AudioBlock *block) = 0;
+
+ protected:
+  AudioEffectNode(int32_t sampleRate, int32_t channelCount, SLuint32 format)
+      : AudioFormat(sampleRate, channelCount, format) {}
+};
+
+/**
+ * ParamExchange: double buffered parameter set, one writer at a time
+ * ( callers serialize publish() ) and one reader ( the audio thread ).
+ * publish() writes the slot that is not current and makes it current;
+ * read() copies the current slot out. The reader announces the slot it is
+ * copying in reading_ and re-checks it is still the published one, so a
+ * writer never overwrites a slot while it is copied. read() never blocks;
+ * only publish() waits, and only while the reader finishes copying the
+ * slot it wants to reuse.
+ */
+template <typename T>
+class ParamExchange {
+ public:
+  ParamExchange() : reading_(kNoSlot) {}
+  explicit ParamExchange(const T &params) : reading_(kNoSlot) { init(params); }
+
+  // set both slots; only before the reader starts
+  void init(const T &params) {
+    slots_[0] = params;
+    slots_[1] = params;
+  }
+
+  void publish(const T &params) {
+    uint32_t slot = published_.load(std::memory_order_relaxed) ^ 1;
+    while (reading_.load() == slot) {
+      std::this_thread::yield();
+    }
+    slots_[slot] = params;
+    published_.store(slot);
+  }
+
+  // returns true if params is a different set than the last read() got
+  bool read(T *params) {
+    uint32_t slot;
+    do {
+      slot = published_.load();
+      reading_.store(slot);
+    } while (slot != published_.load());
+    *params = slots_[slot];
+    reading_.store(kNoSlot, std::memory_order_release);
+
+    bool changed = slot != lastSlot_;
+    lastSlot_ = slot;
+    return changed;
+  }
+
+ private:
+  static const uint32_t kNoSlot = 2;
+  T slots_[2];
+  std::atomic<uint32_t> published_{0};
+  std::atomic<uint32_t> reading_;
+  uint32_t lastSlot_ = 0;
+};
+
+/**
+ * Per-block timing of AudioDelay::process(), updated by the audio thread
+ * and readable from any thread.
+ */
+struct AudioDelayStats {
+  uint64_t blocks_;      // process() calls
+  uint64_t frames_;      // frames processed
+  uint64_t totalNs_;     // time spent in process()
+  uint64_t maxNs_;       // slowest block
+  uint64_t paramSwaps_;  // parameter sets picked up by the audio thread
+};
+
 /**
  * An audio delay effect:
  *   - decay is for feedback(echo)weight
- *   - delay time is adjustable
+ *   - delay time is adjustable up to the maximum given at construction;
+ *     the delay line is allocated once for that maximum
+ *   - parameters are double buffered: setters publish a new set and the
+ *     audio thread picks it up at the start of the next block, so
+ *     process() never blocks or skips a block
  */
-class AudioDelay : public AudioFormat {
+class AudioDelay : public AudioEffectNode {
  public:
+  static const size_t kMaxDelayTimeInMs = 1000;
   ~AudioDelay();
 
   explicit AudioDelay(int32_t sampleRate, int32_t channelCount, SLuint32 format,
-                      size_t delayTimeInMs, float Weight);
+                      size_t delayTimeInMs, float Weight,
+                      size_t maxDelayTimeInMs = kMaxDelayTimeInMs);
   bool setDelayTime(size_t delayTimeInMiliSec);
   size_t getDelayTime(void) const;
   void setDecayWeight(float weight);
   float getDecayWeight(void) const;
+  void process(AudioBlock *block) override;
   void process(int16_t *liveAudio, int32_t numFrames);
+  void process(float *liveAudio, int32_t numFrames);
+  void getStats(AudioDelayStats *stats) const;
+
+ private:
+  struct DelayParams {
+    uint32_t delayFrames_;
+    int16_t feedbackFactor_;  // Q7, for int16 audio
+    int16_t liveAudioFactor_;
+    float feedbackWeight_;    // for float audio
+    float liveAudioWeight_;
+  };
+
+  // writer side, serialized by paramLock_ ( never taken by process() );
+  // atomic so the getters can read them from any thread without it
+  std::atomic<size_t> delayTime_{0};
+  std::atomic<float> decayWeight_{0.5f};
+  std::mutex paramLock_;
+  ParamExchange<DelayParams> params_;
+
+  // audio thread side
+  uint8_t *buffer_ = nullptr;
+  size_t lineFrames_ = 0;  // delay line capacity in frames
+  size_t curPos_ = 0;      // write position in frames
+
+  std::atomic<uint64_t> blocks_{0};
+  std::atomic<uint64_t> frames_{0};
+  std::atomic<uint64_t> totalNs_{0};
+  std::atomic<uint64_t> maxNs_{0};
+  std::atomic<uint64_t> paramSwaps_{0};
+
+  uint32_t msToFrames(size_t ms) const;
+  DelayParams makeParams(size_t delayTimeInMs, float weight) const;
+  template <typename T, typename MixFunc>
+  void runDelayLine(T *liveAudio, int32_t numFrames, MixFunc mix);
+  void updateStats(uint64_t startNs, int32_t numFrames);
+};
+
+/**
+ * Biquad ( RBJ cookbook ) filter for EQ. Coefficients are computed by the
+ * setter and swapped in at the next block; filter state stays with the
+ * audio thread, one pair per channel ( up to kMaxChannels ).
+ */
+class BiquadEq : public AudioEffectNode {
+ public:
+  enum FilterType { LOW_PASS, HIGH_PASS, PEAKING, LOW_SHELF, HIGH_SHELF };
+  static const int32_t kMaxChannels = 2;
+
+  explicit BiquadEq(int32_t sampleRate, int32_t channelCount, SLuint32 format,
+                    FilterType type, float freqInHz, float q, float gainInDb);
+  void setFilter(FilterType type, float freqInHz, float q, float gainInDb);
+  void process(AudioBlock *block) override;
 
  private:
-  size_t delayTime_ = 0;
-  float decayWeight_ = 0.5;
-  void *buffer_ = nullptr;
-  size_t bufCapacity_ = 0;
-  size_t bufSize_ = 0;
-  size_t curPos_ = 0;
-  std::mutex lock_;
-  int32_t feedbackFactor_;
-  int32_t liveAudioFactor_;
-  void allocateBuffer(void);
+  struct Coefs {
+    float b0_, b1_, b2_, a1_, a2_;  // normalized to a0 == 1
+  };
+  Coefs makeCoefs(FilterType type, float freqInHz, float q,
+                  float gainInDb) const;
+
+  std::mutex paramLock_;
+  ParamExchange<Coefs> coefs_;
+  // Direct Form I history per channel
+  float x1_[kMaxChannels] = {}, x2_[kMaxChannels] = {};
+  float y1_[kMaxChannels] = {}, y2_[kMaxChannels] = {};
+};
+
+/**
+ * Gain stage, Q12 fixed point with saturation; unity gain is a no-op.
+ */
+class AudioGain : public AudioEffectNode {
+ public:
+  explicit AudioGain(int32_t sampleRate, int32_t channelCount, SLuint32 format,
+                     float gain);
+  void setGain(float gain);
+  float getGain(void) const;
+  void process(AudioBlock *block) override;
+
+ private:
+  std::atomic<int32_t> gainFactor_;
+};
+
+/**
+ * Peak limiter: instant attack, exponential release. Samples above the
+ * threshold are scaled down by threshold / envelope.
+ */
+class AudioLimiter : public AudioEffectNode {
+ public:
+  explicit AudioLimiter(int32_t sampleRate, int32_t channelCount,
+                        SLuint32 format, float thresholdInDb,
+                        float releaseTimeInMs);
+  void setLimit(float thresholdInDb, float releaseTimeInMs);
+  void process(AudioBlock *block) override;
+
+ private:
+  struct LimitParams {
+    float threshold_;    // linear, full scale == SHRT_MAX
+    float releaseCoef_;  // per sample envelope decay
+  };
+  LimitParams makeParams(float thresholdInDb, float releaseTimeInMs) const;
+
+  std::mutex paramLock_;
+  ParamExchange<LimitParams> params_;
+  float envelope_ = 0.0f;  // audio thread
 };
 #endif  // EFFECT_PROCESSOR_H
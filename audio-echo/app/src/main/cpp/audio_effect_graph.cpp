@@ -0,0 +1,297 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "audio_effect_graph.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+AudioEffectGraph::AudioEffectGraph(int32_t sampleRate, int32_t channelCount,
+                                   uint32_t maxFramesPerBlock)
+    : sampleRate_(sampleRate),
+      channelCount_(channelCount),
+      maxFrames_(maxFramesPerBlock) {}
+
+AudioEffectGraph::~AudioEffectGraph() {
+  retire(chain_.exchange(nullptr));
+  // nodes_ and removed_ go with the object
+}
+
+bool AudioEffectGraph::validId(int32_t id) const {
+  return id >= 0 && id < static_cast<int32_t>(nodes_.size()) && nodes_[id];
+}
+
+int32_t AudioEffectGraph::addNode(AudioEffectNode *node) {
+  assert(node);
+  std::lock_guard<std::mutex> lock(lock_);
+  nodes_.emplace_back(node);
+  return static_cast<int32_t>(nodes_.size() - 1);
+}
+
+/*
+ * The node stays alive, and keeps running in the current chain, until the
+ * next commit() has swapped that chain out.
+ */
+bool AudioEffectGraph::removeNode(int32_t id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!validId(id)) return false;
+
+  edges_.erase(std::remove_if(edges_.begin(), edges_.end(),
+                              [id](const std::pair<int32_t, int32_t> &e) {
+                                return e.first == id || e.second == id;
+                              }),
+               edges_.end());
+  if (output_ == id) output_ = kLiveInput;
+  removed_.push_back(std::move(nodes_[id]));
+  return true;
+}
+
+bool AudioEffectGraph::connect(int32_t from, int32_t to) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if ((from != kLiveInput && !validId(from)) || !validId(to) || from == to) {
+    return false;
+  }
+  edges_.emplace_back(from, to);
+  return true;
+}
+
+void AudioEffectGraph::disconnectAll(void) {
+  std::lock_guard<std::mutex> lock(lock_);
+  edges_.clear();
+}
+
+bool AudioEffectGraph::setOutput(int32_t id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (id != kLiveInput && !validId(id)) return false;
+  output_ = id;
+  return true;
+}
+
+bool AudioEffectGraph::setChain(const std::vector<int32_t> &order) {
+  disconnectAll();
+  int32_t prev = kLiveInput;
+  for (int32_t id : order) {
+    if (!connect(prev, id)) return false;
+    prev = id;
+  }
+  return setOutput(prev);
+}
+
+/*
+ * Build the chain the audio thread runs ( lock_ held ). Returns nullptr
+ * for a pass-through graph; sets the chain's steps_ empty and outSlot_ to
+ * -1 when the graph can not be compiled ( cycle or too many inputs ).
+ */
+AudioEffectGraph::CompiledChain *AudioEffectGraph::compile(void) {
+  if (output_ == kLiveInput) return nullptr;
+
+  std::unique_ptr<CompiledChain> chain(new CompiledChain);
+  int32_t nodeCount = static_cast<int32_t>(nodes_.size());
+
+  // only the nodes feeding the output take part
+  std::vector<bool> used(nodeCount, false);
+  std::vector<int32_t> pending(1, output_);
+  used[output_] = true;
+  while (!pending.empty()) {
+    int32_t id = pending.back();
+    pending.pop_back();
+    for (auto &e : edges_) {
+      if (e.second == id && e.first != kLiveInput && !used[e.first]) {
+        used[e.first] = true;
+        pending.push_back(e.first);
+      }
+    }
+  }
+
+  // consumers of every buffer ( index 0 for the live block ); the output is
+  // read once more at the end
+  std::vector<int32_t> inDegree(nodeCount, 0);
+  std::vector<int32_t> consumers(nodeCount + 1, 0);
+  for (auto &e : edges_) {
+    if (!used[e.second]) continue;
+    consumers[e.first + 1]++;
+    if (e.first != kLiveInput) inDegree[e.second]++;
+  }
+  consumers[output_ + 1]++;
+
+  // Kahn's topological sort, lowest id first
+  std::vector<int32_t> slotOf(nodeCount + 1, -1);
+  slotOf[0] = 0;
+  int32_t sorted = 0, usedCount = 0, slots = 1;
+  for (int32_t id = 0; id < nodeCount; id++) usedCount += used[id];
+  std::vector<bool> done(nodeCount, false);
+  while (sorted < usedCount) {
+    int32_t id = 0;
+    while (id < nodeCount && (!used[id] || done[id] || inDegree[id])) id++;
+    if (id == nodeCount) {
+      LOGE("====Effect graph has a cycle, not committed");
+      chain->outSlot_ = -1;
+      return chain.release();
+    }
+    done[id] = true;
+    sorted++;
+
+    Step step;
+    step.node_ = nodes_[id].get();
+    step.inCount_ = 0;
+    for (auto &e : edges_) {
+      if (e.second != id) continue;
+      if (step.inCount_ == kMaxInputs) {
+        LOGE("====Effect node %d has more than %d inputs", id, kMaxInputs);
+        chain->outSlot_ = -1;
+        return chain.release();
+      }
+      step.in_[step.inCount_++] = slotOf[e.first + 1];
+    }
+    for (auto &e : edges_) {
+      if (e.first == id && used[e.second]) inDegree[e.second]--;
+    }
+
+    // work in place when the only input is not read by anybody else
+    bool inPlace = false;
+    if (step.inCount_ == 1) {
+      for (auto &e : edges_) {
+        if (e.second == id) inPlace = consumers[e.first + 1] == 1;
+      }
+    }
+    step.out_ = inPlace ? step.in_[0] : slots++;
+    slotOf[id + 1] = step.out_;
+    chain->steps_.push_back(step);
+  }
+  chain->outSlot_ = slotOf[output_ + 1];
+
+  // scratch buffers for every slot but the live block
+  if (slots > 1) {
+    chain->scratch_.reset(SampleBufferPool::create(
+        slots - 1, maxFrames_ * channelCount_ * sizeof(int16_t)));
+    if (!chain->scratch_) {
+      chain->steps_.clear();
+      chain->outSlot_ = -1;
+    }
+  }
+  return chain.release();
+}
+
+/*
+ * Free a chain the audio thread may still be running: wait for it to leave.
+ */
+void AudioEffectGraph::retire(CompiledChain *chain) {
+  if (!chain) return;
+  while (active_.load() == chain) {
+    std::this_thread::yield();
+  }
+  delete chain;
+}
+
+/*
+ * Compile the current graph and hand it to the audio thread.
+ * @return false if the graph can not be run ( the old chain stays )
+ */
+bool AudioEffectGraph::commit(void) {
+  std::lock_guard<std::mutex> lock(lock_);
+  CompiledChain *chain = compile();
+  if (chain && chain->outSlot_ < 0) {
+    delete chain;
+    return false;
+  }
+
+  retire(chain_.exchange(chain));
+  removed_.clear();
+  return true;
+}
+
+void AudioEffectGraph::run(CompiledChain *chain, int16_t *liveAudio,
+                           int32_t numFrames) {
+  int32_t sampleCount = numFrames * channelCount_;
+  size_t byteCount = sampleCount * sizeof(int16_t);
+  auto slot = [&](int32_t idx) -> int16_t * {
+    return idx ? reinterpret_cast<int16_t *>(
+                     chain->scratch_->buf(idx - 1)->buf_)
+               : liveAudio;
+  };
+
+  for (auto &step : chain->steps_) {
+    int16_t *out = slot(step.out_);
+    if (!step.inCount_) {
+      memset(out, 0, byteCount);
+    } else if (step.in_[0] != step.out_) {
+      memcpy(out, slot(step.in_[0]), byteCount);
+      for (int32_t i = 1; i < step.inCount_; i++) {
+        const int16_t *in = slot(step.in_[i]);
+        for (int32_t idx = 0; idx < sampleCount; idx++) {
+          int32_t sum = out[idx] + in[idx];
+          sum = sum > SHRT_MAX ? SHRT_MAX : sum;
+          sum = sum < SHRT_MIN ? SHRT_MIN : sum;
+          out[idx] = static_cast<int16_t>(sum);
+        }
+      }
+    }
+    AudioBlock block = {out, numFrames, channelCount_};
+    step.node_->process(&block);
+  }
+  if (chain->outSlot_) {
+    memcpy(liveAudio, slot(chain->outSlot_), byteCount);
+  }
+}
+
+/*
+ * Audio thread: run the current chain over one recorded block, in place.
+ * The chain is announced in active_ and re-checked, so commit() can not
+ * free it underneath.
+ */
+void AudioEffectGraph::process(int16_t *liveAudio, int32_t numFrames) {
+  assert(numFrames <= static_cast<int32_t>(maxFrames_));
+  uint64_t start = GetSystemTimeNs();
+
+  CompiledChain *chain;
+  do {
+    chain = chain_.load();
+    active_.store(chain);
+  } while (chain != chain_.load());
+  if (chain) {
+    run(chain, liveAudio, numFrames);
+  }
+  active_.store(nullptr, std::memory_order_release);
+
+  if (chain != lastChain_) {
+    lastChain_ = chain;
+    chainSwaps_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // single writer ( the audio thread ): plain read-modify-write is enough
+  uint64_t elapsed = GetSystemTimeNs() - start;
+  uint64_t budget = static_cast<uint64_t>(numFrames) * 10000000000ULL *
+                    kBudgetPercent / sampleRate_;
+  blocks_.store(blocks_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  totalNs_.store(totalNs_.load(std::memory_order_relaxed) + elapsed,
+                 std::memory_order_relaxed);
+  if (elapsed > maxNs_.load(std::memory_order_relaxed)) {
+    maxNs_.store(elapsed, std::memory_order_relaxed);
+  }
+  if (elapsed > budget) {
+    overruns_.store(overruns_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+  }
+}
+
+void AudioEffectGraph::getStats(AudioEffectGraphStats *stats) const {
+  stats->blocks_ = blocks_.load(std::memory_order_relaxed);
+  stats->totalNs_ = totalNs_.load(std::memory_order_relaxed);
+  stats->maxNs_ = maxNs_.load(std::memory_order_relaxed);
+  stats->overruns_ = overruns_.load(std::memory_order_relaxed);
+  stats->chainSwaps_ = chainSwaps_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_EFFECT_GRAPH_H
+#define AUDIO_EFFECT_GRAPH_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "audio_common.h"
+#include "audio_effect.h"
+
+/*
+ * Timing of AudioEffectGraph::process(), updated by the audio thread and
+ * readable from any thread.
+ */
+struct AudioEffectGraphStats {
+  uint64_t blocks_;      // process() calls
+  uint64_t totalNs_;     // time spent in process()
+  uint64_t maxNs_;       // slowest block
+  uint64_t overruns_;    // blocks over the per-callback budget
+  uint64_t chainSwaps_;  // commit()s picked up by the audio thread
+};
+
+/*
+ * AudioEffectGraph: the effects run on every recorded block.
+ *
+ * Nodes are added, wired and removed from a control thread; nothing of it
+ * reaches the audio thread until commit(), which sorts the nodes feeding
+ * the output topologically, assigns each one a buffer (in place when it
+ * has a single input nobody else reads, otherwise a scratch buffer from
+ * a SampleBufferPool) and swaps the compiled chain in with one atomic
+ * store. The audio thread only walks the compiled chain: no allocation and
+ * no lock. A replaced chain, and any node removed with it, is freed by
+ * commit() once the audio thread has left it.
+ *
+ * A node with several inputs gets their saturated sum. kLiveInput is the
+ * recorded block; with no output node set the block passes through.
+ */
+class AudioEffectGraph {
+ public:
+  static const int32_t kLiveInput = -1;
+  static const int32_t kMaxInputs = 4;
+  static const uint32_t kBudgetPercent = 50;  // of the block duration
+
+  explicit AudioEffectGraph(int32_t sampleRate, int32_t channelCount,
+                            uint32_t maxFramesPerBlock);
+  ~AudioEffectGraph();
+
+  // control thread side: changes take effect at commit()
+  int32_t addNode(AudioEffectNode *node);  // takes ownership, returns id
+  bool removeNode(int32_t id);
+  bool connect(int32_t from, int32_t to);
+  void disconnectAll(void);
+  bool setOutput(int32_t id);
+  bool setChain(const std::vector<int32_t> &order);  // live->order[0]->...
+  bool commit(void);
+
+  // audio thread side
+  void process(int16_t *liveAudio, int32_t numFrames);
+  void getStats(AudioEffectGraphStats *stats) const;
+
+ private:
+  struct Step {
+    AudioEffectNode *node_;
+    int32_t out_;  // buffer slot, 0 is the live block
+    int32_t in_[kMaxInputs];
+    int32_t inCount_;
+  };
+  struct CompiledChain {
+    std::vector<Step> steps_;
+    std::unique_ptr<SampleBufferPool> scratch_;
+    int32_t outSlot_ = 0;
+  };
+
+  int32_t sampleRate_;  // milliHertz
+  int32_t channelCount_;
+  uint32_t maxFrames_;
+
+  // control thread side, serialized by lock_
+  std::mutex lock_;
+  std::vector<std::unique_ptr<AudioEffectNode>> nodes_;  // id -> node
+  std::vector<std::pair<int32_t, int32_t>> edges_;
+  std::vector<std::unique_ptr<AudioEffectNode>> removed_;
+  int32_t output_ = kLiveInput;
+
+  std::atomic<CompiledChain *> chain_{nullptr};
+  std::atomic<CompiledChain *> active_{nullptr};  // chain in audio thread use
+
+  std::atomic<uint64_t> blocks_{0};
+  std::atomic<uint64_t> totalNs_{0};
+  std::atomic<uint64_t> maxNs_{0};
+  std::atomic<uint64_t> overruns_{0};
+  std::atomic<uint64_t> chainSwaps_{0};
+  CompiledChain *lastChain_ = nullptr;  // audio thread
+
+  bool validId(int32_t id) const;
+  CompiledChain *compile(void);
+  void retire(CompiledChain *chain);
+  void run(CompiledChain *chain, int16_t *liveAudio, int32_t numFrames);
+};
+
+#endif  // AUDIO_EFFECT_GRAPH_H
@@ -17,6 +17,7 @@
 #include "audio_recorder.h"
 #include "audio_player.h"
 #include "audio_effect.h"
+#include "audio_effect_graph.h"
 #include "audio_common.h"
 #include <jni.h>
 #include <SLES/OpenSLES_Android.h>
@@ -35,15 +36,16 @@ struct EchoAudioEngine {
 
   AudioRecorder *recorder_;
   AudioPlayer *player_;
-  AudioQueue *freeBufQueue_;  // Owner of the queue
+  AudioBufPool *freeBufQueue_;  // Owner of the queue
   AudioQueue *recBufQueue_;   // Owner of the queue
 
-  sample_buf *bufs_;
+  SampleBufferPool *bufPool_;  // Owner of the sample buffers
   uint32_t bufCount_;
   uint32_t frameCount_;
   int64_t echoDelay_;
   float echoDecay_;
-  AudioDelay *delayEffect_;
+  AudioDelay *delayEffect_;      // owned by effectGraph_
+  AudioEffectGraph *effectGraph_;
 };
 static EchoAudioEngine engine;
 
@@ -82,14 +84,14 @@ JNIEXPORT void JNICALL Java_com_google_sample_echo_MainActivity_createSLEngine(
                      engine.bitsPerSample_;
   bufSize = (bufSize + 7) >> 3;  // bits --> byte
   engine.bufCount_ = BUF_COUNT;
-  engine.bufs_ = allocateSampleBufs(engine.bufCount_, bufSize);
-  assert(engine.bufs_);
+  engine.bufPool_ = SampleBufferPool::create(engine.bufCount_, bufSize);
+  assert(engine.bufPool_);
 
-  engine.freeBufQueue_ = new AudioQueue(engine.bufCount_);
+  engine.freeBufQueue_ = new AudioBufPool(engine.bufCount_);
   engine.recBufQueue_ = new AudioQueue(engine.bufCount_);
   assert(engine.freeBufQueue_ && engine.recBufQueue_);
   for (uint32_t i = 0; i < engine.bufCount_; i++) {
-    engine.freeBufQueue_->push(&engine.bufs_[i]);
+    engine.freeBufQueue_->push(engine.bufPool_->buf(i));
   }
 
   engine.echoDelay_ = delayInMs;
@@ -98,6 +100,29 @@ JNIEXPORT void JNICALL Java_com_google_sample_echo_MainActivity_createSLEngine(
       engine.fastPathSampleRate_, engine.sampleChannels_, engine.bitsPerSample_,
       engine.echoDelay_, engine.echoDecay_);
   assert(engine.delayEffect_);
+
+  // recorded audio -> rumble filter -> gain -> echo -> limiter -> player
+  engine.effectGraph_ =
+      new AudioEffectGraph(engine.fastPathSampleRate_, engine.sampleChannels_,
+                           engine.fastPathFramesPerBuf_);
+  assert(engine.effectGraph_);
+  AudioEffectGraph *graph = engine.effectGraph_;
+  std::vector<int32_t> chain = {
+      graph->addNode(new BiquadEq(
+          engine.fastPathSampleRate_, engine.sampleChannels_,
+          engine.bitsPerSample_, BiquadEq::HIGH_PASS, 80.0f, 0.707f, 0.0f)),
+      graph->addNode(new AudioGain(engine.fastPathSampleRate_,
+                                   engine.sampleChannels_,
+                                   engine.bitsPerSample_, 1.0f)),
+      graph->addNode(engine.delayEffect_),
+      graph->addNode(new AudioLimiter(engine.fastPathSampleRate_,
+                                      engine.sampleChannels_,
+                                      engine.bitsPerSample_, -1.0f, 50.0f)),
+  };
+  graph->setChain(chain);
+  if (!graph->commit()) {
+    LOGE("====Failed to build the effect chain, audio passes through");
+  }
 }
 
 JNIEXPORT jboolean JNICALL
@@ -189,44 +214,80 @@ Java_com_google_sample_echo_MainActivity_stopPlay(JNIEnv *env, jclass type) {
   engine.recorder_->Stop();
   engine.player_->Stop();
 
+  AudioDelayStats stats;
+  engine.delayEffect_->getStats(&stats);
+  LOGI("====Echo effect: %llu blocks, avg %llu ns, max %llu ns, %llu param swaps",
+       (unsigned long long)stats.blocks_,
+       (unsigned long long)(stats.blocks_ ? stats.totalNs_ / stats.blocks_ : 0),
+       (unsigned long long)stats.maxNs_, (unsigned long long)stats.paramSwaps_);
+  AudioEffectGraphStats graphStats;
+  engine.effectGraph_->getStats(&graphStats);
+  LOGI("====Effect graph: %llu blocks, avg %llu ns, max %llu ns, %llu over "
+       "budget",
+       (unsigned long long)graphStats.blocks_,
+       (unsigned long long)(graphStats.blocks_
+                                ? graphStats.totalNs_ / graphStats.blocks_
+                                : 0),
+       (unsigned long long)graphStats.maxNs_,
+       (unsigned long long)graphStats.overruns_);
+
+  LOGI("====Echo latency estimate: %u us",
+       engine.player_->GetLatencyEstimateUs());
+
   delete engine.recorder_;
   delete engine.player_;
   engine.recorder_ = NULL;
   engine.player_ = NULL;
 }
 
+/*
+ * Current play-out latency estimate of the jitter buffer ( recorded buffer
+ * handed over -> start of playback ), in ms; 0 when not playing.
+ */
+JNIEXPORT jint JNICALL
+Java_com_google_sample_echo_MainActivity_getLatencyEstimate(JNIEnv *env,
+                                                            jclass type) {
+  if (!engine.player_) return 0;
+  return static_cast<jint>((engine.player_->GetLatencyEstimateUs() + 500) /
+                           1000);
+}
+
 JNIEXPORT void JNICALL Java_com_google_sample_echo_MainActivity_deleteSLEngine(
     JNIEnv *env, jclass type) {
   delete engine.recBufQueue_;
   delete engine.freeBufQueue_;
-  releaseSampleBufs(engine.bufs_, engine.bufCount_);
+  delete engine.bufPool_;
+  engine.bufPool_ = nullptr;
   if (engine.slEngineObj_ != NULL) {
     (*engine.slEngineObj_)->Destroy(engine.slEngineObj_);
     engine.slEngineObj_ = NULL;
     engine.slEngineItf_ = NULL;
   }
 
-  if (engine.delayEffect_) {
-    delete engine.delayEffect_;
+  if (engine.effectGraph_) {
+    delete engine.effectGraph_;
+    engine.effectGraph_ = nullptr;
     engine.delayEffect_ = nullptr;
   }
 }
 
 uint32_t dbgEngineGetBufCount(void) {
-  uint32_t count = engine.player_->dbgGetDevBufCount();
-  count += engine.recorder_->dbgGetDevBufCount();
-  count += engine.freeBufQueue_->size();
-  count += engine.recBufQueue_->size();
+  uint32_t held[BUF_OWNER_COUNT];
+  held[BUF_OWNER_FREE] = engine.freeBufQueue_->size();
+  held[BUF_OWNER_RECORDER] = engine.recorder_->dbgGetDevBufCount();
+  held[BUF_OWNER_RECORDED] = engine.recBufQueue_->size();
+  held[BUF_OWNER_PLAYER] = engine.player_->dbgGetDevBufCount();
 
   LOGE(
       "Buf Disrtibutions: PlayerDev=%d, RecDev=%d, FreeQ=%d, "
       "RecQ=%d",
-      engine.player_->dbgGetDevBufCount(),
-      engine.recorder_->dbgGetDevBufCount(), engine.freeBufQueue_->size(),
-      engine.recBufQueue_->size());
-  if (count != engine.bufCount_) {
-    LOGE("====Lost Bufs among the queue(supposed = %d, found = %d)", BUF_COUNT,
-         count);
+      held[BUF_OWNER_PLAYER], held[BUF_OWNER_RECORDER], held[BUF_OWNER_FREE],
+      held[BUF_OWNER_RECORDED]);
+  engine.bufPool_->audit(held);
+
+  uint32_t count = 0;
+  for (uint32_t owner = 0; owner < BUF_OWNER_COUNT; owner++) {
+    count += held[owner];
   }
   return count;
 }
@@ -242,12 +303,13 @@ bool EngineService(void *ctx, uint32_t msg, void *data) {
       break;
     }
     case ENGINE_SERVICE_MSG_RECORDED_AUDIO_AVAILABLE: {
-      // adding audio delay effect
+      // run the effect chain ( echo delay etc. )
       sample_buf *buf = static_cast<sample_buf *>(data);
       assert(engine.fastPathFramesPerBuf_ ==
              buf->size_ / engine.sampleChannels_ / (engine.bitsPerSample_ / 8));
-      engine.delayEffect_->process(reinterpret_cast<int16_t *>(buf->buf_),
+      engine.effectGraph_->process(reinterpret_cast<int16_t *>(buf->buf_),
                                    engine.fastPathFramesPerBuf_);
+      if (engine.player_) engine.player_->NotifyRecordedBuffer();
       break;
     }
     default:
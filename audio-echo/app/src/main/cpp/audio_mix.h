@@ -0,0 +1,124 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_MIX_H
+#define AUDIO_MIX_H
+
+#include <climits>
+#include <cstdint>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUDIO_MIX_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_MIX_SSE2 1
+#endif
+
+/*
+ * Echo mixing kernels used by the delay line. For every sample:
+ *     feedback[i] = saturate(delayed[i] * fbFactor + live[i] * liveFactor)
+ *     live[i]     = delayed[i]
+ * The int16 version works in Q7 ( factors add up to kMixFactorOne ) and
+ * rounds toward -inf, identically in C, NEON and SSE2. The float version
+ * clamps to [-1.0, 1.0].
+ *
+ * feedback may be the very same buffer as delayed, but must not otherwise
+ * overlap it or live.
+ */
+static const int32_t kMixFactorShift = 7;
+static const int32_t kMixFactorOne = 1 << kMixFactorShift;
+
+__inline__ void mixEchoI16(int16_t* live, const int16_t* delayed,
+                           int16_t* feedback, int32_t count, int16_t fbFactor,
+                           int16_t liveFactor) {
+  int32_t idx = 0;
+#if defined(AUDIO_MIX_NEON)
+  for (; idx + 8 <= count; idx += 8) {
+    int16x8_t d = vld1q_s16(delayed + idx);
+    int16x8_t x = vld1q_s16(live + idx);
+    int32x4_t lo = vmull_n_s16(vget_low_s16(d), fbFactor);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(d), fbFactor);
+    lo = vmlal_n_s16(lo, vget_low_s16(x), liveFactor);
+    hi = vmlal_n_s16(hi, vget_high_s16(x), liveFactor);
+    vst1q_s16(feedback + idx, vcombine_s16(vqshrn_n_s32(lo, kMixFactorShift),
+                                           vqshrn_n_s32(hi, kMixFactorShift)));
+    vst1q_s16(live + idx, d);
+  }
+#elif defined(AUDIO_MIX_SSE2)
+  // (delayed, live) pairs against (fbFactor, liveFactor) in one madd
+  const __m128i factors = _mm_set1_epi32(
+      static_cast<int32_t>((static_cast<uint32_t>(liveFactor) << 16) |
+                           static_cast<uint16_t>(fbFactor)));
+  for (; idx + 8 <= count; idx += 8) {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(delayed + idx));
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(live + idx));
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(d, x), factors);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(d, x), factors);
+    lo = _mm_srai_epi32(lo, kMixFactorShift);
+    hi = _mm_srai_epi32(hi, kMixFactorShift);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(feedback + idx),
+                     _mm_packs_epi32(lo, hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(live + idx), d);
+  }
+#endif
+  for (; idx < count; idx++) {
+    int16_t d = delayed[idx];
+    int32_t mixed = (d * fbFactor + live[idx] * liveFactor) >> kMixFactorShift;
+    mixed = mixed > SHRT_MAX ? SHRT_MAX : mixed;
+    mixed = mixed < SHRT_MIN ? SHRT_MIN : mixed;
+    feedback[idx] = static_cast<int16_t>(mixed);
+    live[idx] = d;
+  }
+}
+
+__inline__ void mixEchoF32(float* live, const float* delayed, float* feedback,
+                           int32_t count, float fbWeight, float liveWeight) {
+  int32_t idx = 0;
+#if defined(AUDIO_MIX_NEON)
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t minusOne = vdupq_n_f32(-1.0f);
+  for (; idx + 4 <= count; idx += 4) {
+    float32x4_t d = vld1q_f32(delayed + idx);
+    float32x4_t x = vld1q_f32(live + idx);
+    float32x4_t mixed = vmlaq_n_f32(vmulq_n_f32(d, fbWeight), x, liveWeight);
+    vst1q_f32(feedback + idx, vmaxq_f32(vminq_f32(mixed, one), minusOne));
+    vst1q_f32(live + idx, d);
+  }
+#elif defined(AUDIO_MIX_SSE2)
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 minusOne = _mm_set1_ps(-1.0f);
+  const __m128 fb = _mm_set1_ps(fbWeight);
+  const __m128 lv = _mm_set1_ps(liveWeight);
+  for (; idx + 4 <= count; idx += 4) {
+    __m128 d = _mm_loadu_ps(delayed + idx);
+    __m128 x = _mm_loadu_ps(live + idx);
+    __m128 mixed = _mm_add_ps(_mm_mul_ps(d, fb), _mm_mul_ps(x, lv));
+    _mm_storeu_ps(feedback + idx, _mm_max_ps(_mm_min_ps(mixed, one), minusOne));
+    _mm_storeu_ps(live + idx, d);
+  }
+#endif
+  for (; idx < count; idx++) {
+    float d = delayed[idx];
+    float mixed = d * fbWeight + live[idx] * liveWeight;
+    mixed = mixed > 1.0f ? 1.0f : mixed;
+    mixed = mixed < -1.0f ? -1.0f : mixed;
+    feedback[idx] = mixed;
+    live[idx] = d;
+  }
+}
+
+#endif  // AUDIO_MIX_H
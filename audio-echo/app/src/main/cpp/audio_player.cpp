@@ -13,6 +13,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <cstdlib>
 #include "audio_player.h"
 
@@ -55,42 +56,103 @@ void AudioPlayer::ProcessSLCallback(SLAndroidSimpleBufferQueueItf bq) {
 
   if (buf != &silentBuf_) {
     buf->size_ = 0;
+    SampleBufferPool::transfer(buf, BUF_OWNER_PLAYER, BUF_OWNER_FREE);
     freeQueue_->push(buf);
+  } else {
+    silentInDev_--;
+  }
 
-    if (!playQueue_->front(&buf)) {
-#ifdef ENABLE_LOG
-      logFile_->log("%s", "====Warning: running out of the Audio buffers");
-#endif
+  if (!kickstarted_) {
+    uint32_t depth = jitter_.GetTargetDepth();
+    if (playQueue_->size() < depth) {
+      (*bq)->Enqueue(bq, silentBuf_.buf_, silentBuf_.size_);
+      devShadowQueue_->push(&silentBuf_);
+      silentInDev_++;
       return;
     }
 
-    devShadowQueue_->push(buf);
-    (*bq)->Enqueue(bq, buf->buf_, buf->size_);
-    playQueue_->pop();
+    depth = std::min(depth, DEVICE_SHADOW_BUFFER_QUEUE_LEN -
+                                devShadowQueue_->size());
+    for (uint32_t idx = 0; idx < depth; idx++) {
+      playQueue_->front(&buf);
+      playQueue_->pop();
+      SampleBufferPool::transfer(buf, BUF_OWNER_RECORDED, BUF_OWNER_PLAYER);
+      devShadowQueue_->push(buf);
+      (*bq)->Enqueue(bq, buf->buf_, buf->size_);
+    }
+    kickstarted_ = true;
     return;
   }
 
-  if (playQueue_->size() < PLAY_KICKSTART_BUFFER_COUNT) {
-    (*bq)->Enqueue(bq, buf->buf_, buf->size_);
-    devShadowQueue_->push(&silentBuf_);
-    return;
+  JitterBuffer::Action action = jitter_.OnPlayerCallback(
+      GetSystemTicks(), devShadowQueue_->size(), playQueue_->size());
+  switch (action) {
+    case JitterBuffer::WAIT:
+#ifdef ENABLE_LOG
+      logFile_->log("%s", "====Warning: running out of the Audio buffers");
+#endif
+      return;
+    case JitterBuffer::INSERT_SILENCE:
+      (*bq)->Enqueue(bq, silentBuf_.buf_, silentBuf_.size_);
+      devShadowQueue_->push(&silentBuf_);
+      silentInDev_++;
+      return;
+    case JitterBuffer::DROP_AND_PLAY:
+      playQueue_->front(&buf);
+      playQueue_->pop();
+      buf->size_ = 0;
+      SampleBufferPool::transfer(buf, BUF_OWNER_RECORDED, BUF_OWNER_FREE);
+      freeQueue_->push(buf);
+      break;
+    default:
+      break;
+  }
+
+  playQueue_->front(&buf);
+  playQueue_->pop();
+  SampleBufferPool::transfer(buf, BUF_OWNER_RECORDED, BUF_OWNER_PLAYER);
+  if (action == JitterBuffer::PLAY_SHORTENED) {
+    uint32_t frameSize = buf->size_ / sampleInfo_.framesPerBuf_;
+    uint32_t dropFrames = jitter_.GetShortenFrames();
+    JitterBuffer::ShortenBuffer(reinterpret_cast<int16_t *>(buf->buf_),
+                                sampleInfo_.framesPerBuf_,
+                                sampleInfo_.channels_, dropFrames);
+    buf->size_ -= dropFrames * frameSize;
   }
+  devShadowQueue_->push(buf);
+  (*bq)->Enqueue(bq, buf->buf_, buf->size_);
 
-  assert(PLAY_KICKSTART_BUFFER_COUNT <=
-         (DEVICE_SHADOW_BUFFER_QUEUE_LEN - devShadowQueue_->size()));
-  for (int32_t idx = 0; idx < PLAY_KICKSTART_BUFFER_COUNT; idx++) {
-    playQueue_->front(&buf);
+  // the target went up: give the device more to chew on
+  uint32_t devDepth = std::min<uint32_t>(jitter_.GetTargetDepth(),
+                                         DEVICE_SHADOW_BUFFER_QUEUE_LEN);
+  while (devShadowQueue_->size() < devDepth && playQueue_->front(&buf)) {
     playQueue_->pop();
+    SampleBufferPool::transfer(buf, BUF_OWNER_RECORDED, BUF_OWNER_PLAYER);
     devShadowQueue_->push(buf);
     (*bq)->Enqueue(bq, buf->buf_, buf->size_);
   }
 }
 
+/*
+ * Called on the recorder's callback thread for every recorded buffer
+ * handed over, so the jitter buffer sees both sides of the pipe.
+ */
+void AudioPlayer::NotifyRecordedBuffer(void) {
+  jitter_.OnRecorderCallback(GetSystemTicks());
+}
+
+uint32_t AudioPlayer::GetLatencyEstimateUs(void) const {
+  return jitter_.GetLatencyEstimateUs();
+}
+
 AudioPlayer::AudioPlayer(SampleFormat *sampleFormat, SLEngineItf slEngine)
     : freeQueue_(nullptr),
       playQueue_(nullptr),
       devShadowQueue_(nullptr),
-      callback_(nullptr) {
+      callback_(nullptr),
+      jitter_(sampleFormat->framesPerBuf_, sampleFormat->sampleRate_,
+              PLAY_KICKSTART_BUFFER_COUNT, BUF_COUNT / 2),
+      kickstarted_(false) {
   SLresult result;
   assert(sampleFormat);
   sampleInfo_ = *sampleFormat;
@@ -159,6 +221,9 @@ AudioPlayer::AudioPlayer(SampleFormat *sampleFormat, SLEngineItf slEngine)
   silentBuf_.buf_ = new uint8_t[silentBuf_.cap_];
   memset(silentBuf_.buf_, 0, silentBuf_.cap_);
   silentBuf_.size_ = silentBuf_.cap_;
+  silentBuf_.pool_ = nullptr;
+  silentBuf_.index_ = 0;
+  silentInDev_ = 0;
 
 #ifdef ENABLE_LOG
   std::string name = "play";
@@ -177,8 +242,10 @@ AudioPlayer::~AudioPlayer() {
   // Consume all non-completed audio buffers
   sample_buf *buf = NULL;
   while (devShadowQueue_->front(&buf)) {
-    buf->size_ = 0;
     devShadowQueue_->pop();
+    if (buf == &silentBuf_) continue;
+    buf->size_ = 0;
+    SampleBufferPool::transfer(buf, BUF_OWNER_PLAYER, BUF_OWNER_FREE);
     freeQueue_->push(buf);
   }
   delete devShadowQueue_;
@@ -186,6 +253,7 @@ AudioPlayer::~AudioPlayer() {
   while (playQueue_->front(&buf)) {
     buf->size_ = 0;
     playQueue_->pop();
+    SampleBufferPool::transfer(buf, BUF_OWNER_RECORDED, BUF_OWNER_FREE);
     freeQueue_->push(buf);
   }
 
@@ -197,7 +265,7 @@ AudioPlayer::~AudioPlayer() {
   delete[] silentBuf_.buf_;
 }
 
-void AudioPlayer::SetBufQueue(AudioQueue *playQ, AudioQueue *freeQ) {
+void AudioPlayer::SetBufQueue(AudioQueue *playQ, AudioBufPool *freeQ) {
   playQueue_ = playQ;
   freeQueue_ = freeQ;
 }
@@ -215,11 +283,13 @@ SLresult AudioPlayer::Start(void) {
   result = (*playItf_)->SetPlayState(playItf_, SL_PLAYSTATE_STOPPED);
   SLASSERT(result);
 
+  kickstarted_ = false;
   result =
       (*playBufferQueueItf_)
           ->Enqueue(playBufferQueueItf_, silentBuf_.buf_, silentBuf_.size_);
   SLASSERT(result);
   devShadowQueue_->push(&silentBuf_);
+  silentInDev_++;
 
   result = (*playItf_)->SetPlayState(playItf_, SL_PLAYSTATE_PLAYING);
   SLASSERT(result);
@@ -253,6 +323,7 @@ void AudioPlayer::RegisterCallback(ENGINE_CALLBACK cb, void *ctx) {
   ctx_ = ctx;
 }
 
+// pooled buffers with the device; silentBuf_ is not one of them
 uint32_t AudioPlayer::dbgGetDevBufCount(void) {
-  return (devShadowQueue_->size());
+  return (devShadowQueue_->size() - silentInDev_);
 }
\ No newline at end of file
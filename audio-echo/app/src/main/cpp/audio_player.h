@@ -20,6 +20,7 @@
 #include "audio_common.h"
 #include "buf_manager.h"
 #include "debug_utils.h"
+#include "jitter_buffer.h"
 
 class AudioPlayer {
   // buffer queue player interfaces
@@ -29,13 +30,16 @@ class AudioPlayer {
   SLAndroidSimpleBufferQueueItf playBufferQueueItf_;
 
   SampleFormat sampleInfo_;
-  AudioQueue *freeQueue_;       // user
+  AudioBufPool *freeQueue_;     // user
   AudioQueue *playQueue_;       // user
   AudioQueue *devShadowQueue_;  // owner
 
   ENGINE_CALLBACK callback_;
   void *ctx_;
   sample_buf silentBuf_;
+  uint32_t silentInDev_;  // silentBuf_ entries in devShadowQueue_
+  JitterBuffer jitter_;
+  bool kickstarted_;
 #ifdef ENABLE_LOG
   AndroidLog *logFile_;
 #endif
@@ -44,10 +48,12 @@ class AudioPlayer {
  public:
   explicit AudioPlayer(SampleFormat *sampleFormat, SLEngineItf engine);
   ~AudioPlayer();
-  void SetBufQueue(AudioQueue *playQ, AudioQueue *freeQ);
+  void SetBufQueue(AudioQueue *playQ, AudioBufPool *freeQ);
   SLresult Start(void);
   void Stop(void);
   void ProcessSLCallback(SLAndroidSimpleBufferQueueItf bq);
+  void NotifyRecordedBuffer(void);
+  uint32_t GetLatencyEstimateUs(void) const;
   uint32_t dbgGetDevBufCount(void);
   void RegisterCallback(ENGINE_CALLBACK cb, void *ctx);
 };
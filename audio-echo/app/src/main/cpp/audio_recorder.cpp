@@ -35,13 +35,16 @@ void AudioRecorder::ProcessSLCallback(SLAndroidSimpleBufferQueueItf bq) {
   devShadowQueue_->pop();
   dataBuf->size_ = dataBuf->cap_;  // device only calls us when it is really
                                    // full
+  SampleBufferPool::transfer(dataBuf, BUF_OWNER_RECORDER, BUF_OWNER_RECORDED);
 
   callback_(ctx_, ENGINE_SERVICE_MSG_RECORDED_AUDIO_AVAILABLE, dataBuf);
   recQueue_->push(dataBuf);
 
   sample_buf *freeBuf;
-  while (freeQueue_->front(&freeBuf) && devShadowQueue_->push(freeBuf)) {
-    freeQueue_->pop();
+  while (devShadowQueue_->size() < DEVICE_SHADOW_BUFFER_QUEUE_LEN &&
+         freeQueue_->pop(&freeBuf)) {
+    SampleBufferPool::transfer(freeBuf, BUF_OWNER_FREE, BUF_OWNER_RECORDER);
+    devShadowQueue_->push(freeBuf);
     SLresult result = (*bq)->Enqueue(bq, freeBuf->buf_, freeBuf->cap_);
     SLASSERT(result);
   }
@@ -138,12 +141,12 @@ SLboolean AudioRecorder::Start(void) {
 
   for (int i = 0; i < RECORD_DEVICE_KICKSTART_BUF_COUNT; i++) {
     sample_buf *buf = NULL;
-    if (!freeQueue_->front(&buf)) {
+    if (!freeQueue_->pop(&buf)) {
       LOGE("=====OutOfFreeBuffers @ startingRecording @ (%d)", i);
       break;
     }
-    freeQueue_->pop();
     assert(buf->buf_ && buf->cap_ && !buf->size_);
+    SampleBufferPool::transfer(buf, BUF_OWNER_FREE, BUF_OWNER_RECORDER);
 
     result = (*recBufQueueItf_)->Enqueue(recBufQueueItf_, buf->buf_, buf->cap_);
     SLASSERT(result);
@@ -187,6 +190,7 @@ AudioRecorder::~AudioRecorder() {
     sample_buf *buf = NULL;
     while (devShadowQueue_->front(&buf)) {
       devShadowQueue_->pop();
+      SampleBufferPool::transfer(buf, BUF_OWNER_RECORDER, BUF_OWNER_FREE);
       freeQueue_->push(buf);
     }
     delete (devShadowQueue_);
@@ -198,7 +202,7 @@ AudioRecorder::~AudioRecorder() {
 #endif
 }
 
-void AudioRecorder::SetBufQueues(AudioQueue *freeQ, AudioQueue *recQ) {
+void AudioRecorder::SetBufQueues(AudioBufPool *freeQ, AudioQueue *recQ) {
   assert(freeQ && recQ);
   freeQueue_ = freeQ;
   recQueue_ = recQ;
@@ -29,7 +29,7 @@ class AudioRecorder {
   SLAndroidSimpleBufferQueueItf recBufQueueItf_;
 
   SampleFormat sampleInfo_;
-  AudioQueue *freeQueue_;       // user
+  AudioBufPool *freeQueue_;     // user
   AudioQueue *recQueue_;        // user
   AudioQueue *devShadowQueue_;  // owner
   uint32_t audioBufCount;
@@ -42,7 +42,7 @@ class AudioRecorder {
   ~AudioRecorder();
   SLboolean Start(void);
   SLboolean Stop(void);
-  void SetBufQueues(AudioQueue *freeQ, AudioQueue *recQ);
+  void SetBufQueues(AudioBufPool *freeQ, AudioQueue *recQ);
   void ProcessSLCallback(SLAndroidSimpleBufferQueueItf bq);
   void RegisterCallback(ENGINE_CALLBACK cb, void *ctx);
   int32_t dbgGetDevBufCount(void);
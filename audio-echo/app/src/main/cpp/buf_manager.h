@@ -15,32 +15,44 @@
  */
 #ifndef NATIVE_AUDIO_BUF_MANAGER_H
 #define NATIVE_AUDIO_BUF_MANAGER_H
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <SLES/OpenSLES.h>
 #include <atomic>
 #include <cassert>
+#include <cstring>
 #include <memory>
 #include <limits>
+#include "android_debug.h"
 
 #ifndef CACHE_ALIGN
 #define CACHE_ALIGN 64
 #endif
 
+/*
+ * smallest power of 2 that is >= val ( val must be > 0 )
+ */
+__inline__ uint32_t roundUpPowerOf2(uint32_t val) {
+  assert(val && val <= (1u << 31));
+  return val <= 1 ? 1 : (1u << (32 - __builtin_clz(val - 1)));
+}
+
 /*
  * ProducerConsumerQueue, borrowed from Ian NiLewis
+ *   single producer / single consumer. When the slot storage is a power
+ *   of 2 (always the case when the queue allocates it), read/write
+ *   positions map to slots with a mask instead of a divide.
  */
 template <typename T>
 class ProducerConsumerQueue {
  public:
   explicit ProducerConsumerQueue(int size)
-      : ProducerConsumerQueue(size, new T[size]) {}
+      : ProducerConsumerQueue(size, new T[roundUpPowerOf2(size)],
+                              roundUpPowerOf2(size)) {}
 
+  // buffer must hold size items, the queue takes the ownership of it
   explicit ProducerConsumerQueue(int size, T* buffer)
-      : size_(size), buffer_(buffer) {
-    // This is necessary because we depend on twos-complement wraparound
-    // to take care of overflow conditions.
-    assert(size < std::numeric_limits<int>::max());
-  }
+      : ProducerConsumerQueue(size, buffer, size) {}
 
   bool push(const T& item) {
     return push([&](T* ptr) -> bool {
@@ -98,7 +110,7 @@ class ProducerConsumerQueue {
       result = true;
 
       // writer
-      if (writer(buffer_.get() + (writeptr % size_))) {
+      if (writer(slot(writeptr))) {
         ++writeptr;
         write_.store(writeptr, std::memory_order_release);
       }
@@ -130,7 +142,7 @@ class ProducerConsumerQueue {
     int available = (int)(writeptr - readptr);
     if (available >= 1) {
       result = true;
-      reader(buffer_.get() + (readptr % size_));
+      reader(slot(readptr));
     }
 
     return result;
@@ -143,8 +155,29 @@ class ProducerConsumerQueue {
   }
 
  private:
-  int size_;
-  std::unique_ptr<T> buffer_;
+  ProducerConsumerQueue(int size, T* buffer, int storage)
+      : size_(size),
+        storage_(storage),
+        mask_((storage & (storage - 1)) ? 0 : storage - 1),
+        buffer_(buffer) {
+    // This is necessary because we depend on twos-complement wraparound
+    // to take care of overflow conditions.
+    assert(size > 0 && size <= storage);
+    assert(size < std::numeric_limits<int>::max());
+  }
+
+  // positions wrap around at 2^32, so only a power of 2 storage keeps
+  // mapping them to the same slots across the wrap; the divide is only
+  // there for caller provided buffers of other sizes
+  T* slot(int pos) {
+    uint32_t idx = static_cast<uint32_t>(pos);
+    return buffer_.get() + (mask_ ? (idx & mask_) : (idx % storage_));
+  }
+
+  int size_;      // capacity seen by the user
+  int storage_;   // number of slots in buffer_
+  uint32_t mask_; // storage_ - 1 if storage_ is a power of 2, 0 otherwise
+  std::unique_ptr<T[]> buffer_;
 
   // forcing cache line alignment to eliminate false sharing of the
   // frequently-updated read and write pointers. The object is to never
@@ -154,49 +187,279 @@ class ProducerConsumerQueue {
   alignas(CACHE_ALIGN) std::atomic<int> write_{0};
 };
 
+/*
+ * MPMCQueue: bounded multi-producer / multi-consumer ring (Dmitry Vyukov's
+ * sequence number design). Each cell carries a sequence number telling
+ * whether it is ready for the producer or the consumer at a given lap, so
+ * a push/pop is one CAS on the shared position plus a release store on the
+ * cell; there is no lock, and threads never wait on each other's payload
+ * copy. Capacity is rounded up to a power of 2.
+ *
+ * push_n()/pop_n() claim a run of consecutive ready cells with a single
+ * CAS and return how many items were actually transferred.
+ */
+template <typename T>
+class MPMCQueue {
+ public:
+  explicit MPMCQueue(uint32_t size)
+      : mask_(roundUpPowerOf2(size < 2 ? 2 : size) - 1),
+        cells_(new Cell[mask_ + 1]) {
+    for (uint32_t i = 0; i <= mask_; i++) {
+      cells_[i].seq_.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool push(const T& item) { return push_n(&item, 1) == 1; }
+  bool pop(T* item) { return pop_n(item, 1) == 1; }
+
+  uint32_t push_n(const T* items, uint32_t count) {
+    uint32_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      uint32_t n = 0;
+      bool stale = false;
+      while (n < count) {
+        uint32_t seq = cells_[(pos + n) & mask_].seq_.load(
+            std::memory_order_acquire);
+        // 0: free for this lap; < 0: not consumed yet (full); > 0: stale pos
+        int32_t diff = static_cast<int32_t>(seq - (pos + n));
+        if (diff) {
+          stale = !n && diff > 0;
+          break;
+        }
+        ++n;
+      }
+      if (stale) {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (!n) return 0;
+      if (enqueuePos_.compare_exchange_weak(pos, pos + n,
+                                            std::memory_order_relaxed)) {
+        for (uint32_t i = 0; i < n; i++) {
+          Cell& cell = cells_[(pos + i) & mask_];
+          cell.data_ = items[i];
+          cell.seq_.store(pos + i + 1, std::memory_order_release);
+        }
+        return n;
+      }
+    }
+  }
+
+  uint32_t pop_n(T* items, uint32_t count) {
+    uint32_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+      uint32_t n = 0;
+      bool stale = false;
+      while (n < count) {
+        uint32_t seq = cells_[(pos + n) & mask_].seq_.load(
+            std::memory_order_acquire);
+        // 0: filled for this lap; < 0: not produced yet (empty); > 0: stale
+        int32_t diff = static_cast<int32_t>(seq - (pos + n + 1));
+        if (diff) {
+          stale = !n && diff > 0;
+          break;
+        }
+        ++n;
+      }
+      if (stale) {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (!n) return 0;
+      if (dequeuePos_.compare_exchange_weak(pos, pos + n,
+                                            std::memory_order_relaxed)) {
+        for (uint32_t i = 0; i < n; i++) {
+          Cell& cell = cells_[(pos + i) & mask_];
+          items[i] = cell.data_;
+          cell.seq_.store(pos + i + mask_ + 1, std::memory_order_release);
+        }
+        return n;
+      }
+    }
+  }
+
+  // a snapshot only: other threads may move either end at any time
+  uint32_t size(void) const {
+    uint32_t head = dequeuePos_.load(std::memory_order_acquire);
+    uint32_t tail = enqueuePos_.load(std::memory_order_acquire);
+    int32_t count = static_cast<int32_t>(tail - head);
+    return count < 0 ? 0 : static_cast<uint32_t>(count);
+  }
+  uint32_t capacity(void) const { return mask_ + 1; }
+
+ private:
+  struct Cell {
+    std::atomic<uint32_t> seq_;
+    T data_;
+  };
+  const uint32_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+
+  alignas(CACHE_ALIGN) std::atomic<uint32_t> enqueuePos_{0};
+  alignas(CACHE_ALIGN) std::atomic<uint32_t> dequeuePos_{0};
+};
+
+class SampleBufferPool;
 struct sample_buf {
   uint8_t* buf_;   // audio sample container
   uint32_t cap_;   // buffer capacity in byte
   uint32_t size_;  // audio sample size (n buf) in byte
+  SampleBufferPool* pool_;  // owning pool, nullptr for a stand-alone buffer
+  uint32_t index_;          // position in the pool
 };
 
 using AudioQueue = ProducerConsumerQueue<sample_buf*>;
+// free buffers are returned by the player and taken by the recorder(s)
+using AudioBufPool = MPMCQueue<sample_buf*>;
+
+/*
+ * Who holds a pooled buffer. Every hand-over between the queues goes
+ * through SampleBufferPool::transfer(); with SAMPLE_BUF_POOL_DEBUG ( on
+ * unless NDEBUG ) a hand-over from the wrong owner, e.g. returning a
+ * buffer twice to the free queue, is logged and counted.
+ */
+enum SampleBufOwner : uint32_t {
+  BUF_OWNER_FREE,      // free queue
+  BUF_OWNER_RECORDER,  // recorder device queue
+  BUF_OWNER_RECORDED,  // recorded, waiting in the play queue
+  BUF_OWNER_PLAYER,    // player device queue
+  BUF_OWNER_COUNT
+};
+#if !defined(NDEBUG) && !defined(SAMPLE_BUF_POOL_DEBUG)
+#define SAMPLE_BUF_POOL_DEBUG 1
+#endif
 
-__inline__ void releaseSampleBufs(sample_buf* bufs, uint32_t& count) {
-  if (!bufs || !count) {
-    return;
+/*
+ * SampleBufferPool: count buffers carved out of one page aligned arena.
+ * Every buffer starts on a cache line ( so at least SIMD aligned ) and the
+ * stride is padded off multiples of 4 KB, so the buffers do not all land
+ * in the same cache sets. The arena can ask for transparent huge pages.
+ * All buffers or nothing: create() returns nullptr on failure.
+ */
+class SampleBufferPool {
+ public:
+  static SampleBufferPool* create(uint32_t count, uint32_t sizeInByte,
+                                  bool hugePages = false) {
+    if (!count || count > kMaxCount || !sizeInByte) {
+      return nullptr;
+    }
+    uint32_t stride = (sizeInByte + CACHE_ALIGN - 1) & ~(CACHE_ALIGN - 1);
+    if (!(stride & (kPageSize - 1))) stride += CACHE_ALIGN;
+    size_t arenaSize = static_cast<size_t>(stride) * count;
+    arenaSize = (arenaSize + kPageSize - 1) & ~(size_t(kPageSize) - 1);
+
+    void* arena = mmap(nullptr, arenaSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+      LOGW("====Can not map %zu bytes for %d sample buffers in %s", arenaSize,
+           count, __FUNCTION__);
+      return nullptr;
+    }
+#ifdef MADV_HUGEPAGE
+    if (hugePages) madvise(arena, arenaSize, MADV_HUGEPAGE);
+#else
+    (void)hugePages;
+#endif
+    return new SampleBufferPool(count, sizeInByte, stride,
+                                static_cast<uint8_t*>(arena), arenaSize);
   }
-  for (uint32_t i = 0; i < count; i++) {
-    if (bufs[i].buf_) delete[] bufs[i].buf_;
+  ~SampleBufferPool() { munmap(arena_, arenaSize_); }
+
+  uint32_t count(void) const { return count_; }
+  sample_buf* buf(uint32_t idx) const {
+    assert(idx < count_);
+    return &bufs_[idx];
   }
-  delete[] bufs;
-}
-__inline__ sample_buf* allocateSampleBufs(uint32_t count, uint32_t sizeInByte) {
-  if (count <= 0 || sizeInByte <= 0) {
-    return nullptr;
-  }
-  sample_buf* bufs = new sample_buf[count];
-  assert(bufs);
-  memset(bufs, 0, sizeof(sample_buf) * count);
-
-  uint32_t allocSize = (sizeInByte + 3) & ~3;  // padding to 4 bytes aligned
-  uint32_t i;
-  for (i = 0; i < count; i++) {
-    bufs[i].buf_ = new uint8_t[allocSize];
-    if (bufs[i].buf_ == nullptr) {
-      LOGW("====Requesting %d buffers, allocated %d in %s", count, i,
-           __FUNCTION__);
-      break;
+
+  /*
+   * Hand a buffer over between owners. Stand-alone buffers
+   * ( pool_ == nullptr ) are ignored.
+   */
+  static void transfer(sample_buf* buf, SampleBufOwner from,
+                       SampleBufOwner to) {
+    SampleBufferPool* pool = buf->pool_;
+    if (!pool) return;
+    uint32_t cur =
+        pool->owner_[buf->index_].exchange(to, std::memory_order_relaxed);
+#ifdef SAMPLE_BUF_POOL_DEBUG
+    if (cur != from) {
+      pool->errors_.fetch_add(1, std::memory_order_relaxed);
+      LOGE("====sample_buf %d handed %s -> %s, but was %s", buf->index_,
+           ownerName(from), ownerName(to), ownerName(cur));
     }
-    bufs[i].cap_ = sizeInByte;
-    bufs[i].size_ = 0;  // 0 data in it
+#else
+    (void)from;
+#endif
+  }
+
+  /*
+   * Compare the owners on record with what the queues hold ( indexed by
+   * SampleBufOwner ). Only exact while no callback is running.
+   * @return true when every buffer is where it should be
+   */
+  bool audit(const uint32_t held[BUF_OWNER_COUNT]) const {
+    uint32_t total = 0;
+    for (uint32_t owner = 0; owner < BUF_OWNER_COUNT; owner++) {
+      total += held[owner];
+    }
+    bool ok = total == count_;
+    if (!ok) {
+      LOGE("====Lost Bufs among the queue(supposed = %d, found = %d)", count_,
+           total);
+    }
+#ifdef SAMPLE_BUF_POOL_DEBUG
+    uint32_t owned[BUF_OWNER_COUNT] = {0};
+    for (uint32_t idx = 0; idx < count_; idx++) {
+      owned[owner_[idx].load(std::memory_order_relaxed)]++;
+    }
+    for (uint32_t owner = 0; owner < BUF_OWNER_COUNT; owner++) {
+      if (owned[owner] != held[owner]) {
+        LOGE("====%d bufs owned by %s, %d found there", owned[owner],
+             ownerName(owner), held[owner]);
+        ok = false;
+      }
+    }
+    uint32_t errors = errors_.load(std::memory_order_relaxed);
+    if (errors) {
+      LOGE("====%d bad sample_buf hand-overs", errors);
+      ok = false;
+    }
+#endif
+    return ok;
   }
-  if (i < 2) {
-    releaseSampleBufs(bufs, i);
-    bufs = nullptr;
+
+ private:
+  static const uint32_t kMaxCount = 0xffff;
+  static const uint32_t kPageSize = 4096;
+
+  SampleBufferPool(uint32_t count, uint32_t sizeInByte, uint32_t stride,
+                   uint8_t* arena, size_t arenaSize)
+      : count_(count),
+        arena_(arena),
+        arenaSize_(arenaSize),
+        bufs_(new sample_buf[count]),
+        owner_(new std::atomic<uint32_t>[count]) {
+    for (uint32_t idx = 0; idx < count; idx++) {
+      bufs_[idx].buf_ = arena + static_cast<size_t>(stride) * idx;
+      bufs_[idx].cap_ = sizeInByte;
+      bufs_[idx].size_ = 0;  // 0 data in it
+      bufs_[idx].pool_ = this;
+      bufs_[idx].index_ = idx;
+      owner_[idx].store(BUF_OWNER_FREE, std::memory_order_relaxed);
+    }
   }
-  count = i;
-  return bufs;
-}
+  static const char* ownerName(uint32_t owner) {
+    static const char* kNames[BUF_OWNER_COUNT] = {"FreeQ", "RecDev", "RecQ",
+                                                  "PlayerDev"};
+    return owner < BUF_OWNER_COUNT ? kNames[owner] : "?";
+  }
+
+  const uint32_t count_;
+  uint8_t* const arena_;
+  const size_t arenaSize_;
+  std::unique_ptr<sample_buf[]> bufs_;
+  std::unique_ptr<std::atomic<uint32_t>[]> owner_;  // SampleBufOwner
+  std::atomic<uint32_t> errors_{0};
+};
 
 #endif  // NATIVE_AUDIO_BUF_MANAGER_H
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "jitter_buffer.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+/*
+ * Tuning: how long jitter peaks are remembered, how long the depth is
+ * watched before draining, how long an underrun keeps its extra buffer and
+ * how much of a buffer one shortening cuts ( 1/8: a ~12% speed-up for a
+ * few buffers, hard to hear on an echo ).
+ */
+static const float kJitterHalfLifeUs = 2000000.0f;
+static const uint64_t kWindowUs = 500000;
+static const uint64_t kBoostHoldUs = 10000000;
+static const uint32_t kShortenDivisor = 8;
+static const float kDepthSmoothing = 0.05f;
+// the buffer playing when the callback comes and the one to follow it
+static const uint32_t kMinDepth = 2;
+
+JitterBuffer::JitterBuffer(uint32_t framesPerBuf, uint32_t sampleRate,
+                           uint32_t initialDepth, uint32_t maxDepth)
+    : framesPerBuf_(framesPerBuf),
+      // sampleRate is in milliHertz, as everywhere in the engine
+      periodUs_(std::max<uint64_t>(static_cast<uint64_t>(framesPerBuf) *
+                                       1000000000ULL / sampleRate,
+                                   1)),
+      maxDepth_(std::max(maxDepth, kMinDepth)),
+      jitterDecay_(std::pow(0.5f, periodUs_ / kJitterHalfLifeUs)) {
+  windowLen_ = static_cast<uint32_t>(std::max<uint64_t>(kWindowUs / periodUs_,
+                                                        4));
+  // start where the fixed kickstart used to be and let the boost decay
+  initialDepth = std::min(std::max(initialDepth, kMinDepth), maxDepth_);
+  underrunBoost_ = initialDepth - kMinDepth;
+  depthEma_ = static_cast<float>(initialDepth);
+  targetDepth_.store(initialDepth);
+  latencyUs_.store(static_cast<uint32_t>(initialDepth * periodUs_));
+}
+
+void JitterBuffer::OnRecorderCallback(uint64_t nowUs) {
+  // single writer: load/store is enough
+  float jitter = recJitterUs_.load(std::memory_order_relaxed) * jitterDecay_;
+  if (lastRecUs_) {
+    float dev = std::fabs(static_cast<float>(nowUs - lastRecUs_) -
+                          static_cast<float>(periodUs_));
+    jitter = std::max(jitter, dev);
+  }
+  lastRecUs_ = nowUs;
+  recJitterUs_.store(jitter, std::memory_order_relaxed);
+}
+
+uint32_t JitterBuffer::TargetDepth(void) const {
+  float jitter =
+      std::max(playJitterUs_, recJitterUs_.load(std::memory_order_relaxed));
+  uint32_t margin = static_cast<uint32_t>(std::ceil(jitter / periodUs_));
+  return std::min(kMinDepth + margin + underrunBoost_, maxDepth_);
+}
+
+/*
+ * devBufs: buffers still with the device ( the finished one taken off ),
+ * queuedBufs: recorded buffers waiting in the play queue.
+ */
+JitterBuffer::Action JitterBuffer::OnPlayerCallback(uint64_t nowUs,
+                                                    uint32_t devBufs,
+                                                    uint32_t queuedBufs) {
+  if (lastPlayUs_) {
+    // a shortened buffer comes back early, that is not jitter
+    float dev = static_cast<float>(nowUs - lastPlayUs_) -
+                static_cast<float>(periodUs_);
+    playJitterUs_ = std::max(playJitterUs_ * jitterDecay_,
+                             dev > 0.0f ? dev : 0.0f);
+  }
+  lastPlayUs_ = nowUs;
+  if (underrunBoost_ && nowUs - lastUnderrunUs_ > kBoostHoldUs) {
+    underrunBoost_--;
+    lastUnderrunUs_ = nowUs;
+  }
+
+  uint32_t depth = devBufs + queuedBufs;
+  depthEma_ += (depth - depthEma_) * kDepthSmoothing;
+  latencyUs_.store(static_cast<uint32_t>(depthEma_ * periodUs_),
+                   std::memory_order_relaxed);
+
+  if (!queuedBufs) {
+    if (devBufs) return WAIT;
+    // the device is about to play nothing: fill in and wait longer
+    underrunBoost_ = std::min(underrunBoost_ + 1, maxDepth_);
+    lastUnderrunUs_ = nowUs;
+    drainFrames_ = 0;
+    windowCount_ = 0;
+    windowMin_ = UINT32_MAX;
+    targetDepth_.store(TargetDepth(), std::memory_order_relaxed);
+    return INSERT_SILENCE;
+  }
+
+  uint32_t target = TargetDepth();
+  targetDepth_.store(target, std::memory_order_relaxed);
+  windowMin_ = std::min(windowMin_, depth);
+  Action action = PLAY;
+  if (++windowCount_ >= windowLen_) {
+    if (windowMin_ > target && !drainFrames_) {
+      if (windowMin_ - target >= 2 && queuedBufs >= 2) {
+        action = DROP_AND_PLAY;
+      } else {
+        drainFrames_ = framesPerBuf_;
+      }
+    }
+    windowCount_ = 0;
+    windowMin_ = UINT32_MAX;
+  }
+  if (action == PLAY && drainFrames_) {
+    shortenFrames_ = std::min(
+        drainFrames_, std::max<uint32_t>(framesPerBuf_ / kShortenDivisor, 1));
+    drainFrames_ -= shortenFrames_;
+    action = PLAY_SHORTENED;
+  }
+  return action;
+}
+
+uint32_t JitterBuffer::GetTargetDepth(void) const {
+  return targetDepth_.load(std::memory_order_relaxed);
+}
+
+uint32_t JitterBuffer::GetLatencyEstimateUs(void) const {
+  return latencyUs_.load(std::memory_order_relaxed);
+}
+
+/*
+ * Cut dropFrames from the middle of the buffer: the dropFrames before the
+ * cut are crossfaded into the dropFrames after it, the tail moves up.
+ */
+void JitterBuffer::ShortenBuffer(int16_t *samples, uint32_t frames,
+                                 uint32_t channels, uint32_t dropFrames) {
+  assert(dropFrames * 2 <= frames);
+  uint32_t fade = dropFrames;
+  uint32_t start = (frames - dropFrames - fade) / 2;
+  int16_t *out = samples + start * channels;
+  const int16_t *in = out + dropFrames * channels;
+  for (uint32_t i = 0; i < fade; i++) {
+    for (uint32_t c = 0; c < channels; c++) {
+      int32_t mixed = (out[c] * static_cast<int32_t>(fade - i) +
+                       in[c] * static_cast<int32_t>(i)) /
+                      static_cast<int32_t>(fade);
+      out[c] = static_cast<int16_t>(mixed);
+    }
+    out += channels;
+    in += channels;
+  }
+  memmove(out, in,
+          (frames - start - fade - dropFrames) * channels * sizeof(int16_t));
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_AUDIO_JITTER_BUFFER_H
+#define NATIVE_AUDIO_JITTER_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * JitterBuffer: decides, at every player callback, how deep the queue of
+ * recorded buffers waiting to be heard ( device queue + play queue ) should
+ * be, and what the player does to get there.
+ *
+ * The target depth is two buffers ( the one playing when the callback
+ * comes and the one after it ) plus enough to cover the recent callback
+ * jitter: the deviation of recorder and player callback inter-arrival
+ * times from the buffer period, peak held with a ~2 s decay, plus one
+ * buffer for every recent underrun. The player tops the device queue up to
+ * the target when it grows. The depth seen at the player
+ * callbacks is tracked over a window; when even its minimum stays above
+ * the target the excess is drained: a whole buffer is dropped if two or
+ * more are in excess, otherwise the next buffers are shortened ( a splice
+ * with a short crossfade ) until one buffer worth of frames is gone. When
+ * the device is about to run dry a silent buffer is played instead of
+ * letting it stop, and the target grows.
+ *
+ * OnRecorderCallback() is called on the recorder thread, everything else
+ * on the player thread; the latency estimate can be read from any thread.
+ */
+class JitterBuffer {
+ public:
+  enum Action {
+    PLAY,            // play the next queued buffer
+    PLAY_SHORTENED,  // play it shortened by GetShortenFrames()
+    DROP_AND_PLAY,   // drop the next queued buffer, play the one after
+    INSERT_SILENCE,  // nothing to play and the device is running dry
+    WAIT,            // nothing to play yet, the device still has buffers
+  };
+
+  explicit JitterBuffer(uint32_t framesPerBuf, uint32_t sampleRate,
+                        uint32_t initialDepth, uint32_t maxDepth);
+
+  void OnRecorderCallback(uint64_t nowUs);
+  Action OnPlayerCallback(uint64_t nowUs, uint32_t devBufs,
+                          uint32_t queuedBufs);
+  uint32_t GetShortenFrames(void) const { return shortenFrames_; }
+  uint32_t GetTargetDepth(void) const;
+  uint32_t GetLatencyEstimateUs(void) const;
+
+  // cut frames out of the middle of interleaved int16 audio, in place
+  static void ShortenBuffer(int16_t *samples, uint32_t frames,
+                            uint32_t channels, uint32_t dropFrames);
+
+ private:
+  uint32_t TargetDepth(void) const;
+
+  const uint32_t framesPerBuf_;
+  const uint64_t periodUs_;
+  const uint32_t maxDepth_;
+  const float jitterDecay_;  // per callback
+
+  // recorder thread
+  uint64_t lastRecUs_ = 0;
+  std::atomic<float> recJitterUs_{0.0f};
+
+  // player thread
+  uint64_t lastPlayUs_ = 0;
+  float playJitterUs_ = 0.0f;
+  uint32_t underrunBoost_ = 0;
+  uint64_t lastUnderrunUs_ = 0;
+  uint32_t windowLen_;
+  uint32_t windowCount_ = 0;
+  uint32_t windowMin_ = UINT32_MAX;
+  uint32_t drainFrames_ = 0;  // still to be cut by shortening
+  uint32_t shortenFrames_ = 0;
+  float depthEma_;
+
+  std::atomic<uint32_t> targetDepth_;
+  std::atomic<uint32_t> latencyUs_{0};
+};
+
+#endif  // NATIVE_AUDIO_JITTER_BUFFER_H
@@ -47,6 +47,9 @@ JNIEXPORT jboolean JNICALL
 Java_com_google_sample_echo_MainActivity_configureEcho(JNIEnv *env, jclass type,
                                                        jint delayInMs,
                                                        jfloat decay);
+JNIEXPORT jint JNICALL
+Java_com_google_sample_echo_MainActivity_getLatencyEstimate(JNIEnv *env,
+                                                            jclass type);
 #ifdef __cplusplus
 }
 #endif
@@ -184,8 +184,10 @@ public class MainActivity extends Activity
             startPlay();   // startPlay() triggers startRecording()
             statusView.setText(getString(R.string.echoing_status_msg));
         } else {
+            int latencyMs = getLatencyEstimate();
             stopPlay();  // stopPlay() triggers stopRecording()
             updateNativeAudioUI();
+            statusView.append(getString(R.string.latency_estimate_msg, latencyMs));
             deleteAudioRecorder();
             deleteSLBufferQueueAudioPlayer();
         }
@@ -301,4 +303,5 @@ public class MainActivity extends Activity
     static native void deleteAudioRecorder();
     static native void startPlay();
     static native void stopPlay();
+    static native int getLatencyEstimate();
 }
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Offline run of the audio-echo engine against the simulated OpenSL ES
+ * device in sl_sim.cpp. The engine is driven through the same JNI entry
+ * points MainActivity calls, so AudioPlayer/AudioRecorder::ProcessSLCallback
+ * run unmodified: silent-buffer kickstart, the device shadow queues and the
+ * free buffer recycling.
+ *
+ * Reports end-to-end latency percentiles ( end of capture to start of
+ * playback of the same buffer ), underruns, recorder overruns and buffer
+ * loss: dbgEngineGetBufCount() is sampled between callbacks and any count
+ * below BUF_COUNT is a loss event. The buffer controls in audio_common.h
+ * are compile time; configure the build with ECHO_BUF_COUNT,
+ * ECHO_PLAY_KICKSTART_BUFFER_COUNT, ECHO_DEVICE_SHADOW_BUFFER_QUEUE_LEN or
+ * ECHO_RECORD_DEVICE_KICKSTART_BUF_COUNT to try other values.
+ */
+#include <getopt.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+#include "audio_common.h"
+#include "jni_interface.h"
+#include "sl_sim.h"
+
+uint32_t dbgEngineGetBufCount(void);
+
+namespace {
+
+struct Options {
+  SlSimConfig sim;
+  double seconds = 10.0;
+  uint32_t checkEvery = 1;  // periods between buffer count checks, 0: end
+  int32_t echoDelayMs = 100;
+  float echoDecay = 0.1f;
+  bool verbose = false;
+};
+
+void Usage(const char *prog) {
+  printf(
+      "usage: %s [options]\n"
+      "  -r, --rate HZ          device sample rate          (default 48000)\n"
+      "  -f, --frames N         frames per buffer           (default 192)\n"
+      "  -s, --seconds S        simulated run time          (default 10)\n"
+      "  -d, --delay US         callback delay after period (default 0)\n"
+      "  -j, --jitter US        random extra callback delay (default 0)\n"
+      "  -b, --burst EVERY:LEN  every EVERY periods, LEN callbacks arrive "
+      "together\n"
+      "  -S, --stall EVERY:MS   callback threads stall MS ms every EVERY ms\n"
+      "  -p, --phase US         player period phase vs recorder (default 0)\n"
+      "  -c, --check N          buffer count check every N periods, 0: at "
+      "end\n"
+      "  -e, --echo MS          echo delay effect           (default 100)\n"
+      "      --seed N           jitter random seed          (default 1)\n"
+      "  -v, --verbose          show engine logs\n"
+      "buffer controls: BUF_COUNT %d, PLAY_KICKSTART_BUFFER_COUNT %d, "
+      "DEVICE_SHADOW_BUFFER_QUEUE_LEN %d, RECORD_DEVICE_KICKSTART_BUF_COUNT "
+      "%d\n",
+      prog, BUF_COUNT, PLAY_KICKSTART_BUFFER_COUNT,
+      DEVICE_SHADOW_BUFFER_QUEUE_LEN, RECORD_DEVICE_KICKSTART_BUF_COUNT);
+}
+
+bool ParsePair(const char *arg, uint32_t *a, uint32_t *b) {
+  char *end;
+  *a = static_cast<uint32_t>(strtoul(arg, &end, 0));
+  if (*end != ':') return false;
+  *b = static_cast<uint32_t>(strtoul(end + 1, &end, 0));
+  return !*end;
+}
+
+double PercentileMs(const std::vector<uint64_t> &sorted, double pct) {
+  if (sorted.empty()) return 0.0;
+  size_t idx = static_cast<size_t>(pct / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[idx] * 1e-6;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  static const struct option kOptions[] = {
+      {"rate", required_argument, nullptr, 'r'},
+      {"frames", required_argument, nullptr, 'f'},
+      {"seconds", required_argument, nullptr, 's'},
+      {"delay", required_argument, nullptr, 'd'},
+      {"jitter", required_argument, nullptr, 'j'},
+      {"burst", required_argument, nullptr, 'b'},
+      {"stall", required_argument, nullptr, 'S'},
+      {"phase", required_argument, nullptr, 'p'},
+      {"check", required_argument, nullptr, 'c'},
+      {"echo", required_argument, nullptr, 'e'},
+      {"seed", required_argument, nullptr, 'R'},
+      {"verbose", no_argument, nullptr, 'v'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+  int c;
+  while ((c = getopt_long(argc, argv, "r:f:s:d:j:b:S:p:c:e:vh", kOptions,
+                          nullptr)) != -1) {
+    bool ok = true;
+    switch (c) {
+      case 'r': opt.sim.sampleRate = strtoul(optarg, nullptr, 0); break;
+      case 'f': opt.sim.framesPerBuf = strtoul(optarg, nullptr, 0); break;
+      case 's': opt.seconds = strtod(optarg, nullptr); break;
+      case 'd': opt.sim.callbackDelayUs = strtoul(optarg, nullptr, 0); break;
+      case 'j': opt.sim.jitterUs = strtoul(optarg, nullptr, 0); break;
+      case 'b':
+        ok = ParsePair(optarg, &opt.sim.burstEvery, &opt.sim.burstLen);
+        break;
+      case 'S':
+        ok = ParsePair(optarg, &opt.sim.stallEveryMs, &opt.sim.stallMs);
+        break;
+      case 'p': opt.sim.playPhaseUs = strtol(optarg, nullptr, 0); break;
+      case 'c': opt.checkEvery = strtoul(optarg, nullptr, 0); break;
+      case 'e': opt.echoDelayMs = strtol(optarg, nullptr, 0); break;
+      case 'R': opt.sim.seed = strtoul(optarg, nullptr, 0); break;
+      case 'v': opt.verbose = true; break;
+      case 'h': Usage(argv[0]); return 0;
+      default: ok = false; break;
+    }
+    if (!ok) {
+      Usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!opt.sim.sampleRate || !opt.sim.framesPerBuf || opt.seconds <= 0.0) {
+    Usage(argv[0]);
+    return 2;
+  }
+  // dbgEngineGetBufCount() reports at error level every time it is asked
+  if (!opt.verbose) AndroidLogHostMinPriority() = ANDROID_LOG_FATAL;
+
+  SlSimReset(opt.sim);
+  Java_com_google_sample_echo_MainActivity_createSLEngine(
+      nullptr, nullptr, opt.sim.sampleRate, opt.sim.framesPerBuf,
+      opt.echoDelayMs, opt.echoDecay);
+  if (!Java_com_google_sample_echo_MainActivity_createSLBufferQueueAudioPlayer(
+          nullptr, nullptr) ||
+      !Java_com_google_sample_echo_MainActivity_createAudioRecorder(nullptr,
+                                                                    nullptr)) {
+    fprintf(stderr, "failed to create the player or recorder\n");
+    return 1;
+  }
+  Java_com_google_sample_echo_MainActivity_startPlay(nullptr, nullptr);
+
+  // run, sampling the buffer distribution between callbacks
+  const uint64_t period = SlSimPeriodNs();
+  const uint64_t endNs = static_cast<uint64_t>(opt.seconds * 1e9);
+  const uint64_t step = opt.checkEvery ? opt.checkEvery * period : endNs;
+  uint64_t lossEvents = 0;
+  uint32_t minBufs = BUF_COUNT;
+  for (uint64_t t = std::min(step, endNs);; t = std::min(t + step, endNs)) {
+    SlSimRunUntil(t);
+    uint32_t count = dbgEngineGetBufCount();
+    if (count < BUF_COUNT) {
+      lossEvents++;
+      minBufs = std::min(minBufs, count);
+    }
+    if (t == endNs) break;
+  }
+  int32_t estimateMs =
+      Java_com_google_sample_echo_MainActivity_getLatencyEstimate(nullptr,
+                                                                  nullptr);
+  const SlSimStats &stats = SlSimGetStats();
+  std::vector<uint64_t> latency = stats.latencyNs;
+  std::sort(latency.begin(), latency.end());
+
+  printf("%u Hz, %u frames/buf ( %.3f ms ), %.1f s; callbacks +%u us, "
+         "jitter %u us, burst %u:%u, stall %u:%u ms\n",
+         opt.sim.sampleRate, opt.sim.framesPerBuf, period * 1e-6, opt.seconds,
+         opt.sim.callbackDelayUs, opt.sim.jitterUs, opt.sim.burstEvery,
+         opt.sim.burstLen, opt.sim.stallEveryMs, opt.sim.stallMs);
+  printf("BUF_COUNT %d, PLAY_KICKSTART_BUFFER_COUNT %d, "
+         "DEVICE_SHADOW_BUFFER_QUEUE_LEN %d, RECORD_DEVICE_KICKSTART_BUF_COUNT "
+         "%d\n",
+         BUF_COUNT, PLAY_KICKSTART_BUFFER_COUNT, DEVICE_SHADOW_BUFFER_QUEUE_LEN,
+         RECORD_DEVICE_KICKSTART_BUF_COUNT);
+  printf("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f  "
+         "( %zu buffers )\n",
+         PercentileMs(latency, 50.0), PercentileMs(latency, 90.0),
+         PercentileMs(latency, 99.0), PercentileMs(latency, 100.0),
+         latency.size());
+  printf("jitter buffer latency estimate at end: %d ms\n", estimateMs);
+  printf("played %" PRIu64 ", silent %" PRIu64 ", underruns %" PRIu64
+         ", recorder overruns %" PRIu64 ", callbacks rec %" PRIu64
+         " play %" PRIu64 "\n",
+         stats.playedBufs, stats.silentBufs, stats.underruns, stats.overruns,
+         stats.recCallbacks, stats.playCallbacks);
+  printf("buffer loss events %" PRIu64 " ( lowest count %u of %d )\n",
+         lossEvents, minBufs, BUF_COUNT);
+
+  Java_com_google_sample_echo_MainActivity_stopPlay(nullptr, nullptr);
+  Java_com_google_sample_echo_MainActivity_deleteSLEngine(nullptr, nullptr);
+  return lossEvents ? 1 : 0;
+}
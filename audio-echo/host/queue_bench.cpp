@@ -0,0 +1,240 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Throughput / latency stress test for the audio-echo buffer queues:
+ *   - ProducerConsumerQueue (SPSC): 1 producer, 1 consumer
+ *   - MPMCQueue: N producers x M consumers, single and batched transfers
+ *
+ * Every item is the push timestamp tagged with its producer, so the consumer
+ * side both measures the push-to-pop latency and checks that nothing got
+ * lost, duplicated or reordered within one producer.
+ *
+ *   queue_bench [items-per-producer] [queue-capacity]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "android_debug.h"
+#include "buf_manager.h"
+
+namespace {
+
+const int kMaxThreads = 16;
+
+uint64_t NowNs(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// producer id in the top 8 bits, sequence number in the rest
+uint64_t MakeItem(uint32_t producer, uint64_t seq) {
+  return (static_cast<uint64_t>(producer) << 56) | seq;
+}
+
+struct ConsumerResult {
+  std::vector<uint32_t> latencyNs;  // sampled push-to-pop latency
+  uint64_t count = 0;
+  uint64_t errors = 0;
+};
+
+struct RunResult {
+  const char* name;
+  int producers;
+  int consumers;
+  uint32_t batch;
+  double seconds;
+  uint64_t items;
+  uint64_t errors;
+  std::vector<uint32_t> latencyNs;
+};
+
+/*
+ * Items carry timestamps in a side table indexed by sequence number: the
+ * queues move 64-bit words and a timestamp would not leave room for the
+ * producer tag. One table per producer, written before the push.
+ */
+struct Stamps {
+  std::vector<std::vector<uint64_t>> pushNs;
+  explicit Stamps(int producers, uint64_t items)
+      : pushNs(producers, std::vector<uint64_t>(items)) {}
+};
+
+void Consume(ConsumerResult* res, uint64_t item, uint64_t* lastSeq,
+             const Stamps& stamps, uint64_t now) {
+  uint32_t producer = static_cast<uint32_t>(item >> 56);
+  uint64_t seq = item & ((1ull << 56) - 1);
+  if (producer >= stamps.pushNs.size() || seq >= stamps.pushNs[0].size() ||
+      (lastSeq[producer] != UINT64_MAX && seq <= lastSeq[producer])) {
+    res->errors++;
+    return;
+  }
+  lastSeq[producer] = seq;
+  if ((seq & 63) == 0) {
+    uint64_t delta = now - stamps.pushNs[producer][seq];
+    res->latencyNs.push_back(
+        static_cast<uint32_t>(std::min<uint64_t>(delta, UINT32_MAX)));
+  }
+  res->count++;
+}
+
+RunResult RunSPSC(uint64_t items, int capacity) {
+  ProducerConsumerQueue<uint64_t> queue(capacity);
+  Stamps stamps(1, items);
+  ConsumerResult res;
+  uint64_t start = NowNs();
+
+  std::thread producer([&]() {
+    for (uint64_t seq = 0; seq < items; seq++) {
+      stamps.pushNs[0][seq] = NowNs();
+      while (!queue.push(MakeItem(0, seq))) std::this_thread::yield();
+    }
+  });
+  std::thread consumer([&]() {
+    uint64_t lastSeq[1] = {UINT64_MAX};
+    uint64_t item;
+    while (res.count + res.errors < items) {
+      if (!queue.front(&item)) {
+        std::this_thread::yield();
+        continue;
+      }
+      queue.pop();
+      Consume(&res, item, lastSeq, stamps, NowNs());
+    }
+  });
+  producer.join();
+  consumer.join();
+
+  return RunResult{"spsc", 1, 1, 1, (NowNs() - start) * 1e-9, res.count,
+                   res.errors, std::move(res.latencyNs)};
+}
+
+RunResult RunMPMC(uint64_t items, int capacity, int producers, int consumers,
+                  uint32_t batch) {
+  MPMCQueue<uint64_t> queue(capacity);
+  Stamps stamps(producers, items);
+  std::vector<ConsumerResult> results(consumers);
+  std::atomic<uint64_t> consumed{0};
+  const uint64_t total = items * producers;
+  std::vector<std::thread> threads;
+  uint64_t start = NowNs();
+
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p]() {
+      std::vector<uint64_t> chunk(batch);
+      uint64_t seq = 0;
+      while (seq < items) {
+        uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(batch, items - seq));
+        uint64_t now = NowNs();
+        for (uint32_t i = 0; i < n; i++) {
+          stamps.pushNs[p][seq + i] = now;
+          chunk[i] = MakeItem(p, seq + i);
+        }
+        uint32_t done = 0;
+        while (done < n) {
+          uint32_t pushed = queue.push_n(&chunk[done], n - done);
+          if (!pushed) std::this_thread::yield();
+          done += pushed;
+        }
+        seq += n;
+      }
+    });
+  }
+  for (int c = 0; c < consumers; c++) {
+    threads.emplace_back([&, c]() {
+      std::vector<uint64_t> chunk(batch);
+      uint64_t lastSeq[kMaxThreads];
+      std::fill(lastSeq, lastSeq + kMaxThreads, UINT64_MAX);
+      while (consumed.load(std::memory_order_relaxed) < total) {
+        uint32_t n = queue.pop_n(chunk.data(), batch);
+        if (!n) {
+          std::this_thread::yield();
+          continue;
+        }
+        uint64_t now = NowNs();
+        for (uint32_t i = 0; i < n; i++) {
+          Consume(&results[c], chunk[i], lastSeq, stamps, now);
+        }
+        consumed.fetch_add(n, std::memory_order_relaxed);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  RunResult run{"mpmc", producers, consumers, batch, (NowNs() - start) * 1e-9,
+                0, 0, {}};
+  for (auto& res : results) {
+    run.items += res.count;
+    run.errors += res.errors;
+    run.latencyNs.insert(run.latencyNs.end(), res.latencyNs.begin(),
+                         res.latencyNs.end());
+  }
+  if (run.items != total) run.errors += total - run.items;
+  return run;
+}
+
+uint32_t Percentile(const std::vector<uint32_t>& sorted, double pct) {
+  if (sorted.empty()) return 0;
+  size_t idx = static_cast<size_t>(pct / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[idx];
+}
+
+void Report(RunResult run) {
+  std::sort(run.latencyNs.begin(), run.latencyNs.end());
+  printf("%-5s %2dP x %2dC batch %3u : %8.2f Mitems/s  latency ns p50 %7u "
+         "p99 %8u p99.9 %8u max %9u  %s\n",
+         run.name, run.producers, run.consumers, run.batch,
+         run.items / run.seconds * 1e-6, Percentile(run.latencyNs, 50.0),
+         Percentile(run.latencyNs, 99.0), Percentile(run.latencyNs, 99.9),
+         run.latencyNs.empty() ? 0 : run.latencyNs.back(),
+         run.errors ? "FAILED" : "ok");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint64_t items = argc > 1 ? strtoull(argv[1], nullptr, 0) : 2000000;
+  int capacity = argc > 2 ? atoi(argv[2]) : 16;  // BUF_COUNT
+  int failures = 0;
+
+  printf("%" PRIu64 " items per producer, queue capacity %d, %u cpus\n", items,
+         capacity, std::thread::hardware_concurrency());
+
+  struct {
+    int producers, consumers;
+    uint32_t batch;
+  } const kMpmcRuns[] = {
+      {1, 1, 1}, {1, 1, 8}, {2, 2, 1}, {2, 2, 8},
+      {4, 1, 1}, {1, 4, 1}, {4, 4, 1}, {4, 4, 16},
+  };
+
+  RunResult spsc = RunSPSC(items, capacity);
+  failures += spsc.errors != 0;
+  Report(std::move(spsc));
+  for (auto& cfg : kMpmcRuns) {
+    RunResult run =
+        RunMPMC(items, capacity, cfg.producers, cfg.consumers, cfg.batch);
+    failures += run.errors != 0;
+    Report(std::move(run));
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Host stand-in for the OpenSL ES types and interfaces the audio-echo
+ * engine uses. Interface structs only carry the methods the engine calls,
+ * in the real signatures; host/sl_sim.cpp implements them. Only used by
+ * the Linux host tools in audio-echo/host.
+ */
+#ifndef AUDIO_ECHO_HOST_OPENSLES_H
+#define AUDIO_ECHO_HOST_OPENSLES_H
+#include <cstdint>
+
+typedef uint8_t SLuint8;
+typedef int16_t SLint16;
+typedef uint16_t SLuint16;
+typedef int32_t SLint32;
+typedef uint32_t SLuint32;
+typedef SLuint32 SLboolean;
+typedef SLuint32 SLresult;
+typedef SLuint32 SLmilliHertz;
+typedef SLuint8 SLchar;
+
+#define SL_BOOLEAN_FALSE ((SLboolean)0x00000000)
+#define SL_BOOLEAN_TRUE ((SLboolean)0x00000001)
+
+#define SL_RESULT_SUCCESS ((SLuint32)0x00000000)
+#define SL_RESULT_PARAMETER_INVALID ((SLuint32)0x00000002)
+#define SL_RESULT_BUFFER_INSUFFICIENT ((SLuint32)0x00000007)
+#define SL_RESULT_FEATURE_UNSUPPORTED ((SLuint32)0x0000000C)
+
+#define SL_PCMSAMPLEFORMAT_FIXED_8 ((SLuint16)0x0008)
+#define SL_PCMSAMPLEFORMAT_FIXED_16 ((SLuint16)0x0010)
+#define SL_PCMSAMPLEFORMAT_FIXED_32 ((SLuint16)0x0020)
+
+#define SL_SAMPLINGRATE_48 ((SLuint32)48000000)
+
+#define SL_DATAFORMAT_PCM ((SLuint32)0x00000002)
+#define SL_BYTEORDER_LITTLEENDIAN ((SLuint32)0x00000002)
+#define SL_SPEAKER_FRONT_LEFT ((SLuint32)0x00000001)
+#define SL_SPEAKER_FRONT_RIGHT ((SLuint32)0x00000002)
+
+#define SL_DATALOCATOR_IODEVICE ((SLuint32)0x00000003)
+#define SL_DATALOCATOR_OUTPUTMIX ((SLuint32)0x00000004)
+#define SL_IODEVICE_AUDIOINPUT ((SLuint32)0x00000001)
+#define SL_DEFAULTDEVICEID_AUDIOINPUT ((SLuint32)0xFFFFFFFF)
+
+#define SL_PLAYSTATE_STOPPED ((SLuint32)0x00000001)
+#define SL_PLAYSTATE_PAUSED ((SLuint32)0x00000002)
+#define SL_PLAYSTATE_PLAYING ((SLuint32)0x00000003)
+
+#define SL_RECORDSTATE_STOPPED ((SLuint32)0x00000001)
+#define SL_RECORDSTATE_PAUSED ((SLuint32)0x00000002)
+#define SL_RECORDSTATE_RECORDING ((SLuint32)0x00000003)
+
+typedef const struct SLInterfaceID_ {
+  const char *name;
+} * SLInterfaceID;
+
+extern const SLInterfaceID SL_IID_ENGINE;
+extern const SLInterfaceID SL_IID_PLAY;
+extern const SLInterfaceID SL_IID_RECORD;
+extern const SLInterfaceID SL_IID_BUFFERQUEUE;
+extern const SLInterfaceID SL_IID_VOLUME;
+
+typedef struct SLDataSource_ {
+  void *pLocator;
+  void *pFormat;
+} SLDataSource;
+
+typedef struct SLDataSink_ {
+  void *pLocator;
+  void *pFormat;
+} SLDataSink;
+
+struct SLObjectItf_;
+typedef const struct SLObjectItf_ *const *SLObjectItf;
+struct SLObjectItf_ {
+  SLresult (*Realize)(SLObjectItf self, SLboolean async);
+  SLresult (*GetInterface)(SLObjectItf self, const SLInterfaceID iid,
+                           void *pInterface);
+  void (*Destroy)(SLObjectItf self);
+};
+
+typedef struct SLDataLocator_IODevice_ {
+  SLuint32 locatorType;
+  SLuint32 deviceType;
+  SLuint32 deviceID;
+  SLObjectItf device;
+} SLDataLocator_IODevice;
+
+typedef struct SLDataLocator_OutputMix_ {
+  SLuint32 locatorType;
+  SLObjectItf outputMix;
+} SLDataLocator_OutputMix;
+
+struct SLEngineItf_;
+typedef const struct SLEngineItf_ *const *SLEngineItf;
+struct SLEngineItf_ {
+  SLresult (*CreateAudioPlayer)(SLEngineItf self, SLObjectItf *pPlayer,
+                                SLDataSource *pAudioSrc, SLDataSink *pAudioSnk,
+                                SLuint32 numInterfaces,
+                                const SLInterfaceID *pInterfaceIds,
+                                const SLboolean *pInterfaceRequired);
+  SLresult (*CreateAudioRecorder)(SLEngineItf self, SLObjectItf *pRecorder,
+                                  SLDataSource *pAudioSrc,
+                                  SLDataSink *pAudioSnk, SLuint32 numInterfaces,
+                                  const SLInterfaceID *pInterfaceIds,
+                                  const SLboolean *pInterfaceRequired);
+  SLresult (*CreateOutputMix)(SLEngineItf self, SLObjectItf *pMix,
+                              SLuint32 numInterfaces,
+                              const SLInterfaceID *pInterfaceIds,
+                              const SLboolean *pInterfaceRequired);
+};
+
+struct SLPlayItf_;
+typedef const struct SLPlayItf_ *const *SLPlayItf;
+struct SLPlayItf_ {
+  SLresult (*SetPlayState)(SLPlayItf self, SLuint32 state);
+  SLresult (*GetPlayState)(SLPlayItf self, SLuint32 *pState);
+};
+
+struct SLRecordItf_;
+typedef const struct SLRecordItf_ *const *SLRecordItf;
+struct SLRecordItf_ {
+  SLresult (*SetRecordState)(SLRecordItf self, SLuint32 state);
+  SLresult (*GetRecordState)(SLRecordItf self, SLuint32 *pState);
+};
+
+typedef struct SLEngineOption_ {
+  SLuint32 feature;
+  SLuint32 data;
+} SLEngineOption;
+
+SLresult slCreateEngine(SLObjectItf *pEngine, SLuint32 numOptions,
+                        const SLEngineOption *pEngineOptions,
+                        SLuint32 numInterfaces,
+                        const SLInterfaceID *pInterfaceIds,
+                        const SLboolean *pInterfaceRequired);
+
+#endif  // AUDIO_ECHO_HOST_OPENSLES_H
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Host stand-in for the Android OpenSL ES extensions the audio-echo engine
+ * uses ( simple buffer queue, PCM_EX format, recording preset ). Only used
+ * by the Linux host tools in audio-echo/host.
+ */
+#ifndef AUDIO_ECHO_HOST_OPENSLES_ANDROID_H
+#define AUDIO_ECHO_HOST_OPENSLES_ANDROID_H
+#include <sys/time.h>
+#include <time.h>
+#include <SLES/OpenSLES.h>
+
+#define SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE ((SLuint32)0x800007BD)
+#define SL_ANDROID_DATAFORMAT_PCM_EX ((SLuint32)0x4)
+
+#define SL_ANDROID_PCM_REPRESENTATION_SIGNED_INT ((SLuint32)0x1)
+#define SL_ANDROID_PCM_REPRESENTATION_UNSIGNED_INT ((SLuint32)0x2)
+#define SL_ANDROID_PCM_REPRESENTATION_FLOAT ((SLuint32)0x3)
+
+#define SL_ANDROID_KEY_RECORDING_PRESET \
+  ((const SLchar *)"androidRecordingPreset")
+#define SL_ANDROID_RECORDING_PRESET_VOICE_RECOGNITION ((SLuint32)0x00000003)
+
+extern const SLInterfaceID SL_IID_ANDROIDSIMPLEBUFFERQUEUE;
+extern const SLInterfaceID SL_IID_ANDROIDCONFIGURATION;
+
+typedef struct SLDataLocator_AndroidSimpleBufferQueue {
+  SLuint32 locatorType;
+  SLuint32 numBuffers;
+} SLDataLocator_AndroidSimpleBufferQueue;
+
+typedef struct SLAndroidDataFormat_PCM_EX_ {
+  SLuint32 formatType;
+  SLuint32 numChannels;
+  SLuint32 sampleRate;
+  SLuint32 bitsPerSample;
+  SLuint32 containerSize;
+  SLuint32 channelMask;
+  SLuint32 endianness;
+  SLuint32 representation;
+} SLAndroidDataFormat_PCM_EX;
+
+struct SLAndroidSimpleBufferQueueItf_;
+typedef const struct SLAndroidSimpleBufferQueueItf_ *const
+    *SLAndroidSimpleBufferQueueItf;
+typedef void (*slAndroidSimpleBufferQueueCallback)(
+    SLAndroidSimpleBufferQueueItf caller, void *pContext);
+struct SLAndroidSimpleBufferQueueItf_ {
+  SLresult (*Enqueue)(SLAndroidSimpleBufferQueueItf self, const void *pBuffer,
+                      SLuint32 size);
+  SLresult (*Clear)(SLAndroidSimpleBufferQueueItf self);
+  SLresult (*RegisterCallback)(SLAndroidSimpleBufferQueueItf self,
+                               slAndroidSimpleBufferQueueCallback callback,
+                               void *pContext);
+};
+
+struct SLAndroidConfigurationItf_;
+typedef const struct SLAndroidConfigurationItf_ *const
+    *SLAndroidConfigurationItf;
+struct SLAndroidConfigurationItf_ {
+  SLresult (*SetConfiguration)(SLAndroidConfigurationItf self,
+                               const SLchar *configKey,
+                               const void *pConfigValue,
+                               SLuint32 valueSize);
+};
+
+#endif  // AUDIO_ECHO_HOST_OPENSLES_ANDROID_H
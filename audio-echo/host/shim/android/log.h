@@ -0,0 +1,56 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Host stand-in for <android/log.h>: logcat output goes to stderr.
+ * Only used by the Linux host tools in audio-echo/host.
+ */
+#ifndef AUDIO_ECHO_HOST_ANDROID_LOG_H
+#define AUDIO_ECHO_HOST_ANDROID_LOG_H
+#include <cstdarg>
+#include <cstdio>
+
+typedef enum android_LogPriority {
+  ANDROID_LOG_UNKNOWN = 0,
+  ANDROID_LOG_DEFAULT,
+  ANDROID_LOG_VERBOSE,
+  ANDROID_LOG_DEBUG,
+  ANDROID_LOG_INFO,
+  ANDROID_LOG_WARN,
+  ANDROID_LOG_ERROR,
+  ANDROID_LOG_FATAL,
+  ANDROID_LOG_SILENT,
+} android_LogPriority;
+
+// messages below this priority are dropped; host tools may raise it
+__inline__ int& AndroidLogHostMinPriority(void) {
+  static int minPrio = ANDROID_LOG_VERBOSE;
+  return minPrio;
+}
+
+__inline__ int __android_log_print(int prio, const char* tag, const char* fmt,
+                                   ...) {
+  static const char kPrio[] = "??VDIWEFS";
+  if (prio < AndroidLogHostMinPriority()) return 0;
+  va_list vp;
+  va_start(vp, fmt);
+  fprintf(stderr, "%c/%s: ", kPrio[prio & 7], tag);
+  int ret = vfprintf(stderr, fmt, vp);
+  fputc('\n', stderr);
+  va_end(vp);
+  return ret;
+}
+
+#endif  // AUDIO_ECHO_HOST_ANDROID_LOG_H
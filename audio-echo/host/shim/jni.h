@@ -0,0 +1,37 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Host stand-in for the JNI types in the audio-echo entry points, so the
+ * host tools can drive the engine through the same calls MainActivity
+ * makes. Only used by the Linux host tools in audio-echo/host.
+ */
+#ifndef AUDIO_ECHO_HOST_JNI_H
+#define AUDIO_ECHO_HOST_JNI_H
+#include <cstdint>
+
+typedef uint8_t jboolean;
+typedef int32_t jint;
+typedef int64_t jlong;
+typedef float jfloat;
+typedef void *jclass;
+typedef struct _JNIEnv JNIEnv;
+
+#define JNI_FALSE 0
+#define JNI_TRUE 1
+#define JNIEXPORT __attribute__((visibility("default")))
+#define JNICALL
+
+#endif  // AUDIO_ECHO_HOST_JNI_H
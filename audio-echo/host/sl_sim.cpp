@@ -0,0 +1,456 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sl_sim.h"
+
+#include <SLES/OpenSLES.h>
+#include <SLES/OpenSLES_Android.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <queue>
+#include <random>
+
+static const SLInterfaceID_ kIidEngine = {"engine"};
+static const SLInterfaceID_ kIidPlay = {"play"};
+static const SLInterfaceID_ kIidRecord = {"record"};
+static const SLInterfaceID_ kIidBufferQueue = {"bufferqueue"};
+static const SLInterfaceID_ kIidVolume = {"volume"};
+static const SLInterfaceID_ kIidAndroidBufferQueue = {"androidsimplebufq"};
+static const SLInterfaceID_ kIidAndroidConfig = {"androidconfiguration"};
+const SLInterfaceID SL_IID_ENGINE = &kIidEngine;
+const SLInterfaceID SL_IID_PLAY = &kIidPlay;
+const SLInterfaceID SL_IID_RECORD = &kIidRecord;
+const SLInterfaceID SL_IID_BUFFERQUEUE = &kIidBufferQueue;
+const SLInterfaceID SL_IID_VOLUME = &kIidVolume;
+const SLInterfaceID SL_IID_ANDROIDSIMPLEBUFFERQUEUE = &kIidAndroidBufferQueue;
+const SLInterfaceID SL_IID_ANDROIDCONFIGURATION = &kIidAndroidConfig;
+
+namespace {
+
+enum ObjectKind { ENGINE, OUTPUT_MIX, PLAYER, RECORDER };
+struct SimObject;
+
+// an SL interface handle points at itf_; owner_ leads back to the object
+template <typename Itf>
+struct Holder {
+  const Itf *itf_;
+  SimObject *owner_;
+};
+
+template <typename Itf>
+SimObject *Owner(const Itf *const *self) {
+  return reinterpret_cast<const Holder<Itf> *>(self)->owner_;
+}
+
+struct SimObject {
+  ObjectKind kind_;
+  uint32_t id_;
+  Holder<SLObjectItf_> object_;
+  Holder<SLEngineItf_> engine_;
+  Holder<SLPlayItf_> play_;
+  Holder<SLRecordItf_> record_;
+  Holder<SLAndroidSimpleBufferQueueItf_> bufQueue_;
+  Holder<SLAndroidConfigurationItf_> config_;
+
+  SLuint32 state_ = 0;
+  uint32_t queueCap_ = 0;
+  uint32_t bytesPerFrame_ = 0;
+  std::deque<std::pair<const void *, SLuint32>> queue_;
+  const void *playing_ = nullptr;
+  slAndroidSimpleBufferQueueCallback callback_ = nullptr;
+  void *ctx_ = nullptr;
+  uint64_t lastDeliveryNs_ = 0;
+};
+
+enum EventType { REC_PERIOD, PLAY_PERIOD, REC_CALLBACK, PLAY_CALLBACK };
+struct Event {
+  uint64_t timeNs_;
+  uint64_t seq_;
+  EventType type_;
+  uint32_t objectId_;
+  uint64_t period_;
+};
+struct Later {
+  bool operator()(const Event &a, const Event &b) const {
+    return a.timeNs_ != b.timeNs_ ? a.timeNs_ > b.timeNs_ : a.seq_ > b.seq_;
+  }
+};
+
+struct Sim {
+  SlSimConfig config_;
+  SlSimStats stats_;
+  uint64_t nowNs_ = 0;
+  uint64_t periodNs_ = 0;
+  uint64_t seq_ = 0;
+  uint32_t nextId_ = 1;
+  std::priority_queue<Event, std::vector<Event>, Later> events_;
+  std::mt19937 rng_;
+  SimObject *player_ = nullptr;
+  SimObject *recorder_ = nullptr;
+  std::map<const void *, uint64_t> captureNs_;  // buffer -> end of capture
+  uint64_t samplePos_ = 0;
+};
+Sim gSim;
+
+void Schedule(uint64_t timeNs, EventType type, uint32_t objectId,
+              uint64_t period) {
+  gSim.events_.push(Event{timeNs, gSim.seq_++, type, objectId, period});
+}
+
+/*
+ * When the app sees the callback of the buffer finished at periodEndNs.
+ */
+uint64_t DeliveryTime(SimObject *dev, uint64_t periodEndNs, uint64_t period) {
+  const SlSimConfig &cfg = gSim.config_;
+  uint64_t t = periodEndNs + cfg.callbackDelayUs * 1000ULL;
+  if (cfg.jitterUs) {
+    t += std::uniform_int_distribution<uint64_t>(
+        0, cfg.jitterUs * 1000ULL - 1)(gSim.rng_);
+  }
+  if (cfg.burstEvery && cfg.burstLen) {
+    uint64_t pos = period % cfg.burstEvery;
+    if (pos < cfg.burstLen) t += (cfg.burstLen - 1 - pos) * gSim.periodNs_;
+  }
+  if (cfg.stallEveryMs && cfg.stallMs) {
+    uint64_t window = cfg.stallEveryMs * 1000000ULL;
+    uint64_t stall = std::min<uint64_t>(cfg.stallMs, cfg.stallEveryMs) * 1000000ULL;
+    if (t % window >= window - stall) t = (t / window + 1) * window;
+  }
+  t = std::max(t, dev->lastDeliveryNs_);
+  dev->lastDeliveryNs_ = t;
+  return t;
+}
+
+void FillCapture(const void *buf, SLuint32 size) {
+  // a slow triangle so the effects have something to chew on
+  int16_t *samples = static_cast<int16_t *>(const_cast<void *>(buf));
+  for (SLuint32 i = 0; i < size / sizeof(int16_t); i++, gSim.samplePos_++) {
+    int32_t phase = static_cast<int32_t>(gSim.samplePos_ & 0xff);
+    samples[i] = static_cast<int16_t>((phase < 0x80 ? phase : 0xff - phase) *
+                                          0x100 -
+                                      0x4000);
+  }
+}
+
+void RecorderPeriod(uint64_t period) {
+  SimObject *rec = gSim.recorder_;
+  if (!rec || rec->state_ != SL_RECORDSTATE_RECORDING) return;
+  if (rec->queue_.empty()) {
+    gSim.stats_.overruns++;
+    return;
+  }
+  const void *buf = rec->queue_.front().first;
+  FillCapture(buf, rec->queue_.front().second);
+  rec->queue_.pop_front();
+  gSim.captureNs_[buf] = gSim.nowNs_;
+  Schedule(DeliveryTime(rec, gSim.nowNs_, period), REC_CALLBACK, rec->id_,
+           period);
+}
+
+/*
+ * Returns when the player needs the next buffer: a buffer plays for as many
+ * frames as it holds, an underrun waits one period.
+ */
+uint64_t PlayerPeriod(uint64_t period) {
+  SimObject *player = gSim.player_;
+  if (!player || player->state_ != SL_PLAYSTATE_PLAYING) {
+    return gSim.periodNs_;
+  }
+  if (player->playing_) {
+    Schedule(DeliveryTime(player, gSim.nowNs_, period), PLAY_CALLBACK,
+             player->id_, period);
+    player->playing_ = nullptr;
+  }
+  if (player->queue_.empty()) {
+    gSim.stats_.underruns++;
+    return gSim.periodNs_;
+  }
+  player->playing_ = player->queue_.front().first;
+  uint64_t frames = player->queue_.front().second / player->bytesPerFrame_;
+  player->queue_.pop_front();
+  auto captured = gSim.captureNs_.find(player->playing_);
+  if (captured == gSim.captureNs_.end()) {
+    gSim.stats_.silentBufs++;
+  } else {
+    gSim.stats_.latencyNs.push_back(gSim.nowNs_ - captured->second);
+    gSim.stats_.playedBufs++;
+    gSim.captureNs_.erase(captured);
+  }
+  return std::max<uint64_t>(
+      frames * 1000000000ULL / gSim.config_.sampleRate, 1);
+}
+
+void DeliverCallback(SimObject *dev, uint64_t *count) {
+  if (!dev || !dev->callback_) return;
+  (*count)++;
+  dev->callback_(&dev->bufQueue_.itf_, dev->ctx_);
+}
+
+/*
+ * SLObjectItf
+ */
+SLresult Realize(SLObjectItf self, SLboolean async) {
+  (void)self;
+  (void)async;
+  return SL_RESULT_SUCCESS;
+}
+
+SLresult GetInterface(SLObjectItf self, const SLInterfaceID iid,
+                      void *pInterface) {
+  SimObject *obj = Owner(self);
+  const void *itf = nullptr;
+  switch (obj->kind_) {
+    case ENGINE:
+      if (iid == SL_IID_ENGINE) itf = &obj->engine_.itf_;
+      break;
+    case PLAYER:
+      if (iid == SL_IID_PLAY) itf = &obj->play_.itf_;
+      if (iid == SL_IID_BUFFERQUEUE || iid == SL_IID_ANDROIDSIMPLEBUFFERQUEUE)
+        itf = &obj->bufQueue_.itf_;
+      break;
+    case RECORDER:
+      if (iid == SL_IID_RECORD) itf = &obj->record_.itf_;
+      if (iid == SL_IID_ANDROIDSIMPLEBUFFERQUEUE) itf = &obj->bufQueue_.itf_;
+      if (iid == SL_IID_ANDROIDCONFIGURATION) itf = &obj->config_.itf_;
+      break;
+    default:
+      break;
+  }
+  if (!itf) return SL_RESULT_FEATURE_UNSUPPORTED;
+  *static_cast<const void **>(pInterface) = itf;
+  return SL_RESULT_SUCCESS;
+}
+
+void Destroy(SLObjectItf self) {
+  SimObject *obj = Owner(self);
+  if (gSim.player_ == obj) gSim.player_ = nullptr;
+  if (gSim.recorder_ == obj) gSim.recorder_ = nullptr;
+  delete obj;
+}
+
+/*
+ * SLPlayItf / SLRecordItf
+ */
+SLresult SetState(SimObject *obj, SLuint32 state) {
+  obj->state_ = state;
+  return SL_RESULT_SUCCESS;
+}
+SLresult SetPlayState(SLPlayItf self, SLuint32 state) {
+  return SetState(Owner(self), state);
+}
+SLresult GetPlayState(SLPlayItf self, SLuint32 *pState) {
+  *pState = Owner(self)->state_;
+  return SL_RESULT_SUCCESS;
+}
+SLresult SetRecordState(SLRecordItf self, SLuint32 state) {
+  return SetState(Owner(self), state);
+}
+SLresult GetRecordState(SLRecordItf self, SLuint32 *pState) {
+  *pState = Owner(self)->state_;
+  return SL_RESULT_SUCCESS;
+}
+
+/*
+ * SLAndroidSimpleBufferQueueItf: the buffer being played counts against
+ * the queue capacity, as it does on the device
+ */
+SLresult Enqueue(SLAndroidSimpleBufferQueueItf self, const void *pBuffer,
+                 SLuint32 size) {
+  SimObject *obj = Owner(self);
+  if (!pBuffer || !size) return SL_RESULT_PARAMETER_INVALID;
+  if (obj->queue_.size() + (obj->playing_ ? 1 : 0) >= obj->queueCap_) {
+    return SL_RESULT_BUFFER_INSUFFICIENT;
+  }
+  obj->queue_.emplace_back(pBuffer, size);
+  return SL_RESULT_SUCCESS;
+}
+
+SLresult Clear(SLAndroidSimpleBufferQueueItf self) {
+  SimObject *obj = Owner(self);
+  obj->queue_.clear();
+  obj->playing_ = nullptr;
+  return SL_RESULT_SUCCESS;
+}
+
+SLresult RegisterCallback(SLAndroidSimpleBufferQueueItf self,
+                          slAndroidSimpleBufferQueueCallback callback,
+                          void *pContext) {
+  SimObject *obj = Owner(self);
+  obj->callback_ = callback;
+  obj->ctx_ = pContext;
+  return SL_RESULT_SUCCESS;
+}
+
+SLresult SetConfiguration(SLAndroidConfigurationItf self,
+                          const SLchar *configKey, const void *pConfigValue,
+                          SLuint32 valueSize) {
+  (void)self;
+  (void)configKey;
+  (void)pConfigValue;
+  (void)valueSize;
+  return SL_RESULT_SUCCESS;
+}
+
+const SLObjectItf_ kObjectItf = {Realize, GetInterface, Destroy};
+const SLPlayItf_ kPlayItf = {SetPlayState, GetPlayState};
+const SLRecordItf_ kRecordItf = {SetRecordState, GetRecordState};
+const SLAndroidSimpleBufferQueueItf_ kBufQueueItf = {Enqueue, Clear,
+                                                     RegisterCallback};
+const SLAndroidConfigurationItf_ kConfigItf = {SetConfiguration};
+extern const SLEngineItf_ kEngineItf;
+
+SimObject *NewObject(ObjectKind kind) {
+  SimObject *obj = new SimObject;
+  obj->kind_ = kind;
+  obj->id_ = gSim.nextId_++;
+  obj->object_ = {&kObjectItf, obj};
+  obj->engine_ = {&kEngineItf, obj};
+  obj->play_ = {&kPlayItf, obj};
+  obj->record_ = {&kRecordItf, obj};
+  obj->bufQueue_ = {&kBufQueueItf, obj};
+  obj->config_ = {&kConfigItf, obj};
+  return obj;
+}
+
+uint32_t QueueCapacity(const void *locator) {
+  const SLDataLocator_AndroidSimpleBufferQueue *bq =
+      static_cast<const SLDataLocator_AndroidSimpleBufferQueue *>(locator);
+  assert(bq->locatorType == SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE);
+  return bq->numBuffers;
+}
+
+/*
+ * SLEngineItf: one player and one recorder at a time, like the fast path
+ */
+SLresult CreateAudioPlayer(SLEngineItf self, SLObjectItf *pPlayer,
+                           SLDataSource *pAudioSrc, SLDataSink *pAudioSnk,
+                           SLuint32 numInterfaces,
+                           const SLInterfaceID *pInterfaceIds,
+                           const SLboolean *pInterfaceRequired) {
+  (void)self, (void)pAudioSnk, (void)numInterfaces, (void)pInterfaceIds,
+      (void)pInterfaceRequired;
+  if (gSim.player_) return SL_RESULT_FEATURE_UNSUPPORTED;
+  SimObject *obj = NewObject(PLAYER);
+  obj->state_ = SL_PLAYSTATE_STOPPED;
+  obj->queueCap_ = QueueCapacity(pAudioSrc->pLocator);
+  const SLAndroidDataFormat_PCM_EX *format =
+      static_cast<const SLAndroidDataFormat_PCM_EX *>(pAudioSrc->pFormat);
+  obj->bytesPerFrame_ = (format->containerSize >> 3) * format->numChannels;
+  assert(obj->bytesPerFrame_);
+  gSim.player_ = obj;
+  *pPlayer = &obj->object_.itf_;
+  return SL_RESULT_SUCCESS;
+}
+
+SLresult CreateAudioRecorder(SLEngineItf self, SLObjectItf *pRecorder,
+                             SLDataSource *pAudioSrc, SLDataSink *pAudioSnk,
+                             SLuint32 numInterfaces,
+                             const SLInterfaceID *pInterfaceIds,
+                             const SLboolean *pInterfaceRequired) {
+  (void)self, (void)pAudioSrc, (void)numInterfaces, (void)pInterfaceIds,
+      (void)pInterfaceRequired;
+  if (gSim.recorder_) return SL_RESULT_FEATURE_UNSUPPORTED;
+  SimObject *obj = NewObject(RECORDER);
+  obj->state_ = SL_RECORDSTATE_STOPPED;
+  obj->queueCap_ = QueueCapacity(pAudioSnk->pLocator);
+  gSim.recorder_ = obj;
+  *pRecorder = &obj->object_.itf_;
+  return SL_RESULT_SUCCESS;
+}
+
+SLresult CreateOutputMix(SLEngineItf self, SLObjectItf *pMix,
+                         SLuint32 numInterfaces,
+                         const SLInterfaceID *pInterfaceIds,
+                         const SLboolean *pInterfaceRequired) {
+  (void)self, (void)numInterfaces, (void)pInterfaceIds,
+      (void)pInterfaceRequired;
+  *pMix = &NewObject(OUTPUT_MIX)->object_.itf_;
+  return SL_RESULT_SUCCESS;
+}
+
+const SLEngineItf_ kEngineItf = {CreateAudioPlayer, CreateAudioRecorder,
+                                 CreateOutputMix};
+
+}  // namespace
+
+SLresult slCreateEngine(SLObjectItf *pEngine, SLuint32 numOptions,
+                        const SLEngineOption *pEngineOptions,
+                        SLuint32 numInterfaces,
+                        const SLInterfaceID *pInterfaceIds,
+                        const SLboolean *pInterfaceRequired) {
+  (void)numOptions, (void)pEngineOptions, (void)numInterfaces,
+      (void)pInterfaceIds, (void)pInterfaceRequired;
+  *pEngine = &NewObject(ENGINE)->object_.itf_;
+  return SL_RESULT_SUCCESS;
+}
+
+void SlSimReset(const SlSimConfig &config) {
+  assert(!gSim.player_ && !gSim.recorder_);
+  gSim.config_ = config;
+  gSim.stats_ = SlSimStats();
+  gSim.nowNs_ = 0;
+  gSim.periodNs_ =
+      static_cast<uint64_t>(config.framesPerBuf) * 1000000000ULL /
+      config.sampleRate;
+  gSim.events_ = decltype(gSim.events_)();
+  gSim.rng_.seed(config.seed);
+  gSim.captureNs_.clear();
+  gSim.samplePos_ = 0;
+
+  int64_t playStart = static_cast<int64_t>(gSim.periodNs_) +
+                      static_cast<int64_t>(config.playPhaseUs) * 1000;
+  Schedule(gSim.periodNs_, REC_PERIOD, 0, 0);
+  Schedule(static_cast<uint64_t>(std::max<int64_t>(playStart, 1)), PLAY_PERIOD,
+           0, 0);
+}
+
+void SlSimRunUntil(uint64_t timeNs) {
+  while (!gSim.events_.empty() && gSim.events_.top().timeNs_ <= timeNs) {
+    Event ev = gSim.events_.top();
+    gSim.events_.pop();
+    gSim.nowNs_ = ev.timeNs_;
+    switch (ev.type_) {
+      case REC_PERIOD:
+        RecorderPeriod(ev.period_);
+        Schedule(ev.timeNs_ + gSim.periodNs_, REC_PERIOD, 0, ev.period_ + 1);
+        break;
+      case PLAY_PERIOD:
+        Schedule(ev.timeNs_ + PlayerPeriod(ev.period_), PLAY_PERIOD, 0,
+                 ev.period_ + 1);
+        break;
+      case REC_CALLBACK:
+        if (gSim.recorder_ && gSim.recorder_->id_ == ev.objectId_) {
+          DeliverCallback(gSim.recorder_, &gSim.stats_.recCallbacks);
+        }
+        break;
+      case PLAY_CALLBACK:
+        if (gSim.player_ && gSim.player_->id_ == ev.objectId_) {
+          DeliverCallback(gSim.player_, &gSim.stats_.playCallbacks);
+        }
+        break;
+    }
+  }
+  gSim.nowNs_ = std::max(gSim.nowNs_, timeNs);
+}
+
+uint64_t SlSimNowNs(void) { return gSim.nowNs_; }
+
+// the engine's clock ( audio_common.h, ECHO_EXTERNAL_CLOCK ) is simulated
+uint64_t GetSystemTicks(void) { return gSim.nowNs_ / 1000; }
+uint64_t SlSimPeriodNs(void) { return gSim.periodNs_; }
+const SlSimStats &SlSimGetStats(void) { return gSim.stats_; }
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Simulated OpenSL ES device for the audio-echo engine on a Linux host.
+ *
+ * sl_sim.cpp implements slCreateEngine() and the engine, output mix, audio
+ * player and audio recorder objects declared in host/shim/SLES. Nothing
+ * runs on its own: SlSimRunUntil() advances a simulated clock and, on the
+ * calling thread,
+ *   - every period the recorder fills its head buffer; the player finishes
+ *     its current buffer when all of its frames have played ( shortened
+ *     buffers play for less than a period ) and starts the next one, as the
+ *     device would ( an empty recorder queue is an overrun, an empty player
+ *     queue an underrun of one period );
+ *   - the buffer queue callbacks of finished buffers are delivered after a
+ *     delay shaped by SlSimConfig: fixed delay, random jitter, bursts and
+ *     stalls of the callback thread. Callbacks of one device stay in order.
+ */
+#ifndef AUDIO_ECHO_HOST_SL_SIM_H
+#define AUDIO_ECHO_HOST_SL_SIM_H
+
+#include <cstdint>
+#include <vector>
+
+struct SlSimConfig {
+  uint32_t sampleRate = 48000;  // Hz
+  uint32_t framesPerBuf = 192;  // device period
+  uint32_t callbackDelayUs = 0;  // period end -> callback
+  uint32_t jitterUs = 0;         // plus uniform random [0, jitterUs)
+  uint32_t burstEvery = 0;  // every burstEvery periods, the callbacks of the
+  uint32_t burstLen = 0;    // first burstLen periods arrive all at once
+  uint32_t stallEveryMs = 0;  // callback threads blocked for the last
+  uint32_t stallMs = 0;       // stallMs of every stallEveryMs
+  int32_t playPhaseUs = 0;    // player period start against the recorder
+  uint32_t seed = 1;
+};
+
+struct SlSimStats {
+  std::vector<uint64_t> latencyNs;  // end of capture -> start of playback
+  uint64_t playedBufs = 0;          // recorded buffers played
+  uint64_t silentBufs = 0;          // other buffers played ( silence )
+  uint64_t underruns = 0;           // player periods with nothing queued
+  uint64_t overruns = 0;            // recorder periods with nothing queued
+  uint64_t recCallbacks = 0;
+  uint64_t playCallbacks = 0;
+};
+
+void SlSimReset(const SlSimConfig &config);
+void SlSimRunUntil(uint64_t timeNs);
+uint64_t SlSimNowNs(void);
+uint64_t SlSimPeriodNs(void);
+const SlSimStats &SlSimGetStats(void);
+
+#endif  // AUDIO_ECHO_HOST_SL_SIM_H
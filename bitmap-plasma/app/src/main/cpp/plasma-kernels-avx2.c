@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <immintrin.h>
+#include "plasma-kernels.h"
+
+/*
+ * AVX2 kernel: the SSE4.1 scheme on 256-bit registers, 16 pixels per
+ * iteration. packs_epi32 works per 128-bit lane, a permute puts the pixels
+ * back in order before the palette.
+ */
+static inline __m256i
+palette_565(__m256i idx)
+{
+    const __m256i c255 = _mm256_set1_epi16(255);
+    __m256i seg  = _mm256_srli_epi16(idx, 6);
+    __m256i jj   = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(idx, _mm256_set1_epi16(63)),
+                                                        _mm256_set1_epi16(1020)), 8);
+    __m256i inv  = _mm256_sub_epi16(c255, jj);
+    __m256i s0   = _mm256_cmpeq_epi16(seg, _mm256_setzero_si256());
+    __m256i s1   = _mm256_cmpeq_epi16(seg, _mm256_set1_epi16(1));
+    __m256i s2   = _mm256_cmpeq_epi16(seg, _mm256_set1_epi16(2));
+    __m256i s3   = _mm256_cmpeq_epi16(seg, _mm256_set1_epi16(3));
+
+    __m256i r = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(s0, c255),
+                                                _mm256_and_si256(s1, inv)),
+                                _mm256_and_si256(s3, jj));
+    __m256i g = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(s0, jj),
+                                                _mm256_and_si256(s1, c255)),
+                                _mm256_and_si256(s2, inv));
+    __m256i b = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(s0, inv),
+                                                _mm256_and_si256(s1, jj)),
+                                _mm256_and_si256(_mm256_or_si256(s2, s3), c255));
+
+    r = _mm256_and_si256(_mm256_slli_epi16(r, 8), _mm256_set1_epi16((short)0xf800));
+    g = _mm256_and_si256(_mm256_slli_epi16(g, 3), _mm256_set1_epi16(0x07e0));
+    b = _mm256_srli_epi16(b, 3);
+    return _mm256_or_si256(_mm256_or_si256(r, g), b);
+}
+
+/* swap the pixels of each 32-bit word */
+static inline __m256i
+swap_pairs(__m256i px)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(px, 16), _mm256_srli_epi32(px, 16));
+}
+
+static inline __m256i
+palette_index(const int32_t* xsum, __m256i base)
+{
+    const __m256i clamp = _mm256_set1_epi32(0xffff);
+    __m256i v = _mm256_srai_epi32(_mm256_add_epi32(_mm256_loadu_si256((const __m256i*)xsum),
+                                                   base), 2);
+    return _mm256_srli_epi32(_mm256_min_epi32(_mm256_abs_epi32(v), clamp), 8);
+}
+
+int
+plasma_row_avx2_x16(uint16_t* line, const int32_t* xsum, int32_t base, int width)
+{
+    const __m256i vbase = _mm256_set1_epi32(base);
+    int nn;
+
+    for (nn = 0; nn + 16 <= width; nn += 16) {
+        __m256i idx = _mm256_packs_epi32(palette_index(xsum + nn, vbase),
+                                         palette_index(xsum + nn + 8, vbase));
+        idx = _mm256_permute4x64_epi64(idx, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(line + nn), swap_pairs(palette_565(idx)));
+    }
+    return nn;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <arm_neon.h>
+#include "plasma-kernels.h"
+
+/*
+ * NEON kernel, 16 pixels per iteration: four registers of 32-bit lanes for
+ * the palette index, narrowed to two of 16-bit lanes for the RGB565 ramps.
+ */
+static inline uint16x8_t
+palette_565(uint16x8_t idx)
+{
+    const uint16x8_t c255 = vdupq_n_u16(255);
+    uint16x8_t seg  = vshrq_n_u16(idx, 6);
+    /* jj = (idx % 64) * 4 * 255 / 256, at most 64260 before the shift */
+    uint16x8_t jj   = vshrq_n_u16(vmulq_n_u16(vandq_u16(idx, vdupq_n_u16(63)), 1020), 8);
+    uint16x8_t inv  = vsubq_u16(c255, jj);
+    uint16x8_t s0   = vceqq_u16(seg, vdupq_n_u16(0));
+    uint16x8_t s1   = vceqq_u16(seg, vdupq_n_u16(1));
+    uint16x8_t s2   = vceqq_u16(seg, vdupq_n_u16(2));
+    uint16x8_t s3   = vceqq_u16(seg, vdupq_n_u16(3));
+
+    /* ramps: (255, jj, inv) (inv, 255, jj) (0, inv, 255) (jj, 0, 255) */
+    uint16x8_t r = vorrq_u16(vorrq_u16(vandq_u16(s0, c255), vandq_u16(s1, inv)),
+                             vandq_u16(s3, jj));
+    uint16x8_t g = vorrq_u16(vorrq_u16(vandq_u16(s0, jj), vandq_u16(s1, c255)),
+                             vandq_u16(s2, inv));
+    uint16x8_t b = vorrq_u16(vorrq_u16(vandq_u16(s0, inv), vandq_u16(s1, jj)),
+                             vandq_u16(vorrq_u16(s2, s3), c255));
+
+    r = vandq_u16(vshlq_n_u16(r, 8), vdupq_n_u16(0xf800));
+    g = vandq_u16(vshlq_n_u16(g, 3), vdupq_n_u16(0x07e0));
+    b = vshrq_n_u16(b, 3);
+    return vorrq_u16(vorrq_u16(r, g), b);
+}
+
+static inline uint16x4_t
+palette_index(const int32_t* xsum, int32x4_t base)
+{
+    int32x4_t v = vshrq_n_s32(vaddq_s32(vld1q_s32(xsum), base), 2);
+    v = vminq_s32(vabsq_s32(v), vdupq_n_s32(0xffff));
+    return vmovn_u32(vreinterpretq_u32_s32(vshrq_n_s32(v, 8)));
+}
+
+int
+plasma_row_neon_x16(uint16_t* line, const int32_t* xsum, int32_t base, int width)
+{
+    const int32x4_t vbase = vdupq_n_s32(base);
+    int nn;
+
+    for (nn = 0; nn + 16 <= width; nn += 16) {
+        uint16x8_t lo = vcombine_u16(palette_index(xsum + nn, vbase),
+                                     palette_index(xsum + nn + 4, vbase));
+        uint16x8_t hi = vcombine_u16(palette_index(xsum + nn + 8, vbase),
+                                     palette_index(xsum + nn + 12, vbase));
+        /* vrev32 swaps the pixels of each 32-bit word */
+        vst1q_u16(line + nn, vrev32q_u16(palette_565(lo)));
+        vst1q_u16(line + nn + 8, vrev32q_u16(palette_565(hi)));
+    }
+    return nn;
+}
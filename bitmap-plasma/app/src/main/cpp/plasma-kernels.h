@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef PLASMA_KERNELS_H
+#define PLASMA_KERNELS_H
+
+#include <stdint.h>
+
+/*
+ * Per-ISA row kernels behind fill_plasma(). The column phases of the plasma
+ * are the same on every row, so their two sines are summed once per frame
+ * into xsum[]; a row is then, for every pixel,
+ *
+ *     palette_from_fixed((base + xsum[x]) >> 2)
+ *
+ * with the palette, four linear ramps in RGB565, computed in registers
+ * rather than looked up. The two pixels of every 32-bit word are swapped,
+ * as the scalar path's ( p0 << 16 | p1 ) stores leave them on little endian:
+ * line must be 32-bit aligned. A kernel writes as many whole vectors of
+ * pixels as fit in width, with full vector stores, and returns how many it
+ * wrote; plasma.c finishes the row. Only the kernels whose HAVE_PLASMA_* flag is
+ * set by CMakeLists.txt are compiled in.
+ */
+typedef int (*plasma_row_fn)(uint16_t* line, const int32_t* xsum, int32_t base, int width);
+
+#ifdef HAVE_PLASMA_NEON
+int plasma_row_neon_x16(uint16_t* line, const int32_t* xsum, int32_t base, int width);
+#endif
+
+#ifdef HAVE_PLASMA_SSE41
+int plasma_row_sse41_x8(uint16_t* line, const int32_t* xsum, int32_t base, int width);
+#endif
+
+#ifdef HAVE_PLASMA_AVX2
+int plasma_row_avx2_x16(uint16_t* line, const int32_t* xsum, int32_t base, int width);
+#endif
+
+#endif /* PLASMA_KERNELS_H */
@@ -22,6 +22,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <cpu-features.h>
+#endif
+
+#include "frame_stats.h"
+#include "plasma-kernels.h"
 
 #define  LOG_TAG    "libplasma"
 #define  LOGI(...)  __android_log_print(ANDROID_LOG_INFO,LOG_TAG,__VA_ARGS__)
@@ -36,9 +45,7 @@
 /* Return current time in milliseconds */
 static double now_ms(void)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec*1000. + tv.tv_usec/1000.;
+    return FRAME_STATS_MS(frame_stats_now_ns());
 }
 
 /* We're going to perform computations for every pixel of the target
@@ -135,7 +142,16 @@ static __inline__ Fixed  fixed_cos( Fixed  f )
 #  error PALETTE_BITS must be smaller than FIXED_BITS 
 #endif
 
+/* Pixel formats the plasma can be rendered in, each with its own palette */
+enum {
+    PLASMA_FORMAT_RGB565,
+    PLASMA_FORMAT_RGBA8888,     /* also RGBX_8888: alpha is always opaque */
+    PLASMA_FORMAT_RGBA_F16,     /* linear half floats */
+};
+
 static uint16_t  palette[PALETTE_SIZE];
+static uint32_t  palette_8888[PALETTE_SIZE];
+static uint64_t  palette_f16[PALETTE_SIZE];
 
 static uint16_t  make565(int red, int green, int blue)
 {
@@ -144,37 +160,89 @@ static uint16_t  make565(int red, int green, int blue)
                        ((blue  >> 3) & 0x001f) );
 }
 
+/* R, G, B, A bytes in memory */
+static uint32_t  make8888(int red, int green, int blue)
+{
+    return (uint32_t)red | ((uint32_t)green << 8) | ((uint32_t)blue << 16) | 0xff000000u;
+}
+
+/* IEEE half float of a value in [0, 1] */
+static uint16_t  half_from_unit(double x)
+{
+    int  exp;
+    if (x <= 0.)
+        return 0;
+    /* x = m * 2^exp with m in [0.5, 1): the half is 1.f * 2^(exp-1) */
+    double  m = frexp(x, &exp);
+    int     bits = (int)floor((m*2. - 1.)*1024. + 0.5);
+    if (exp - 1 + 15 <= 0) {
+        /* subnormal: 0.f * 2^-14 */
+        return (uint16_t)floor(x*16777216. + 0.5);
+    }
+    if (bits == 1024) {
+        bits = 0;
+        exp += 1;
+    }
+    return (uint16_t)(((exp - 1 + 15) << 10) | bits);
+}
+
+/* the sRGB transfer function undone, for the linear half float surfaces */
+static uint16_t  linear_half(int value)
+{
+    double  v = value/255.;
+    v = (v <= 0.04045) ? v/12.92 : pow((v + 0.055)/1.055, 2.4);
+    return half_from_unit(v);
+}
+
+static uint64_t  makeF16(int red, int green, int blue)
+{
+    return (uint64_t)linear_half(red) | ((uint64_t)linear_half(green) << 16) |
+           ((uint64_t)linear_half(blue) << 32) | ((uint64_t)half_from_unit(1.) << 48);
+}
+
+static void set_palette(int  nn, int  red, int  green, int  blue)
+{
+    palette[nn]      = make565(red, green, blue);
+    palette_8888[nn] = make8888(red, green, blue);
+    palette_f16[nn]  = makeF16(red, green, blue);
+}
+
 static void init_palette(void)
 {
     int  nn, mm = 0;
     /* fun with colors */
     for (nn = 0; nn < PALETTE_SIZE/4; nn++) {
         int  jj = (nn-mm)*4*255/PALETTE_SIZE;
-        palette[nn] = make565(255, jj, 255-jj);
+        set_palette(nn, 255, jj, 255-jj);
     }
 
     for ( mm = nn; nn < PALETTE_SIZE/2; nn++ ) {
         int  jj = (nn-mm)*4*255/PALETTE_SIZE;
-        palette[nn] = make565(255-jj, 255, jj);
+        set_palette(nn, 255-jj, 255, jj);
     }
 
     for ( mm = nn; nn < PALETTE_SIZE*3/4; nn++ ) {
         int  jj = (nn-mm)*4*255/PALETTE_SIZE;
-        palette[nn] = make565(0, 255-jj, 255);
+        set_palette(nn, 0, 255-jj, 255);
     }
 
     for ( mm = nn; nn < PALETTE_SIZE; nn++ ) {
         int  jj = (nn-mm)*4*255/PALETTE_SIZE;
-        palette[nn] = make565(jj, 0, 255);
+        set_palette(nn, jj, 0, 255);
     }
 }
 
-static __inline__ uint16_t  palette_from_fixed( Fixed  x )
+static __inline__ int  palette_index( Fixed  x )
 {
     if (x < 0) x = -x;
     if (x >= FIXED_ONE) x = FIXED_ONE-1;
     int  idx = FIXED_FRAC(x) >> (FIXED_BITS - PALETTE_BITS);
-    return palette[idx & (PALETTE_SIZE-1)];
+    return idx & (PALETTE_SIZE-1);
+}
+
+static __inline__ uint16_t  palette_from_fixed( Fixed  x )
+{
+    return palette[palette_index(x)];
 }
 
 /* Angles expressed as fixed point radians */
@@ -185,18 +253,37 @@ static void init_tables(void)
     init_angles();
 }
 
-static void fill_plasma( AndroidBitmapInfo*  info, void*  pixels, double  t )
-{
-    Fixed yt1 = FIXED_FROM_FLOAT(t/1230.);
-    Fixed yt2 = yt1;
-    Fixed xt10 = FIXED_FROM_FLOAT(t/3000.);
-    Fixed xt20 = xt10;
+/* Everything a band of rows needs to render a frame */
+typedef struct {
+    void*   pixels;
+    int     width;
+    int     height;
+    int     stride;     /* in bytes */
+    int     format;     /* PLASMA_FORMAT_* */
+    double  t;
+
+    /* per-column sine sums and the RGB565 vector row kernel, NULL for the scalar path */
+    plasma_row_fn   row;
+    const Fixed*    xsum;
+} PlasmaFrame;
 
 #define  YT1_INCR   FIXED_FROM_FLOAT(1/100.)
 #define  YT2_INCR   FIXED_FROM_FLOAT(1/163.)
+#define  XT1_INCR   FIXED_FROM_FLOAT(1/173.)
+#define  XT2_INCR   FIXED_FROM_FLOAT(1/242.)
+
+/* Render rows [y0, y1) of an RGB565 frame */
+static void fill_plasma_rows_565( const PlasmaFrame*  frame, int  y0, int  y1 )
+{
+    /* the row phases only ever grow by a constant: start them at y0 */
+    Fixed yt1 = FIXED_FROM_FLOAT(frame->t/1230.) + y0*YT1_INCR;
+    Fixed yt2 = FIXED_FROM_FLOAT(frame->t/1230.) + y0*YT2_INCR;
+    Fixed xt10 = FIXED_FROM_FLOAT(frame->t/3000.);
+    Fixed xt20 = xt10;
+    void* pixels = (char*)frame->pixels + (size_t)y0*frame->stride;
 
     int  yy;
-    for (yy = 0; yy < info->height; yy++) {
+    for (yy = y0; yy < y1; yy++) {
         uint16_t*  line = (uint16_t*)pixels;
         Fixed      base = fixed_sin(yt1) + fixed_sin(yt2);
         Fixed      xt1 = xt10;
@@ -205,14 +292,38 @@ static void fill_plasma( AndroidBitmapInfo*  info, void*  pixels, double  t )
         yt1 += YT1_INCR;
         yt2 += YT2_INCR;
 
-#define  XT1_INCR  FIXED_FROM_FLOAT(1/173.)
-#define  XT2_INCR  FIXED_FROM_FLOAT(1/242.)
+        if (frame->row != NULL) {
+            /* same pixel order as the OPTIMIZE_WRITES path below */
+            const Fixed*  xsum = frame->xsum;
+            uint16_t*     line_end = line + frame->width;
+            int           done;
+
+            if (line < line_end && ((uint32_t)(uintptr_t)line & 3) != 0) {
+                line[0] = palette_from_fixed((base + xsum[0]) >> 2);
+                line++;
+                xsum++;
+            }
+            done = frame->row(line, xsum, base, (int)(line_end - line));
+            line += done;
+            xsum += done;
+            while (line + 2 <= line_end) {
+                line[0] = palette_from_fixed((base + xsum[1]) >> 2);
+                line[1] = palette_from_fixed((base + xsum[0]) >> 2);
+                line += 2;
+                xsum += 2;
+            }
+            if (line < line_end)
+                line[0] = palette_from_fixed((base + xsum[0]) >> 2);
+
+            pixels = (char*)pixels + frame->stride;
+            continue;
+        }
 
 #if OPTIMIZE_WRITES
         /* optimize memory writes by generating one aligned 32-bit store
          * for every pair of pixels.
          */
-        uint16_t*  line_end = line + info->width;
+        uint16_t*  line_end = line + frame->width;
 
         if (line < line_end) {
             if (((uint32_t)(uintptr_t)line & 3) != 0) {
@@ -249,7 +360,7 @@ static void fill_plasma( AndroidBitmapInfo*  info, void*  pixels, double  t )
         }
 #else /* !OPTIMIZE_WRITES */
         int xx;
-        for (xx = 0; xx < info->width; xx++) {
+        for (xx = 0; xx < frame->width; xx++) {
 
             Fixed ii = base + fixed_sin(xt1) + fixed_sin(xt2);
 
@@ -261,103 +372,432 @@ static void fill_plasma( AndroidBitmapInfo*  info, void*  pixels, double  t )
 #endif /* !OPTIMIZE_WRITES */
 
         // go to next line
-        pixels = (char*)pixels + info->stride;
+        pixels = (char*)pixels + frame->stride;
+    }
+}
+
+/* Render rows [y0, y1) of a 32 or 64-bit per pixel frame: one palette
+ * entry per pixel. Always inlined with a constant pixelBytes, so that each
+ * format gets its own loop.
+ */
+static __inline__ __attribute__((always_inline)) void
+fill_plasma_rows_wide( const PlasmaFrame*  frame, int  y0, int  y1, int  pixelBytes )
+{
+    Fixed yt1 = FIXED_FROM_FLOAT(frame->t/1230.) + y0*YT1_INCR;
+    Fixed yt2 = FIXED_FROM_FLOAT(frame->t/1230.) + y0*YT2_INCR;
+    Fixed xt10 = FIXED_FROM_FLOAT(frame->t/3000.);
+    Fixed xt20 = xt10;
+    void* pixels = (char*)frame->pixels + (size_t)y0*frame->stride;
+
+    int  yy;
+    for (yy = y0; yy < y1; yy++) {
+        Fixed  base = fixed_sin(yt1) + fixed_sin(yt2);
+        Fixed  xt1 = xt10;
+        Fixed  xt2 = xt20;
+        int    xx;
+
+        yt1 += YT1_INCR;
+        yt2 += YT2_INCR;
+
+        for (xx = 0; xx < frame->width; xx++) {
+            Fixed  ii;
+            if (frame->xsum != NULL) {
+                ii = base + frame->xsum[xx];
+            } else {
+                ii = base + fixed_sin(xt1) + fixed_sin(xt2);
+                xt1 += XT1_INCR;
+                xt2 += XT2_INCR;
+            }
+            if (pixelBytes == 4)
+                ((uint32_t*)pixels)[xx] = palette_8888[palette_index(ii >> 2)];
+            else
+                ((uint64_t*)pixels)[xx] = palette_f16[palette_index(ii >> 2)];
+        }
+
+        // go to next line
+        pixels = (char*)pixels + frame->stride;
+    }
+}
+
+static void fill_plasma_rows( const PlasmaFrame*  frame, int  y0, int  y1 )
+{
+    switch (frame->format) {
+    case PLASMA_FORMAT_RGBA8888:
+        fill_plasma_rows_wide(frame, y0, y1, 4);
+        break;
+    case PLASMA_FORMAT_RGBA_F16:
+        fill_plasma_rows_wide(frame, y0, y1, 8);
+        break;
+    default:
+        fill_plasma_rows_565(frame, y0, y1);
+        break;
     }
 }
 
-/* simple stats management */
+/* Vector kernels
+ *
+ * The kernels in plasma-kernels-*.c compute the same RGB565 pixels as the
+ * OPTIMIZE_WRITES path above, 8 or 16 at a time; the wider formats get the
+ * per-column sine sums only. The best kernel the CPU supports is picked at
+ * startup and checked against palette_from_fixed() over every palette index
+ * and both signs; a mismatch falls back to the scalar path.
+ * plasma_toggle_kernel() switches between the two at run time.
+ */
+enum {
+    PLASMA_ISA_NEON  = 1 << 0,
+    PLASMA_ISA_SSE41 = 1 << 1,
+    PLASMA_ISA_AVX2  = 1 << 2,
+};
+
 typedef struct {
-    double  renderTime;
-    double  frameTime;
-} FrameStats;
+    const char*    name;
+    plasma_row_fn  row;
+    uint32_t       isa;      /* required PLASMA_ISA_* bits */
+} PlasmaKernel;
+
+/* sorted from least to most preferred */
+static const PlasmaKernel  plasma_kernels[] = {
+    { "scalar",    NULL,                 0 },
+#ifdef HAVE_PLASMA_NEON
+    { "neonx16",   plasma_row_neon_x16,  PLASMA_ISA_NEON },
+#endif
+#ifdef HAVE_PLASMA_SSE41
+    { "sse41x8",   plasma_row_sse41_x8,  PLASMA_ISA_SSE41 },
+#endif
+#ifdef HAVE_PLASMA_AVX2
+    { "avx2x16",   plasma_row_avx2_x16,  PLASMA_ISA_AVX2 },
+#endif
+};
+#define  PLASMA_KERNEL_COUNT  (sizeof(plasma_kernels)/sizeof(plasma_kernels[0]))
 
-#define  MAX_FRAME_STATS  200
-#define  MAX_PERIOD_MS    1500
+static const PlasmaKernel*  kernel_best = &plasma_kernels[0];
+static const PlasmaKernel*  kernel      = &plasma_kernels[0];
+
+static uint32_t detect_isa(void)
+{
+    uint32_t isa = 0;
+#ifdef __ANDROID__
+    uint64_t features = android_getCpuFeatures();
+
+    switch (android_getCpuFamily()) {
+    case ANDROID_CPU_FAMILY_ARM:
+        if (features & ANDROID_CPU_ARM_FEATURE_NEON)
+            isa |= PLASMA_ISA_NEON;
+        break;
+    case ANDROID_CPU_FAMILY_ARM64:
+        isa |= PLASMA_ISA_NEON;
+        break;
+    case ANDROID_CPU_FAMILY_X86:
+    case ANDROID_CPU_FAMILY_X86_64:
+        if (features & ANDROID_CPU_X86_FEATURE_SSE4_1)
+            isa |= PLASMA_ISA_SSE41;
+        if (features & ANDROID_CPU_X86_FEATURE_AVX2)
+            isa |= PLASMA_ISA_AVX2;
+        break;
+    default:
+        break;
+    }
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1"))
+        isa |= PLASMA_ISA_SSE41;
+    if (__builtin_cpu_supports("avx2"))
+        isa |= PLASMA_ISA_AVX2;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+    isa |= PLASMA_ISA_NEON;
+#endif
+    return isa;
+}
+
+/* run a kernel over sums reaching every palette index, with both signs */
+static int kernel_matches_scalar(const PlasmaKernel*  k)
+{
+#define  CHECK_PIXELS  (2*4*PALETTE_SIZE)
+    static Fixed     xsum[CHECK_PIXELS];
+    static uint32_t  words[CHECK_PIXELS/2];
+    uint16_t*        line = (uint16_t*)words;
+    const Fixed      base = -FIXED_ONE/2;
+    int              nn, done;
+
+    for (nn = 0; nn < CHECK_PIXELS; nn++) {
+        /* (base + xsum) >> 2 sweeps -3 .. 3, in steps finer than a palette entry */
+        xsum[nn] = (nn - CHECK_PIXELS/2)*(FIXED_ONE*4/PALETTE_SIZE)*3/4 + FIXED_ONE/2 + nn%4;
+    }
+    done = k->row(line, xsum, base, CHECK_PIXELS);
+    for (nn = 0; nn < done; nn++) {
+        if (line[nn] != palette_from_fixed((base + xsum[nn ^ 1]) >> 2))
+            return 0;
+    }
+    return done > 0;
+#undef  CHECK_PIXELS
+}
+
+static void init_kernels(void)
+{
+#if OPTIMIZE_WRITES
+    uint32_t  isa = detect_isa();
+    size_t    nn;
+
+    for (nn = 1; nn < PLASMA_KERNEL_COUNT; nn++) {
+        const PlasmaKernel*  k = &plasma_kernels[nn];
+        if ((k->isa & isa) != k->isa)
+            continue;
+        if (!kernel_matches_scalar(k)) {
+            LOGE("Plasma kernel %s does not match the scalar path, not used", k->name);
+            continue;
+        }
+        kernel_best = k;
+    }
+#endif
+    kernel = kernel_best;
+    LOGI("Plasma kernel: %s", kernel->name);
+}
+
+/* switch between the best vector kernel and the scalar path */
+static void plasma_toggle_kernel(void)
+{
+    kernel = (kernel == kernel_best) ? &plasma_kernels[0] : kernel_best;
+    LOGI("Plasma kernel: %s", kernel->name);
+}
+
+/* Multithreaded rendering
+ *
+ * The rows are split into bands of about BAND_BYTES of pixels: small enough
+ * to stay in cache while they are written, and many more bands than threads
+ * so that the threads finish together. Worker threads are created once, with
+ * the first frame, and meet the rendering thread at a barrier every frame:
+ * they wake up when the frame number changes, take bands until none are
+ * left, and the last one to finish wakes the rendering thread, which renders
+ * bands too in the meantime.
+ */
+#define  MAX_THREADS  8
+#define  BAND_BYTES   (32*1024)
 
 typedef struct {
-    double  firstTime;
-    double  lastTime;
-    double  frameTime;
+    double  busyTime;   /* ms spent rendering the last frame */
+    int     bands;
+} ThreadStats;
+
+static struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      frameReady;
+    pthread_cond_t      frameDone;
+    int                 numThreads;     /* the rendering thread included */
+    unsigned            frame;
+    int                 busy;           /* workers not done with the frame */
+    const PlasmaFrame*  job;
+    int                 bandRows;
+    int                 numBands;
+    int                 nextBand;       /* taken with an atomic increment */
+    ThreadStats         threadStats[MAX_THREADS];
+} pool = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 1,
+};
+
+static void render_bands(int  index)
+{
+    ThreadStats*  ts = &pool.threadStats[index];
+    double        start = now_ms();
+    int           band;
+
+    while ((band = __atomic_fetch_add(&pool.nextBand, 1, __ATOMIC_RELAXED)) < pool.numBands) {
+        int  y0 = band*pool.bandRows;
+        int  y1 = y0 + pool.bandRows;
+        if (y1 > pool.job->height)
+            y1 = pool.job->height;
+        fill_plasma_rows(pool.job, y0, y1);
+        ts->bands += 1;
+    }
+    ts->busyTime = now_ms() - start;
+}
+
+static void* worker_main(void*  arg)
+{
+    int       index = (int)(intptr_t)arg;
+    unsigned  frame = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.frame == frame)
+            pthread_cond_wait(&pool.frameReady, &pool.lock);
+        frame = pool.frame;
+        pthread_mutex_unlock(&pool.lock);
+
+        render_bands(index);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.busy == 0)
+            pthread_cond_signal(&pool.frameDone);
+    }
+    return NULL;
+}
 
-    int         firstFrame;
-    int         numFrames;
-    FrameStats  frames[ MAX_FRAME_STATS ];
+static void init_threads(void)
+{
+    long  cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int   nn;
+
+    if (cpus > MAX_THREADS)
+        cpus = MAX_THREADS;
+    for (nn = 1; nn < cpus; nn++) {
+        pthread_t  thread;
+        if (pthread_create(&thread, NULL, worker_main, (void*)(intptr_t)nn) != 0) {
+            LOGE("Cannot create plasma worker thread %d", nn);
+            break;
+        }
+        pthread_detach(thread);
+    }
+    pool.numThreads = nn;
+    LOGI("Rendering plasma with %d threads", pool.numThreads);
+}
+
+static void fill_plasma( PlasmaFrame*  frame )
+{
+    static Fixed*  xsum;
+    static int     xsumSize;
+    int  rowBytes = frame->stride < 0 ? -frame->stride : frame->stride;
+    int  nn;
+
+    if (kernel != &plasma_kernels[0] && frame->width > 0) {
+        if (frame->width > xsumSize) {
+            Fixed*  grown = realloc(xsum, frame->width*sizeof(Fixed));
+            if (grown != NULL) {
+                xsum = grown;
+                xsumSize = frame->width;
+            }
+        }
+        if (frame->width <= xsumSize) {
+            /* sum the column sines once, for every row */
+            Fixed  xt1 = FIXED_FROM_FLOAT(frame->t/3000.);
+            Fixed  xt2 = xt1;
+            for (nn = 0; nn < frame->width; nn++) {
+                xsum[nn] = fixed_sin(xt1) + fixed_sin(xt2);
+                xt1 += XT1_INCR;
+                xt2 += XT2_INCR;
+            }
+            /* the vector kernels write RGB565, other formats only use the sums */
+            frame->row  = frame->format == PLASMA_FORMAT_RGB565 ? kernel->row : NULL;
+            frame->xsum = xsum;
+        }
+    }
+
+    pool.job = frame;
+    pool.bandRows = rowBytes > 0 && rowBytes < BAND_BYTES ? BAND_BYTES/rowBytes : 1;
+    pool.numBands = (frame->height + pool.bandRows - 1)/pool.bandRows;
+    pool.nextBand = 0;
+    for (nn = 0; nn < pool.numThreads; nn++) {
+        pool.threadStats[nn].busyTime = 0.;
+        pool.threadStats[nn].bands = 0;
+    }
+
+    if (pool.numThreads == 1 || pool.numBands < 2) {
+        render_bands(0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.busy = pool.numThreads - 1;
+    pool.frame += 1;
+    pthread_cond_broadcast(&pool.frameReady);
+    pthread_mutex_unlock(&pool.lock);
+
+    render_bands(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.busy > 0)
+        pthread_cond_wait(&pool.frameDone, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+/* frame timing from frame_stats.h, plus the rendering threads' share */
+#define  REPORT_PERIOD_NS  1500000000LL
+
+typedef struct {
+    FrameStats  frames;
+
+    /* per rendering thread, summed over the reporting period */
+    int         threadFrames;
+    double      threadBusy[ MAX_THREADS ];
+    int         threadBands[ MAX_THREADS ];
 } Stats;
 
+static void
+stats_resetThreads( Stats*  s )
+{
+    int nn;
+    s->threadFrames = 0;
+    for (nn = 0; nn < MAX_THREADS; nn++) {
+        s->threadBusy[nn]  = 0.;
+        s->threadBands[nn] = 0;
+    }
+}
+
 static void
 stats_init( Stats*  s )
 {
-    s->lastTime = now_ms();
-    s->firstTime = 0.;
-    s->firstFrame = 0;
-    s->numFrames  = 0;
+    frame_stats_init(&s->frames, FRAME_STATS_60HZ_NS, REPORT_PERIOD_NS);
+    stats_resetThreads(s);
 }
 
 static void
 stats_startFrame( Stats*  s )
 {
-    s->frameTime = now_ms();
+    frame_stats_begin(&s->frames);
 }
 
+/* add the rendering threads' share of the frame just rendered */
 static void
-stats_endFrame( Stats*  s )
+stats_addThreads( Stats*  s )
 {
-    double now = now_ms();
-    double renderTime = now - s->frameTime;
-    double frameTime  = now - s->lastTime;
     int nn;
-
-    if (now - s->firstTime >= MAX_PERIOD_MS) {
-        if (s->numFrames > 0) {
-            double minRender, maxRender, avgRender;
-            double minFrame, maxFrame, avgFrame;
-            int count;
-
-            nn = s->firstFrame;
-            minRender = maxRender = avgRender = s->frames[nn].renderTime;
-            minFrame  = maxFrame  = avgFrame  = s->frames[nn].frameTime;
-            for (count = s->numFrames; count > 0; count-- ) {
-                nn += 1;
-                if (nn >= MAX_FRAME_STATS)
-                    nn -= MAX_FRAME_STATS;
-                double render = s->frames[nn].renderTime;
-                if (render < minRender) minRender = render;
-                if (render > maxRender) maxRender = render;
-                double frame = s->frames[nn].frameTime;
-                if (frame < minFrame) minFrame = frame;
-                if (frame > maxFrame) maxFrame = frame;
-                avgRender += render;
-                avgFrame  += frame;
-            }
-            avgRender /= s->numFrames;
-            avgFrame  /= s->numFrames;
-
-            LOGI("frame/s (avg,min,max) = (%.1f,%.1f,%.1f) "
-                 "render time ms (avg,min,max) = (%.1f,%.1f,%.1f)\n",
-                 1000./avgFrame, 1000./maxFrame, 1000./minFrame,
-                 avgRender, minRender, maxRender);
-        }
-        s->numFrames  = 0;
-        s->firstFrame = 0;
-        s->firstTime  = now;
+    for (nn = 0; nn < pool.numThreads; nn++) {
+        s->threadBusy[nn]  += pool.threadStats[nn].busyTime;
+        s->threadBands[nn] += pool.threadStats[nn].bands;
     }
+    s->threadFrames += 1;
+}
 
-    nn = s->firstFrame + s->numFrames;
-    if (nn >= MAX_FRAME_STATS)
-        nn -= MAX_FRAME_STATS;
+static void
+stats_endFrame( Stats*  s )
+{
+    FrameStatsSnapshot  snap;
+    int nn;
 
-    s->frames[nn].renderTime = renderTime;
-    s->frames[nn].frameTime  = frameTime;
+    if (!frame_stats_end(&s->frames))
+        return;
 
-    if (s->numFrames < MAX_FRAME_STATS) {
-        s->numFrames += 1;
-    } else {
-        s->firstFrame += 1;
-        if (s->firstFrame >= MAX_FRAME_STATS)
-            s->firstFrame -= MAX_FRAME_STATS;
+    frame_stats_snapshot(&s->frames, &snap);
+    if (snap.interval.count > 0) {
+        LOGI("frame/s %.1f, jank %d/%d, "
+             "frame ms (p50,p99,p99.9,max) = (%.1f,%.1f,%.1f,%.1f) "
+             "render ms (p50,p99,p99.9,max) = (%.1f,%.1f,%.1f,%.1f)\n",
+             frame_stats_fps(&snap), (int)snap.jankFrames, (int)snap.interval.count,
+             FRAME_STATS_MS(snap.interval.p50Ns), FRAME_STATS_MS(snap.interval.p99Ns),
+             FRAME_STATS_MS(snap.interval.p999Ns), FRAME_STATS_MS(snap.interval.maxNs),
+             FRAME_STATS_MS(snap.work.p50Ns), FRAME_STATS_MS(snap.work.p99Ns),
+             FRAME_STATS_MS(snap.work.p999Ns), FRAME_STATS_MS(snap.work.maxNs));
     }
+    if (s->threadFrames > 0) {
+        double minBusy, maxBusy, avgBusy = 0.;
+        int    bands = 0;
+
+        minBusy = maxBusy = s->threadBusy[0];
+        for (nn = 0; nn < pool.numThreads; nn++) {
+            double busy = s->threadBusy[nn];
+            if (busy < minBusy) minBusy = busy;
+            if (busy > maxBusy) maxBusy = busy;
+            avgBusy += busy;
+            bands += s->threadBands[nn];
+        }
+        avgBusy /= pool.numThreads;
 
-    s->lastTime = now;
+        LOGI("%d threads, %s kernel, %.1f bands/frame, "
+             "busy ms/frame per thread (avg,min,max) = (%.1f,%.1f,%.1f)\n",
+             pool.numThreads, kernel->name, (double)bands/s->threadFrames,
+             avgBusy/s->threadFrames, minBusy/s->threadFrames,
+             maxBusy/s->threadFrames);
+    }
+    stats_resetThreads(s);
 }
 
 JNIEXPORT void JNICALL Java_com_example_plasma_PlasmaView_renderPlasma(JNIEnv * env, jobject  obj, jobject bitmap,  jlong  time_ms)
@@ -365,11 +805,14 @@ JNIEXPORT void JNICALL Java_com_example_plasma_PlasmaView_renderPlasma(JNIEnv *
     AndroidBitmapInfo  info;
     void*              pixels;
     int                ret;
+    int                format;
     static Stats       stats;
     static int         init;
 
     if (!init) {
         init_tables();
+        init_kernels();
+        init_threads();
         stats_init(&stats);
         init = 1;
     }
@@ -379,8 +822,19 @@ JNIEXPORT void JNICALL Java_com_example_plasma_PlasmaView_renderPlasma(JNIEnv *
         return;
     }
 
-    if (info.format != ANDROID_BITMAP_FORMAT_RGB_565) {
-        LOGE("Bitmap format is not RGB_565 !");
+    /* render straight into the bitmap's own format */
+    switch (info.format) {
+    case ANDROID_BITMAP_FORMAT_RGB_565:
+        format = PLASMA_FORMAT_RGB565;
+        break;
+    case ANDROID_BITMAP_FORMAT_RGBA_8888:
+        format = PLASMA_FORMAT_RGBA8888;
+        break;
+    case ANDROID_BITMAP_FORMAT_RGBA_F16:
+        format = PLASMA_FORMAT_RGBA_F16;
+        break;
+    default:
+        LOGE("Bitmap format %d is not supported !", info.format);
         return;
     }
 
@@ -391,9 +845,17 @@ JNIEXPORT void JNICALL Java_com_example_plasma_PlasmaView_renderPlasma(JNIEnv *
     stats_startFrame(&stats);
 
     /* Now fill the values with a nice little plasma */
-    fill_plasma(&info, pixels, time_ms );
+    PlasmaFrame  frame = { .pixels = pixels, .width = info.width, .height = info.height,
+                           .stride = info.stride, .format = format, .t = time_ms };
+    fill_plasma(&frame);
 
     AndroidBitmap_unlockPixels(env, bitmap);
 
+    stats_addThreads(&stats);
     stats_endFrame(&stats);
 }
+
+JNIEXPORT void JNICALL Java_com_example_plasma_PlasmaView_toggleKernel(JNIEnv * env, jobject  obj)
+{
+    plasma_toggle_kernel();
+}
@@ -24,6 +24,7 @@ import android.view.View;
 import android.graphics.Bitmap;
 import android.graphics.Canvas;
 import android.view.Display;
+import android.view.MotionEvent;
 import android.view.WindowManager;
 
 public class Plasma extends Activity
@@ -56,6 +57,7 @@ class PlasmaView extends View {
 
     // implementend by libplasma.so
     private static native void renderPlasma(Bitmap  bitmap, long time_ms);
+    private static native void toggleKernel();
 
     public PlasmaView(Context context, int width, int height) {
         super(context);
@@ -69,4 +71,13 @@ class PlasmaView extends View {
         // force a redraw, with a different time-based pattern.
         invalidate();
     }
+
+    // a tap switches between the vector and scalar plasma kernels
+    @Override public boolean onTouchEvent(MotionEvent event) {
+        if (event.getActionMasked() == MotionEvent.ACTION_DOWN) {
+            toggleKernel();
+            return true;
+        }
+        return super.onTouchEvent(event);
+    }
 }
@@ -18,10 +18,31 @@
  *   Demonstrate NDK Camera interface added to android-24
  */
 
+#include <algorithm>
 #include <cstdio>
+#include <ctime>
 #include "camera_engine.h"
 #include "utils/native_debug.h"
 
+/*
+ * The preview is drawn with OpenGL ES when kGLPreview is set and the device
+ * can, and converted on the CPU otherwise. CPU previews above 720p convert
+ * in bands on up to kMaxPreviewThreads threads. Every kPreviewLogFrames
+ * frames the CPU time the preview took is logged, with the band timings.
+ */
+static const bool kGLPreview = true;
+static const int32_t kBandedPreviewPixels = 1280 * 720;
+static const int32_t kMaxPreviewThreads = 4;
+static const uint32_t kPreviewLogFrames = 300;
+
+static int64_t NowNs(void) {
+  struct timespec ts {
+      0, 0
+  };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
 /**
  * constructor and destructor for main application class
  * @param app native_app_glue environment
@@ -34,7 +55,10 @@ CameraEngine::CameraEngine(android_app* app)
       cameraReady_(false),
       yuvReader_(nullptr),
       jpgReader_(nullptr),
-      camera_(nullptr) {
+      camera_(nullptr),
+      glPreview_(nullptr),
+      frameCount_(0),
+      previewNs_(0) {
   memset(&savedNativeWinRes_, 0, sizeof(savedNativeWinRes_));
 }
 
@@ -89,6 +113,20 @@ void CameraEngine::CreateCamera(void) {
 
   yuvReader_ = new ImageReader(&view, AIMAGE_FORMAT_YUV_420_888);
   yuvReader_->SetPresentRotation(imageRotation);
+  if (kGLPreview) {
+    glPreview_ = new GLPreview();
+    if (!glPreview_->Init(app_->window)) {
+      LOGW("GL preview not available, converting on the CPU");
+      delete glPreview_;
+      glPreview_ = nullptr;
+    }
+  }
+  if (!glPreview_ && view.width * view.height > kBandedPreviewPixels) {
+    // two bands per thread, so a preempted thread holds up less of the frame
+    int32_t cpus = static_cast<int32_t>(std::thread::hardware_concurrency());
+    int32_t threads = std::max(1, std::min(cpus, kMaxPreviewThreads));
+    yuvReader_->SetConversionBands(2 * threads, threads);
+  }
   jpgReader_ = new ImageReader(&capture, AIMAGE_FORMAT_JPEG);
   jpgReader_->SetPresentRotation(imageRotation);
   jpgReader_->RegisterCallback(this, [this](void* ctx, const char* str) -> void {
@@ -106,6 +144,10 @@ void CameraEngine::DeleteCamera(void) {
     delete camera_;
     camera_ = nullptr;
   }
+  if (glPreview_) {
+    delete glPreview_;
+    glPreview_ = nullptr;
+  }
   if (yuvReader_) {
     delete yuvReader_;
     yuvReader_ = nullptr;
@@ -159,14 +201,47 @@ void CameraEngine::DrawFrame(void) {
     return;
   }
 
-  ANativeWindow_acquire(app_->window);
-  ANativeWindow_Buffer buf;
-  if (ANativeWindow_lock(app_->window, &buf, nullptr) < 0) {
-    yuvReader_->DeleteImage(image);
-    return;
+  if (glPreview_) {
+    glPreview_->Draw(image, yuvReader_->GetPresentRotation());
+    previewNs_ += glPreview_->LastUploadNs();
+  } else {
+    ANativeWindow_acquire(app_->window);
+    ANativeWindow_Buffer buf;
+    if (ANativeWindow_lock(app_->window, &buf, nullptr) < 0) {
+      yuvReader_->DeleteImage(image);
+      return;
+    }
+
+    int64_t startNs = NowNs();
+    yuvReader_->DisplayImage(&buf, image);
+    previewNs_ += NowNs() - startNs;
+    ANativeWindow_unlockAndPost(app_->window);
+    ANativeWindow_release(app_->window);
+  }
+
+  if (++frameCount_ % kPreviewLogFrames == 0) {
+    LOGI("Preview: %.2f ms CPU per frame %s",
+         previewNs_ * 1e-6 / kPreviewLogFrames,
+         glPreview_ ? "uploading to GL" : "converting");
+    previewNs_ = 0;
+    LogBandTimings();
   }
+}
 
-  yuvReader_->DisplayImage(&buf, image);
-  ANativeWindow_unlockAndPost(app_->window);
-  ANativeWindow_release(app_->window);
+/**
+ * Log how the bands of the last preview frame were converted: when the
+ * slowest band starts late, or one thread takes several bands, the band
+ * count is worth tuning for the device.
+ */
+void CameraEngine::LogBandTimings(void) {
+  const std::vector<YuvBandTiming>& timings = yuvReader_->GetBandTimings();
+  if (timings.size() < 2) return;
+  int64_t endNs = 0;
+  for (const YuvBandTiming& t : timings) {
+    endNs = std::max(endNs, t.startNs + t.durationNs);
+    LOGI("  band rows %d-%d: thread %d, start %.2f ms, took %.2f ms",
+         t.firstRow, t.firstRow + t.rowCount - 1, t.thread, t.startNs * 1e-6,
+         t.durationNs * 1e-6);
+  }
+  LOGI("YUV conversion: %zu bands in %.2f ms", timings.size(), endNs * 1e-6);
 }
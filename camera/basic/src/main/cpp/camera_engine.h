@@ -24,6 +24,7 @@
 #include <thread>
 
 #include "camera_manager.h"
+#include "gl_preview.h"
 
 /**
  * basic CameraAppEngine
@@ -60,6 +61,7 @@ class CameraEngine {
  private:
   void OnPhotoTaken(const char* fileName);
   int  GetDisplayRotation(void);
+  void LogBandTimings(void);
 
   struct android_app* app_;
   ImageFormat savedNativeWinRes_;
@@ -69,6 +71,9 @@ class CameraEngine {
   NDKCamera* camera_;
   ImageReader* yuvReader_;
   ImageReader* jpgReader_;
+  GLPreview* glPreview_;
+  uint32_t frameCount_;
+  int64_t previewNs_;  // CPU time of the preview frames since the last log
 };
 
 /**
@@ -92,6 +92,17 @@ void CameraEngine::OnTakePhoto() {
 
 void CameraEngine::OnPhotoTaken(const char* fileName) {
   int32_t nameLen = strlen(fileName);
+  JpegWriter* writer = jpgReader_ ? jpgReader_->GetJpegWriter() : nullptr;
+  if (writer) {
+    JpegWriterStats stats = writer->GetStats();
+    LOGI("JPEG %llu/%llu written, queue %d (max %d), write %.1f ms "
+         "(max %.1f), latency %.1f ms (max %.1f), %llu stalls",
+         (unsigned long long)stats.written,
+         (unsigned long long)stats.submitted, stats.queueDepth,
+         stats.maxQueueDepth, stats.lastWriteNs * 1e-6,
+         stats.maxWriteNs * 1e-6, stats.lastLatencyNs * 1e-6,
+         stats.maxLatencyNs * 1e-6, (unsigned long long)stats.stalls);
+  }
   JNIEnv *jni;
   app_->activity->vm->AttachCurrentThread(&jni, NULL);
 
@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "gl_preview.h"
+#include "utils/native_debug.h"
+
+static const char* kVertexShader = R"(#version 300 es
+layout(location = 0) in vec2 aPosition;
+layout(location = 1) in vec2 aTexCoord;
+uniform vec2 uChromaScale;
+out vec2 vLumaCoord;
+out vec2 vChromaCoord;
+void main() {
+  vLumaCoord = aTexCoord;
+  vChromaCoord = aTexCoord * uChromaScale;
+  gl_Position = vec4(aPosition, 0.0, 1.0);
+}
+)";
+
+/*
+ * YUV2RGB() of image_reader.cpp, on 0..255 values: uTexU is the plane that
+ * function takes as nU ( plane 2 ), uTexV the one it takes as nV. The CPU
+ * path stores 0xAARRGGBB words into an RGBA window, so its R lands in blue
+ * and its B in red; the preview here looks the same.
+ */
+static const char* kFragmentShader = R"(#version 300 es
+precision highp float;
+uniform sampler2D uTexY;
+uniform sampler2D uTexU;
+uniform sampler2D uTexV;
+uniform vec4 uSelectU;
+uniform vec4 uSelectV;
+in vec2 vLumaCoord;
+in vec2 vChromaCoord;
+out vec4 outColor;
+void main() {
+  float y = max(texture(uTexY, vLumaCoord).r * 255.0 - 16.0, 0.0);
+  float u = dot(texture(uTexU, vChromaCoord), uSelectU) * 255.0 - 128.0;
+  float v = dot(texture(uTexV, vChromaCoord), uSelectV) * 255.0 - 128.0;
+  vec3 rgb = vec3(1192.0 * y + 1634.0 * v,
+                  1192.0 * y - 833.0 * v - 400.0 * u,
+                  1192.0 * y + 2066.0 * u) / (1024.0 * 255.0);
+  outColor = vec4(clamp(rgb.bgr, 0.0, 1.0), 1.0);
+}
+)";
+
+static int64_t NowNs(void) {
+  struct timespec ts {
+      0, 0
+  };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static GLuint CompileShader(GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled) {
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    LOGE("Failed to compile preview shader: %s", log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+GLPreview::GLPreview()
+    : display_(EGL_NO_DISPLAY),
+      surface_(EGL_NO_SURFACE),
+      context_(EGL_NO_CONTEXT),
+      program_(0),
+      chromaScaleLoc_(-1),
+      pboIndex_(0),
+      vertexBuffer_(0),
+      vertexArray_(0),
+      uploadNs_(0) {
+  memset(textures_, 0, sizeof(textures_));
+  memset(texWidth_, 0, sizeof(texWidth_));
+  memset(texHeight_, 0, sizeof(texHeight_));
+  memset(texFormat_, 0, sizeof(texFormat_));
+  memset(pbos_, 0, sizeof(pbos_));
+}
+
+GLPreview::~GLPreview() {
+  if (context_ != EGL_NO_CONTEXT) {
+    eglMakeCurrent(display_, surface_, surface_, context_);
+    glDeleteTextures(PLANE_COUNT, textures_);
+    glDeleteBuffers(PLANE_COUNT * kPboCount, &pbos_[0][0]);
+    glDeleteBuffers(1, &vertexBuffer_);
+    glDeleteVertexArrays(1, &vertexArray_);
+    glDeleteProgram(program_);
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display_, context_);
+  }
+  if (surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, surface_);
+  }
+  if (display_ != EGL_NO_DISPLAY) {
+    eglTerminate(display_);
+  }
+}
+
+bool GLPreview::Init(ANativeWindow* window) {
+  display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (!eglInitialize(display_, nullptr, nullptr)) {
+    display_ = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  const EGLint configAttribs[] = {
+      EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+      EGL_BLUE_SIZE, 8,
+      EGL_GREEN_SIZE, 8,
+      EGL_RED_SIZE, 8,
+      EGL_ALPHA_SIZE, 8,
+      EGL_NONE,
+  };
+  EGLConfig config;
+  EGLint cfgCount = 0;
+  if (!eglChooseConfig(display_, configAttribs, &config, 1, &cfgCount) ||
+      cfgCount != 1) {
+    LOGW("No ES 3.0 RGBA8888 config for the GL preview");
+    return false;
+  }
+
+  const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+  context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, contextAttribs);
+  if (context_ == EGL_NO_CONTEXT) {
+    return false;
+  }
+  surface_ = eglCreateWindowSurface(display_, config, window, nullptr);
+  if (surface_ == EGL_NO_SURFACE ||
+      !eglMakeCurrent(display_, surface_, surface_, context_)) {
+    LOGW("Cannot render the GL preview to the window");
+    return false;
+  }
+
+  if (!CreateProgram()) {
+    return false;
+  }
+  glGenTextures(PLANE_COUNT, textures_);
+  for (int plane = 0; plane < PLANE_COUNT; plane++) {
+    glBindTexture(GL_TEXTURE_2D, textures_[plane]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  glGenBuffers(PLANE_COUNT * kPboCount, &pbos_[0][0]);
+
+  glGenVertexArrays(1, &vertexArray_);
+  glBindVertexArray(vertexArray_);
+  glGenBuffers(1, &vertexBuffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(GLfloat), nullptr,
+               GL_DYNAMIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat),
+                        reinterpret_cast<void*>(0));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat),
+                        reinterpret_cast<void*>(2 * sizeof(GLfloat)));
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+  return glGetError() == GL_NO_ERROR;
+}
+
+bool GLPreview::CreateProgram(void) {
+  GLuint vs = CompileShader(GL_VERTEX_SHADER, kVertexShader);
+  GLuint fs = CompileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+  if (!vs || !fs) {
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return false;
+  }
+  program_ = glCreateProgram();
+  glAttachShader(program_, vs);
+  glAttachShader(program_, fs);
+  glLinkProgram(program_);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program_, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    LOGE("Failed to link the preview program");
+    return false;
+  }
+
+  glUseProgram(program_);
+  texLoc_[PLANE_Y] = glGetUniformLocation(program_, "uTexY");
+  texLoc_[PLANE_U] = glGetUniformLocation(program_, "uTexU");
+  texLoc_[PLANE_V] = glGetUniformLocation(program_, "uTexV");
+  selectLoc_[0] = glGetUniformLocation(program_, "uSelectU");
+  selectLoc_[1] = glGetUniformLocation(program_, "uSelectV");
+  chromaScaleLoc_ = glGetUniformLocation(program_, "uChromaScale");
+  return true;
+}
+
+/*
+ * Copy height rows of width texels out of a plane into tight rows at dst.
+ */
+static void PackPlane(uint8_t* dst, const uint8_t* data, GLint width,
+                      GLint height, int32_t texelSize, int32_t rowStride,
+                      int32_t pixelStride) {
+  for (GLint y = 0; y < height; y++) {
+    const uint8_t* src = data + y * rowStride;
+    for (GLint x = 0; x < width; x++) {
+      for (int32_t c = 0; c < texelSize; c++) {
+        *dst++ = src[x * pixelStride + c];
+      }
+    }
+  }
+}
+
+/*
+ * Copy a plane into the next PBO of its ring and upload it into the plane's
+ * texture. Planes whose pixels are format-sized texels are copied as one
+ * block and unpacked with GL_UNPACK_ROW_LENGTH; anything else is repacked
+ * into tight rows. If the PBO cannot be mapped, the plane is uploaded from
+ * client memory instead.
+ */
+void GLPreview::Upload(int plane, GLenum format, GLint width, GLint height,
+                       const uint8_t* data, int32_t rowStride,
+                       int32_t pixelStride, int32_t length) {
+  const int32_t texelSize = (format == GL_RG) ? 2 : 1;
+  const int32_t needed = rowStride * (height - 1) + width * texelSize;
+  const bool direct = (pixelStride == texelSize) &&
+                      (rowStride % texelSize == 0) && (length >= needed);
+  const int32_t size = direct ? needed : width * height * texelSize;
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[plane][pboIndex_]);
+  // orphan the old storage: the GPU may still be reading it
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  uint8_t* dst = static_cast<uint8_t*>(
+      glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  // offset into the bound PBO, or client memory once it is unbound
+  const uint8_t* pixels = nullptr;
+  if (dst) {
+    if (direct) {
+      memcpy(dst, data, size);
+    } else {
+      PackPlane(dst, data, width, height, texelSize, rowStride, pixelStride);
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  } else {
+    LOGW("Cannot map the PBO of plane %d, uploading from client memory",
+         plane);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (direct) {
+      pixels = data;
+    } else {
+      packed_.resize(size);
+      PackPlane(packed_.data(), data, width, height, texelSize, rowStride,
+                pixelStride);
+      pixels = packed_.data();
+    }
+  }
+
+  glActiveTexture(GL_TEXTURE0 + plane);
+  glBindTexture(GL_TEXTURE_2D, textures_[plane]);
+  if (texWidth_[plane] != width || texHeight_[plane] != height ||
+      texFormat_[plane] != format) {
+    glTexImage2D(GL_TEXTURE_2D, 0, format == GL_RG ? GL_RG8 : GL_R8, width,
+                 height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+    texWidth_[plane] = width;
+    texHeight_[plane] = height;
+    texFormat_[plane] = format;
+  }
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, direct ? rowStride / texelSize : 0);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format,
+                  GL_UNSIGNED_BYTE, pixels);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/*
+ * A quad over the whole surface whose texture coordinates pick the crop
+ * rectangle, rotated the way ImageReader::PresentImage() rotates it:
+ * (dc, dr) is a corner of the destination, top-down, and (sx, sy) is where
+ * it comes from in the crop rectangle.
+ */
+void GLPreview::SetGeometry(int32_t rotation, const AImageCropRect& crop,
+                            int32_t width, int32_t height) {
+  GLfloat vertices[16];
+  for (int corner = 0; corner < 4; corner++) {
+    GLfloat dc = static_cast<GLfloat>(corner & 1);
+    GLfloat dr = static_cast<GLfloat>(corner >> 1);
+    GLfloat sx, sy;
+    switch (rotation) {
+      case 90:
+        sx = dr, sy = 1.0f - dc;
+        break;
+      case 180:
+        sx = 1.0f - dc, sy = 1.0f - dr;
+        break;
+      case 270:
+        sx = 1.0f - dr, sy = dc;
+        break;
+      default:
+        sx = dc, sy = dr;
+        break;
+    }
+    GLfloat* v = vertices + corner * 4;
+    v[0] = dc * 2.0f - 1.0f;
+    v[1] = 1.0f - dr * 2.0f;
+    v[2] = (crop.left + sx * (crop.right - crop.left)) / width;
+    v[3] = (crop.top + sy * (crop.bottom - crop.top)) / height;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+}
+
+bool GLPreview::Draw(AImage* image, int32_t rotation) {
+  int32_t width = 0, height = 0;
+  AImageCropRect crop;
+  AImage_getWidth(image, &width);
+  AImage_getHeight(image, &height);
+  AImage_getCropRect(image, &crop);
+
+  int32_t yStride, uvStride, yPixelStride, uvPixelStride;
+  uint8_t *yPixel, *uPixel, *vPixel;
+  int32_t yLen, uLen, vLen;
+  AImage_getPlaneRowStride(image, 0, &yStride);
+  AImage_getPlaneRowStride(image, 1, &uvStride);
+  AImage_getPlanePixelStride(image, 0, &yPixelStride);
+  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
+  AImage_getPlaneData(image, 0, &yPixel, &yLen);
+  AImage_getPlaneData(image, 1, &vPixel, &vLen);
+  AImage_getPlaneData(image, 2, &uPixel, &uLen);
+  const GLint chromaWidth = (width + 1) / 2;
+  const GLint chromaHeight = (height + 1) / 2;
+
+  int64_t startNs = NowNs();
+  Upload(PLANE_Y, GL_RED, width, height, yPixel, yStride, yPixelStride, yLen);
+
+  // ( 1, 0, 0, 0 ) selects the red channel of a texel, ( 0, 1, 0, 0 ) green
+  GLfloat select[2][4] = {{1.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}};
+  GLint chromaTex[2] = {PLANE_U, PLANE_V};
+  if (uvPixelStride == 2 && std::abs(uPixel - vPixel) == 1) {
+    // semi-planar: both chroma samples of a pair in one RG texel
+    const bool uFirst = uPixel < vPixel;
+    const uint8_t* first = uFirst ? uPixel : vPixel;
+    int32_t length = uFirst ? std::max(uLen, vLen + 1)
+                            : std::max(vLen, uLen + 1);
+    Upload(PLANE_U, GL_RG, chromaWidth, chromaHeight, first, uvStride, 2,
+           length);
+    select[uFirst ? 1 : 0][0] = 0.0f;
+    select[uFirst ? 1 : 0][1] = 1.0f;
+    chromaTex[1] = PLANE_U;
+  } else {
+    Upload(PLANE_U, GL_RED, chromaWidth, chromaHeight, uPixel, uvStride,
+           uvPixelStride, uLen);
+    Upload(PLANE_V, GL_RED, chromaWidth, chromaHeight, vPixel, uvStride,
+           uvPixelStride, vLen);
+  }
+  pboIndex_ = (pboIndex_ + 1) % kPboCount;
+  uploadNs_ = NowNs() - startNs;
+
+  // the planes are in the PBOs, the reader can have its buffer back
+  AImage_delete(image);
+
+  EGLint surfaceWidth = 0, surfaceHeight = 0;
+  eglQuerySurface(display_, surface_, EGL_WIDTH, &surfaceWidth);
+  eglQuerySurface(display_, surface_, EGL_HEIGHT, &surfaceHeight);
+  glViewport(0, 0, surfaceWidth, surfaceHeight);
+
+  glUseProgram(program_);
+  glUniform1i(texLoc_[PLANE_Y], PLANE_Y);
+  glUniform1i(texLoc_[PLANE_U], chromaTex[0]);
+  glUniform1i(texLoc_[PLANE_V], chromaTex[1]);
+  glUniform4fv(selectLoc_[0], 1, select[0]);
+  glUniform4fv(selectLoc_[1], 1, select[1]);
+  glUniform2f(chromaScaleLoc_,
+              static_cast<GLfloat>(width) / (2 * chromaWidth),
+              static_cast<GLfloat>(height) / (2 * chromaHeight));
+  SetGeometry(rotation, crop, width, height);
+  glBindVertexArray(vertexArray_);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+  return eglSwapBuffers(display_, surface_) == EGL_TRUE;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_GL_PREVIEW_H
+#define CAMERA_GL_PREVIEW_H
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+#include <android/native_window.h>
+#include <media/NdkImage.h>
+#include <cstdint>
+#include <vector>
+
+/*
+ * GLPreview:
+ *     Presents YUV_420_888 camera images with OpenGL ES 3.0 instead of
+ * converting them on the CPU. The luma plane and the chroma plane(s) are
+ * copied as they are into pixel buffer objects and uploaded as R8 / RG8
+ * textures; YUV to RGB, crop and rotation happen in the fragment shader,
+ * with the same coefficients as the CPU YUV2RGB().
+ *
+ * Each plane has a ring of kPboCount PBOs, created once and orphaned before
+ * every copy, so mapping one never waits for the GPU to finish reading the
+ * previous frame out of it.
+ *
+ * A window used here cannot be locked for CPU rendering until the preview
+ * is destroyed.
+ */
+class GLPreview {
+ public:
+  GLPreview();
+  ~GLPreview();
+
+  /**
+   * Create an ES 3.0 context and a surface for window, and make them
+   * current on the calling thread, which must also call Draw().
+   * @return false if the device cannot, the preview is then unusable
+   */
+  bool Init(ANativeWindow* window);
+
+  /**
+   * Upload image, draw it rotated anti-clockwise by rotation degrees
+   * ( 0, 90, 180 or 270 ) to fill the window, and post it.
+   * @param image a {@link AImage} instance, deleted via
+   *        {@link AImage_delete}
+   * @return false if the image could not be drawn
+   */
+  bool Draw(AImage* image, int32_t rotation);
+
+  /**
+   * CPU time of the last Draw() spent copying the planes into PBOs and
+   * issuing the texture uploads, in nanoseconds
+   */
+  int64_t LastUploadNs(void) const { return uploadNs_; }
+
+ private:
+  static const int kPboCount = 3;
+
+  // textures, and the PBO rings behind them
+  enum { PLANE_Y, PLANE_U, PLANE_V, PLANE_COUNT };
+
+  EGLDisplay display_;
+  EGLSurface surface_;
+  EGLContext context_;
+
+  GLuint program_;
+  GLint texLoc_[PLANE_COUNT];
+  GLint selectLoc_[2];     // picks u and v out of a chroma texel
+  GLint chromaScaleLoc_;   // luma to chroma texture coordinates
+  GLuint textures_[PLANE_COUNT];
+  GLint texWidth_[PLANE_COUNT];
+  GLint texHeight_[PLANE_COUNT];
+  GLenum texFormat_[PLANE_COUNT];
+  GLuint pbos_[PLANE_COUNT][kPboCount];
+  int pboIndex_;
+  // tight rows of a plane when its PBO cannot be mapped
+  std::vector<uint8_t> packed_;
+  GLuint vertexBuffer_;
+  GLuint vertexArray_;
+
+  int64_t uploadNs_;
+
+  bool CreateProgram(void);
+  void Upload(int plane, GLenum format, GLint width, GLint height,
+              const uint8_t* data, int32_t rowStride, int32_t pixelStride,
+              int32_t length);
+  void SetGeometry(int32_t rotation, const AImageCropRect& crop,
+                   int32_t width, int32_t height);
+};
+
+#endif  // CAMERA_GL_PREVIEW_H
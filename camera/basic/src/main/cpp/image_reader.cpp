@@ -13,24 +13,31 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <string>
 #include <functional>
 #include <thread>
-#include <cstdlib>
-#include <dirent.h>
-#include <ctime>
 #include "image_reader.h"
 #include "utils/native_debug.h"
 
 /*
  * For JPEG capture, captured files are saved under
  *     DirName
- * File names are incrementally appended an index number as
- *     capture0.jpg, capture1.jpg, capture2.jpg
+ * File names carry the capture time and an index number as
+ *     capture<month><day>-<hour><minute><second>_0.jpg, ..._1.jpg
  */
 static const char *kDirName = "/sdcard/DCIM/Camera/";
 static const char *kFileName = "capture";
 
+/*
+ * JPEG writer: captures are written out by kJpegWriterThreads threads, with
+ * up to MAX_BUF_COUNT of them copied out and waiting; the buffers start at
+ * kJpegBytesPerPixel of the capture size, about what a high quality JPEG
+ * takes, and grow if a capture is bigger.
+ */
+static const int32_t kJpegWriterThreads = 2;
+static const float kJpegBytesPerPixel = 0.5f;
+
 /**
  * MAX_BUF_COUNT:
  *   Max buffers in this ImageReader.
@@ -55,7 +62,10 @@ void OnImageCallback(void *ctx, AImageReader *reader) {
  * Constructor
  */
 ImageReader::ImageReader(ImageFormat *res, enum AIMAGE_FORMATS format)
-    : reader_(nullptr), presentRotation_(0) {
+    : reader_(nullptr),
+      presentRotation_(0),
+      bandPool_(new YuvBandPool(0)),
+      bandCount_(1) {
   callback_ = nullptr;
   callbackCtx_ = nullptr;
 
@@ -67,6 +77,23 @@ ImageReader::ImageReader(ImageFormat *res, enum AIMAGE_FORMATS format)
       .context = this, .onImageAvailable = OnImageCallback,
   };
   AImageReader_setImageListener(reader_, &listener);
+
+  if (format == AIMAGE_FORMAT_JPEG) {
+    JpegWriterConfig config{
+        .threadCount = kJpegWriterThreads,
+        .bufferCount = MAX_BUF_COUNT,
+        .bufferSize = static_cast<int32_t>(res->width * res->height *
+                                           kJpegBytesPerPixel),
+        .directIo = true,
+        .fsyncPolicy = JPEG_FSYNC_DATA,
+    };
+    jpegWriter_.reset(new JpegWriter(kDirName, kFileName, config));
+    jpegWriter_->SetCallback([this](const char *fileName) {
+      if (callback_) {
+        callback_(callbackCtx_, fileName);
+      }
+    });
+  }
 }
 
 ImageReader::~ImageReader() {
@@ -89,12 +116,13 @@ void ImageReader::ImageCallback(AImageReader *reader) {
     media_status_t status = AImageReader_acquireNextImage(reader, &image);
     ASSERT(status == AMEDIA_OK && image, "Image is not available");
 
-    // Create a thread and write out the jpeg files
-    std::thread writeFileHandler(&ImageReader::WriteFile, this, image);
-    writeFileHandler.detach();
+    // Copy it out and hand it back to the reader; the writer threads save it
+    jpegWriter_->Submit(image);
   }
 }
 
+JpegWriter *ImageReader::GetJpegWriter(void) { return jpegWriter_.get(); }
+
 ANativeWindow *ImageReader::GetNativeWindow(void) {
   if (!reader_) return nullptr;
   ANativeWindow *nativeWindow;
@@ -140,59 +168,6 @@ void ImageReader::DeleteImage(AImage *image) {
   if (image) AImage_delete(image);
 }
 
-/**
- * Helper function for YUV_420 to RGB conversion. Courtesy of Tensorflow
- * ImageClassifier Sample:
- * https://github.com/tensorflow/tensorflow/blob/master/tensorflow/examples/android/jni/yuv2rgb.cc
- * The difference is that here we have to swap UV plane when calling it.
- */
-#ifndef MAX
-#define MAX(a, b)           \
-  ({                        \
-    __typeof__(a) _a = (a); \
-    __typeof__(b) _b = (b); \
-    _a > _b ? _a : _b;      \
-  })
-#define MIN(a, b)           \
-  ({                        \
-    __typeof__(a) _a = (a); \
-    __typeof__(b) _b = (b); \
-    _a < _b ? _a : _b;      \
-  })
-#endif
-
-// This value is 2 ^ 18 - 1, and is used to clamp the RGB values before their
-// ranges
-// are normalized to eight bits.
-static const int kMaxChannelValue = 262143;
-
-static inline uint32_t YUV2RGB(int nY, int nU, int nV) {
-  nY -= 16;
-  nU -= 128;
-  nV -= 128;
-  if (nY < 0) nY = 0;
-
-  // This is the floating point equivalent. We do the conversion in integer
-  // because some Android devices do not have floating point in hardware.
-  // nR = (int)(1.164 * nY + 1.596 * nV);
-  // nG = (int)(1.164 * nY - 0.813 * nV - 0.391 * nU);
-  // nB = (int)(1.164 * nY + 2.018 * nU);
-
-  int nR = (int)(1192 * nY + 1634 * nV);
-  int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
-  int nB = (int)(1192 * nY + 2066 * nU);
-
-  nR = MIN(kMaxChannelValue, MAX(0, nR));
-  nG = MIN(kMaxChannelValue, MAX(0, nG));
-  nB = MIN(kMaxChannelValue, MAX(0, nB));
-
-  nR = (nR >> 10) & 0xff;
-  nG = (nG >> 10) & 0xff;
-  nB = (nB >> 10) & 0xff;
-
-  return 0xff000000 | (nR << 16) | (nG << 8) | nB;
-}
-
 /**
  * Convert yuv image inside AImage into ANativeWindow_Buffer
  * ANativeWindow_Buffer format is guaranteed to be
@@ -215,22 +190,7 @@ bool ImageReader::DisplayImage(ANativeWindow_Buffer *buf, AImage *image) {
   AImage_getNumberOfPlanes(image, &srcPlanes);
   ASSERT(srcPlanes == 3, "Is not 3 planes");
 
-  switch (presentRotation_) {
-    case 0:
-      PresentImage(buf, image);
-      break;
-    case 90:
-      PresentImage90(buf, image);
-      break;
-    case 180:
-      PresentImage180(buf, image);
-      break;
-    case 270:
-      PresentImage270(buf, image);
-      break;
-    default:
-      ASSERT(0, "NOT recognized display rotation: %d", presentRotation_);
-  }
+  PresentImage(buf, image);
 
   AImage_delete(image);
 
@@ -239,219 +199,60 @@ bool ImageReader::DisplayImage(ANativeWindow_Buffer *buf, AImage *image) {
 
 /*
  * PresentImage()
- *   Converting yuv to RGB
- *   No rotation: (x,y) --> (x, y)
+ *   Converting yuv to RGB, rotated anti-clockwise by presentRotation_:
+ *     0:   (x, y) --> (x, y)
+ *     90:  (x, y) --> (-y, x)
+ *     180: (x, y) --> (-x, -y)
+ *     270: (x, y) --> (y, -x)
  *   Refer to:
  * https://mathbits.com/MathBits/TISection/Geometry/Transformations2.htm
  */
-void ImageReader::PresentImage(ANativeWindow_Buffer *buf, AImage *image) {  
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &vPixel, &vLen);
-  AImage_getPlaneData(image, 2, &uPixel, &uLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out += buf->stride;
-  }
-}
-
-/*
- * PresentImage90()
- *   Converting YUV to RGB
- *   Rotation image anti-clockwise 90 degree -- (x, y) --> (-y, x)
- */
-void ImageReader::PresentImage90(ANativeWindow_Buffer *buf, AImage *image) {
+void ImageReader::PresentImage(ANativeWindow_Buffer *buf, AImage *image) {
   AImageCropRect srcRect;
   AImage_getCropRect(image, &srcRect);
 
-  int32_t yStride, uvStride;
+  YuvImage src;
   uint8_t *yPixel, *uPixel, *vPixel;
   int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
+  AImage_getPlaneRowStride(image, 0, &src.yStride);
+  AImage_getPlaneRowStride(image, 1, &src.uvStride);
   AImage_getPlaneData(image, 0, &yPixel, &yLen);
   AImage_getPlaneData(image, 1, &vPixel, &vLen);
   AImage_getPlaneData(image, 2, &uPixel, &uLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  out += height - 1;
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      // [x, y]--> [-y, x]
-      out[x * buf->stride] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out -= 1;  // move to the next column
-  }
+  AImage_getPlanePixelStride(image, 1, &src.uvPixelStride);
+  src.y = yPixel;
+  src.u = uPixel;
+  src.v = vPixel;
+  src.left = srcRect.left;
+  src.top = srcRect.top;
+
+  bool transposed = (presentRotation_ == 90 || presentRotation_ == 270);
+  src.height = std::min(transposed ? buf->width : buf->height,
+                        srcRect.bottom - srcRect.top);
+  src.width = std::min(transposed ? buf->height : buf->width,
+                       srcRect.right - srcRect.left);
+
+  bandPool_->Convert(converter_, src, static_cast<uint32_t *>(buf->bits),
+                     buf->stride, presentRotation_, bandCount_);
 }
 
-/*
- * PresentImage180()
- *   Converting yuv to RGB
- *   Rotate image 180 degree: (x, y) --> (-x, -y)
- */
-void ImageReader::PresentImage180(ANativeWindow_Buffer *buf, AImage *image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &vPixel, &vLen);
-  AImage_getPlaneData(image, 2, &uPixel, &uLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  out += (height - 1) * buf->stride;
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      // mirror image since we are using front camera
-      out[width - 1 - x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-      // out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out -= buf->stride;
-  }
-}
-
-/*
- * PresentImage270()
- *   Converting image from YUV to RGB
- *   Rotate Image counter-clockwise 270 degree: (x, y) --> (y, x)
- */
-void ImageReader::PresentImage270(ANativeWindow_Buffer *buf, AImage *image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &vPixel, &vLen);
-  AImage_getPlaneData(image, 2, &uPixel, &uLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      out[(width - 1 - x) * buf->stride] =
-          YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out += 1;  // move to the next column
-  }
-}
 void ImageReader::SetPresentRotation(int32_t angle) {
   presentRotation_ = angle;
 }
 
-/**
- * Write out jpeg files to kDirName directory
- * @param image point capture jpg image
- */
-void ImageReader::WriteFile(AImage* image) {
-
-  int planeCount;
-  media_status_t status = AImage_getNumberOfPlanes(image, &planeCount);
-  ASSERT(status == AMEDIA_OK && planeCount == 1,
-         "Error: getNumberOfPlanes() planeCount = %d", planeCount);
-  uint8_t *data = nullptr;
-  int len = 0;
-  AImage_getPlaneData(image, 0, &data, &len);
-
-  DIR *dir = opendir(kDirName);
-  if (dir) {
-    closedir(dir);
-  } else {
-    std::string cmd = "mkdir -p ";
-    cmd += kDirName;
-    system(cmd.c_str());
+void ImageReader::SetConversionBands(int32_t bandCount, int32_t threadCount) {
+  bandCount_ = std::max(bandCount, 1);
+  if (threadCount <= 0) {
+    threadCount = static_cast<int32_t>(std::thread::hardware_concurrency());
   }
-
-  struct timespec ts {
-      0, 0
-  };
-  clock_gettime(CLOCK_REALTIME, &ts);
-  struct tm localTime;
-  localtime_r(&ts.tv_sec, &localTime);
-
-  std::string fileName = kDirName;
-  std::string dash("-");
-  fileName += kFileName + std::to_string(localTime.tm_mon) +
-              std::to_string(localTime.tm_mday) + dash +
-              std::to_string(localTime.tm_hour) +
-              std::to_string(localTime.tm_min) +
-              std::to_string(localTime.tm_sec) + ".jpg";
-  FILE *file = fopen(fileName.c_str(), "wb");
-  if (file && data && len) {
-    fwrite(data, 1, len, file);
-    fclose(file);
-
-    if (callback_) {
-      callback_(callbackCtx_, fileName.c_str());
-    }
-  } else {
-    if (file)
-      fclose(file);
+  int32_t workerCount = std::max(std::min(threadCount, bandCount_), 1) - 1;
+  if (workerCount != bandPool_->WorkerCount()) {
+    bandPool_.reset(new YuvBandPool(workerCount));
   }
-  AImage_delete(image);
-}
\ No newline at end of file
+  LOGI("YUV conversion: %d bands on %d threads, %s kernel", bandCount_,
+       workerCount + 1, converter_.KernelName());
+}
+
+const std::vector<YuvBandTiming> &ImageReader::GetBandTimings(void) const {
+  return bandPool_->BandTimings();
+}
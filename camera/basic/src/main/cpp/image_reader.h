@@ -18,6 +18,12 @@
 #define CAMERA_IMAGE_READER_H
 #include <media/NdkImageReader.h>
 #include <functional>
+#include <memory>
+#include <vector>
+
+#include "jpeg_writer.h"
+#include "yuv_band_pool.h"
+#include "yuv_converter.h"
 /*
  * ImageFormat:
  *     A Data Structure to communicate resolution between camera and ImageReader
@@ -88,6 +94,23 @@ class ImageReader {
    *    Human Rotation (rotated degree related to Phone native orientation
    */
   void SetPresentRotation(int32_t angle);
+  int32_t GetPresentRotation(void) const { return presentRotation_; }
+
+  /**
+   * Split the conversion in DisplayImage() into bandCount horizontal bands,
+   * converted on a fixed pool of worker threads and the calling thread.
+   * DisplayImage() still returns only when the whole image is converted.
+   * @param bandCount number of bands; 1, the default, converts on the
+   *        calling thread only
+   * @param threadCount threads to convert on, the calling one included;
+   *        0 for one per CPU, up to bandCount
+   */
+  void SetConversionBands(int32_t bandCount, int32_t threadCount = 0);
+
+  /**
+   * Per-band timing of the last DisplayImage(), to choose the band count
+   */
+  const std::vector<YuvBandTiming>& GetBandTimings(void) const;
 
   /**
    * regsiter a callback function for client to be notified that jpeg already
@@ -96,19 +119,25 @@ class ImageReader {
    * @param callback is the actual callback function
    */
   void RegisterCallback(void* ctx, std::function<void(void* ctx, const char* fileName)>);
+
+  /**
+   * The writer that saves captures of a JPEG reader, nullptr for other
+   * formats; to set its fsync policy and read its queue and latency stats.
+   */
+  JpegWriter* GetJpegWriter(void);
  private:
   int32_t presentRotation_;
   AImageReader* reader_;
 
   std::function<void(void *ctx, const char* fileName)> callback_;
   void *callbackCtx_;
+  std::unique_ptr<JpegWriter> jpegWriter_;
 
-  void PresentImage(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage90(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage180(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage270(ANativeWindow_Buffer* buf, AImage* image);
+  YuvConverter converter_;
+  std::unique_ptr<YuvBandPool> bandPool_;
+  int32_t bandCount_;
 
-  void WriteFile(AImage* image);
+  void PresentImage(ANativeWindow_Buffer* buf, AImage* image);
 };
 
 #endif  // CAMERA_IMAGE_READER_H
@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "jpeg_writer.h"
+#include "utils/native_debug.h"
+
+/*
+ * O_DIRECT transfers must start, and be sized, on this boundary
+ */
+static const size_t kDirectIoAlign = 4096;
+
+static size_t AlignUp(size_t size) {
+  return (size + kDirectIoAlign - 1) & ~(kDirectIoAlign - 1);
+}
+
+static int64_t NowNs(void) {
+  struct timespec ts {
+      0, 0
+  };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static uint8_t* AllocBuffer(size_t capacity) {
+  void* data = nullptr;
+  if (posix_memalign(&data, kDirectIoAlign, capacity)) {
+    return nullptr;
+  }
+  return static_cast<uint8_t*>(data);
+}
+
+/*
+ * pwrite() all of data, through short writes and signals
+ */
+static bool WriteAll(int fd, const uint8_t* data, size_t length) {
+  size_t done = 0;
+  while (done < length) {
+    ssize_t n = pwrite(fd, data + done, length - done, done);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+JpegWriter::JpegWriter(const char* dirName, const char* filePrefix,
+                       const JpegWriterConfig& config)
+    : dirName_(dirName),
+      filePrefix_(filePrefix),
+      directIo_(config.directIo),
+      fsyncPolicy_(config.fsyncPolicy),
+      callback_(nullptr),
+      quit_(false),
+      sequence_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+
+  DIR* dir = opendir(dirName);
+  if (dir) {
+    closedir(dir);
+  } else {
+    std::string cmd = "mkdir -p ";
+    cmd += dirName;
+    system(cmd.c_str());
+  }
+
+  size_t capacity = AlignUp(std::max(config.bufferSize, 1));
+  for (int32_t i = 0; i < std::max(config.bufferCount, 1); i++) {
+    Buffer buffer{AllocBuffer(capacity), capacity};
+    ASSERT(buffer.data, "Failed to allocate %zu byte JPEG buffer", capacity);
+    buffers_.push_back(buffer);
+    freeBuffers_.push_back(i);
+  }
+  for (int32_t i = 0; i < std::max(config.threadCount, 1); i++) {
+    threads_.push_back(std::thread(&JpegWriter::ThreadMain, this));
+  }
+}
+
+JpegWriter::~JpegWriter() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    quit_ = true;
+  }
+  jobReady_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  for (auto& buffer : buffers_) {
+    free(buffer.data);
+  }
+}
+
+void JpegWriter::SetCallback(
+    std::function<void(const char* fileName)> callback) {
+  std::lock_guard<std::mutex> guard(lock_);
+  callback_ = callback;
+}
+
+void JpegWriter::SetFsyncPolicy(JpegFsyncPolicy policy) {
+  fsyncPolicy_.store(policy);
+}
+
+JpegWriterStats JpegWriter::GetStats(void) {
+  std::lock_guard<std::mutex> guard(lock_);
+  return stats_;
+}
+
+/*
+ * capture<month><day>-<hour><minute><second>_<sequence>.jpg, named when the
+ * capture is submitted
+ */
+std::string JpegWriter::NextFileName(void) {
+  struct timespec ts {
+      0, 0
+  };
+  clock_gettime(CLOCK_REALTIME, &ts);
+  struct tm localTime;
+  localtime_r(&ts.tv_sec, &localTime);
+
+  std::string fileName = dirName_;
+  std::string dash("-");
+  fileName += filePrefix_ + std::to_string(localTime.tm_mon) +
+              std::to_string(localTime.tm_mday) + dash +
+              std::to_string(localTime.tm_hour) +
+              std::to_string(localTime.tm_min) +
+              std::to_string(localTime.tm_sec) + "_" +
+              std::to_string(sequence_++) + ".jpg";
+  return fileName;
+}
+
+void JpegWriter::Submit(AImage* image) {
+  int32_t planeCount = 0;
+  media_status_t status = AImage_getNumberOfPlanes(image, &planeCount);
+  ASSERT(status == AMEDIA_OK && planeCount == 1,
+         "Error: getNumberOfPlanes() planeCount = %d", planeCount);
+  uint8_t* data = nullptr;
+  int len = 0;
+  AImage_getPlaneData(image, 0, &data, &len);
+  if (!data || len <= 0) {
+    AImage_delete(image);
+    std::lock_guard<std::mutex> guard(lock_);
+    stats_.submitted++;
+    stats_.failed++;
+    return;
+  }
+
+  int64_t submitNs = NowNs();
+  int32_t index;
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    if (freeBuffers_.empty()) {
+      stats_.stalls++;
+      bufferFree_.wait(guard, [this] { return !freeBuffers_.empty(); });
+      stats_.stallNs += NowNs() - submitNs;
+    }
+    index = freeBuffers_.back();
+    freeBuffers_.pop_back();
+  }
+
+  // the buffer is ours until it is queued
+  Buffer& buffer = buffers_[index];
+  size_t length = static_cast<size_t>(len);
+  if (AlignUp(length) > buffer.capacity) {
+    size_t capacity = AlignUp(length + length / 4);
+    LOGW("JPEG of %zu bytes, growing buffer %d to %zu bytes", length, index,
+         capacity);
+    free(buffer.data);
+    buffer.data = AllocBuffer(capacity);
+    ASSERT(buffer.data, "Failed to allocate %zu byte JPEG buffer", capacity);
+    buffer.capacity = capacity;
+  }
+  memcpy(buffer.data, data, length);
+  // O_DIRECT writes whole blocks; the file is truncated to length after
+  memset(buffer.data + length, 0, AlignUp(length) - length);
+  AImage_delete(image);
+
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    queue_.push_back(Job{index, length, NextFileName(), submitNs});
+    stats_.submitted++;
+    stats_.queueDepth = static_cast<int32_t>(queue_.size());
+    stats_.maxQueueDepth = std::max(stats_.maxQueueDepth, stats_.queueDepth);
+  }
+  jobReady_.notify_one();
+}
+
+void JpegWriter::ThreadMain(void) {
+  std::unique_lock<std::mutex> guard(lock_);
+  for (;;) {
+    jobReady_.wait(guard, [this] { return quit_ || !queue_.empty(); });
+    if (queue_.empty()) return;  // quit_, and nothing left to write
+
+    Job job = queue_.front();
+    queue_.pop_front();
+    stats_.queueDepth = static_cast<int32_t>(queue_.size());
+    guard.unlock();
+
+    int64_t startNs = NowNs();
+    bool written = WriteJob(job);
+    int64_t endNs = NowNs();
+
+    guard.lock();
+    freeBuffers_.push_back(job.buffer);
+    bufferFree_.notify_one();
+    if (written) {
+      stats_.written++;
+      stats_.lastWriteNs = endNs - startNs;
+      stats_.maxWriteNs = std::max(stats_.maxWriteNs, stats_.lastWriteNs);
+      stats_.totalWriteNs += stats_.lastWriteNs;
+      stats_.lastLatencyNs = endNs - job.submitNs;
+      stats_.maxLatencyNs = std::max(stats_.maxLatencyNs, stats_.lastLatencyNs);
+    } else {
+      stats_.failed++;
+    }
+    std::function<void(const char* fileName)> callback = callback_;
+    guard.unlock();
+
+    if (written && callback) {
+      callback(job.fileName.c_str());
+    }
+    guard.lock();
+  }
+}
+
+/*
+ * Write one capture out with pwrite(), straight from the buffer when the
+ * file system takes O_DIRECT, then make it as durable as fsyncPolicy_ says.
+ */
+bool JpegWriter::WriteJob(const Job& job) {
+  const Buffer& buffer = buffers_[job.buffer];
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  int fd = -1;
+  bool direct = false;
+  if (directIo_) {
+    fd = open(job.fileName.c_str(), flags | O_DIRECT, 0664);
+    direct = (fd >= 0);
+  }
+  if (fd < 0) {
+    fd = open(job.fileName.c_str(), flags, 0664);
+  }
+  if (fd < 0) {
+    LOGE("Cannot create %s: %s", job.fileName.c_str(), strerror(errno));
+    return false;
+  }
+
+  bool ok;
+  if (direct) {
+    ok = WriteAll(fd, buffer.data, AlignUp(job.length)) &&
+         ftruncate(fd, job.length) == 0;
+    if (!ok && errno == EINVAL) {
+      // accepted at open() but not for these writes: go through the cache
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+      ok = ftruncate(fd, 0) == 0 && WriteAll(fd, buffer.data, job.length);
+    }
+  } else {
+    ok = WriteAll(fd, buffer.data, job.length);
+  }
+
+  switch (fsyncPolicy_.load()) {
+    case JPEG_FSYNC_DATA:
+      ok = ok && fdatasync(fd) == 0;
+      break;
+    case JPEG_FSYNC_FULL:
+      ok = ok && fsync(fd) == 0;
+      break;
+    default:
+      break;
+  }
+  if (!ok) {
+    LOGE("Cannot write %s: %s", job.fileName.c_str(), strerror(errno));
+  }
+  close(fd);
+  return ok;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_JPEG_WRITER_H
+#define CAMERA_JPEG_WRITER_H
+
+#include <media/NdkImage.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * JpegFsyncPolicy:
+ *     What a writer does to make a file durable before reporting it written
+ */
+enum JpegFsyncPolicy {
+  JPEG_FSYNC_NONE,  // leave it to the page cache
+  JPEG_FSYNC_DATA,  // fdatasync(): the data and the file size
+  JPEG_FSYNC_FULL,  // fsync(): all metadata as well
+};
+
+/*
+ * JpegWriterConfig:
+ *     Size of a JpegWriter, fixed when it is created
+ */
+struct JpegWriterConfig {
+  int32_t threadCount;  // writer threads
+  int32_t bufferCount;  // captures copied out and not yet written, at most
+  int32_t bufferSize;   // bytes each buffer starts with; grown on demand
+  bool directIo;        // try O_DIRECT, falling back to buffered writes
+  JpegFsyncPolicy fsyncPolicy;
+};
+
+/*
+ * JpegWriterStats:
+ *     Counters since the writer was created; times in nanoseconds
+ */
+struct JpegWriterStats {
+  int32_t queueDepth;     // captures waiting to be written, now
+  int32_t maxQueueDepth;  // ... and at most
+  uint64_t submitted;
+  uint64_t written;
+  uint64_t failed;
+  uint64_t stalls;        // Submit() calls that waited for a free buffer
+  int64_t stallNs;        // ... and how long they waited in total
+  int64_t lastWriteNs;    // open() to close() of the last file
+  int64_t maxWriteNs;
+  int64_t totalWriteNs;
+  int64_t lastLatencyNs;  // Submit() to written, of the last file
+  int64_t maxLatencyNs;
+};
+
+/*
+ * JpegWriter:
+ *     Writes JPEG captures out on a fixed pool of threads. Submit() copies
+ * the image into one of a fixed set of buffers and releases the AImage at
+ * once, so the AImageReader gets its buffer back whatever the storage is
+ * doing. When every buffer is waiting to be written, Submit() blocks until
+ * one is free: the backpressure is a bounded wait in the image listener,
+ * never an unbounded pile of threads and images.
+ */
+class JpegWriter {
+ public:
+  JpegWriter(const char* dirName, const char* filePrefix,
+             const JpegWriterConfig& config);
+  /**
+   * Writes out whatever is queued, then stops the threads
+   */
+  ~JpegWriter();
+
+  /**
+   * Called on a writer thread with the name of every file written
+   */
+  void SetCallback(std::function<void(const char* fileName)> callback);
+
+  /**
+   * Copy a JPEG image out and queue it for writing
+   * @param image a {@link AImage} in AIMAGE_FORMAT_JPEG; it is deleted via
+   *        {@link AImage_delete} before this returns
+   */
+  void Submit(AImage* image);
+
+  void SetFsyncPolicy(JpegFsyncPolicy policy);
+
+  JpegWriterStats GetStats(void);
+
+ private:
+  struct Buffer {
+    uint8_t* data;  // aligned for O_DIRECT
+    size_t capacity;
+  };
+  struct Job {
+    int32_t buffer;
+    size_t length;
+    std::string fileName;
+    int64_t submitNs;
+  };
+
+  std::string dirName_;
+  std::string filePrefix_;
+  bool directIo_;
+  std::atomic<int> fsyncPolicy_;
+  std::function<void(const char* fileName)> callback_;
+
+  std::vector<Buffer> buffers_;
+  std::vector<int32_t> freeBuffers_;
+  std::deque<Job> queue_;
+  std::vector<std::thread> threads_;
+  std::mutex lock_;
+  std::condition_variable bufferFree_;
+  std::condition_variable jobReady_;
+  bool quit_;
+  uint32_t sequence_;  // tells apart captures in the same second
+  JpegWriterStats stats_;
+
+  void ThreadMain(void);
+  bool WriteJob(const Job& job);
+  std::string NextFileName(void);
+};
+
+#endif  // CAMERA_JPEG_WRITER_H
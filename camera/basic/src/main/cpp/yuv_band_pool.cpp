@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include "yuv_band_pool.h"
+
+static int64_t NsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+YuvBandPool::YuvBandPool(int32_t workerCount)
+    : generation_(0), busy_(0), quit_(false), nextBand_(0) {
+  for (int32_t i = 0; i < workerCount; i++) {
+    workers_.push_back(std::thread(&YuvBandPool::WorkerMain, this, i + 1));
+  }
+}
+
+YuvBandPool::~YuvBandPool() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    quit_ = true;
+  }
+  frameReady_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void YuvBandPool::WorkerMain(int32_t thread) {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> guard(lock_);
+  for (;;) {
+    frameReady_.wait(guard, [&] { return quit_ || generation_ != seen; });
+    if (quit_) return;
+    seen = generation_;
+
+    guard.unlock();
+    ConvertBands(thread);
+    guard.lock();
+
+    if (--busy_ == 0) {
+      frameDone_.notify_one();
+    }
+  }
+}
+
+/*
+ * Take bands off the counter until there are none left
+ */
+void YuvBandPool::ConvertBands(int32_t thread) {
+  const int32_t bandCount = static_cast<int32_t>(timings_.size());
+  for (;;) {
+    int32_t band = nextBand_.fetch_add(1, std::memory_order_relaxed);
+    if (band >= bandCount) break;
+
+    YuvBandTiming& timing = timings_[band];
+    timing.thread = thread;
+    timing.startNs = NsSince(frameStart_);
+    frame_.converter->ConvertRows(*frame_.src, frame_.dst, frame_.dstStride,
+                                  frame_.rotation, bandRows_[band],
+                                  bandRows_[band + 1]);
+    timing.durationNs = NsSince(frameStart_) - timing.startNs;
+  }
+}
+
+void YuvBandPool::Convert(const YuvConverter& converter, const YuvImage& src,
+                          uint32_t* dst, int32_t dstStride, int32_t rotation,
+                          int32_t bandCount) {
+  frameStart_ = std::chrono::steady_clock::now();
+
+  // Band edges at even rows of the whole image, (y + top) being the row
+  // YuvConverter takes the chroma row from; empty bands are dropped.
+  bandCount = std::max(bandCount, 1);
+  bandRows_.assign(1, 0);
+  for (int32_t band = 1; band < bandCount; band++) {
+    int32_t row = static_cast<int32_t>(
+        static_cast<int64_t>(src.height) * band / bandCount);
+    row = ((row + src.top) & ~1) - src.top;
+    if (row > bandRows_.back() && row < src.height) {
+      bandRows_.push_back(row);
+    }
+  }
+  if (src.height > 0) {
+    bandRows_.push_back(src.height);
+  }
+
+  timings_.resize(bandRows_.size() - 1);
+  for (size_t band = 0; band < timings_.size(); band++) {
+    timings_[band].firstRow = bandRows_[band];
+    timings_[band].rowCount = bandRows_[band + 1] - bandRows_[band];
+  }
+
+  frame_ = {&converter, &src, dst, dstStride, rotation};
+  nextBand_.store(0, std::memory_order_relaxed);
+
+  // only wake workers when there are bands to spare
+  bool parallel = !workers_.empty() && timings_.size() > 1;
+  if (parallel) {
+    std::lock_guard<std::mutex> guard(lock_);
+    busy_ = static_cast<int32_t>(workers_.size());
+    generation_++;
+  }
+  if (parallel) {
+    frameReady_.notify_all();
+  }
+
+  ConvertBands(0);
+
+  if (parallel) {
+    std::unique_lock<std::mutex> guard(lock_);
+    frameDone_.wait(guard, [this] { return busy_ == 0; });
+  }
+}
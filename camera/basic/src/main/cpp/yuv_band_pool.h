@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_YUV_BAND_POOL_H
+#define CAMERA_YUV_BAND_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "yuv_converter.h"
+
+/*
+ * YuvBandTiming:
+ *     How one band of the last frame was converted
+ */
+struct YuvBandTiming {
+  int32_t firstRow;  // source rows [firstRow, firstRow + rowCount)
+  int32_t rowCount;
+  int32_t thread;    // 0 is the calling thread, 1.. the workers
+  int64_t startNs;   // from the start of the frame
+  int64_t durationNs;
+};
+
+/*
+ * YuvBandPool:
+ *     Converts a frame as horizontal bands of source rows on a fixed set of
+ * worker threads plus the calling thread. Band boundaries fall on even image
+ * rows, so each chroma row is read by exactly one band. Bands are handed out
+ * in order from an atomic counter, so more bands than threads balance the
+ * load. Workers are created with the pool and sleep between frames.
+ */
+class YuvBandPool {
+ public:
+  explicit YuvBandPool(int32_t workerCount);
+  ~YuvBandPool();
+
+  /**
+   * Convert src into dst as YuvConverter::Convert() does, split into up to
+   * bandCount bands; returns once every band is done.
+   */
+  void Convert(const YuvConverter& converter, const YuvImage& src,
+               uint32_t* dst, int32_t dstStride, int32_t rotation,
+               int32_t bandCount);
+
+  /**
+   * Per-band timing of the last Convert(), in band order
+   */
+  const std::vector<YuvBandTiming>& BandTimings(void) const {
+    return timings_;
+  }
+
+  int32_t WorkerCount(void) const {
+    return static_cast<int32_t>(workers_.size());
+  }
+
+ private:
+  // the frame being converted, valid while busy_ is non-zero
+  struct Frame {
+    const YuvConverter* converter;
+    const YuvImage* src;
+    uint32_t* dst;
+    int32_t dstStride;
+    int32_t rotation;
+  };
+
+  std::vector<std::thread> workers_;
+  std::mutex lock_;
+  std::condition_variable frameReady_;
+  std::condition_variable frameDone_;
+  uint64_t generation_;  // bumped for every frame
+  int32_t busy_;         // workers not done with the frame
+  bool quit_;
+
+  Frame frame_;
+  std::vector<int32_t> bandRows_;  // band i is [bandRows_[i], bandRows_[i+1])
+  std::vector<YuvBandTiming> timings_;
+  std::atomic<int32_t> nextBand_;
+  std::chrono::steady_clock::time_point frameStart_;
+
+  void WorkerMain(int32_t thread);
+  void ConvertBands(int32_t thread);
+};
+
+#endif  // CAMERA_YUV_BAND_POOL_H
@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#ifdef __ANDROID__
+#include <cpu-features.h>
+#endif
+#include "yuv_converter.h"
+#include "utils/native_debug.h"
+
+/**
+ * Helper function for YUV_420 to RGB conversion. Courtesy of Tensorflow
+ * ImageClassifier Sample:
+ * https://github.com/tensorflow/tensorflow/blob/master/tensorflow/examples/android/jni/yuv2rgb.cc
+ * The difference is that here we have to swap UV plane when calling it.
+ */
+#ifndef MAX
+#define MAX(a, b)           \
+  ({                        \
+    __typeof__(a) _a = (a); \
+    __typeof__(b) _b = (b); \
+    _a > _b ? _a : _b;      \
+  })
+#define MIN(a, b)           \
+  ({                        \
+    __typeof__(a) _a = (a); \
+    __typeof__(b) _b = (b); \
+    _a < _b ? _a : _b;      \
+  })
+#endif
+
+// This value is 2 ^ 18 - 1, and is used to clamp the RGB values before their
+// ranges
+// are normalized to eight bits.
+static const int kMaxChannelValue = 262143;
+
+static inline uint32_t YUV2RGB(int nY, int nU, int nV) {
+  nY -= 16;
+  nU -= 128;
+  nV -= 128;
+  if (nY < 0) nY = 0;
+
+  // This is the floating point equivalent. We do the conversion in integer
+  // because some Android devices do not have floating point in hardware.
+  // nR = (int)(1.164 * nY + 1.596 * nV);
+  // nG = (int)(1.164 * nY - 0.813 * nV - 0.391 * nU);
+  // nB = (int)(1.164 * nY + 2.018 * nU);
+
+  int nR = (int)(1192 * nY + 1634 * nV);
+  int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
+  int nB = (int)(1192 * nY + 2066 * nU);
+
+  nR = MIN(kMaxChannelValue, MAX(0, nR));
+  nG = MIN(kMaxChannelValue, MAX(0, nG));
+  nB = MIN(kMaxChannelValue, MAX(0, nB));
+
+  nR = (nR >> 10) & 0xff;
+  nG = (nG >> 10) & 0xff;
+  nB = (nB >> 10) & 0xff;
+
+  return 0xff000000 | (nR << 16) | (nG << 8) | nB;
+}
+
+/*
+ * The reference row conversion, also used for what the vector kernels
+ * leave at the end of a row
+ */
+static void YuvRowScalar(uint32_t* dst, const uint8_t* y, const uint8_t* u,
+                         const uint8_t* v, int32_t uvPixelStride,
+                         int32_t width) {
+  for (int32_t x = 0; x < width; x++) {
+    const int32_t uv_offset = (x >> 1) * uvPixelStride;
+    dst[x] = YUV2RGB(y[x], u[uv_offset], v[uv_offset]);
+  }
+}
+
+/*
+ * Vector kernels, sorted from least to most preferred
+ */
+enum {
+  kIsaNeon = 1 << 0,
+  kIsaSse41 = 1 << 1,
+  kIsaAvx2 = 1 << 2,
+};
+
+struct YuvKernel {
+  const char* name;
+  YuvRowFn row;
+  uint32_t isa;  // required kIsa* bits
+};
+
+static const YuvKernel kKernels[] = {
+#ifdef HAVE_YUV_NEON
+    {"neon", YuvRowNeon, kIsaNeon},
+#endif
+#ifdef HAVE_YUV_SSE41
+    {"sse41", YuvRowSse41, kIsaSse41},
+#endif
+#ifdef HAVE_YUV_AVX2
+    {"avx2", YuvRowAvx2, kIsaAvx2},
+#endif
+    {nullptr, nullptr, 0},
+};
+
+static uint32_t DetectIsa(void) {
+  uint32_t isa = 0;
+#ifdef __ANDROID__
+  uint64_t features = android_getCpuFeatures();
+  switch (android_getCpuFamily()) {
+    case ANDROID_CPU_FAMILY_ARM:
+      if (features & ANDROID_CPU_ARM_FEATURE_NEON) isa |= kIsaNeon;
+      break;
+    case ANDROID_CPU_FAMILY_ARM64:
+      isa |= kIsaNeon;
+      break;
+    case ANDROID_CPU_FAMILY_X86:
+    case ANDROID_CPU_FAMILY_X86_64:
+      if (features & ANDROID_CPU_X86_FEATURE_SSE4_1) isa |= kIsaSse41;
+      if (features & ANDROID_CPU_X86_FEATURE_AVX2) isa |= kIsaAvx2;
+      break;
+    default:
+      break;
+  }
+#elif defined(__i386__) || defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.1")) isa |= kIsaSse41;
+  if (__builtin_cpu_supports("avx2")) isa |= kIsaAvx2;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+  isa |= kIsaNeon;
+#endif
+  return isa;
+}
+
+/*
+ * Compare a kernel with YuvRowScalar() on rows that sweep every luma value
+ * against pseudo-random chroma, in the planar and both semi-planar layouts.
+ */
+static bool KernelMatchesScalar(const YuvKernel* k) {
+  const int32_t kWidth = 4 * 256 + 16 + 5;  // ends with a scalar tail
+  std::vector<uint8_t> y(kWidth), uv(kWidth + 1);
+  std::vector<uint32_t> expected(kWidth), actual(kWidth);
+  uint32_t seed = 1;
+  for (int32_t x = 0; x < kWidth; x++) {
+    y[x] = static_cast<uint8_t>(x * 7 + (x >> 8));
+  }
+  for (int32_t pass = 0; pass < 8; pass++) {
+    for (auto& c : uv) {
+      seed = seed * 1103515245 + 12345;
+      c = static_cast<uint8_t>(seed >> 16);
+    }
+    const uint8_t* u = uv.data();
+    const uint8_t* v = uv.data() + kWidth / 2;
+    int32_t pixelStride = 1;
+    if (pass & 1) {
+      // semi-planar, u and v in either order
+      u = uv.data() + (pass & 2 ? 1 : 0);
+      v = uv.data() + (pass & 2 ? 0 : 1);
+      pixelStride = 2;
+    }
+    YuvRowScalar(expected.data(), y.data(), u, v, pixelStride, kWidth);
+    int32_t done = k->row(actual.data(), y.data(), u, v, pixelStride, kWidth);
+    YuvRowScalar(actual.data() + done, y.data() + done,
+                 u + (done >> 1) * pixelStride, v + (done >> 1) * pixelStride,
+                 pixelStride, kWidth - done);
+    if (done != (kWidth & ~15) || expected != actual) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static const YuvKernel* SelectKernel(void) {
+  const YuvKernel* selected = nullptr;
+  uint32_t isa = DetectIsa();
+  for (const YuvKernel* k = kKernels; k->name; k++) {
+    if ((k->isa & isa) != k->isa) continue;
+    if (!KernelMatchesScalar(k)) {
+      LOGE("YUV kernel %s does not match the scalar conversion, not used",
+           k->name);
+      continue;
+    }
+    selected = k;
+  }
+  LOGI("YUV to RGBA kernel: %s", selected ? selected->name : "scalar");
+  return selected;
+}
+
+YuvConverter::YuvConverter() {
+  static const YuvKernel* selected = SelectKernel();
+  kernel_ = selected ? selected->row : nullptr;
+  kernelName_ = selected ? selected->name : "scalar";
+}
+
+/*
+ * Convert count pixels of source row y from x0, which must be even to keep
+ * pixel pairs on the same chroma sample as the whole row.
+ */
+void YuvConverter::ConvertRow(const YuvImage& src, YuvRowFn kernel, int32_t y,
+                              int32_t x0, int32_t count, uint32_t* dst) const {
+  const int32_t ps = src.uvPixelStride;
+  const uint8_t* pY = src.y + src.yStride * (y + src.top) + src.left + x0;
+  int32_t uv_offset =
+      src.uvStride * ((y + src.top) >> 1) + ((src.left >> 1) + (x0 >> 1)) * ps;
+  const uint8_t* pU = src.u + uv_offset;
+  const uint8_t* pV = src.v + uv_offset;
+
+  int32_t done = kernel ? kernel(dst, pY, pU, pV, ps, count) : 0;
+  YuvRowScalar(dst + done, pY + done, pU + (done >> 1) * ps,
+               pV + (done >> 1) * ps, ps, count - done);
+}
+
+void YuvConverter::Convert(const YuvImage& src, uint32_t* dst,
+                           int32_t dstStride, int32_t rotation) const {
+  ConvertRows(src, dst, dstStride, rotation, 0, src.height);
+}
+
+void YuvConverter::ConvertRows(const YuvImage& src, uint32_t* dst,
+                               int32_t dstStride, int32_t rotation, int32_t y0,
+                               int32_t y1) const {
+  const int32_t kTileRows = 16;
+  const int32_t kTileCols = 64;
+
+  // the kernels know planar chroma, and chroma interleaved in one plane
+  YuvRowFn kernel = kernel_;
+  if (!(src.uvPixelStride == 1 ||
+        (src.uvPixelStride == 2 && std::abs(src.u - src.v) == 1))) {
+    kernel = nullptr;
+  }
+
+  switch (rotation) {
+    case 0:
+      // (x, y) --> (x, y)
+      for (int32_t y = y0; y < y1; y++) {
+        ConvertRow(src, kernel, y, 0, src.width, dst + y * dstStride);
+      }
+      break;
+    case 180:
+      // (x, y) --> (-x, -y): convert, then reverse the row in cache
+      for (int32_t y = y0; y < y1; y++) {
+        uint32_t* out = dst + (src.height - 1 - y) * dstStride;
+        ConvertRow(src, kernel, y, 0, src.width, out);
+        std::reverse(out, out + src.width);
+      }
+      break;
+    case 90:
+    case 270: {
+      uint32_t tile[kTileRows * kTileCols];
+      for (int32_t ty = y0; ty < y1; ty += kTileRows) {
+        const int32_t rows = std::min(kTileRows, y1 - ty);
+        for (int32_t tx = 0; tx < src.width; tx += kTileCols) {
+          const int32_t cols = std::min(kTileCols, src.width - tx);
+          for (int32_t r = 0; r < rows; r++) {
+            ConvertRow(src, kernel, ty + r, tx, cols, tile + r * kTileCols);
+          }
+          for (int32_t c = 0; c < cols; c++) {
+            const uint32_t* in = tile + c;
+            if (rotation == 90) {
+              // (x, y) --> (-y, x): source column x is destination row x
+              uint32_t* out =
+                  dst + (tx + c) * dstStride + (src.height - ty - rows);
+              for (int32_t r = 0; r < rows; r++) {
+                out[rows - 1 - r] = in[r * kTileCols];
+              }
+            } else {
+              // (x, y) --> (y, -x)
+              uint32_t* out = dst + (src.width - 1 - tx - c) * dstStride + ty;
+              for (int32_t r = 0; r < rows; r++) {
+                out[r] = in[r * kTileCols];
+              }
+            }
+          }
+        }
+      }
+      break;
+    }
+    default:
+      ASSERT(0, "NOT recognized display rotation: %d", rotation);
+  }
+}
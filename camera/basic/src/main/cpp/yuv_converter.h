@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_YUV_CONVERTER_H
+#define CAMERA_YUV_CONVERTER_H
+
+#include <cstdint>
+
+#include "yuv_kernels.h"
+
+/*
+ * YuvImage:
+ *     The planes of a YUV_420_888 AImage, and the part of it to convert
+ */
+struct YuvImage {
+  const uint8_t* y;
+  const uint8_t* u;  // chroma taken as nU by the scalar YUV2RGB()
+  const uint8_t* v;  // chroma taken as nV
+  int32_t yStride;
+  int32_t uvStride;
+  int32_t uvPixelStride;
+  int32_t left;  // crop origin
+  int32_t top;
+  int32_t width;  // pixels to convert, from the crop origin
+  int32_t height;
+};
+
+/*
+ * YuvConverter:
+ *     YUV_420_888 to RGBA conversion for the preview, with the display
+ * rotation done in the same pass. Rows go through the fastest vector kernel
+ * the CPU has that gives the scalar YUV2RGB() results bit for bit; that is
+ * checked once, when the first converter is created. 90 and 270 degree
+ * rotations convert 16 rows x 64 pixel tiles into a scratch tile that stays
+ * in L1, and write it transposed, 16 contiguous pixels per destination row.
+ */
+class YuvConverter {
+ public:
+  YuvConverter();
+
+  /**
+   * Convert src into dst, rotated anti-clockwise by rotation degrees
+   * ( 0, 90, 180 or 270 ), the way ImageReader presents it.
+   * @param dst 0xAARRGGBB pixels, dstStride pixels apart; it must hold
+   *        src.width x src.height pixels, or src.height x src.width when
+   *        rotated by 90 or 270 degrees
+   */
+  void Convert(const YuvImage& src, uint32_t* dst, int32_t dstStride,
+               int32_t rotation) const;
+
+  /**
+   * Convert only the source rows [y0, y1) of src, to where Convert() puts
+   * them.
+   */
+  void ConvertRows(const YuvImage& src, uint32_t* dst, int32_t dstStride,
+                   int32_t rotation, int32_t y0, int32_t y1) const;
+
+  const char* KernelName(void) const { return kernelName_; }
+
+ private:
+  YuvRowFn kernel_;
+  const char* kernelName_;
+
+  void ConvertRow(const YuvImage& src, YuvRowFn kernel, int32_t y, int32_t x0,
+                  int32_t count, uint32_t* dst) const;
+};
+
+#endif  // CAMERA_YUV_CONVERTER_H
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_YUV_KERNELS_H
+#define CAMERA_YUV_KERNELS_H
+
+#include <cstdint>
+
+/*
+ * Per-ISA row kernels behind YuvConverter. A kernel converts one row of
+ * YUV_420_888 pixels to the 0xAARRGGBB words of the scalar YUV2RGB(), bit
+ * for bit: 32-bit products of the same integer coefficients, shifted by 10
+ * and saturated to 8 bits.
+ *
+ * u and v are the chroma samples YUV2RGB() takes as nU and nV for the first
+ * pixel pair; pixel x uses sample (x / 2) * uvPixelStride. Kernels handle
+ * planar chroma, uvPixelStride 1, and semi-planar chroma, uvPixelStride 2
+ * with u and v interleaved in one plane ( |u - v| == 1 ). They convert as
+ * many whole 16 pixel blocks as fit in width, reading nothing outside those
+ * pixels' samples, and return how many pixels they wrote; YuvConverter
+ * finishes the row. Only the kernels whose HAVE_YUV_* flag is set by
+ * CMakeLists.txt are compiled in.
+ */
+typedef int32_t (*YuvRowFn)(uint32_t* dst, const uint8_t* y, const uint8_t* u,
+                            const uint8_t* v, int32_t uvPixelStride,
+                            int32_t width);
+
+#ifdef HAVE_YUV_NEON
+int32_t YuvRowNeon(uint32_t* dst, const uint8_t* y, const uint8_t* u,
+                   const uint8_t* v, int32_t uvPixelStride, int32_t width);
+#endif
+
+#ifdef HAVE_YUV_SSE41
+int32_t YuvRowSse41(uint32_t* dst, const uint8_t* y, const uint8_t* u,
+                    const uint8_t* v, int32_t uvPixelStride, int32_t width);
+#endif
+
+#ifdef HAVE_YUV_AVX2
+int32_t YuvRowAvx2(uint32_t* dst, const uint8_t* y, const uint8_t* u,
+                   const uint8_t* v, int32_t uvPixelStride, int32_t width);
+#endif
+
+#endif  // CAMERA_YUV_KERNELS_H
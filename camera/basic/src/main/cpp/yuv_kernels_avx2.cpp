@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <immintrin.h>
+
+#include "yuv_kernels.h"
+
+/*
+ * 16 pixels per step in one pass of 256-bit registers: lane 0 holds
+ * pixels 0-7, lane 1 pixels 8-15, so the in-lane unpacks and packs keep
+ * pixels in order until the final two stores.
+ */
+namespace {
+
+inline __m256i CoefPair(int16_t a, int16_t b) {
+  return _mm256_set1_epi32(static_cast<int32_t>(
+      static_cast<uint32_t>(static_cast<uint16_t>(b)) << 16 |
+      static_cast<uint16_t>(a)));
+}
+
+inline __m256i Narrow(__m256i lo, __m256i hi) {
+  return _mm256_packs_epi32(_mm256_srai_epi32(lo, 10),
+                            _mm256_srai_epi32(hi, 10));
+}
+
+inline __m256i Clamp8(__m256i c) {
+  return _mm256_min_epi16(_mm256_max_epi16(c, _mm256_setzero_si256()),
+                          _mm256_set1_epi16(255));
+}
+
+// chroma samples 0-7, as 16-bit lanes, repeated for the two pixels of a pair
+inline __m256i Duplicate(__m128i c16) {
+  return _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_unpacklo_epi16(c16, c16)),
+      _mm_unpackhi_epi16(c16, c16), 1);
+}
+
+}  // namespace
+
+int32_t YuvRowAvx2(uint32_t* dst, const uint8_t* y, const uint8_t* u,
+                   const uint8_t* v, int32_t uvPixelStride, int32_t width) {
+  const __m256i kR = CoefPair(1192, 1634);   // ( y, v )
+  const __m256i kGv = CoefPair(1192, -833);  // ( y, v )
+  const __m256i kGu = CoefPair(0, -400);     // ( y, u )
+  const __m256i kB = CoefPair(1192, 2066);   // ( y, u )
+  const __m256i k16 = _mm256_set1_epi16(16);
+  const __m128i k128 = _mm_set1_epi16(128);
+  const __m256i alpha = _mm256_set1_epi16(static_cast<int16_t>(0xff00));
+  int32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const int32_t c = (x >> 1) * uvPixelStride;
+    __m128i u16, v16;
+    if (uvPixelStride == 1) {
+      u16 = _mm_cvtepu8_epi16(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + c)));
+      v16 = _mm_cvtepu8_epi16(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + c)));
+    } else {
+      const uint8_t* lo = u < v ? u : v;
+      __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo + c));
+      __m128i even = _mm_and_si128(uv, _mm_set1_epi16(0xff));
+      __m128i odd = _mm_srli_epi16(uv, 8);
+      u16 = u < v ? even : odd;
+      v16 = u < v ? odd : even;
+    }
+    __m256i ud = Duplicate(_mm_sub_epi16(u16, k128));
+    __m256i vd = Duplicate(_mm_sub_epi16(v16, k128));
+
+    __m256i y16 = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)));
+    y16 = _mm256_max_epi16(_mm256_sub_epi16(y16, k16), _mm256_setzero_si256());
+
+    // lo: pixels 0-3 and 8-11, hi: pixels 4-7 and 12-15
+    __m256i yvLo = _mm256_unpacklo_epi16(y16, vd);
+    __m256i yvHi = _mm256_unpackhi_epi16(y16, vd);
+    __m256i yuLo = _mm256_unpacklo_epi16(y16, ud);
+    __m256i yuHi = _mm256_unpackhi_epi16(y16, ud);
+    __m256i r =
+        Narrow(_mm256_madd_epi16(yvLo, kR), _mm256_madd_epi16(yvHi, kR));
+    __m256i g = Narrow(_mm256_add_epi32(_mm256_madd_epi16(yvLo, kGv),
+                                        _mm256_madd_epi16(yuLo, kGu)),
+                       _mm256_add_epi32(_mm256_madd_epi16(yvHi, kGv),
+                                        _mm256_madd_epi16(yuHi, kGu)));
+    __m256i b =
+        Narrow(_mm256_madd_epi16(yuLo, kB), _mm256_madd_epi16(yuHi, kB));
+
+    // clamping to 0..255 is the scalar clamp; store as 0xAARRGGBB words
+    __m256i bg = _mm256_or_si256(Clamp8(b), _mm256_slli_epi16(Clamp8(g), 8));
+    __m256i ra = _mm256_or_si256(Clamp8(r), alpha);
+    __m256i lo = _mm256_unpacklo_epi16(bg, ra);
+    __m256i hi = _mm256_unpackhi_epi16(bg, ra);
+    __m256i* out = reinterpret_cast<__m256i*>(dst + x);
+    _mm256_storeu_si256(out, _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+  return x;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <arm_neon.h>
+
+#include "yuv_kernels.h"
+
+/*
+ * 16 pixels per step. vld2 splits semi-planar chroma, the channels are
+ * widening 16x16->32 bit multiply-accumulates, and vst4 interleaves the
+ * bytes of the output words.
+ */
+namespace {
+
+inline uint8x8_t Narrow(int32x4_t lo, int32x4_t hi) {
+  // the saturating narrows are the scalar clamp
+  return vqmovun_s16(vcombine_s16(vqshrn_n_s32(lo, 10), vqshrn_n_s32(hi, 10)));
+}
+
+/*
+ * 8 pixels: luma y16, and the chroma of every pixel in u16 and v16, minus
+ * 128; B, G and R bytes out.
+ */
+inline void Convert8(int16x8_t y16, int16x8_t u16, int16x8_t v16,
+                     uint8x8_t* r, uint8x8_t* g, uint8x8_t* b) {
+  int32x4_t yLo = vmull_n_s16(vget_low_s16(y16), 1192);
+  int32x4_t yHi = vmull_n_s16(vget_high_s16(y16), 1192);
+  *r = Narrow(vmlal_n_s16(yLo, vget_low_s16(v16), 1634),
+              vmlal_n_s16(yHi, vget_high_s16(v16), 1634));
+  *g = Narrow(vmlal_n_s16(vmlal_n_s16(yLo, vget_low_s16(v16), -833),
+                          vget_low_s16(u16), -400),
+              vmlal_n_s16(vmlal_n_s16(yHi, vget_high_s16(v16), -833),
+                          vget_high_s16(u16), -400));
+  *b = Narrow(vmlal_n_s16(yLo, vget_low_s16(u16), 2066),
+              vmlal_n_s16(yHi, vget_high_s16(u16), 2066));
+}
+
+inline int16x8_t Widen(uint8x8_t c, int16_t bias) {
+  return vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(c)), vdupq_n_s16(bias));
+}
+
+}  // namespace
+
+int32_t YuvRowNeon(uint32_t* dst, const uint8_t* y, const uint8_t* u,
+                   const uint8_t* v, int32_t uvPixelStride, int32_t width) {
+  int32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const int32_t c = (x >> 1) * uvPixelStride;
+    uint8x8_t u8, v8;
+    if (uvPixelStride == 1) {
+      u8 = vld1_u8(u + c);
+      v8 = vld1_u8(v + c);
+    } else {
+      uint8x8x2_t uv = vld2_u8((u < v ? u : v) + c);
+      u8 = u < v ? uv.val[0] : uv.val[1];
+      v8 = u < v ? uv.val[1] : uv.val[0];
+    }
+    int16x8_t u16 = Widen(u8, 128);
+    int16x8_t v16 = Widen(v8, 128);
+    int16x8x2_t ud = vzipq_s16(u16, u16);
+    int16x8x2_t vd = vzipq_s16(v16, v16);
+
+    uint8x16_t y8 = vld1q_u8(y + x);
+    int16x8_t y0 = vmaxq_s16(Widen(vget_low_u8(y8), 16), vdupq_n_s16(0));
+    int16x8_t y1 = vmaxq_s16(Widen(vget_high_u8(y8), 16), vdupq_n_s16(0));
+
+    uint8x8_t r0, g0, b0, r1, g1, b1;
+    Convert8(y0, ud.val[0], vd.val[0], &r0, &g0, &b0);
+    Convert8(y1, ud.val[1], vd.val[1], &r1, &g1, &b1);
+
+    // 0xAARRGGBB words are B, G, R, A in memory
+    uint8x16x4_t bgra;
+    bgra.val[0] = vcombine_u8(b0, b1);
+    bgra.val[1] = vcombine_u8(g0, g1);
+    bgra.val[2] = vcombine_u8(r0, r1);
+    bgra.val[3] = vdupq_n_u8(0xff);
+    vst4q_u8(reinterpret_cast<uint8_t*>(dst + x), bgra);
+  }
+  return x;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <smmintrin.h>
+
+#include "yuv_kernels.h"
+
+/*
+ * 16 pixels per step, as two halves of 8. pmaddwd multiplies 16-bit
+ * ( luma, chroma ) pairs by a pair of coefficients and adds them in 32 bits,
+ * so every channel is exactly the scalar 1192 * y + c * chroma.
+ */
+namespace {
+
+inline __m128i CoefPair(int16_t a, int16_t b) {
+  return _mm_set_epi16(b, a, b, a, b, a, b, a);
+}
+
+inline __m128i Narrow(__m128i lo, __m128i hi) {
+  return _mm_packs_epi32(_mm_srai_epi32(lo, 10), _mm_srai_epi32(hi, 10));
+}
+
+/*
+ * The 8 chroma pairs of 16 pixels as 16-bit lanes, minus 128. Semi-planar
+ * samples come from one 16 byte load of the interleaved plane.
+ */
+inline void LoadChroma(const uint8_t* u, const uint8_t* v,
+                       int32_t uvPixelStride, __m128i* u16, __m128i* v16) {
+  const __m128i k128 = _mm_set1_epi16(128);
+  if (uvPixelStride == 1) {
+    *u16 = _mm_cvtepu8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u)));
+    *v16 = _mm_cvtepu8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v)));
+  } else {
+    __m128i c =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(u < v ? u : v));
+    __m128i even = _mm_and_si128(c, _mm_set1_epi16(0xff));
+    __m128i odd = _mm_srli_epi16(c, 8);
+    *u16 = u < v ? even : odd;
+    *v16 = u < v ? odd : even;
+  }
+  *u16 = _mm_sub_epi16(*u16, k128);
+  *v16 = _mm_sub_epi16(*v16, k128);
+}
+
+/*
+ * 8 pixels: luma y16, and the chroma of every pixel in u16 and v16; the
+ * three channels come out as int16, not yet clamped.
+ */
+inline void Convert8(__m128i y16, __m128i u16, __m128i v16, __m128i* r,
+                     __m128i* g, __m128i* b) {
+  const __m128i kR = CoefPair(1192, 1634);   // ( y, v )
+  const __m128i kGv = CoefPair(1192, -833);  // ( y, v )
+  const __m128i kGu = CoefPair(0, -400);     // ( y, u )
+  const __m128i kB = CoefPair(1192, 2066);   // ( y, u )
+  __m128i yvLo = _mm_unpacklo_epi16(y16, v16);
+  __m128i yvHi = _mm_unpackhi_epi16(y16, v16);
+  __m128i yuLo = _mm_unpacklo_epi16(y16, u16);
+  __m128i yuHi = _mm_unpackhi_epi16(y16, u16);
+  *r = Narrow(_mm_madd_epi16(yvLo, kR), _mm_madd_epi16(yvHi, kR));
+  *g = Narrow(
+      _mm_add_epi32(_mm_madd_epi16(yvLo, kGv), _mm_madd_epi16(yuLo, kGu)),
+      _mm_add_epi32(_mm_madd_epi16(yvHi, kGv), _mm_madd_epi16(yuHi, kGu)));
+  *b = Narrow(_mm_madd_epi16(yuLo, kB), _mm_madd_epi16(yuHi, kB));
+}
+
+}  // namespace
+
+int32_t YuvRowSse41(uint32_t* dst, const uint8_t* y, const uint8_t* u,
+                    const uint8_t* v, int32_t uvPixelStride, int32_t width) {
+  const __m128i k16 = _mm_set1_epi16(16);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha = _mm_set1_epi8(-1);
+  int32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const int32_t c = (x >> 1) * uvPixelStride;
+    __m128i u16, v16;
+    LoadChroma(u + c, v + c, uvPixelStride, &u16, &v16);
+
+    __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+    __m128i y0 = _mm_max_epi16(_mm_sub_epi16(_mm_cvtepu8_epi16(y8), k16), zero);
+    __m128i y1 = _mm_max_epi16(
+        _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(y8, 8)), k16), zero);
+
+    __m128i r0, g0, b0, r1, g1, b1;
+    Convert8(y0, _mm_unpacklo_epi16(u16, u16), _mm_unpacklo_epi16(v16, v16),
+             &r0, &g0, &b0);
+    Convert8(y1, _mm_unpackhi_epi16(u16, u16), _mm_unpackhi_epi16(v16, v16),
+             &r1, &g1, &b1);
+
+    // saturating to 0..255 is the scalar clamp; store as 0xAARRGGBB words
+    __m128i r8 = _mm_packus_epi16(r0, r1);
+    __m128i g8 = _mm_packus_epi16(g0, g1);
+    __m128i b8 = _mm_packus_epi16(b0, b1);
+    __m128i bgLo = _mm_unpacklo_epi8(b8, g8);
+    __m128i bgHi = _mm_unpackhi_epi8(b8, g8);
+    __m128i raLo = _mm_unpacklo_epi8(r8, alpha);
+    __m128i raHi = _mm_unpackhi_epi8(r8, alpha);
+    __m128i* out = reinterpret_cast<__m128i*>(dst + x);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(bgLo, raLo));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bgLo, raLo));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bgHi, raHi));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bgHi, raHi));
+  }
+  return x;
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Frame timing for render loops, header only, for C and C++.
+ *
+ * The render thread calls frame_stats_begin() when it starts a frame and
+ * frame_stats_end() once the frame is submitted, or only frame_stats_tick()
+ * when the interval between frames is all it can measure. Frame intervals
+ * and work times go into log-linear histograms in the manner of
+ * HdrHistogram: 32 linear buckets per power of two of microseconds, so a
+ * percentile is within 3% whatever the number of frames, for a fixed 6 KB.
+ * An interval longer than one and a half target periods is a janky frame:
+ * it missed at least one vsync.
+ *
+ * At the end of every report period the render thread reduces the
+ * histograms to a FrameStatsSnapshot and publishes it behind a sequence
+ * counter; any thread reads the latest one with frame_stats_snapshot(),
+ * never blocking the render thread, and can dump it as CSV or JSON.
+ *
+ * Shared by the samples from here: each one adds this directory to its
+ * target_include_directories().
+ */
+
+#define FRAME_STATS_SUB_BITS   5
+#define FRAME_STATS_SUB_COUNT  (1 << FRAME_STATS_SUB_BITS)
+#define FRAME_STATS_MAX_BITS   26   /* intervals are clamped to 2^27 us, about 2 minutes */
+#define FRAME_STATS_BUCKETS    ((FRAME_STATS_MAX_BITS - FRAME_STATS_SUB_BITS + 2) * FRAME_STATS_SUB_COUNT)
+
+#define FRAME_STATS_60HZ_NS    16666667LL
+
+typedef struct {
+    int64_t  count;
+    int64_t  minNs;
+    int64_t  meanNs;
+    int64_t  p50Ns;
+    int64_t  p90Ns;
+    int64_t  p99Ns;
+    int64_t  p999Ns;
+    int64_t  maxNs;
+} FrameStatsDist;
+
+typedef struct {
+    int64_t         period;         /* 1 for the first report period, 0 before it */
+    int64_t         periodNs;       /* wall time the period covers */
+    int64_t         targetNs;
+    int64_t         jankFrames;
+    int64_t         missedVsyncs;   /* target periods skipped by the janky frames */
+    int64_t         totalFrames;    /* since frame_stats_init() */
+    int64_t         totalJank;
+    FrameStatsDist  interval;       /* begin to begin */
+    FrameStatsDist  work;           /* begin to end */
+} FrameStatsSnapshot;
+
+typedef struct {
+    uint32_t  counts[FRAME_STATS_BUCKETS];
+    int64_t   count;
+    int64_t   sumNs;
+    int64_t   minNs;
+    int64_t   maxNs;
+} FrameStatsHistogram;
+
+typedef struct {
+    int64_t              targetNs;
+    int64_t              reportNs;
+    int64_t              periodStart;
+    int64_t              lastBegin;     /* 0 when there is no interval to measure */
+    int64_t              begin;
+    int64_t              period;
+    int64_t              jankFrames;
+    int64_t              missedVsyncs;
+    int64_t              totalFrames;
+    int64_t              totalJank;
+    FrameStatsHistogram  interval;
+    FrameStatsHistogram  work;
+
+    /* the last snapshot, as words a reader can load atomically */
+    uint32_t             seq;           /* odd while the render thread writes */
+    uint32_t             published[sizeof(FrameStatsSnapshot) / sizeof(uint32_t)];
+} FrameStats;
+
+/* CLOCK_MONOTONIC, in nanoseconds */
+static inline int64_t frame_stats_now_ns(void)
+{
+    struct timespec  now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec*1000000000LL + now.tv_nsec;
+}
+
+static inline int frame_stats_bucket(int64_t ns)
+{
+    const uint32_t  maxUs = (2u << FRAME_STATS_MAX_BITS) - 1;
+    int64_t         us = ns / 1000;
+    int             shift;
+
+    if (us < 2*FRAME_STATS_SUB_COUNT)
+        return us < 0 ? 0 : (int)us;
+    if (us > maxUs)
+        us = maxUs;
+    shift = 31 - __builtin_clz((uint32_t)us) - FRAME_STATS_SUB_BITS;
+    return (shift + 1)*FRAME_STATS_SUB_COUNT + (int)(us >> shift) - FRAME_STATS_SUB_COUNT;
+}
+
+/* the largest value, in ns, that lands in bucket idx */
+static inline int64_t frame_stats_bucket_top(int idx)
+{
+    int  shift;
+
+    if (idx < 2*FRAME_STATS_SUB_COUNT)
+        return idx*1000LL + 999;
+    shift = idx/FRAME_STATS_SUB_COUNT - 1;
+    return ((((int64_t)(idx % FRAME_STATS_SUB_COUNT + FRAME_STATS_SUB_COUNT + 1)) << shift) - 1)*1000 + 999;
+}
+
+static inline void frame_stats_record(FrameStatsHistogram*  h, int64_t  ns)
+{
+    h->counts[frame_stats_bucket(ns)] += 1;
+    if (h->count == 0 || ns < h->minNs)
+        h->minNs = ns;
+    if (h->count == 0 || ns > h->maxNs)
+        h->maxNs = ns;
+    h->count += 1;
+    h->sumNs += ns;
+}
+
+static inline void frame_stats_reduce(const FrameStatsHistogram*  h, FrameStatsDist*  d)
+{
+    static const int  perMille[4] = { 500, 900, 990, 999 };
+    int64_t*          out[4];
+    int64_t           seen = 0;
+    int               nn, k = 0;
+
+    memset(d, 0, sizeof(*d));
+    if (h->count == 0)
+        return;
+    d->count  = h->count;
+    d->minNs  = h->minNs;
+    d->maxNs  = h->maxNs;
+    d->meanNs = h->sumNs / h->count;
+    out[0] = &d->p50Ns;
+    out[1] = &d->p90Ns;
+    out[2] = &d->p99Ns;
+    out[3] = &d->p999Ns;
+    for (nn = 0; nn < FRAME_STATS_BUCKETS && k < 4; nn++) {
+        seen += h->counts[nn];
+        /* the smallest value with at least that share of the samples at or below it */
+        while (k < 4 && seen*1000 >= h->count*perMille[k]) {
+            int64_t  top = frame_stats_bucket_top(nn);
+            *out[k++] = top < h->maxNs ? top : h->maxNs;
+        }
+    }
+}
+
+static inline void frame_stats_init(FrameStats*  fs, int64_t  targetNs, int64_t  reportNs)
+{
+    memset(fs, 0, sizeof(*fs));
+    fs->targetNs    = targetNs;
+    fs->reportNs    = reportNs;
+    fs->periodStart = frame_stats_now_ns();
+}
+
+/* the frame period jank is measured against, e.g. after a refresh rate change */
+static inline void frame_stats_set_target(FrameStats*  fs, int64_t  targetNs)
+{
+    fs->targetNs = targetNs;
+}
+
+/* forget the last frame, so that a pause is not measured as an interval */
+static inline void frame_stats_reset_clock(FrameStats*  fs)
+{
+    fs->lastBegin = 0;
+}
+
+/* start a frame; returns the interval since the previous one, 0 for the first */
+static inline int64_t frame_stats_begin(FrameStats*  fs)
+{
+    int64_t  now = frame_stats_now_ns();
+    int64_t  interval = 0;
+
+    if (fs->lastBegin != 0) {
+        interval = now - fs->lastBegin;
+        frame_stats_record(&fs->interval, interval);
+        fs->totalFrames += 1;
+        if (interval*2 > fs->targetNs*3) {
+            fs->jankFrames += 1;
+            fs->totalJank  += 1;
+            fs->missedVsyncs += (interval + fs->targetNs/2)/fs->targetNs - 1;
+        }
+    }
+    fs->lastBegin = fs->begin = now;
+    return interval;
+}
+
+static inline int frame_stats_publish_if_due(FrameStats*  fs, int64_t  now)
+{
+    FrameStatsSnapshot  snap;
+    uint32_t            words[sizeof(fs->published) / sizeof(uint32_t)];
+    uint32_t            seq = fs->seq;
+    unsigned            nn;
+
+    if (now - fs->periodStart < fs->reportNs)
+        return 0;
+
+    fs->period += 1;
+    snap.period       = fs->period;
+    snap.periodNs     = now - fs->periodStart;
+    snap.targetNs     = fs->targetNs;
+    snap.jankFrames   = fs->jankFrames;
+    snap.missedVsyncs = fs->missedVsyncs;
+    snap.totalFrames  = fs->totalFrames;
+    snap.totalJank    = fs->totalJank;
+    frame_stats_reduce(&fs->interval, &snap.interval);
+    frame_stats_reduce(&fs->work, &snap.work);
+    memcpy(words, &snap, sizeof(words));
+
+    __atomic_store_n(&fs->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (nn = 0; nn < sizeof(words) / sizeof(words[0]); nn++)
+        __atomic_store_n(&fs->published[nn], words[nn], __ATOMIC_RELAXED);
+    __atomic_store_n(&fs->seq, seq + 2, __ATOMIC_RELEASE);
+
+    memset(&fs->interval, 0, sizeof(fs->interval));
+    memset(&fs->work, 0, sizeof(fs->work));
+    fs->jankFrames   = 0;
+    fs->missedVsyncs = 0;
+    fs->periodStart  = now;
+    return 1;
+}
+
+/* end the frame started by frame_stats_begin(); 1 when a new snapshot was published */
+static inline int frame_stats_end(FrameStats*  fs)
+{
+    int64_t  now = frame_stats_now_ns();
+
+    frame_stats_record(&fs->work, now - fs->begin);
+    return frame_stats_publish_if_due(fs, now);
+}
+
+/* a frame with no work time to measure: frame_stats_begin() and the report */
+static inline int frame_stats_tick(FrameStats*  fs)
+{
+    frame_stats_begin(fs);
+    return frame_stats_publish_if_due(fs, fs->begin);
+}
+
+/*
+ * Copy the last published snapshot, from any thread; returns its period
+ * number, 0 if none was published yet.
+ */
+static inline int64_t frame_stats_snapshot(const FrameStats*  fs, FrameStatsSnapshot*  snap)
+{
+    uint32_t  words[sizeof(fs->published) / sizeof(uint32_t)];
+    uint32_t  seq;
+    unsigned  nn;
+
+    do {
+        while ((seq = __atomic_load_n(&fs->seq, __ATOMIC_ACQUIRE)) & 1)
+            ;
+        for (nn = 0; nn < sizeof(words) / sizeof(words[0]); nn++)
+            words[nn] = __atomic_load_n(&fs->published[nn], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&fs->seq, __ATOMIC_RELAXED) != seq);
+    memcpy(snap, words, sizeof(words));
+    return snap->period;
+}
+
+static inline double frame_stats_fps(const FrameStatsSnapshot*  snap)
+{
+    return snap->interval.meanNs > 0 ? 1e9 / snap->interval.meanNs : 0.;
+}
+
+#define FRAME_STATS_MS(ns)  ((ns) / 1e6)
+
+#define FRAME_STATS_CSV_HEADER \
+    "period,period_ms,target_ms,frames,jank,missed_vsyncs,total_frames,total_jank," \
+    "interval_min_ms,interval_mean_ms,interval_p50_ms,interval_p90_ms,interval_p99_ms," \
+    "interval_p999_ms,interval_max_ms,work_min_ms,work_mean_ms,work_p50_ms,work_p90_ms," \
+    "work_p99_ms,work_p999_ms,work_max_ms"
+
+/* one FRAME_STATS_CSV_HEADER row; returns what snprintf() returns */
+static inline int frame_stats_csv(const FrameStatsSnapshot*  s, char*  buf, size_t  size)
+{
+    const FrameStatsDist*  i = &s->interval;
+    const FrameStatsDist*  w = &s->work;
+
+    return snprintf(buf, size,
+                    "%lld,%.3f,%.3f,%lld,%lld,%lld,%lld,%lld,"
+                    "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,"
+                    "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f",
+                    (long long)s->period, FRAME_STATS_MS(s->periodNs),
+                    FRAME_STATS_MS(s->targetNs), (long long)i->count,
+                    (long long)s->jankFrames, (long long)s->missedVsyncs,
+                    (long long)s->totalFrames, (long long)s->totalJank,
+                    FRAME_STATS_MS(i->minNs), FRAME_STATS_MS(i->meanNs),
+                    FRAME_STATS_MS(i->p50Ns), FRAME_STATS_MS(i->p90Ns),
+                    FRAME_STATS_MS(i->p99Ns), FRAME_STATS_MS(i->p999Ns),
+                    FRAME_STATS_MS(i->maxNs),
+                    FRAME_STATS_MS(w->minNs), FRAME_STATS_MS(w->meanNs),
+                    FRAME_STATS_MS(w->p50Ns), FRAME_STATS_MS(w->p90Ns),
+                    FRAME_STATS_MS(w->p99Ns), FRAME_STATS_MS(w->p999Ns),
+                    FRAME_STATS_MS(w->maxNs));
+}
+
+/* the snapshot as one JSON object, times in ms; returns what snprintf() returns */
+static inline int frame_stats_json(const FrameStatsSnapshot*  s, char*  buf, size_t  size)
+{
+    const FrameStatsDist*  d[2];
+    const char*            name[2] = { "interval", "work" };
+    int                    len, nn;
+
+    d[0] = &s->interval;
+    d[1] = &s->work;
+    len = snprintf(buf, size,
+                   "{\"period\":%lld,\"period_ms\":%.3f,\"target_ms\":%.3f,\"frames\":%lld,"
+                   "\"jank\":%lld,\"missed_vsyncs\":%lld,\"total_frames\":%lld,\"total_jank\":%lld",
+                   (long long)s->period, FRAME_STATS_MS(s->periodNs),
+                   FRAME_STATS_MS(s->targetNs), (long long)s->interval.count,
+                   (long long)s->jankFrames, (long long)s->missedVsyncs,
+                   (long long)s->totalFrames, (long long)s->totalJank);
+    for (nn = 0; nn < 2 && len >= 0; nn++) {
+        size_t  used = (size_t)len < size ? (size_t)len : size;
+        int     n = snprintf(buf + used, size - used,
+                             ",\"%s\":{\"count\":%lld,\"min_ms\":%.3f,\"mean_ms\":%.3f,"
+                             "\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,"
+                             "\"p999_ms\":%.3f,\"max_ms\":%.3f}",
+                             name[nn], (long long)d[nn]->count,
+                             FRAME_STATS_MS(d[nn]->minNs), FRAME_STATS_MS(d[nn]->meanNs),
+                             FRAME_STATS_MS(d[nn]->p50Ns), FRAME_STATS_MS(d[nn]->p90Ns),
+                             FRAME_STATS_MS(d[nn]->p99Ns), FRAME_STATS_MS(d[nn]->p999Ns),
+                             FRAME_STATS_MS(d[nn]->maxNs));
+        len = n < 0 ? n : len + n;
+    }
+    if (len >= 0) {
+        if ((size_t)len + 1 < size) {
+            buf[len] = '}';
+            buf[len + 1] = '\0';
+        }
+        len += 1;
+    }
+    return len;
+}
+
+#endif /* FRAME_STATS_H */
@@ -22,6 +22,7 @@
  *    Release all textures created in engine
  */
 void ImageViewEngine::DeleteTextures(void) {
+  textureService_->Cancel();
   for (auto& tex : textures_) {
     delete tex;
   }
@@ -33,6 +34,8 @@ void ImageViewEngine::DeleteTextures(void) {
  *    Create 2 textures in current display_ color space ( P3 or sRGB)
  *    If it is P3 space, image is transformed through sRGB so colors
  *    outside sRGB gamut are removed.
+ *    Textures are only requested here: textureService_ decodes them on its
+ *    thread and DrawFrame() uploads them, the one on screen first.
  */
 bool ImageViewEngine::CreateTextures(void) {
   std::vector<std::string> files;
@@ -46,10 +49,14 @@ bool ImageViewEngine::CreateTextures(void) {
     AssetTexture* tex = new AssetTexture(f);
     ASSERT(tex, "OUT OF MEMORY");
     tex->ColorSpace(dispColorSpace_);
-    bool status = tex->CreateGLTextures(app_->activity->assetManager);
-    ASSERT(status, "Failed to create Texture for %s", f.c_str());
+    tex->DisplayFormat(dispFormat_);
     textures_.push_back(tex);
   }
 
+  textureIdx_ = textureIdx_ % textures_.size();
+  for (size_t i = 0; i < textures_.size(); i++) {
+    textureService_->Request(
+        textures_[(textureIdx_ + i) % textures_.size()]);
+  }
   return true;
 }
@@ -21,6 +21,7 @@
 #include <string>
 #include <GLES3/gl32.h>
 #include <android/asset_manager.h>
+#include "ColorSpaceTransform.h"
 
 class AssetTexture {
 private:
@@ -29,17 +30,27 @@ private:
   GLuint sRGBId_;
   bool  valid_;
   enum DISPLAY_COLORSPACE dispColorSpace_;
+  enum DISPLAY_FORMAT dispFormat_;
 
 public:
   explicit AssetTexture(const std::string& name);
   ~AssetTexture();
   void ColorSpace(enum DISPLAY_COLORSPACE  clrSpace);
   DISPLAY_COLORSPACE ColorSpace(void);
-  bool CreateGLTextures(AAssetManager* mgr);
+  void DisplayFormat(enum DISPLAY_FORMAT fmt);
+  DISPLAY_FORMAT DisplayFormat(void);
+  void GLTextures(GLuint p3Id, GLuint sRGBId);
   bool IsValid(void);
   GLuint P3TexId(void);
   GLuint SRGBATexId(void);
   std::string& Name(void);
 };
 
+/*
+ * Texture formats and sampling shared with TextureService
+ */
+void GetTextureFormat(PIXEL_FORMAT fmt, GLenum* internalFormat, GLenum* type);
+PIXEL_FORMAT GetPixelFormat(DISPLAY_FORMAT fmt);
+void SetTextureParameters(void);
+
 #endif  // __ASSET_TEXTURE_H__
@@ -14,9 +14,20 @@
  * limitations under the License.
  *
  */
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "android_debug.h"
 #include "ColorSpaceTransform.h"
 
@@ -75,142 +86,504 @@ static void CreateGammaDecodeTable(float gamma, std::vector<uint8_t>&table) {
 }
 
 /*
- * ApplyGamma()
- *    Perform gamma lookup for RGBA8888 format
+ * GetGammaTable()
+ *    The table for gamma, built on first use and kept: the same few gamma
+ *    values come back for every texture
  */
-static bool ApplyGamma(void* dst, void* src, uint32_t w, uint32_t h,
-                std::vector<uint8_t>& gammaTable) {
-  if(!src || !dst || gammaTable.empty()) {
-    LOGE("Invalid Input to %s, dst(%p),src(%p)",
-         __FUNCTION__, dst, src);
-    return false;
-  }
-  uint8_t* imgSrc = static_cast<uint8_t*>(src);
-  uint8_t* imgDst = static_cast<uint8_t*>(dst);
-  for (uint32_t r = 0; r < w; r++) {
-    for(uint32_t c = 0; c < h; c++) {
-      *imgDst++ = gammaTable[*imgSrc++];
-      *imgDst++ = gammaTable[*imgSrc++];
-      *imgDst++ = gammaTable[*imgSrc++];
-      *imgDst++ = *imgSrc++;
+static const std::vector<uint8_t>& GetGammaTable(float gamma, bool encode) {
+  static std::mutex lock;
+  static std::map<float, std::vector<uint8_t>> tables[2];
+
+  std::lock_guard<std::mutex> guard(lock);
+  std::map<float, std::vector<uint8_t>>& cache = tables[encode ? 1 : 0];
+  auto it = cache.find(gamma);
+  if (it == cache.end()) {
+    it = cache.emplace(gamma, std::vector<uint8_t>()).first;
+    if (encode) {
+      CreateGammaEncodeTable(gamma, it->second);
+    } else {
+      CreateGammaDecodeTable(gamma, it->second);
     }
   }
-  return true;
+  return it->second;
 }
 
 /*
- * GammaDecode(IMAGE_FORMAT& src):
- *    Decode gamma for src image
- *    src.gamma: the gamma used encoding the src image
- * Ouput:
- *     src.buf_: gamma decoded image with gamma value of 1.0f/src.gamma
+ * Everything one pass needs: optional de-gamma table, the matrix in 10 bit
+ * fixed point, optional en-gamma table
+ */
+struct TRANSFORM_PARAMS {
+  const uint8_t* decode_;   // nullptr: source is linear already
+  const uint8_t* encode_;   // nullptr: destination stays linear
+  int32_t m_[3][3];
+  bool    simd_;            // m_ fits the 16 bit SIMD multiplies
+};
+
+// pixels per chunk; the planar staging rows stay in L1
+#define TRANSFORM_CHUNK 256
+// below this many pixels one thread does it all
+#define PARALLEL_PIXELS (256 * 256)
+#define MAX_TRANSFORM_THREADS 4
+
+/*
+ * MatrixScalar()
+ *    out = (m * in + 512) >> 10 clamped to 0 -- 255, for planar channels
  */
-static bool GammaDecode(IMAGE_FORMAT &src) {
-  if (!HAS_GAMMA(src.gamma_)) {
-    LOGE("No gamma value to source gamma");
-    return true;
+static void MatrixScalar(uint8_t* out[3], uint8_t* in[3], uint32_t start,
+                         uint32_t count, const TRANSFORM_PARAMS& params) {
+  for (uint32_t i = start; i < count; i++) {
+    for (int c = 0; c < 3; c++) {
+      int32_t v = (params.m_[c][0] * in[0][i] + params.m_[c][1] * in[1][i] +
+                   params.m_[c][2] * in[2][i] + 512) >> 10;
+      out[c][i] = static_cast<uint8_t>(CLIP_COLOR(v, 255));
+    }
   }
-  std::vector<uint8_t> gammaTable;
-  CreateGammaDecodeTable(1.0f/src.gamma_, gammaTable);
+}
 
-  return ApplyGamma(src.buf_, src.buf_, src.width_, src.height_,
-                    gammaTable);
+/*
+ * MatrixSimd()
+ *    MatrixScalar() 8 pixels at a time; the products and the sums are exact
+ *    in 32 bits and the saturating narrows do the clamping, so the results
+ *    are the same. Returns how many pixels it did.
+ */
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+static uint32_t MatrixSimd(uint8_t* out[3], uint8_t* in[3], uint32_t count,
+                           const TRANSFORM_PARAMS& params) {
+  const int32x4_t round = vdupq_n_s32(512);
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(in[0] + i)));
+    int16x8_t g = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(in[1] + i)));
+    int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(in[2] + i)));
+    for (int c = 0; c < 3; c++) {
+      int16_t m0 = static_cast<int16_t>(params.m_[c][0]);
+      int16_t m1 = static_cast<int16_t>(params.m_[c][1]);
+      int16_t m2 = static_cast<int16_t>(params.m_[c][2]);
+      int32x4_t lo = vmlal_n_s16(round, vget_low_s16(r), m0);
+      lo = vmlal_n_s16(lo, vget_low_s16(g), m1);
+      lo = vmlal_n_s16(lo, vget_low_s16(b), m2);
+      int32x4_t hi = vmlal_n_s16(round, vget_high_s16(r), m0);
+      hi = vmlal_n_s16(hi, vget_high_s16(g), m1);
+      hi = vmlal_n_s16(hi, vget_high_s16(b), m2);
+      uint16x8_t v = vcombine_u16(vqmovun_s32(vshrq_n_s32(lo, 10)),
+                                  vqmovun_s32(vshrq_n_s32(hi, 10)));
+      vst1_u8(out[c] + i, vqmovn_u16(v));
+    }
+  }
+  return i;
+}
+#elif defined(__SSE2__)
+static uint32_t MatrixSimd(uint8_t* out[3], uint8_t* in[3], uint32_t count,
+                           const TRANSFORM_PARAMS& params) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi16(1);
+  __m128i coefRG[3], coefB1[3];
+  for (int c = 0; c < 3; c++) {
+    // (r, g) pairs times (m0, m1), (b, 1) pairs times (m2, 512)
+    coefRG[c] = _mm_set1_epi32(
+        static_cast<int32_t>((static_cast<uint32_t>(params.m_[c][1]) << 16) |
+                             (params.m_[c][0] & 0xFFFF)));
+    coefB1[c] = _mm_set1_epi32(
+        static_cast<int32_t>((512u << 16) | (params.m_[c][2] & 0xFFFF)));
+  }
+  uint32_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i r = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in[0] + i)), zero);
+    __m128i g = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in[1] + i)), zero);
+    __m128i b = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in[2] + i)), zero);
+    __m128i rgLo = _mm_unpacklo_epi16(r, g), rgHi = _mm_unpackhi_epi16(r, g);
+    __m128i b1Lo = _mm_unpacklo_epi16(b, one), b1Hi = _mm_unpackhi_epi16(b, one);
+    for (int c = 0; c < 3; c++) {
+      __m128i lo = _mm_add_epi32(_mm_madd_epi16(rgLo, coefRG[c]),
+                                 _mm_madd_epi16(b1Lo, coefB1[c]));
+      __m128i hi = _mm_add_epi32(_mm_madd_epi16(rgHi, coefRG[c]),
+                                 _mm_madd_epi16(b1Hi, coefB1[c]));
+      __m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, 10),
+                                  _mm_srai_epi32(hi, 10));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out[c] + i),
+                       _mm_packus_epi16(v, v));
+    }
+  }
+  return i;
+}
+#else
+static uint32_t MatrixSimd(uint8_t**, uint8_t**, uint32_t,
+                           const TRANSFORM_PARAMS&) {
+  return 0;
 }
+#endif
+
+/*
+ * TransformRows()
+ *    de-gamma, matrix and en-gamma rows [firstRow, lastRow) in one pass,
+ *    a chunk at a time. Pixel for pixel it computes what the separate
+ *    de-gamma, matrix and en-gamma passes used to, so dst may be src.
+ */
+static void TransformRows(uint8_t* dst, const uint8_t* src, uint32_t width,
+                          uint32_t firstRow, uint32_t lastRow,
+                          const TRANSFORM_PARAMS& params) {
+  uint8_t linear[3][TRANSFORM_CHUNK];
+  uint8_t mixed[3][TRANSFORM_CHUNK];
+  uint8_t* in[3] = {linear[0], linear[1], linear[2]};
+  uint8_t* out[3] = {mixed[0], mixed[1], mixed[2]};
 
-static bool GammaDecode(IMAGE_FORMAT &dst, IMAGE_FORMAT &src) {
-  if (!HAS_GAMMA(src.gamma_)) {
-    LOGE("No gamma value to source gamma");
-    return true;
+  uint64_t pixels = static_cast<uint64_t>(lastRow - firstRow) * width;
+  src += static_cast<uint64_t>(firstRow) * width * 4;
+  dst += static_cast<uint64_t>(firstRow) * width * 4;
+  while (pixels) {
+    uint32_t count = static_cast<uint32_t>(
+        pixels < TRANSFORM_CHUNK ? pixels : TRANSFORM_CHUNK);
+    const uint8_t* s = src;
+    for (uint32_t i = 0; i < count; i++, s += 4) {
+      if (params.decode_) {
+        linear[0][i] = params.decode_[s[0]];
+        linear[1][i] = params.decode_[s[1]];
+        linear[2][i] = params.decode_[s[2]];
+      } else {
+        linear[0][i] = s[0];
+        linear[1][i] = s[1];
+        linear[2][i] = s[2];
+      }
+    }
+
+    uint32_t done = params.simd_ ? MatrixSimd(out, in, count, params) : 0;
+    MatrixScalar(out, in, done, count, params);
+
+    s = src;
+    uint8_t* d = dst;
+    for (uint32_t i = 0; i < count; i++, s += 4, d += 4) {
+      uint8_t alpha = s[3];
+      if (params.encode_) {
+        d[0] = params.encode_[mixed[0][i]];
+        d[1] = params.encode_[mixed[1][i]];
+        d[2] = params.encode_[mixed[2][i]];
+      } else {
+        d[0] = mixed[0][i];
+        d[1] = mixed[1][i];
+        d[2] = mixed[2][i];
+      }
+      d[3] = alpha;
+    }
+    src += count * 4;
+    dst += count * 4;
+    pixels -= count;
   }
-  std::vector<uint8_t> gammaTable;
-  CreateGammaDecodeTable(1.0f/src.gamma_, gammaTable);
+}
 
-  return ApplyGamma(dst.buf_, src.buf_, src.width_, src.height_,
-                    gammaTable);
+/*
+ * RunBands()
+ *    rows(firstRow, lastRow) over the whole image: large images are split
+ *    into row bands over a few threads
+ */
+static void RunBands(uint32_t width, uint32_t height,
+                     const std::function<void(uint32_t, uint32_t)>& rows) {
+  uint32_t bands = 1;
+  if (static_cast<uint64_t>(width) * height >= PARALLEL_PIXELS) {
+    bands = std::min(std::max(std::thread::hardware_concurrency(), 1u),
+                     static_cast<uint32_t>(MAX_TRANSFORM_THREADS));
+    bands = std::min(bands, height);
+  }
+  std::vector<std::thread> workers;
+  for (uint32_t band = 1; band < bands; band++) {
+    workers.push_back(std::thread(rows, height * band / bands,
+                                  height * (band + 1) / bands));
+  }
+  rows(0, height / bands);
+  for (auto& worker : workers) {
+    worker.join();
+  }
 }
 
 /*
- * GammaEncode(IMAGE_FORMAT& format dst)
- *    Gamma encode image with the gamma value of dst.gamma_
+ * FloatToHalf()
+ *    IEEE half float bits of value, rounded to nearest even
  */
-static bool GammaEncode(IMAGE_FORMAT &dst) {
-  if (!HAS_GAMMA(dst.gamma_)) {
-    LOGE("No gamma value to dst gamma");
-    return true;
+static uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  int32_t exp = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mant = bits & 0x7FFFFF;
+  if (exp >= 31) {
+    return sign | 0x7C00;
   }
-  std::vector<uint8_t> gammaTable;
-  CreateGammaEncodeTable(dst.gamma_, gammaTable);
+  uint32_t shift = 13;
+  uint32_t half;
+  if (exp <= 0) {
+    // denormal: the implicit 1 becomes explicit
+    if (exp < -10) {
+      return sign;
+    }
+    mant |= 0x800000;
+    shift = static_cast<uint32_t>(14 - exp);
+    half = mant >> shift;
+  } else {
+    half = (static_cast<uint32_t>(exp) << 10) | (mant >> shift);
+  }
+  uint32_t rest = mant & ((1u << shift) - 1);
+  uint32_t midway = 1u << (shift - 1);
+  if (rest > midway || (rest == midway && (half & 1))) {
+    half++;
+  }
+  return sign | static_cast<uint16_t>(half);
+}
 
-  return ApplyGamma(dst.buf_, dst.buf_, dst.width_, dst.height_,
-                    gammaTable);
+uint32_t GetPixelSize(PIXEL_FORMAT fmt) {
+  return (fmt == PIXEL_RGBA16F) ? 8 : 4;
 }
 
+// steps of the linear values going into the en-gamma tables
+#define LINEAR_STEPS 65535
+
 /*
- * ApplyTransform8888()
- *    dst = matrix * src
- *    and clamp the result to 0 -- 255
+ * GetLinearTable()
+ *    Linear value, 0.0f -- 1.0f, of every 8 bit code gamma encoded with
+ *    gamma; pass 0.0f for linear codes. Unlike CreateGammaDecodeTable()
+ *    there is no linear toe: with gammas other than 2.4 it does not meet
+ *    the curve, and GetCodeTable() could not invert it.
  */
-static bool TransformR8G8B8A8(uint8_t* dst, uint8_t *src,
-                           uint32_t width, uint32_t height,
-                           mathfu::mat3& transMatrix) {
-  ASSERT(src && dst, "Wrong image store to %s", __FUNCTION__);
+static const float* GetLinearTable(float gamma) {
+  static std::mutex lock;
+  static std::map<float, std::vector<float>> tables;
 
-  int32_t m00, m01, m02, m10, m11, m12, m20, m21, m22;
-  m00 = static_cast<int32_t>(transMatrix(0, 0) * 1024 + 0.5f),
-  m01 = static_cast<int32_t>(transMatrix(0, 1) * 1024 + 0.5f);
-  m02 = static_cast<int32_t>(transMatrix(0, 2) * 1024 + 0.5f);
-  m10 = static_cast<int32_t>(transMatrix(1, 0) * 1024 + 0.5f);
-  m11 = static_cast<int32_t>(transMatrix(1, 1) * 1024 + 0.5f);
-  m12 = static_cast<int32_t>(transMatrix(1, 2) * 1024 + 0.5f);
-  m20 = static_cast<int32_t>(transMatrix(2, 0) * 1024 + 0.5f);
-  m21 = static_cast<int32_t>(transMatrix(2, 1) * 1024 + 0.5f);
-  m22 = static_cast<int32_t>(transMatrix(2, 2) * 1024 + 0.5f);
-    for (uint32_t row = 0; row < height; row++) {
-      for (uint32_t col = 0; col < width; col++) {
-        int32_t r, g, b;
-        r = (m00 * src[0] + m01 * src[1] + m02 * src[2] + 512) >> 10;
-        g = (m10 * src[0] + m11 * src[1] + m12 * src[2] + 512) >> 10;
-        b = (m20 * src[0] + m21 * src[1] + m22 * src[2] + 512) >> 10;
-        *dst++ = static_cast<uint8_t>(CLIP_COLOR(r, 255));
-        *dst++ = static_cast<uint8_t>(CLIP_COLOR(g, 255));
-        *dst++ = static_cast<uint8_t>(CLIP_COLOR(b, 255));
+  std::lock_guard<std::mutex> guard(lock);
+  std::vector<float>& table = tables[gamma];
+  if (table.empty()) {
+    for (uint32_t idx = 0; idx <= 255; idx++) {
+      double val = idx / 255.0;
+      if (HAS_GAMMA(gamma)) {
+        val = pow((val + 0.055) / 1.055, 1.0 / gamma);
+      }
+      table.push_back(static_cast<float>(val));
+    }
+  }
+  return table.data();
+}
+
+/*
+ * GetCodeTable()
+ *    Output code in fmt for every linear value idx / LINEAR_STEPS,
+ *    gamma encoded with gamma, or left linear for 0.0f
+ */
+static const uint16_t* GetCodeTable(float gamma, PIXEL_FORMAT fmt) {
+  static std::mutex lock;
+  static std::map<std::pair<float, int>, std::vector<uint16_t>> tables;
 
-        src += 3;          // update src pointer
-        *dst++ = *src++;   // copy alpha
+  std::lock_guard<std::mutex> guard(lock);
+  std::vector<uint16_t>& table = tables[std::make_pair(gamma, fmt)];
+  if (table.empty()) {
+    table.resize(LINEAR_STEPS + 1);
+    for (uint32_t idx = 0; idx <= LINEAR_STEPS; idx++) {
+      double val = static_cast<double>(idx) / LINEAR_STEPS;
+      if (HAS_GAMMA(gamma)) {
+        val = 1.055 * pow(val, gamma) - 0.055;
+        val = CLIP_COLOR(val, 1.0);
       }
+      switch (fmt) {
+        case PIXEL_R8G8B8A8:
+          table[idx] = static_cast<uint16_t>(val * 255 + 0.5);
+          break;
+        case PIXEL_R10G10B10A2:
+          table[idx] = static_cast<uint16_t>(val * 1023 + 0.5);
+          break;
+        case PIXEL_RGBA16F:
+          table[idx] = FloatToHalf(static_cast<float>(val));
+          break;
+      }
+    }
+  }
+  return table.data();
+}
+
+/*
+ * Everything one precise pass needs
+ */
+struct PRECISE_PARAMS {
+  const float*    decode_;   // 8 bit code --> linear
+  const uint16_t* encode_;   // linear step --> output code
+  const uint16_t* alpha_;    // linear step --> output code, never gamma-ed
+  float m_[3][3];            // source --> gamut, or straight to destination
+  float gamutToDst_[3][3];
+  bool  gamut_;
+  PIXEL_FORMAT fmt_;
+};
+
+/*
+ * MatrixFloat()
+ *    out = m * in for planar channels, clamped to 0.0f -- 1.0f
+ */
+static void MatrixFloat(float out[3][TRANSFORM_CHUNK],
+                        float in[3][TRANSFORM_CHUNK],
+                        const float m[3][3], uint32_t count) {
+  for (int c = 0; c < 3; c++) {
+    const float m0 = m[c][0], m1 = m[c][1], m2 = m[c][2];
+    for (uint32_t i = 0; i < count; i++) {
+      float v = m0 * in[0][i] + m1 * in[1][i] + m2 * in[2][i];
+      out[c][i] = std::min(std::max(v, 0.0f), 1.0f);
+    }
+  }
+}
+
+static inline uint32_t LinearStep(float v) {
+  return static_cast<uint32_t>(v * LINEAR_STEPS + 0.5f);
+}
+
+/*
+ * TransformRowsPrecise()
+ *    TransformRows() with floating point linear values, into any
+ *    PIXEL_FORMAT, optionally through a gamut clip
+ */
+static void TransformRowsPrecise(uint8_t* dst, const uint8_t* src,
+                                 uint32_t width, uint32_t firstRow,
+                                 uint32_t lastRow,
+                                 const PRECISE_PARAMS& params) {
+  float linear[3][TRANSFORM_CHUNK];
+  float mixed[3][TRANSFORM_CHUNK];
+  const uint32_t pixelSize = GetPixelSize(params.fmt_);
+
+  uint64_t pixels = static_cast<uint64_t>(lastRow - firstRow) * width;
+  src += static_cast<uint64_t>(firstRow) * width * 4;
+  dst += static_cast<uint64_t>(firstRow) * width * pixelSize;
+  while (pixels) {
+    uint32_t count = static_cast<uint32_t>(
+        pixels < TRANSFORM_CHUNK ? pixels : TRANSFORM_CHUNK);
+    const uint8_t* s = src;
+    for (uint32_t i = 0; i < count; i++, s += 4) {
+      linear[0][i] = params.decode_[s[0]];
+      linear[1][i] = params.decode_[s[1]];
+      linear[2][i] = params.decode_[s[2]];
+    }
+
+    MatrixFloat(mixed, linear, params.m_, count);
+    float (*result)[TRANSFORM_CHUNK] = mixed;
+    if (params.gamut_) {
+      MatrixFloat(linear, mixed, params.gamutToDst_, count);
+      result = linear;
+    }
+
+    s = src;
+    const uint16_t* encode = params.encode_;
+    switch (params.fmt_) {
+      case PIXEL_R8G8B8A8:
+        for (uint32_t i = 0; i < count; i++, s += 4) {
+          uint8_t* d = dst + i * 4;
+          uint8_t alpha = s[3];
+          d[0] = static_cast<uint8_t>(encode[LinearStep(result[0][i])]);
+          d[1] = static_cast<uint8_t>(encode[LinearStep(result[1][i])]);
+          d[2] = static_cast<uint8_t>(encode[LinearStep(result[2][i])]);
+          d[3] = alpha;
+        }
+        break;
+      case PIXEL_R10G10B10A2:
+        for (uint32_t i = 0; i < count; i++, s += 4) {
+          uint32_t pixel = encode[LinearStep(result[0][i])] |
+                           (encode[LinearStep(result[1][i])] << 10) |
+                           (encode[LinearStep(result[2][i])] << 20) |
+                           (static_cast<uint32_t>(s[3] * 3 + 127) / 255) << 30;
+          memcpy(dst + i * 4, &pixel, sizeof(pixel));
+        }
+        break;
+      case PIXEL_RGBA16F:
+        for (uint32_t i = 0; i < count; i++, s += 4) {
+          uint16_t pixel[4] = {
+              encode[LinearStep(result[0][i])],
+              encode[LinearStep(result[1][i])],
+              encode[LinearStep(result[2][i])],
+              params.alpha_[s[3] * 257],   // s[3] / 255 in linear steps
+          };
+          memcpy(dst + i * 8, pixel, sizeof(pixel));
+        }
+        break;
     }
+    src += count * 4;
+    dst += count * pixelSize;
+    pixels -= count;
+  }
+}
+
+bool TransformColorSpace(IMAGE_FORMAT &dst, IMAGE_FORMAT& src,
+                         const mathfu::mat3* gamutNpm,
+                         const mathfu::mat3* gamutNpmInv) {
+  if (!src.npm_  || !dst.npm_ || !dst.buf_ || !src.buf_ ||
+      (!gamutNpm != !gamutNpmInv) || src.fmt_ != PIXEL_R8G8B8A8) {
+    LOGE("=====Error: Invalid Parameters to TransformColorSpace()");
+    return false;
+  }
+  if (!gamutNpm && dst.fmt_ == PIXEL_R8G8B8A8) {
+    return TransformColorSpace(dst, src);
+  }
+
+  PRECISE_PARAMS params;
+  params.decode_ = GetLinearTable(HAS_GAMMA(src.gamma_) ? src.gamma_ : 0.0f);
+  params.encode_ = GetCodeTable(HAS_GAMMA(dst.gamma_) ? dst.gamma_ : 0.0f,
+                                dst.fmt_);
+  params.alpha_ = GetCodeTable(0.0f, dst.fmt_);
+  params.gamut_ = (gamutNpm != nullptr);
+  params.fmt_ = dst.fmt_;
+
+  mathfu::mat3 matrix = params.gamut_ ? *gamutNpmInv * (*src.npm_) :
+                                        *dst.npm_ * (*src.npm_);
+  mathfu::mat3 gamutToDst = params.gamut_ ? *dst.npm_ * (*gamutNpm) : matrix;
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      params.m_[r][c] = matrix(r, c);
+      params.gamutToDst_[r][c] = gamutToDst(r, c);
+    }
+  }
+
+  uint8_t* dstBits = static_cast<uint8_t*>(dst.buf_);
+  const uint8_t* srcBits = static_cast<const uint8_t*>(src.buf_);
+  uint32_t width = src.width_;
+  RunBands(width, src.height_, [&](uint32_t firstRow, uint32_t lastRow) {
+    TransformRowsPrecise(dstBits, srcBits, width, firstRow, lastRow, params);
+  });
+
   return true;
 }
 
 /*
  * Interface Function:
  *     Convert Color Spaces
+ *     Large images are split into row bands over a few threads
  */
 bool TransformColorSpace(IMAGE_FORMAT &dst, IMAGE_FORMAT& src) {
   if (!src.npm_  || !dst.npm_ || !dst.buf_ || !src.buf_) {
     LOGE("=====Error: Invalid Parameters to TransformColorSpace()");
     return false;
   }
-
-  uint8_t* dstBits = static_cast<uint8_t*>(dst.buf_);
-  uint8_t* srcBits = static_cast<uint8_t*>(src.buf_);
-
-  if (HAS_GAMMA(src.gamma_)) {
-    GammaDecode(dst, src);
-    srcBits = dstBits;
+  if (dst.fmt_ != PIXEL_R8G8B8A8) {
+    return TransformColorSpace(dst, src, nullptr, nullptr);
   }
 
-  mathfu::mat3 matrix = *dst.npm_ * (*src.npm_);
-  TransformR8G8B8A8(dstBits, srcBits, src.width_, src.height_, matrix);
+  TRANSFORM_PARAMS params;
+  params.decode_ = HAS_GAMMA(src.gamma_) ?
+                   GetGammaTable(1.0f/src.gamma_, false).data() : nullptr;
+  params.encode_ = HAS_GAMMA(dst.gamma_) ?
+                   GetGammaTable(dst.gamma_, true).data() : nullptr;
 
-  if (HAS_GAMMA(dst.gamma_)) {
-    GammaEncode(dst);
+  mathfu::mat3 matrix = *dst.npm_ * (*src.npm_);
+  params.simd_ = true;
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      params.m_[r][c] = static_cast<int32_t>(matrix(r, c) * 1024 + 0.5f);
+      params.simd_ = params.simd_ &&
+                     params.m_[r][c] >= INT16_MIN && params.m_[r][c] <= INT16_MAX;
+    }
   }
 
+  uint8_t* dstBits = static_cast<uint8_t*>(dst.buf_);
+  const uint8_t* srcBits = static_cast<const uint8_t*>(src.buf_);
+  uint32_t width = src.width_;
+  RunBands(width, src.height_, [&](uint32_t firstRow, uint32_t lastRow) {
+    TransformRows(dstBits, srcBits, width, firstRow, lastRow, params);
+  });
+
   return true;
 }
 
-
 /*
  * Default NPMs with white reference points as D65
  * The array sequence should match enum NPM_TYPE definition
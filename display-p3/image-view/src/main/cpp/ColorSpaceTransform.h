@@ -21,11 +21,21 @@
 #include <cstdint>
 #include <mathfu/glsl_mappings.h>
 
+/*
+ * Packed pixel layouts; sources are always PIXEL_R8G8B8A8
+ */
+enum PIXEL_FORMAT {
+  PIXEL_R8G8B8A8 = 0,
+  PIXEL_R10G10B10A2,  // GL_UNSIGNED_INT_2_10_10_10_REV, red in the low bits
+  PIXEL_RGBA16F,      // GL_HALF_FLOAT
+};
+
 struct IMAGE_FORMAT {
   void*       buf_;  // packed image pointer
   uint32_t    width_, height_;
   float       gamma_;
   const mathfu::mat3* npm_;
+  PIXEL_FORMAT fmt_;
 };
 
 #define DEFAULT_DISPLAY_GAMMA (1.0f/2.2f)
@@ -42,9 +52,31 @@ struct IMAGE_FORMAT {
  *     source of the image bits to transform.
  * Both src and dst must be in:
  *     R8G8B8A8 4 channels packed format
+ * All three steps happen in one pass over the image, so dst.buf_ may be
+ * src.buf_; large images are transformed on a few threads.
  */
 bool TransformColorSpace(IMAGE_FORMAT &dst, IMAGE_FORMAT& src);
 
+/*
+ * TransformColorSpace(dst, src, gamutNpm, gamutNpmInv)
+ *     Same as above, but on the way colors are clipped to the gamut given
+ *     by gamutNpm ( gamut --> XYZ ) and gamutNpmInv ( XYZ --> gamut ):
+ *     dst.buf_ = en-gamma(dst.npm * gamutNpm *
+ *                         clip(gamutNpmInv * src.npm * de-gamma(src.buf_)))
+ *     For this, and for dst formats other than PIXEL_R8G8B8A8, linear values
+ *     are kept in floating point and en-gamma-ed at 16 bit precision rather
+ *     than through 8 bit intermediates. dst.buf_ may be src.buf_ only when
+ *     dst.fmt_ is 4 bytes per pixel as well.
+ */
+bool TransformColorSpace(IMAGE_FORMAT &dst, IMAGE_FORMAT& src,
+                         const mathfu::mat3* gamutNpm,
+                         const mathfu::mat3* gamutNpmInv);
+
+/*
+ * Bytes per pixel of fmt
+ */
+uint32_t GetPixelSize(PIXEL_FORMAT fmt);
+
 /*
  * GetTransformNPM
  */
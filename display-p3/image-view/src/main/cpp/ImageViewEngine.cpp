@@ -17,6 +17,9 @@
 #include <memory>
 #include "ImageViewEngine.h"
 
+// texture bytes uploaded per frame while textures are being created
+#define TEXTURE_UPLOAD_BUDGET (4 * 1024 * 1024)
+
 /*
  * Create Rendering Context
  */
@@ -75,6 +78,8 @@ void ImageViewEngine::DrawFrame(void) {
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT);
 
+  textureService_->Pump(TEXTURE_UPLOAD_BUDGET);
+
   glUseProgram(program_.getProgram());
 
   glVertexAttribPointer(program_.getAttribLocation(),
@@ -85,6 +90,11 @@ void ImageViewEngine::DrawFrame(void) {
                         2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, leftQuadVertices + 2);
   glEnableVertexAttribArray(program_.getAttribLocationTex());
   int32_t texIdx = textureIdx_;
+  if (!textures_[texIdx]->IsValid()) {
+    // still on its way: show it next frame, or the one after
+    eglSwapBuffers(display_, surface_);
+    return;
+  }
   if(renderModeBits_ & RENDERING_P3) {
     glActiveTexture(GL_TEXTURE0 + 0);
     glBindTexture(GL_TEXTURE_2D, textures_[texIdx]->P3TexId());
@@ -117,6 +127,9 @@ void ImageViewEngine::TerminateDisplay(void) {
   if(display_ == EGL_NO_DISPLAY)
     return;
 
+  // textures in flight need the context to be deleted
+  textureService_->Cancel();
+
   DestroyWideColorCtx();
 
   glDeleteProgram(program_.getProgram());
@@ -135,4 +148,16 @@ ImageViewEngine::ImageViewEngine(struct android_app* app) :
   eglContext_ = EGL_NO_CONTEXT;
   surface_ = EGL_NO_SURFACE;
   display_ = EGL_NO_DISPLAY;
+
+  std::string cacheDir;
+  if (app_->activity->internalDataPath) {
+    cacheDir = std::string(app_->activity->internalDataPath) + "/textures";
+  }
+  textureService_ = new TextureService(app_->activity->assetManager,
+                                       cacheDir);
+  ASSERT(textureService_, "OUT OF MEMORY");
+}
+
+ImageViewEngine::~ImageViewEngine() {
+  delete textureService_;
 }
@@ -36,10 +36,12 @@
 #include "gldebug.h"
 #include "ShaderProgram.h"
 #include "AssetTexture.h"
+#include "TextureService.h"
 
 class ImageViewEngine {
 public:
   ImageViewEngine(struct android_app* app);
+  ~ImageViewEngine();
 
   bool InitializeDisplay(void);
   void TerminateDisplay(void);
@@ -73,6 +75,8 @@ private:
   // Image file texture store
   std::vector<AssetTexture*> textures_;
   std::atomic<uint32_t>  textureIdx_;
+  // creates them off the GL thread, a budget of bytes per frame
+  TextureService* textureService_;
 
   enum WIDECOLOR_MODE {
     P3_R8G8B8A8_REV,
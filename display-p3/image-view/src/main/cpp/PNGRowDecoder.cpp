@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "android_debug.h"
+#include "PNGRowDecoder.h"
+
+// PNG color types, https://www.w3.org/TR/PNG/#6Colour-values
+#define PNG_GREY        0
+#define PNG_RGB         2
+#define PNG_PALETTE     3
+#define PNG_GREY_ALPHA  4
+#define PNG_RGBA        6
+
+// filter types, https://www.w3.org/TR/PNG/#9Filter-types
+#define PNG_FILTER_NONE  0
+#define PNG_FILTER_SUB   1
+#define PNG_FILTER_UP    2
+#define PNG_FILTER_AVG   3
+#define PNG_FILTER_PAETH 4
+
+static uint32_t ChannelCount(uint32_t colorType) {
+  switch (colorType) {
+    case PNG_GREY:
+    case PNG_PALETTE:
+      return 1;
+    case PNG_GREY_ALPHA:
+      return 2;
+    case PNG_RGB:
+      return 3;
+    case PNG_RGBA:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+static bool IsValidBitDepth(uint32_t colorType, uint32_t bitDepth) {
+  switch (colorType) {
+    case PNG_GREY:
+      return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 ||
+             bitDepth == 8 || bitDepth == 16;
+    case PNG_PALETTE:
+      return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8;
+    default:
+      return bitDepth == 8 || bitDepth == 16;
+  }
+}
+
+static inline uint16_t ReadUint16(const uint8_t* data) {
+  return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+PNGRowDecoder::PNGRowDecoder(const PNGHeader& header) :
+    header_(header), valid_(false), nextChunk_(0), row_(0),
+    channels_(ChannelCount(header.ColorType())), bitDepth_(header.BitDepth()),
+    rowBytes_(0), pixelBytes_(0), hasKey_(false) {
+  memset(&zstream_, 0, sizeof(zstream_));
+  if (!header_.IsValid() || header_.IsInterlaced() || !channels_ ||
+      !IsValidBitDepth(header_.ColorType(), bitDepth_) ||
+      !header_.Width() || !header_.Height() || header_.ImageData().empty()) {
+    return;
+  }
+
+  uint64_t bits = static_cast<uint64_t>(header_.Width()) * channels_ * bitDepth_;
+  if (bits > 8ull * 0x7FFFFFFF) {
+    return;
+  }
+  rowBytes_ = static_cast<uint32_t>((bits + 7) / 8);
+  pixelBytes_ = std::max(1u, channels_ * bitDepth_ / 8);
+  prev_.assign(rowBytes_ + 1, 0);
+  cur_.assign(rowBytes_ + 1, 0);
+
+  // palette, with tRNS alpha; entries past PLTE are opaque black
+  const PNG_CHUNK_DATA& plte = header_.Palette();
+  const PNG_CHUNK_DATA& trns = header_.Transparency();
+  for (uint32_t idx = 0; idx < 256; idx++) {
+    palette_[idx][0] = palette_[idx][1] = palette_[idx][2] = 0;
+    palette_[idx][3] = 255;
+    if (idx * 3 + 2 < plte.length_) {
+      memcpy(palette_[idx], plte.data_ + idx * 3, 3);
+    }
+    if (header_.ColorType() == PNG_PALETTE && idx < trns.length_) {
+      palette_[idx][3] = trns.data_[idx];
+    }
+  }
+  if (header_.ColorType() == PNG_PALETTE && plte.length_ < 3) {
+    return;
+  }
+  if (header_.ColorType() == PNG_GREY && trns.length_ >= 2) {
+    hasKey_ = true;
+    key_[0] = ReadUint16(trns.data_);
+  } else if (header_.ColorType() == PNG_RGB && trns.length_ >= 6) {
+    hasKey_ = true;
+    for (int c = 0; c < 3; c++) {
+      key_[c] = ReadUint16(trns.data_ + c * 2);
+    }
+  }
+
+  if (inflateInit(&zstream_) != Z_OK) {
+    LOGE("====inflateInit() failed: %s", zstream_.msg ? zstream_.msg : "");
+    return;
+  }
+  valid_ = true;
+}
+
+PNGRowDecoder::~PNGRowDecoder() {
+  if (valid_) {
+    inflateEnd(&zstream_);
+  }
+}
+
+bool PNGRowDecoder::IsValid(void) const {
+  return valid_;
+}
+
+uint32_t PNGRowDecoder::Width(void) const {
+  return header_.Width();
+}
+
+uint32_t PNGRowDecoder::Height(void) const {
+  return header_.Height();
+}
+
+/*
+ * InflateRow()
+ *    Inflate the next filtered row into cur_, feeding the inflater the
+ *    IDAT chunks as it runs dry
+ */
+bool PNGRowDecoder::InflateRow(void) {
+  const std::vector<PNG_CHUNK_DATA>& chunks = header_.ImageData();
+  zstream_.next_out = cur_.data();
+  zstream_.avail_out = static_cast<uInt>(cur_.size());
+  while (zstream_.avail_out) {
+    if (!zstream_.avail_in) {
+      if (nextChunk_ >= chunks.size()) {
+        LOGE("====PNG image data ends at row %d", row_);
+        return false;
+      }
+      zstream_.next_in = const_cast<Bytef*>(chunks[nextChunk_].data_);
+      zstream_.avail_in = chunks[nextChunk_].length_;
+      nextChunk_++;
+      continue;
+    }
+    int status = inflate(&zstream_, Z_NO_FLUSH);
+    if (status == Z_STREAM_END) {
+      if (zstream_.avail_out) {
+        LOGE("====PNG image data ends at row %d", row_);
+        return false;
+      }
+      break;
+    }
+    if (status != Z_OK) {
+      LOGE("====inflate() failed(%d) at row %d", status, row_);
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * UnfilterRow()
+ *    Undo the row filter of cur_, in place, against the previous row
+ */
+void PNGRowDecoder::UnfilterRow(void) {
+  uint8_t* cur = cur_.data() + 1;
+  const uint8_t* prev = prev_.data() + 1;
+  const uint32_t bpp = pixelBytes_;
+  switch (cur_[0]) {
+    case PNG_FILTER_SUB:
+      for (uint32_t i = bpp; i < rowBytes_; i++) {
+        cur[i] += cur[i - bpp];
+      }
+      break;
+    case PNG_FILTER_UP:
+      for (uint32_t i = 0; i < rowBytes_; i++) {
+        cur[i] += prev[i];
+      }
+      break;
+    case PNG_FILTER_AVG:
+      for (uint32_t i = 0; i < rowBytes_; i++) {
+        uint32_t left = (i >= bpp) ? cur[i - bpp] : 0;
+        cur[i] += static_cast<uint8_t>((left + prev[i]) >> 1);
+      }
+      break;
+    case PNG_FILTER_PAETH:
+      for (uint32_t i = 0; i < rowBytes_; i++) {
+        int32_t a = (i >= bpp) ? cur[i - bpp] : 0;
+        int32_t b = prev[i];
+        int32_t c = (i >= bpp) ? prev[i - bpp] : 0;
+        int32_t p = a + b - c;
+        int32_t pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        int32_t pred = (pa <= pb && pa <= pc) ? a : ((pb <= pc) ? b : c);
+        cur[i] += static_cast<uint8_t>(pred);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * ExpandRow()
+ *    Unfiltered row in cur_ to R8G8B8A8
+ */
+void PNGRowDecoder::ExpandRow(uint8_t* dst) {
+  const uint8_t* src = cur_.data() + 1;
+  const uint32_t width = header_.Width();
+  const uint32_t step = bitDepth_ / 8;   // bytes per 8/16 bit sample
+
+  if (bitDepth_ < 8) {
+    // grey or palette indices, packed most significant bits first
+    const uint32_t mask = (1u << bitDepth_) - 1;
+    const uint32_t scale = 255 / mask;
+    for (uint32_t x = 0; x < width; x++, dst += 4) {
+      uint32_t bit = x * bitDepth_;
+      uint32_t v = (src[bit >> 3] >> (8 - bitDepth_ - (bit & 7))) & mask;
+      if (header_.ColorType() == PNG_PALETTE) {
+        memcpy(dst, palette_[v], 4);
+      } else {
+        dst[0] = dst[1] = dst[2] = static_cast<uint8_t>(v * scale);
+        dst[3] = (hasKey_ && v == key_[0]) ? 0 : 255;
+      }
+    }
+    return;
+  }
+
+  for (uint32_t x = 0; x < width; x++, dst += 4, src += channels_ * step) {
+    switch (header_.ColorType()) {
+      case PNG_GREY:
+        dst[0] = dst[1] = dst[2] = src[0];
+        dst[3] = (hasKey_ && (step == 2 ? ReadUint16(src) : src[0]) ==
+                             key_[0]) ? 0 : 255;
+        break;
+      case PNG_PALETTE:
+        memcpy(dst, palette_[src[0]], 4);
+        break;
+      case PNG_GREY_ALPHA:
+        dst[0] = dst[1] = dst[2] = src[0];
+        dst[3] = src[step];
+        break;
+      case PNG_RGB:
+        dst[0] = src[0];
+        dst[1] = src[step];
+        dst[2] = src[2 * step];
+        dst[3] = 255;
+        if (hasKey_) {
+          bool keyed = (step == 2) ?
+              (ReadUint16(src) == key_[0] && ReadUint16(src + 2) == key_[1] &&
+               ReadUint16(src + 4) == key_[2]) :
+              (src[0] == key_[0] && src[1] == key_[1] && src[2] == key_[2]);
+          dst[3] = keyed ? 0 : 255;
+        }
+        break;
+      case PNG_RGBA:
+        dst[0] = src[0];
+        dst[1] = src[step];
+        dst[2] = src[2 * step];
+        dst[3] = src[3 * step];
+        break;
+    }
+  }
+}
+
+bool PNGRowDecoder::ReadRows(uint8_t* dst, uint32_t count) {
+  if (!valid_ || count > header_.Height() - row_) {
+    return false;
+  }
+  for (uint32_t r = 0; r < count; r++) {
+    if (!InflateRow()) {
+      return false;
+    }
+    if (cur_[0] > PNG_FILTER_PAETH) {
+      LOGE("====Unknown PNG filter(%d) at row %d", cur_[0], row_);
+      return false;
+    }
+    UnfilterRow();
+    ExpandRow(dst);
+    dst += static_cast<size_t>(header_.Width()) * 4;
+    cur_.swap(prev_);
+    row_++;
+  }
+  return true;
+}
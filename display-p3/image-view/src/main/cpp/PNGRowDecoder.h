@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __PNG_ROW_DECODER_H__
+#define __PNG_ROW_DECODER_H__
+
+#include <cstdint>
+#include <vector>
+#include <zlib.h>
+#include "simple_png.h"
+
+/*
+ * PNGRowDecoder:
+ *     Decodes a PNG top to bottom, a few rows at a time, into R8G8B8A8:
+ *     the IDAT chunks PNGHeader found are inflated incrementally and each
+ *     row is unfiltered against the previous one, so only two rows of the
+ *     image are held at any time. 16 bit samples keep their high byte, low
+ *     bit depths are scaled to 8 bits and tRNS becomes alpha, as stb_image
+ *     does. Interlaced images are not supported.
+ */
+class PNGRowDecoder {
+public:
+  explicit PNGRowDecoder(const PNGHeader& header);
+  ~PNGRowDecoder();
+
+  // false if the image cannot be decoded row by row
+  bool IsValid(void) const;
+  uint32_t Width(void) const;
+  uint32_t Height(void) const;
+
+  /*
+   * Decode the next count rows into dst, width * 4 bytes per row
+   * return false on corrupt data, or when past the last row
+   */
+  bool ReadRows(uint8_t* dst, uint32_t count);
+
+private:
+  bool InflateRow(void);
+  void UnfilterRow(void);
+  void ExpandRow(uint8_t* dst);
+
+  const PNGHeader& header_;
+  z_stream zstream_;
+  bool valid_;
+  size_t nextChunk_;     // next IDAT to feed the inflater
+  uint32_t row_;         // rows decoded so far
+
+  uint32_t channels_;
+  uint32_t bitDepth_;
+  uint32_t rowBytes_;    // filtered row, without the filter type byte
+  uint32_t pixelBytes_;  // distance between bytes the filters combine
+  std::vector<uint8_t> prev_, cur_;  // filter type byte + row
+
+  uint8_t palette_[256][4];
+  bool hasKey_;          // tRNS colour key for grey / RGB images
+  uint16_t key_[3];
+};
+
+#endif  // __PNG_ROW_DECODER_H__
@@ -0,0 +1,803 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <cstring>
+#include "simple_png.h"
+#include "PNGRowDecoder.h"
+#include "android_debug.h"
+#include "TextureService.h"
+
+/*
+ * Cache file: CACHE_HEADER, then the pixels of each texture from
+ * offset_[], page aligned; both offsets are the same when the textures
+ * share their pixels
+ */
+#define CACHE_MAGIC 0x43543350  // "P3TC"
+#define CACHE_VERSION 1
+#define CACHE_ALIGN 4096
+// larger than any GLES texture: a cache header beyond it is corrupt
+#define CACHE_MAX_SIZE 32768
+// pixels decoded, transformed and uploaded per band
+#define STREAM_BAND_PIXELS (128 * 1024)
+// bands in the ring when there is no cache file to transform them into
+#define STREAM_BAND_COUNT 3
+
+struct CACHE_HEADER {
+  uint32_t magic_;
+  uint32_t version_;
+  uint32_t assetLength_;  // the PNG the pixels came from
+  uint32_t assetSum_;     // ... and its adler32
+  uint32_t space_;
+  uint32_t fmt_;
+  float gamma_[2];        // image, display
+  uint32_t width_, height_;
+  uint32_t pixelFmt_[2];
+  uint32_t offset_[2];
+};
+
+static size_t CacheAlign(size_t size) {
+  return (size + CACHE_ALIGN - 1) & ~static_cast<size_t>(CACHE_ALIGN - 1);
+}
+
+/*
+ * TextureFormats()
+ *     Pixel formats of the P3 and the sRGB texture:
+ *       P3 display:   P3 as decoded; clipped to sRGB, in display precision
+ *       sRGB display: P3 --> sRGB, the same pixels for both textures
+ *     return true when the textures share their pixels
+ */
+static bool TextureFormats(DISPLAY_COLORSPACE space, DISPLAY_FORMAT fmt,
+                           PIXEL_FORMAT pixelFmt[2]) {
+  pixelFmt[0] = PIXEL_R8G8B8A8;
+  if (space == DISPLAY_COLORSPACE::P3) {
+    pixelFmt[1] = GetPixelFormat(fmt);
+    return false;
+  }
+  pixelFmt[1] = PIXEL_R8G8B8A8;
+  return true;
+}
+
+/*
+ * TransformRows()
+ *     Turn rows of decoded pixels into those of texture i; the P3 texture
+ *     of a P3 display is the decoded pixels, so dst may be rgba itself
+ */
+static bool TransformRows(DISPLAY_COLORSPACE space, DISPLAY_FORMAT fmt, int i,
+                          uint8_t* rgba, uint32_t width, uint32_t rows,
+                          void* dst) {
+  IMAGE_FORMAT src {
+      .buf_ = rgba,
+      .width_ = width,
+      .height_ = rows,
+      .gamma_ = DEFAULT_P3_IMAGE_GAMMA,
+      .npm_ = GetTransformNPM(NPM_TYPE::P3_D65),
+      .fmt_ = PIXEL_R8G8B8A8,
+  };
+  IMAGE_FORMAT out = src;
+  out.buf_ = dst;
+  out.gamma_ = DEFAULT_DISPLAY_GAMMA;
+  if (space == DISPLAY_COLORSPACE::P3) {
+    if (i == 0) {
+      if (dst != rgba) {
+        memcpy(dst, rgba, static_cast<size_t>(width) * rows * 4);
+      }
+      return true;
+    }
+    out.fmt_ = GetPixelFormat(fmt);
+    out.npm_ = GetTransformNPM(NPM_TYPE::P3_D65_INV);
+    return TransformColorSpace(out, src, GetTransformNPM(NPM_TYPE::SRGB_D65),
+                               GetTransformNPM(NPM_TYPE::SRGB_D65_INV));
+  }
+  out.npm_ = GetTransformNPM(NPM_TYPE::SRGB_D65_INV);
+  return TransformColorSpace(out, src);
+}
+
+/*
+ * CacheHeader()
+ *     Header and plane sizes of the cache file for an image of width x
+ *     height; sizes[1] is 0 when the textures share their pixels
+ *     return false if the image is too large to be cached
+ */
+static bool CacheHeader(CACHE_HEADER* header, size_t sizes[2],
+                        uint32_t assetLength, uint32_t assetSum,
+                        DISPLAY_COLORSPACE space, DISPLAY_FORMAT fmt,
+                        uint32_t width, uint32_t height) {
+  if (!width || width > CACHE_MAX_SIZE || !height ||
+      height > CACHE_MAX_SIZE) {
+    return false;
+  }
+  memset(header, 0, sizeof(*header));
+  header->magic_ = CACHE_MAGIC;
+  header->version_ = CACHE_VERSION;
+  header->assetLength_ = assetLength;
+  header->assetSum_ = assetSum;
+  header->space_ = space;
+  header->fmt_ = fmt;
+  header->gamma_[0] = DEFAULT_P3_IMAGE_GAMMA;
+  header->gamma_[1] = DEFAULT_DISPLAY_GAMMA;
+  header->width_ = width;
+  header->height_ = height;
+
+  PIXEL_FORMAT pixelFmt[2];
+  bool shared = TextureFormats(space, fmt, pixelFmt);
+  uint64_t offset = CacheAlign(sizeof(*header));
+  for (int i = 0; i < 2; i++) {
+    header->pixelFmt_[i] = pixelFmt[i];
+    if (i && shared) {
+      header->offset_[1] = header->offset_[0];
+      sizes[1] = 0;
+      break;
+    }
+    header->offset_[i] = static_cast<uint32_t>(offset);
+    uint64_t size = static_cast<uint64_t>(width) * height *
+                    GetPixelSize(pixelFmt[i]);
+    sizes[i] = static_cast<size_t>(size);
+    offset = CacheAlign(offset + size);
+  }
+  // offsets are 32 bits, and so is off_t on 32-bit ABIs
+  return offset <= INT32_MAX;
+}
+
+/*
+ * pwrite() all of data at offset, through short writes and signals
+ */
+static bool WriteAll(int fd, const void* data, size_t length, off_t offset) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  size_t done = 0;
+  while (done < length) {
+    ssize_t n = pwrite(fd, bytes + done, length - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+/*
+ * Cache files are written next to their path and renamed into place once
+ * complete: a cache file is whole, or absent
+ */
+static int CreateCacheFile(const std::string& path) {
+  std::string tmpPath = path + ".tmp";
+  int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0600);
+  if (fd < 0) {
+    LOGW("====Cannot create %s: %s", tmpPath.c_str(), strerror(errno));
+  }
+  return fd;
+}
+
+// ok false: the file is incomplete and goes away
+static bool CommitCacheFile(const std::string& path, int fd, bool ok) {
+  std::string tmpPath = path + ".tmp";
+  if (close(fd) || !ok || rename(tmpPath.c_str(), path.c_str())) {
+    if (ok) {
+      LOGW("====Cannot write %s: %s", path.c_str(), strerror(errno));
+    }
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+TextureService::TextureService(AAssetManager* mgr,
+                               const std::string& cacheDir) :
+  mgr_(mgr), cacheDir_(cacheDir), busy_(false), quit_(false),
+  generation_(0) {
+  ASSERT(mgr_, "Asset Manager is not valid");
+  if (!cacheDir_.empty() && mkdir(cacheDir_.c_str(), 0700) &&
+      errno != EEXIST) {
+    LOGW("====Cannot create %s, textures are not cached", cacheDir_.c_str());
+    cacheDir_.clear();
+  }
+  upload_.pixels_ = nullptr;
+  memset(upload_.pbos_, 0, sizeof(upload_.pbos_));
+  upload_.pboIdx_ = 0;
+  worker_ = std::thread(&TextureService::ThreadMain, this);
+}
+
+TextureService::~TextureService() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    quit_ = true;
+  }
+  jobReady_.notify_all();
+  bandFree_.notify_all();
+  worker_.join();
+  for (auto pixels : ready_) {
+    Release(pixels);
+  }
+  // its textures and buffers went with the context
+  if (upload_.pixels_) {
+    Release(upload_.pixels_);
+  }
+}
+
+void TextureService::Request(AssetTexture* tex) {
+  ASSERT(tex->ColorSpace() != DISPLAY_COLORSPACE::INVALID,
+         "eglContext_ color space not set");
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    jobs_.push_back({tex, tex->Name(), tex->ColorSpace(),
+                     tex->DisplayFormat(), generation_});
+  }
+  jobReady_.notify_one();
+}
+
+void TextureService::Cancel(void) {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    generation_++;
+    jobs_.clear();
+    for (auto pixels : ready_) {
+      Drop(pixels);
+    }
+    ready_.clear();
+    if (upload_.pixels_) {
+      Drop(upload_.pixels_);
+    }
+  }
+  // a worker waiting for a band to come back gives up on it
+  bandFree_.notify_all();
+  if (upload_.pixels_) {
+    glDeleteTextures(2, upload_.ids_);
+    upload_.pixels_ = nullptr;
+  }
+  if (upload_.pbos_[0][0]) {
+    glDeleteBuffers(2 * STREAM_PBO_COUNT, &upload_.pbos_[0][0]);
+    memset(upload_.pbos_, 0, sizeof(upload_.pbos_));
+  }
+}
+
+void TextureService::ThreadMain(void) {
+  std::unique_lock<std::mutex> guard(lock_);
+  for (;;) {
+    jobReady_.wait(guard, [this] { return quit_ || !jobs_.empty(); });
+    if (quit_) return;
+
+    JOB job = jobs_.front();
+    jobs_.pop_front();
+    busy_ = true;
+    guard.unlock();
+
+    Prepare(job);
+
+    guard.lock();
+    busy_ = false;
+  }
+}
+
+/*
+ * Prepare()
+ *     Worker thread: pixels for both textures of job, from the cache when
+ *     it has them for this very PNG; otherwise the PNG is streamed, into a
+ *     new cache file when there can be one. Failures are handed over too,
+ *     for the GL thread to report.
+ */
+void TextureService::Prepare(const JOB& job) {
+  TEXTURE_PIXELS* pixels = new TEXTURE_PIXELS;
+  ASSERT(pixels, "OUT OF MEMORY");
+  pixels->job_ = job;
+  pixels->width_ = pixels->height_ = 0;
+  pixels->map_ = nullptr;
+  pixels->mapLength_ = 0;
+  pixels->rows_ = pixels->uploaded_ = 0;
+  pixels->done_ = pixels->ok_ = pixels->dropped_ = false;
+
+  AAsset* asset = AAssetManager_open(mgr_, job.name_.c_str(),
+                                     AASSET_MODE_BUFFER);
+  if (!asset) {
+    LOGE("====Cannot open %s", job.name_.c_str());
+    Fail(pixels);
+    return;
+  }
+  const uint8_t* file = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+  size_t length = static_cast<size_t>(AAsset_getLength64(asset));
+  if (!file) {
+    LOGE("====Cannot read %s", job.name_.c_str());
+    AAsset_close(asset);
+    Fail(pixels);
+    return;
+  }
+  uint32_t sum = adler32(adler32(0, Z_NULL, 0), file,
+                         static_cast<uInt>(length));
+
+  std::string path = CachePath(job);
+  if (!path.empty() && LoadCache(path, length, sum, pixels)) {
+    // complete before anyone else sees it
+    pixels->rows_ = pixels->height_;
+    pixels->done_ = pixels->ok_ = true;
+    if (!Publish(pixels)) {
+      Release(pixels);
+    }
+  } else {
+    Stream(path, file, length, sum, pixels);
+  }
+  AAsset_close(asset);
+}
+
+/*
+ * Stream()
+ *     Decode the PNG a band of rows at a time and transform each band
+ *     into both textures' pixels, handing the rows to the GL thread as they
+ *     are done. The bands go straight into a new cache file at path when
+ *     it can be mapped, or else through the ring of bands. PNGs
+ *     PNGRowDecoder does not take are decoded whole first, and banded from
+ *     there: never more than that image and the bands in memory.
+ */
+void TextureService::Stream(const std::string& path, const uint8_t* file,
+                            size_t length, uint32_t assetSum,
+                            TEXTURE_PIXELS* pixels) {
+  const JOB& job = pixels->job_;
+  std::string name = job.name_;
+  PNGHeader png(name, const_cast<uint8_t*>(file), length);
+  PNGRowDecoder decoder(png);
+  uint8_t* image = nullptr;
+  if (decoder.IsValid()) {
+    pixels->width_ = decoder.Width();
+    pixels->height_ = decoder.Height();
+  } else {
+    int width, height, n;
+    image = stbi_load_from_memory(file, static_cast<int>(length), &width,
+                                  &height, &n, 4);
+    if (!image) {
+      LOGE("====Cannot decode %s", name.c_str());
+      Fail(pixels);
+      return;
+    }
+    pixels->width_ = width;
+    pixels->height_ = height;
+  }
+  pixels->shared_ = TextureFormats(job.space_, job.fmt_, pixels->fmt_);
+  Layout(pixels);
+  uint32_t width = pixels->width_, height = pixels->height_;
+  uint32_t bandRows = pixels->bandRows_;
+
+  int fd = path.empty() ? -1 : MapCache(path, length, assetSum, pixels);
+  if (fd < 0) {
+    pixels->bands_.resize(STREAM_BAND_COUNT * bandRows *
+                          (pixels->pitch_[0] +
+                           (pixels->shared_ ? 0 : pixels->pitch_[1])));
+  }
+
+  // texture 0 is decoded in place and transformed there; texture 1 is
+  // transformed out of it
+  bool ok = Publish(pixels);
+  for (uint32_t row = 0; ok && row < height; row += bandRows) {
+    uint32_t count = std::min(bandRows, height - row);
+    if (fd < 0 && !WaitForBand(pixels, row)) {
+      ok = false;
+      break;
+    }
+    uint8_t* rgba = Rows(pixels, 0, row);
+    if (image) {
+      memcpy(rgba, image + static_cast<size_t>(row) * width * 4,
+             static_cast<size_t>(count) * width * 4);
+    } else {
+      ok = decoder.ReadRows(rgba, count);
+    }
+    if (ok && !pixels->shared_) {
+      ok = TransformRows(job.space_, job.fmt_, 1, rgba, width, count,
+                         Rows(pixels, 1, row));
+    }
+    ok = ok && TransformRows(job.space_, job.fmt_, 0, rgba, width, count,
+                             rgba);
+    if (!ok) {
+      LOGE("====Cannot decode %s", name.c_str());
+      break;
+    }
+    ok = Progress(pixels, row + count);
+  }
+  if (image) {
+    stbi_image_free(image);
+  }
+  if (fd >= 0) {
+    CommitCacheFile(path, fd, ok);
+  }
+  Finish(pixels, ok);
+}
+
+/*
+ * CachePath()
+ *     <cacheDir>/<asset>-<space>-<format>-<image gamma>-<display gamma>.tex
+ */
+std::string TextureService::CachePath(const JOB& job) {
+  if (cacheDir_.empty()) {
+    return std::string();
+  }
+  std::string name = job.name_;
+  std::replace(name.begin(), name.end(), '/', '_');
+  char key[64];
+  snprintf(key, sizeof(key), "-%d-%d-%d-%d.tex", job.space_, job.fmt_,
+           static_cast<int>(DEFAULT_P3_IMAGE_GAMMA * 10000 + 0.5f),
+           static_cast<int>(DEFAULT_DISPLAY_GAMMA * 10000 + 0.5f));
+  return cacheDir_ + "/" + name + key;
+}
+
+/*
+ * LoadCache()
+ *     Map the cache file at path, if it holds pixels transformed from this
+ *     PNG for job; they are paged in ahead of the upload
+ */
+bool TextureService::LoadCache(const std::string& path, uint32_t assetLength,
+                               uint32_t assetSum, TEXTURE_PIXELS* pixels) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(CACHE_HEADER)) {
+    map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  size_t mapLength = static_cast<size_t>(st.st_size);
+
+  const JOB& job = pixels->job_;
+  const CACHE_HEADER* header = static_cast<const CACHE_HEADER*>(map);
+  bool ok = header->magic_ == CACHE_MAGIC &&
+            header->version_ == CACHE_VERSION &&
+            header->assetLength_ == assetLength &&
+            header->assetSum_ == assetSum &&
+            header->space_ == static_cast<uint32_t>(job.space_) &&
+            header->fmt_ == static_cast<uint32_t>(job.fmt_) &&
+            header->gamma_[0] == DEFAULT_P3_IMAGE_GAMMA &&
+            header->gamma_[1] == DEFAULT_DISPLAY_GAMMA &&
+            header->width_ && header->width_ <= CACHE_MAX_SIZE &&
+            header->height_ && header->height_ <= CACHE_MAX_SIZE;
+  for (int i = 0; ok && i < 2; i++) {
+    PIXEL_FORMAT fmt = static_cast<PIXEL_FORMAT>(header->pixelFmt_[i]);
+    ok = fmt <= PIXEL_RGBA16F &&
+         header->offset_[i] % CACHE_ALIGN == 0 &&
+         header->offset_[i] <= mapLength &&
+         static_cast<uint64_t>(header->width_) * header->height_ *
+             GetPixelSize(fmt) <= mapLength - header->offset_[i];
+    pixels->fmt_[i] = fmt;
+    // read only: nothing writes pixels mapped from a complete file
+    pixels->pixels_[i] = static_cast<uint8_t*>(map) + header->offset_[i];
+  }
+  if (!ok) {
+    LOGW("====Stale texture cache %s", path.c_str());
+    munmap(map, mapLength);
+    unlink(path.c_str());
+    return false;
+  }
+  pixels->width_ = header->width_;
+  pixels->height_ = header->height_;
+  pixels->shared_ = header->offset_[0] == header->offset_[1];
+  pixels->map_ = map;
+  pixels->mapLength_ = mapLength;
+  Layout(pixels);
+  madvise(map, mapLength, MADV_WILLNEED);
+  return true;
+}
+
+/*
+ * MapCache()
+ *     Create the cache file for pixels at path, its blocks allocated up
+ *     front, and map it for the bands to be transformed into
+ *     return the file descriptor, or -1 if it cannot be done
+ */
+int TextureService::MapCache(const std::string& path, uint32_t assetLength,
+                             uint32_t assetSum, TEXTURE_PIXELS* pixels) {
+  const JOB& job = pixels->job_;
+  CACHE_HEADER header;
+  size_t sizes[2];
+  if (!CacheHeader(&header, sizes, assetLength, assetSum, job.space_,
+                   job.fmt_, pixels->width_, pixels->height_)) {
+    return -1;
+  }
+  size_t mapLength = std::max(header.offset_[0] + sizes[0],
+                              header.offset_[1] + sizes[1]);
+  int fd = CreateCacheFile(path);
+  if (fd < 0) {
+    return -1;
+  }
+  // a full disk fails here, rather than as SIGBUS on a store to the map
+  int err = posix_fallocate(fd, 0, mapLength);
+  void* map = MAP_FAILED;
+  if (!err) {
+    map = mmap(nullptr, mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    err = errno;
+  }
+  if (map == MAP_FAILED) {
+    LOGW("====Cannot map %s: %s", path.c_str(), strerror(err));
+    CommitCacheFile(path, fd, false);
+    return -1;
+  }
+  memcpy(map, &header, sizeof(header));
+  for (int i = 0; i < 2; i++) {
+    pixels->pixels_[i] = static_cast<uint8_t*>(map) + header.offset_[i];
+  }
+  pixels->map_ = map;
+  pixels->mapLength_ = mapLength;
+  return fd;
+}
+
+/*
+ * Publish()
+ *     Worker thread: hand pixels over to the GL thread, before its rows are
+ *     ready; false if they were cancelled meanwhile
+ */
+bool TextureService::Publish(TEXTURE_PIXELS* pixels) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (quit_ || pixels->job_.generation_ != generation_) {
+    pixels->dropped_ = true;
+    return false;
+  }
+  ready_.push_back(pixels);
+  return true;
+}
+
+/*
+ * Fail()
+ *     Worker thread: hand pixels over as failed, for the GL thread to
+ *     report; nobody else has seen them yet
+ */
+void TextureService::Fail(TEXTURE_PIXELS* pixels) {
+  pixels->done_ = true;
+  pixels->ok_ = false;
+  if (!Publish(pixels)) {
+    Release(pixels);
+  }
+}
+
+/*
+ * WaitForBand()
+ *     Worker thread: wait until the ring slot of the band starting at row
+ *     has been uploaded out of
+ *     return false if the pixels are dropped meanwhile
+ */
+bool TextureService::WaitForBand(TEXTURE_PIXELS* pixels, uint32_t row) {
+  uint32_t behind = (STREAM_BAND_COUNT - 1) * pixels->bandRows_;
+  std::unique_lock<std::mutex> guard(lock_);
+  bandFree_.wait(guard, [this, pixels, row, behind] {
+    return quit_ || pixels->dropped_ || pixels->uploaded_ + behind >= row;
+  });
+  return !quit_ && !pixels->dropped_;
+}
+
+/*
+ * Progress()
+ *     Worker thread: the first rows rows are ready for upload
+ *     return false if nobody uploads them any more
+ */
+bool TextureService::Progress(TEXTURE_PIXELS* pixels, uint32_t rows) {
+  std::lock_guard<std::mutex> guard(lock_);
+  pixels->rows_ = rows;
+  return !quit_ && !pixels->dropped_;
+}
+
+/*
+ * Finish()
+ *     Worker thread: done with pixels; release them if they were dropped
+ */
+void TextureService::Finish(TEXTURE_PIXELS* pixels, bool ok) {
+  std::lock_guard<std::mutex> guard(lock_);
+  pixels->done_ = true;
+  pixels->ok_ = ok;
+  if (pixels->dropped_) {
+    Release(pixels);
+  }
+}
+
+/*
+ * Drop()
+ *     With lock_ held: the GL thread is done with pixels; release them,
+ *     or leave that to the worker if it is still writing them
+ */
+void TextureService::Drop(TEXTURE_PIXELS* pixels) {
+  if (pixels->done_) {
+    Release(pixels);
+  } else {
+    pixels->dropped_ = true;
+  }
+}
+
+/*
+ * Layout()
+ *     Row pitches and band height of pixels, once their size and formats
+ *     are known
+ */
+void TextureService::Layout(TEXTURE_PIXELS* pixels) {
+  for (int i = 0; i < 2; i++) {
+    pixels->pitch_[i] = static_cast<size_t>(pixels->width_) *
+                        GetPixelSize(pixels->fmt_[i]);
+  }
+  pixels->bandRows_ = std::max(1u, STREAM_BAND_PIXELS / pixels->width_);
+}
+
+/*
+ * Rows()
+ *     Where row of texture i is: in the whole image, or in its band's
+ *     ring slot, texture 0's rows followed by texture 1's
+ */
+uint8_t* TextureService::Rows(TEXTURE_PIXELS* pixels, int i, uint32_t row) {
+  if (pixels->map_) {
+    return pixels->pixels_[i] + row * pixels->pitch_[i];
+  }
+  size_t rows0 = pixels->bandRows_ * pixels->pitch_[0];
+  size_t slot = rows0 + (pixels->shared_ ? 0 : pixels->bandRows_ *
+                                                   pixels->pitch_[1]);
+  uint8_t* band = pixels->bands_.data() +
+                  (row / pixels->bandRows_) % STREAM_BAND_COUNT * slot;
+  if (i && !pixels->shared_) {
+    band += rows0;
+  }
+  return band + (row % pixels->bandRows_) * pixels->pitch_[i];
+}
+
+void TextureService::Release(TEXTURE_PIXELS* pixels) {
+  if (pixels->map_) {
+    munmap(pixels->map_, pixels->mapLength_);
+  }
+  delete pixels;
+}
+
+/*
+ * BeginUpload()
+ *     Take the next texture handed over and create its storage
+ *     return false when there is none
+ */
+bool TextureService::BeginUpload(void) {
+  TEXTURE_PIXELS* pixels = nullptr;
+  while (!pixels) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (ready_.empty()) {
+      return false;
+    }
+    pixels = ready_.front();
+    ready_.pop_front();
+    if (pixels->done_ && !pixels->ok_) {
+      LOGE("====Failed to create Texture for %s", pixels->job_.name_.c_str());
+      Release(pixels);
+      pixels = nullptr;
+    }
+  }
+
+  upload_.pixels_ = pixels;
+  upload_.row_ = 0;
+  if (!upload_.pbos_[0][0]) {
+    glGenBuffers(2 * STREAM_PBO_COUNT, &upload_.pbos_[0][0]);
+  }
+  glGenTextures(2, upload_.ids_);
+  for (int i = 0; i < 2; i++) {
+    GLenum internalFormat, type;
+    GetTextureFormat(pixels->fmt_[i], &internalFormat, &type);
+    glBindTexture(GL_TEXTURE_2D, upload_.ids_[i]);
+    glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, pixels->width_,
+                   pixels->height_);
+    SetTextureParameters();
+  }
+  return true;
+}
+
+/*
+ * UploadRows()
+ *     Copy the next rows of texture i into the next PBO of its ring and
+ *     update the texture from it; straight from the pixels if the PBO
+ *     cannot be mapped
+ */
+void TextureService::UploadRows(int i, uint32_t rows) {
+  TEXTURE_PIXELS* pixels = upload_.pixels_;
+  GLenum internalFormat, type;
+  GetTextureFormat(pixels->fmt_[i], &internalFormat, &type);
+  const uint8_t* src = Rows(pixels, i, upload_.row_);
+  GLsizeiptr size = static_cast<GLsizeiptr>(rows * pixels->pitch_[i]);
+
+  // orphan the buffer: a copy still reading it carries on undisturbed
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_.pbos_[i][upload_.pboIdx_]);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  void* band = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                GL_MAP_WRITE_BIT |
+                                GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (band) {
+    memcpy(band, src, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    src = nullptr;  // offset into the PBO
+  } else {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  glBindTexture(GL_TEXTURE_2D, upload_.ids_[i]);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, upload_.row_, pixels->width_, rows,
+                  GL_RGBA, type, src);
+}
+
+/*
+ * EndUpload()
+ *     The textures are complete: they now belong to the AssetTexture
+ */
+void TextureService::EndUpload(void) {
+  TEXTURE_PIXELS* pixels = upload_.pixels_;
+  pixels->job_.tex_->GLTextures(upload_.ids_[0], upload_.ids_[1]);
+  upload_.pixels_ = nullptr;
+  std::lock_guard<std::mutex> guard(lock_);
+  Drop(pixels);
+}
+
+bool TextureService::Pump(size_t byteBudget) {
+  size_t spent = 0;
+  while (spent < byteBudget) {
+    if (!upload_.pixels_ && !BeginUpload()) {
+      break;
+    }
+    TEXTURE_PIXELS* pixels = upload_.pixels_;
+    uint32_t ready;
+    bool failed;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      ready = pixels->rows_;
+      failed = pixels->done_ && !pixels->ok_;
+    }
+    if (failed) {
+      LOGE("====Failed to create Texture for %s", pixels->job_.name_.c_str());
+      glDeleteTextures(2, upload_.ids_);
+      upload_.pixels_ = nullptr;
+      std::lock_guard<std::mutex> guard(lock_);
+      Drop(pixels);
+      continue;
+    }
+    if (upload_.row_ == ready) {
+      break;  // the next band is not transformed yet
+    }
+
+    size_t rowBytes = pixels->pitch_[0] + pixels->pitch_[1];
+    // at least one row a frame, however small the budget; never past the
+    // band, which may be a ring slot of its own
+    uint32_t bandEnd = (upload_.row_ / pixels->bandRows_ + 1) *
+                       pixels->bandRows_;
+    uint32_t rows = static_cast<uint32_t>(std::min<size_t>(
+        std::max<size_t>(1, (byteBudget - spent) / rowBytes),
+        std::min(ready, bandEnd) - upload_.row_));
+    for (int i = 0; i < 2; i++) {
+      UploadRows(i, rows);
+    }
+    upload_.pboIdx_ = (upload_.pboIdx_ + 1) % STREAM_PBO_COUNT;
+    upload_.row_ += rows;
+    spent += rows * rowBytes;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      pixels->uploaded_ = upload_.row_;
+    }
+    bandFree_.notify_one();
+    if (upload_.row_ == pixels->height_) {
+      EndUpload();
+    }
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  std::lock_guard<std::mutex> guard(lock_);
+  return !upload_.pixels_ && ready_.empty() && jobs_.empty() && !busy_;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __TEXTURE_SERVICE_H__
+#define __TEXTURE_SERVICE_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <android/asset_manager.h>
+#include "common.h"
+#include "ColorSpaceTransform.h"
+#include "AssetTexture.h"
+
+// pixel unpack buffers per texture, used in turn for its bands
+#define STREAM_PBO_COUNT 2
+
+/*
+ * TextureService:
+ *     Creates AssetTexture textures without stalling the GL thread.
+ *     A worker thread reads, decodes and transforms each requested PNG for
+ *     the texture's color space and display format, a band of rows at a
+ *     time; Pump(), called once a frame on the GL thread, uploads the bands
+ *     ready so far through a ring of PBOs, a budget of bytes at a time, and
+ *     hands the finished textures to their AssetTexture. Decoding and
+ *     uploading overlap: a texture is handed over as soon as its size is
+ *     known, and its bands as they are transformed.
+ *     Transformed pixels are kept in cacheDir, one file per asset, color
+ *     space, display format and gamma, laid out so they are mapped and
+ *     uploaded as they are: later runs never decode those PNGs again. Bands
+ *     are transformed straight into the mapped cache file; without one they
+ *     go to a small ring of bands the GL thread hands back once uploaded.
+ *     Only PNGs PNGRowDecoder does not take are decoded whole first.
+ */
+class TextureService {
+public:
+  // an empty cacheDir disables the disk cache
+  TextureService(AAssetManager* mgr, const std::string& cacheDir);
+  ~TextureService();
+
+  /*
+   * Queue tex to be created for its current ColorSpace() and
+   * DisplayFormat(); tex must outlive the request, or Cancel() it
+   */
+  void Request(AssetTexture* tex);
+
+  /*
+   * Forget every request, prepared or half uploaded; call it on the GL
+   * thread before the textures or the context go away
+   */
+  void Cancel(void);
+
+  /*
+   * GL thread, once per frame: upload at most about byteBudget bytes
+   * return true when every request has been uploaded
+   */
+  bool Pump(size_t byteBudget);
+
+private:
+  struct JOB {
+    AssetTexture* tex_;
+    std::string name_;
+    DISPLAY_COLORSPACE space_;
+    DISPLAY_FORMAT fmt_;
+    uint32_t generation_;
+  };
+
+  /*
+   * Pixels of the P3 and the sRGB texture, both the same pixels when
+   * shared_. The whole images live in a mapped cache file, read or being
+   * written; otherwise bands_ is a ring of STREAM_BAND_COUNT bands.
+   * Handed to the GL thread while the worker still writes them: the fields
+   * after bands_ are guarded by lock_, and the worker and the GL thread
+   * hand rows over through rows_ and uploaded_.
+   */
+  struct TEXTURE_PIXELS {
+    JOB job_;
+    uint32_t width_, height_;
+    PIXEL_FORMAT fmt_[2];
+    size_t pitch_[2];
+    bool shared_;
+    uint32_t bandRows_;
+    uint8_t* pixels_[2];
+    void* map_;
+    size_t mapLength_;
+    std::vector<uint8_t> bands_;
+
+    uint32_t rows_;      // rows ready for upload
+    uint32_t uploaded_;  // rows uploaded, their bands free again
+    bool done_;          // the worker is done with it
+    bool ok_;
+    bool dropped_;       // nobody uploads it: the worker releases it
+  };
+
+  struct UPLOAD {
+    TEXTURE_PIXELS* pixels_;
+    GLuint ids_[2];
+    uint32_t row_;  // rows uploaded so far
+    GLuint pbos_[2][STREAM_PBO_COUNT];
+    int pboIdx_;
+  };
+
+  AAssetManager* mgr_;
+  std::string cacheDir_;
+
+  std::thread worker_;
+  std::mutex lock_;
+  std::condition_variable jobReady_;
+  std::condition_variable bandFree_;
+  std::deque<JOB> jobs_;
+  std::deque<TEXTURE_PIXELS*> ready_;
+  bool busy_;           // worker is preparing a job
+  bool quit_;
+  uint32_t generation_; // bumped by Cancel(): older jobs are dropped
+
+  // GL thread only
+  UPLOAD upload_;
+
+  void ThreadMain(void);
+  void Prepare(const JOB& job);
+  void Stream(const std::string& path, const uint8_t* file, size_t length,
+              uint32_t assetSum, TEXTURE_PIXELS* pixels);
+  std::string CachePath(const JOB& job);
+  bool LoadCache(const std::string& path, uint32_t assetLength,
+                 uint32_t assetSum, TEXTURE_PIXELS* pixels);
+  int MapCache(const std::string& path, uint32_t assetLength,
+               uint32_t assetSum, TEXTURE_PIXELS* pixels);
+  bool Publish(TEXTURE_PIXELS* pixels);
+  void Fail(TEXTURE_PIXELS* pixels);
+  bool WaitForBand(TEXTURE_PIXELS* pixels, uint32_t row);
+  bool Progress(TEXTURE_PIXELS* pixels, uint32_t rows);
+  void Finish(TEXTURE_PIXELS* pixels, bool ok);
+  void Drop(TEXTURE_PIXELS* pixels);
+  bool BeginUpload(void);
+  void UploadRows(int i, uint32_t rows);
+  void EndUpload(void);
+  static void Layout(TEXTURE_PIXELS* pixels);
+  static uint8_t* Rows(TEXTURE_PIXELS* pixels, int i, uint32_t row);
+  static void Release(TEXTURE_PIXELS* pixels);
+};
+
+#endif  // __TEXTURE_SERVICE_H__
@@ -15,6 +15,7 @@
  *
  */
 #include <cmath>
+#include <cstring>
 #include "common.h"
 #include "simple_png.h"
 
@@ -40,6 +41,9 @@ union littleEndianUint32 {
  */
 PNGHeader::PNGHeader(std::string& name, uint8_t *buf, uint64_t len) :
     name_(name), buf_( buf), length_(len), offset_(0),
+    width_(0), height_(0), bpp_(0), colorType_(0),
+    compressType_(0), filterType_(0), interlaceType_(0),
+    plte_{nullptr, 0}, trns_{nullptr, 0},
     hasChrm_(false), valid_(false) {
 
   ASSERT(buf_, "PNG header is not initialized");
@@ -60,6 +64,10 @@ PNGHeader::PNGHeader(std::string& name, uint8_t *buf, uint64_t len) :
   LOGV("=== Parsing File: %s", name_.c_str());
   while (offset_ < length_) {
     littleEndianUint32 len, type;
+    if (length_ - offset_ < 2 * sizeof(uint32_t)) {
+      LOGE("==== PNG file %s truncated", name_.c_str());
+      return;
+    }
 
     /*
      * Read the len word ( 4 bytes ), it is only for data field - no self, not for type
@@ -71,6 +79,13 @@ PNGHeader::PNGHeader(std::string& name, uint8_t *buf, uint64_t len) :
     READ_INT_SWAP(type, buf_, offset_);
     offset_ += 4;
 
+    // data and CRC must fit; in 64 bits, len + 4 wraps on 32-bit ABIs
+    if (static_cast<uint64_t>(len.value) + sizeof(uint32_t) >
+        length_ - offset_) {
+      LOGE("==== PNG file %s truncated", name_.c_str());
+      return;
+    }
+
     switch (type.value) {
       case PNG_CHUNCK('I', 'H', 'D', 'R'):
       {
@@ -127,11 +142,22 @@ PNGHeader::PNGHeader(std::string& name, uint8_t *buf, uint64_t len) :
         has_iCCP = true;
         offset_ += sizeof(uint32_t) + len.value;
         break;
+      case PNG_CHUNCK('I', 'D', 'A', 'T'):
+        idat_.push_back({&buf_[offset_], len.value});
+        offset_ += sizeof(uint32_t) + len.value;
+        break;
+      case PNG_CHUNCK('P', 'L', 'T', 'E'):
+        plte_ = {&buf_[offset_], len.value};
+        offset_ += sizeof(uint32_t) + len.value;
+        break;
+      case PNG_CHUNCK('t', 'R', 'N', 'S'):
+        trns_ = {&buf_[offset_], len.value};
+        offset_ += sizeof(uint32_t) + len.value;
+        break;
       default:
         LOGV("====Unprocessed CHUNK %c%c%c%c",
              type.bytes[3], type.bytes[2], type.bytes[1], type.bytes[0]);
         // on purpose: pass through
-      case PNG_CHUNCK('I', 'D', 'A', 'T'):
       case PNG_CHUNCK('i', 'T', 'X','t'):
       case PNG_CHUNCK('t', 'T', 'X', 't'):
       case PNG_CHUNCK('z', 'T', 'X', 't'):
@@ -20,11 +20,10 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 #include "android_debug.h"
 #include <mathfu/glsl_mappings.h>
 
-#pragma pack(push, 1 )
-
 struct CIE_POINT {
   float x, y;
 };
@@ -34,6 +33,14 @@ struct CIE_POINT {
 #define REF_GREEN_IDX 2
 #define REF_BLUE_IDX  3
 
+/*
+ * Data of one chunk, pointing into the file buffer
+ */
+struct PNG_CHUNK_DATA {
+  const uint8_t* data_;
+  uint32_t length_;
+};
+
 #define PNG_INTEGER_ENCODING_FACTOR 100000.0f
 /*
  * Default Gamma if image file does not have Gamma
@@ -52,6 +59,18 @@ public:
   bool  HasNPM(void) const;
   const mathfu::mat3* NPM(void);
 
+  bool IsValid(void) const { return valid_; }
+  uint32_t Width(void) const { return width_; }
+  uint32_t Height(void) const { return height_; }
+  uint32_t BitDepth(void) const { return bpp_; }
+  uint32_t ColorType(void) const { return colorType_; }
+  bool IsInterlaced(void) const { return interlaceType_ != 0; }
+  // IDAT chunks in file order: together, the zlib stream of the image
+  const std::vector<PNG_CHUNK_DATA>& ImageData(void) const { return idat_; }
+  // PLTE and tRNS; length_ is 0 when absent
+  const PNG_CHUNK_DATA& Palette(void) const { return plte_; }
+  const PNG_CHUNK_DATA& Transparency(void) const { return trns_; }
+
 private:
   void UpdateNPM(void);
 
@@ -64,14 +83,14 @@ private:
   // header info:
   uint32_t width_, height_, bpp_, colorType_;
   uint32_t compressType_, filterType_, interlaceType_;
+  std::vector<PNG_CHUNK_DATA> idat_;
+  PNG_CHUNK_DATA plte_, trns_;
   CIE_POINT  chrm_[4];
   bool hasChrm_;
   mathfu::mat3 NPM_;
   bool  valid_;
 };
 
-#pragma pack(pop)
-
 #endif //  __SIMPLE_PNG_H__
 
 
@@ -52,6 +52,9 @@
 // maximum delta T between two frames
 #define MAX_DELTA_T 0.05f
 
+// how often the play scene logs its frame statistics, in nanoseconds
+#define FRAME_STATS_PERIOD_NS 5000000000LL
+
 // player's speed
 #define PLAYER_SPEED 80.0f
 
@@ -110,7 +110,7 @@ PlayScene::PlayScene() : Scene() {
     mBonusInARow = 0;
     mLastCrashSection = -1;
 
-    mFrameClock.SetMaxDelta(MAX_DELTA_T);
+    frame_stats_init(&mFrameStats, FRAME_STATS_60HZ_NS, FRAME_STATS_PERIOD_NS);
     mLastAmbientBeepEmitted = 0;
     mMenuTouchActive = false;
 
@@ -261,7 +261,7 @@ void PlayScene::OnStartGraphics() {
             _gen_wall_texture());
 
     // reset frame clock so the animation doesn't jump
-    mFrameClock.Reset();
+    frame_stats_reset_clock(&mFrameStats);
 
     // life icon geometry
     mLifeGeom = AsciiArtToGeom(ART_LIFE, LIFE_ICON_SCALE);
@@ -283,7 +283,7 @@ void PlayScene::OnKillGraphics() {
 }
 
 void PlayScene::DoFrame() {
-    float deltaT = mFrameClock.ReadDelta();
+    float deltaT = Clamp(frame_stats_begin(&mFrameStats) * 1e-9f, 0.0f, MAX_DELTA_T);
     float previousY = mPlayerPos.y;
 
     // clear screen
@@ -306,6 +306,7 @@ void PlayScene::DoFrame() {
     if (mMenu) {
         RenderMenu();
         // nothing more to do
+        EndFrameStats();
         return;
     }
 
@@ -404,6 +405,18 @@ void PlayScene::DoFrame() {
         mLastAmbientBeepEmitted = soundPoint;
         SfxMan::GetInstance()->PlayTone(soundPoint % 2 ? TONE_AMBIENT_0 : TONE_AMBIENT_1);
     }
+
+    EndFrameStats();
+}
+
+void PlayScene::EndFrameStats() {
+    if (frame_stats_end(&mFrameStats)) {
+        FrameStatsSnapshot snapshot;
+        char json[512];
+        frame_stats_snapshot(&mFrameStats, &snapshot);
+        frame_stats_json(&snapshot, json, sizeof(json));
+        LOGD("Frame stats: %s", json);
+    }
 }
 
 static float GetSectionCenterY(int i) {
@@ -753,7 +766,7 @@ void PlayScene::DetectCollisions(float previousY) {
 bool PlayScene::OnBackKeyPressed() {
     if (mMenu) {
         // reset frame clock so that the animation doesn't jump:
-        mFrameClock.Reset();
+        frame_stats_reset_clock(&mFrameStats);
 
         // leave menu
         ShowMenu(MENU_NONE);
@@ -816,7 +829,7 @@ void PlayScene::ShowMenu(int menu) {
         default:
             // since we're leaving the menu, reset the frame clock to avoid a skip
             // in the animation
-            mFrameClock.Reset();
+            frame_stats_reset_clock(&mFrameStats);
     }
 }
 
@@ -17,6 +17,7 @@
 #define endlesstunnel_play_scene_h
 
 #include "engine.hpp"
+#include "frame_stats.h"
 #include "obstacle_generator.hpp"
 #include "obstacle.hpp"
 #include "sfxman.hpp"
@@ -44,6 +45,9 @@ class PlayScene : public Scene {
         virtual void OnPause();
 
     protected:
+        // ends the frame's timing, logging the statistics once per period
+        void EndFrameStats();
+
         // shaders
         OurShader *mOurShader;
         TrivialShader *mTrivialShader;
@@ -115,9 +119,9 @@ class PlayScene : public Scene {
         static const int NOISE_FILTER_SAMPLES = 5;
         float mFilteredSteerX, mFilteredSteerZ;
 
-        // frame clock -- it computes the deltas between successive frames so we can
-        // update stuff properly
-        DeltaClock mFrameClock;
+        // frame statistics -- they give the deltas between successive frames so we can
+        // update stuff properly, and track frame time percentiles and jank
+        FrameStats mFrameStats;
 
         // sign (string) that we're currently showing (NULL if none)
         const char *mSignText;
@@ -16,6 +16,7 @@
 #include <cstdlib>
 #include <ctime>
 
+#include "frame_stats.h"
 #include "util.hpp"
 
 int Random(int uboundExclusive) {
@@ -30,19 +31,8 @@ int Random(int lbound, int uboundExclusive) {
 }
 
 float Clock() {
-    static struct timespec _base;
-    static bool firstCall = true;
-
-    if (firstCall) {
-        clock_gettime(CLOCK_MONOTONIC, &_base);
-        firstCall = false;
-    }
-
-    struct timespec t;
-    clock_gettime(CLOCK_MONOTONIC, &t);
-    float secDiff = (float)(t.tv_sec - _base.tv_sec);
-    float msecDiff = (float)((t.tv_nsec - _base.tv_nsec) / 1000000);
-    return secDiff + 0.001f * msecDiff;
+    static int64_t _base = frame_stats_now_ns();
+    return (float)((frame_stats_now_ns() - _base) * 1e-9);
 }
 
 
@@ -72,34 +72,5 @@ float Clock();
 float SineWave(float min, float max, float period, float phase);
 bool BlinkFunc(float period);
 
-/* A simple chronometer that computes elapsed time. */
-class DeltaClock {
-    private:
-        float mLastTick;
-        float mMaxDelta;
-        bool mHasMax;
-    public:
-        DeltaClock() {
-            mLastTick = Clock();
-            mHasMax = false;
-        }
-        DeltaClock(float maxDelta) {
-            mLastTick = Clock();
-            mMaxDelta = maxDelta;
-            mHasMax = true;
-        }
-        float ReadDelta() {
-            float d = Clamp(Clock() - mLastTick, 0.0f, mMaxDelta);
-            mLastTick = Clock();
-            return d;
-        }
-        void SetMaxDelta(float m) {
-            mMaxDelta = m;
-        }
-        void Reset() {
-            mLastTick = Clock();
-        }
-};
-
 #endif
 
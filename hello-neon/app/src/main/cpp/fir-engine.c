@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __ANDROID__
+#include <cpu-features.h>
+#endif
+
+#include "fir-engine.h"
+#include "fir-kernels.h"
+
+/* this is a FIR filter implemented in C */
+void
+fir_filter_c(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    int  offset = -kernelSize/2;
+    int  nn;
+    for (nn = 0; nn < width; nn++) {
+        int sum = 0;
+        int mm;
+        for (mm = 0; mm < kernelSize; mm++) {
+            sum += kernel[mm]*input[nn+offset+mm];
+        }
+        output[nn] = (short)((sum + 0x8000) >> 16);
+    }
+}
+
+enum {
+    FIR_ISA_NEON = 1 << 0,
+    FIR_ISA_SSE2 = 1 << 1,
+    FIR_ISA_AVX2 = 1 << 2,
+};
+
+typedef struct {
+    fir_variant variant;
+    uint32_t    isa;      /* required FIR_ISA_* bits, 0 for plain C */
+} fir_entry;
+
+/* sorted from least to most preferred: the dispatcher picks the last usable one */
+static const fir_entry fir_table[] = {
+    { { "c",        fir_filter_c,        1  }, 0 },
+#ifdef HAVE_FIR_NEON
+    { { "neonx4",   fir_filter_neon_x4,  4  }, FIR_ISA_NEON },
+    { { "neonx8",   fir_filter_neon_x8,  8  }, FIR_ISA_NEON },
+    { { "neonx16",  fir_filter_neon_x16, 16 }, FIR_ISA_NEON },
+#endif
+#ifdef HAVE_FIR_SSE2
+    { { "sse2x4",   fir_filter_sse2_x4,  4  }, FIR_ISA_SSE2 },
+    { { "sse2x8",   fir_filter_sse2_x8,  8  }, FIR_ISA_SSE2 },
+    { { "sse2x16",  fir_filter_sse2_x16, 16 }, FIR_ISA_SSE2 },
+#endif
+#ifdef HAVE_FIR_AVX2
+    { { "avx2x16",  fir_filter_avx2_x16, 16 }, FIR_ISA_AVX2 },
+#endif
+};
+#define FIR_TABLE_SIZE  (sizeof(fir_table) / sizeof(fir_table[0]))
+
+static pthread_once_t     fir_once = PTHREAD_ONCE_INIT;
+static const fir_variant* fir_usable[FIR_TABLE_SIZE];
+static int                fir_usable_count;
+static const fir_variant* fir_selected = &fir_table[0].variant;
+
+static uint32_t
+fir_detect_isa(void)
+{
+    uint32_t isa = 0;
+#ifdef __ANDROID__
+    AndroidCpuFamily family = android_getCpuFamily();
+    uint64_t features = android_getCpuFeatures();
+
+    switch (family) {
+    case ANDROID_CPU_FAMILY_ARM:
+        if (features & ANDROID_CPU_ARM_FEATURE_NEON)
+            isa |= FIR_ISA_NEON;
+        break;
+    case ANDROID_CPU_FAMILY_ARM64:
+        isa |= FIR_ISA_NEON;
+        break;
+    case ANDROID_CPU_FAMILY_X86:
+    case ANDROID_CPU_FAMILY_X86_64:
+        /* both x86 ABIs require at least SSSE3 */
+        isa |= FIR_ISA_SSE2;
+        if (features & ANDROID_CPU_X86_FEATURE_AVX2)
+            isa |= FIR_ISA_AVX2;
+        break;
+    default:
+        break;
+    }
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        isa |= FIR_ISA_SSE2;
+    if (__builtin_cpu_supports("avx2"))
+        isa |= FIR_ISA_AVX2;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+    isa |= FIR_ISA_NEON;
+#endif
+    return isa;
+}
+
+static void
+fir_engine_select(void)
+{
+    uint32_t isa = fir_detect_isa();
+    size_t   ii;
+
+    for (ii = 0; ii < FIR_TABLE_SIZE; ii++) {
+        if ((fir_table[ii].isa & isa) != fir_table[ii].isa)
+            continue;
+        fir_usable[fir_usable_count++] = &fir_table[ii].variant;
+        fir_selected = &fir_table[ii].variant;
+    }
+}
+
+void
+fir_engine_init(void)
+{
+    pthread_once(&fir_once, fir_engine_select);
+}
+
+void
+fir_filter(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    fir_engine_init();
+    fir_selected->func(output, input, kernel, width, kernelSize);
+}
+
+const fir_variant*
+fir_engine_selected(void)
+{
+    fir_engine_init();
+    return fir_selected;
+}
+
+int
+fir_engine_variant_count(void)
+{
+    fir_engine_init();
+    return fir_usable_count;
+}
+
+const fir_variant*
+fir_engine_variant(int index)
+{
+    fir_engine_init();
+    if (index < 0 || index >= fir_usable_count)
+        return NULL;
+    return fir_usable[index];
+}
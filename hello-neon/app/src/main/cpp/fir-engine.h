@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef FIR_ENGINE_H
+#define FIR_ENGINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * FIR filter engine: a set of output-blocked kernels (4/8/16 output samples
+ * per iteration) for NEON, SSE2 and AVX2, plus a dispatcher that picks the
+ * fastest kernel the running CPU supports. The choice is made once, on the
+ * first call to fir_engine_init() or fir_filter().
+ *
+ * All kernels share the fir_filter_c() contract and are bit-exact with it:
+ *   output[n] = (short)((sum(kernel[m] * input[n - kernelSize/2 + m]) + 0x8000) >> 16)
+ * input must be readable from input[-kernelSize/2] up to
+ * input[width - 1 - kernelSize/2 + kernelSize - 1]; no alignment is required.
+ */
+typedef void (*fir_filter_func)(short *output, const short* input,
+                                const short* kernel, int width, int kernelSize);
+
+typedef struct {
+    const char*     name;        /* e.g. "avx2x16" */
+    fir_filter_func func;
+    int             block;       /* output samples per iteration */
+} fir_variant;
+
+/* the plain C reference every other variant is verified against */
+void fir_filter_c(short *output, const short* input, const short* kernel, int width, int kernelSize);
+
+/* select the best variant; safe to call more than once, from any thread */
+void fir_engine_init(void);
+
+/* run the selected variant */
+void fir_filter(short *output, const short* input, const short* kernel, int width, int kernelSize);
+
+/* variant fir_filter() dispatches to */
+const fir_variant* fir_engine_selected(void);
+
+/* variants usable on this CPU, index 0 is the C reference */
+int fir_engine_variant_count(void);
+const fir_variant* fir_engine_variant(int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIR_ENGINE_H */
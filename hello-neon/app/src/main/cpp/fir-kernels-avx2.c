@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <immintrin.h>
+#include "fir-engine.h"
+#include "fir-kernels.h"
+
+/*
+ * AVX2 kernel: the SSE2 tap-pair scheme on 256-bit registers. unpacklo/hi
+ * work per 128-bit lane, so the two accumulators hold outputs {0-3, 8-11}
+ * and {4-7, 12-15}; packs_epi32 is per lane too and puts them back in order.
+ */
+static inline __m256i
+tap_pair(short k0, short k1)
+{
+    return _mm256_set1_epi32((int)(((unsigned)(unsigned short)k1 << 16) |
+                                   (unsigned short)k0));
+}
+
+void
+fir_filter_avx2_x16(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    const __m256i half = _mm256_set1_epi32(0x8000);
+    int nn, offset = -kernelSize/2;
+
+    for (nn = 0; nn + 16 <= width; nn += 16) {
+        const short* in = input + nn + offset;
+        __m256i lo = _mm256_setzero_si256();
+        __m256i hi = _mm256_setzero_si256();
+        int mm;
+
+        for (mm = 0; mm + 1 < kernelSize; mm += 2) {
+            __m256i k  = tap_pair(kernel[mm], kernel[mm+1]);
+            __m256i x0 = _mm256_loadu_si256((const __m256i*)(in + mm));
+            __m256i x1 = _mm256_loadu_si256((const __m256i*)(in + mm + 1));
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(x0, x1), k));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(x0, x1), k));
+        }
+        if (kernelSize & 1) {
+            __m256i k  = tap_pair(kernel[mm], 0);
+            __m256i z  = _mm256_setzero_si256();
+            __m256i x0 = _mm256_loadu_si256((const __m256i*)(in + mm));
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(x0, z), k));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(x0, z), k));
+        }
+        lo = _mm256_srai_epi32(_mm256_add_epi32(lo, half), 16);
+        hi = _mm256_srai_epi32(_mm256_add_epi32(hi, half), 16);
+        _mm256_storeu_si256((__m256i*)(output + nn), _mm256_packs_epi32(lo, hi));
+    }
+    /* leave the AVX state clean before falling back to SSE2 / C code */
+    _mm256_zeroupper();
+
+#ifdef HAVE_FIR_SSE2
+    fir_filter_sse2_x8(output + nn, input + nn, kernel, width - nn, kernelSize);
+#else
+    fir_filter_c(output + nn, input + nn, kernel, width - nn, kernelSize);
+#endif
+}
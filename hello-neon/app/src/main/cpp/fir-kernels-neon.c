@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <arm_neon.h>
+#include "fir-engine.h"
+#include "fir-kernels.h"
+
+/*
+ * NEON kernels: every 32-bit lane accumulates one output sample, so each tap
+ * is a single vmlal_n_s16 per 4 outputs and no horizontal reduction is left
+ * at the end. Outputs are rounded with a plain add + shift + narrow rather
+ * than vrshrn, whose wider intermediate would not match the C wrap-around.
+ */
+static inline int16x4_t
+round_narrow(int32x4_t sum)
+{
+    return vmovn_s32(vshrq_n_s32(vaddq_s32(sum, vdupq_n_s32(0x8000)), 16));
+}
+
+/* outputs [nn, nn + 4 * quads), quads is a compile time constant */
+static inline void
+fir_block(short *output, const short* in, const short* kernel,
+          int kernelSize, int quads)
+{
+    int32x4_t acc[4];
+    int q, mm;
+
+    for (q = 0; q < quads; q++) {
+        acc[q] = vdupq_n_s32(0);
+    }
+    for (mm = 0; mm < kernelSize; mm++) {
+        const short k = kernel[mm];
+        for (q = 0; q + 1 < quads; q += 2) {
+            int16x8_t x = vld1q_s16(in + q*4 + mm);
+            acc[q]   = vmlal_n_s16(acc[q],   vget_low_s16(x),  k);
+            acc[q+1] = vmlal_n_s16(acc[q+1], vget_high_s16(x), k);
+        }
+        if (quads & 1) {
+            acc[q] = vmlal_n_s16(acc[q], vld1_s16(in + q*4 + mm), k);
+        }
+    }
+    for (q = 0; q < quads; q++) {
+        vst1_s16(output + q*4, round_narrow(acc[q]));
+    }
+}
+
+void
+fir_filter_neon_x4(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    int nn, offset = -kernelSize/2;
+
+    for (nn = 0; nn + 4 <= width; nn += 4) {
+        fir_block(output + nn, input + nn + offset, kernel, kernelSize, 1);
+    }
+    fir_filter_c(output + nn, input + nn, kernel, width - nn, kernelSize);
+}
+
+void
+fir_filter_neon_x8(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    int nn, offset = -kernelSize/2;
+
+    for (nn = 0; nn + 8 <= width; nn += 8) {
+        fir_block(output + nn, input + nn + offset, kernel, kernelSize, 2);
+    }
+    for (; nn + 4 <= width; nn += 4) {
+        fir_block(output + nn, input + nn + offset, kernel, kernelSize, 1);
+    }
+    fir_filter_c(output + nn, input + nn, kernel, width - nn, kernelSize);
+}
+
+void
+fir_filter_neon_x16(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    int nn, offset = -kernelSize/2;
+
+    for (nn = 0; nn + 16 <= width; nn += 16) {
+        fir_block(output + nn, input + nn + offset, kernel, kernelSize, 4);
+    }
+    for (; nn + 8 <= width; nn += 8) {
+        fir_block(output + nn, input + nn + offset, kernel, kernelSize, 2);
+    }
+    for (; nn + 4 <= width; nn += 4) {
+        fir_block(output + nn, input + nn + offset, kernel, kernelSize, 1);
+    }
+    fir_filter_c(output + nn, input + nn, kernel, width - nn, kernelSize);
+}
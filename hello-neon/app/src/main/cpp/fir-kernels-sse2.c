@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <emmintrin.h>
+#include "fir-engine.h"
+#include "fir-kernels.h"
+
+/*
+ * SSE2 kernels. Taps are consumed two at a time with pmaddwd: interleaving
+ * input[n+m] with input[n+m+1] lines up every output lane with the tap pair
+ * (kernel[m], kernel[m+1]), so one multiply-add covers two taps for four
+ * outputs. Everything is 32-bit wrap-around arithmetic, exactly as in C.
+ */
+
+/* (k0, k1) tap pair broadcast to all four 32-bit lanes */
+static inline __m128i
+tap_pair(short k0, short k1)
+{
+    return _mm_set1_epi32((int)(((unsigned)(unsigned short)k1 << 16) |
+                                (unsigned short)k0));
+}
+
+/* (sum + 0x8000) >> 16 for 2 x 4 sums, narrowed to 8 shorts */
+static inline __m128i
+round_pack(__m128i lo, __m128i hi)
+{
+    const __m128i half = _mm_set1_epi32(0x8000);
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, half), 16);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, half), 16);
+    /* every value is already in short range: packs never saturates */
+    return _mm_packs_epi32(lo, hi);
+}
+
+/* outputs [nn, nn + 8 * groups), groups is a compile time constant */
+static inline void
+fir_block8(short *output, const short* in, const short* kernel,
+           int kernelSize, int groups)
+{
+    __m128i acc[4];
+    int g, mm;
+
+    for (g = 0; g < groups; g++) {
+        acc[2*g] = acc[2*g+1] = _mm_setzero_si128();
+    }
+    for (mm = 0; mm + 1 < kernelSize; mm += 2) {
+        __m128i k = tap_pair(kernel[mm], kernel[mm+1]);
+        for (g = 0; g < groups; g++) {
+            __m128i x0 = _mm_loadu_si128((const __m128i*)(in + g*8 + mm));
+            __m128i x1 = _mm_loadu_si128((const __m128i*)(in + g*8 + mm + 1));
+            acc[2*g]   = _mm_add_epi32(acc[2*g],
+                                       _mm_madd_epi16(_mm_unpacklo_epi16(x0, x1), k));
+            acc[2*g+1] = _mm_add_epi32(acc[2*g+1],
+                                       _mm_madd_epi16(_mm_unpackhi_epi16(x0, x1), k));
+        }
+    }
+    if (kernelSize & 1) {
+        __m128i k = tap_pair(kernel[mm], 0);
+        __m128i z = _mm_setzero_si128();
+        for (g = 0; g < groups; g++) {
+            __m128i x0 = _mm_loadu_si128((const __m128i*)(in + g*8 + mm));
+            acc[2*g]   = _mm_add_epi32(acc[2*g],
+                                       _mm_madd_epi16(_mm_unpacklo_epi16(x0, z), k));
+            acc[2*g+1] = _mm_add_epi32(acc[2*g+1],
+                                       _mm_madd_epi16(_mm_unpackhi_epi16(x0, z), k));
+        }
+    }
+    for (g = 0; g < groups; g++) {
+        _mm_storeu_si128((__m128i*)(output + g*8), round_pack(acc[2*g], acc[2*g+1]));
+    }
+}
+
+/* outputs [nn, nn + 4) with 64-bit loads, so nothing past the C range is read */
+static inline void
+fir_block4(short *output, const short* in, const short* kernel, int kernelSize)
+{
+    __m128i acc = _mm_setzero_si128();
+    int mm;
+
+    for (mm = 0; mm + 1 < kernelSize; mm += 2) {
+        __m128i x0 = _mm_loadl_epi64((const __m128i*)(in + mm));
+        __m128i x1 = _mm_loadl_epi64((const __m128i*)(in + mm + 1));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(x0, x1),
+                                                tap_pair(kernel[mm], kernel[mm+1])));
+    }
+    if (kernelSize & 1) {
+        __m128i x0 = _mm_loadl_epi64((const __m128i*)(in + mm));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(x0, _mm_setzero_si128()),
+                                                tap_pair(kernel[mm], 0)));
+    }
+    _mm_storel_epi64((__m128i*)output, round_pack(acc, acc));
+}
+
+void
+fir_filter_sse2_x4(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    int nn, offset = -kernelSize/2;
+
+    for (nn = 0; nn + 4 <= width; nn += 4) {
+        fir_block4(output + nn, input + nn + offset, kernel, kernelSize);
+    }
+    fir_filter_c(output + nn, input + nn, kernel, width - nn, kernelSize);
+}
+
+void
+fir_filter_sse2_x8(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    int nn, offset = -kernelSize/2;
+
+    for (nn = 0; nn + 8 <= width; nn += 8) {
+        fir_block8(output + nn, input + nn + offset, kernel, kernelSize, 1);
+    }
+    for (; nn + 4 <= width; nn += 4) {
+        fir_block4(output + nn, input + nn + offset, kernel, kernelSize);
+    }
+    fir_filter_c(output + nn, input + nn, kernel, width - nn, kernelSize);
+}
+
+void
+fir_filter_sse2_x16(short *output, const short* input, const short* kernel, int width, int kernelSize)
+{
+    int nn, offset = -kernelSize/2;
+
+    for (nn = 0; nn + 16 <= width; nn += 16) {
+        fir_block8(output + nn, input + nn + offset, kernel, kernelSize, 2);
+    }
+    for (; nn + 8 <= width; nn += 8) {
+        fir_block8(output + nn, input + nn + offset, kernel, kernelSize, 1);
+    }
+    for (; nn + 4 <= width; nn += 4) {
+        fir_block4(output + nn, input + nn + offset, kernel, kernelSize);
+    }
+    fir_filter_c(output + nn, input + nn, kernel, width - nn, kernelSize);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef FIR_KERNELS_H
+#define FIR_KERNELS_H
+
+/*
+ * Per-ISA kernels behind fir-engine.c. Each one handles as many outputs as
+ * fit its block and finishes the remainder with fir_filter_c(). Only the
+ * kernels whose HAVE_FIR_* flag is set by CMakeLists.txt are compiled in.
+ */
+#ifdef HAVE_FIR_NEON
+void fir_filter_neon_x4(short *output, const short* input, const short* kernel, int width, int kernelSize);
+void fir_filter_neon_x8(short *output, const short* input, const short* kernel, int width, int kernelSize);
+void fir_filter_neon_x16(short *output, const short* input, const short* kernel, int width, int kernelSize);
+#endif
+
+#ifdef HAVE_FIR_SSE2
+void fir_filter_sse2_x4(short *output, const short* input, const short* kernel, int width, int kernelSize);
+void fir_filter_sse2_x8(short *output, const short* input, const short* kernel, int width, int kernelSize);
+void fir_filter_sse2_x16(short *output, const short* input, const short* kernel, int width, int kernelSize);
+#endif
+
+#ifdef HAVE_FIR_AVX2
+void fir_filter_avx2_x16(short *output, const short* input, const short* kernel, int width, int kernelSize);
+#endif
+
+#endif /* FIR_KERNELS_H */
@@ -22,6 +22,7 @@
 
 #include <cpu-features.h>
 #include "helloneon-intrinsics.h"
+#include "fir-engine.h"
 
 #define DEBUG 0
 
@@ -42,22 +43,6 @@ now_ms(void)
 }
 
 
-/* this is a FIR filter implemented in C */
-static void
-fir_filter_c(short *output, const short* input, const short* kernel, int width, int kernelSize)
-{
-    int  offset = -kernelSize/2;
-    int  nn;
-    for (nn = 0; nn < width; nn++) {
-        int sum = 0;
-        int mm;
-        for (mm = 0; mm < kernelSize; mm++) {
-            sum += kernel[mm]*input[nn+offset+mm];
-        }
-        output[nn] = (short)((sum + 0x8000) >> 16);
-    }
-}
-
 #define  FIR_KERNEL_SIZE   32
 #define  FIR_OUTPUT_SIZE   2560
 #define  FIR_INPUT_SIZE    (FIR_OUTPUT_SIZE + FIR_KERNEL_SIZE)
@@ -87,7 +72,7 @@ Java_com_example_helloneon_HelloNeon_stringFromJNI( JNIEnv* env,
     uint64_t features;
     char buffer[512];
     char tryNeon = 0;
-    double  t0, t1, time_c, time_neon;
+    double  t0, t1, time_c, time_neon, time_engine;
 
     /* setup FIR input - whatever */
     {
@@ -113,6 +98,27 @@ Java_com_example_helloneon_HelloNeon_stringFromJNI( JNIEnv* env,
     strlcpy(buffer, str, sizeof buffer);
     free(str);
 
+    /* Benchmark small FIR filter loop - dispatched engine version */
+    fir_engine_init();
+    t0 = now_ms();
+    {
+        int  count = FIR_ITERATIONS;
+        for (; count > 0; count--) {
+            fir_filter(fir_output, fir_input, fir_kernel, FIR_OUTPUT_SIZE, FIR_KERNEL_SIZE);
+        }
+    }
+    t1 = now_ms();
+    time_engine = t1 - t0;
+    asprintf(&str, "Engine (%s) : %g ms (x%g faster)\n", fir_engine_selected()->name,
+             time_engine, time_c / (time_engine < 1e-6 ? 1. : time_engine));
+    strlcat(buffer, str, sizeof buffer);
+    free(str);
+
+    /* the engine must be bit-exact with the C version */
+    if (memcmp(fir_output, fir_output_expected, sizeof fir_output) != 0) {
+        strlcat(buffer, "Engine output MISMATCH !\n", sizeof buffer);
+    }
+
     strlcat(buffer, "Neon version   : ", sizeof buffer);
 
     family = android_getCpuFamily();
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+/*
+ * Host benchmark for the hello-neon FIR engine.
+ *
+ * For every (kernel size, output width, alignment) combination it checks each
+ * variant against fir_filter_c() and then times it: a few warmup runs, then
+ * the median of N timed runs, each long enough to dwarf the clock overhead.
+ *
+ * Reported per variant:
+ *   ns/sample  - median wall time per output sample
+ *   GB/s       - input + output bytes touched per call / median time
+ *   cyc/sample - CPU cycles per output sample, from perf_event_open() when
+ *                available, else estimated from --ghz, else "-"
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "fir-engine.h"
+
+#define MAX_LIST        32
+#define BUF_PAD         64      /* shorts of slack around every buffer */
+
+typedef struct {
+    int    kernels[MAX_LIST];
+    int    kernelCount;
+    int    widths[MAX_LIST];
+    int    widthCount;
+    int    aligns[MAX_LIST];
+    int    alignCount;
+    int    reps;
+    int    warmup;
+    double minRunNs;
+    double ghz;
+    int    csv;
+    const char* only;
+} bench_config;
+
+static uint64_t
+now_ns(void)
+{
+    struct timespec res;
+    clock_gettime(CLOCK_MONOTONIC, &res);
+    return (uint64_t)res.tv_sec * 1000000000ull + (uint64_t)res.tv_nsec;
+}
+
+/* user-space cycle counter for this thread, -1 when perf is not available */
+static int
+cycles_open(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof attr;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t
+cycles_read(int fd)
+{
+    uint64_t value = 0;
+    if (fd < 0 || read(fd, &value, sizeof value) != sizeof value)
+        return 0;
+    return value;
+}
+
+static int
+compare_double(const void* a, const void* b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static int
+parse_list(const char* arg, int* list, int* count)
+{
+    char* end;
+    *count = 0;
+    while (*arg && *count < MAX_LIST) {
+        long value = strtol(arg, &end, 0);
+        if (end == arg || value < 0)
+            return -1;
+        list[(*count)++] = (int)value;
+        arg = (*end == ',') ? end + 1 : end;
+    }
+    return *count ? 0 : -1;
+}
+
+static void
+usage(const char* prog)
+{
+    printf("usage: %s [options]\n"
+           "  -k, --kernels LIST   kernel sizes           (default 4,8,15,16,31,32,64,128)\n"
+           "  -w, --widths LIST    output widths          (default 64,256,1024,2560,16384)\n"
+           "  -a, --aligns LIST    buffer offsets, shorts (default 0,1,8)\n"
+           "  -n, --reps N         timed runs per variant, median is reported (default 15)\n"
+           "  -W, --warmup N       untimed runs before timing (default 3)\n"
+           "  -t, --min-time US    minimum duration of one timed run (default 2000)\n"
+           "  -g, --ghz F          CPU clock used for cyc/sample when perf is unavailable\n"
+           "  -v, --variant NAME   only benchmark this variant (always checks all)\n"
+           "  -c, --csv            machine readable output\n",
+           prog);
+}
+
+/* deterministic input covering the full short range, extremes included */
+static void
+fill_random(short* data, int count, uint32_t seed)
+{
+    int ii;
+    for (ii = 0; ii < count; ii++) {
+        seed = seed * 1664525u + 1013904223u;
+        switch (seed >> 29) {
+        case 0:  data[ii] = -32768;                     break;
+        case 1:  data[ii] = 32767;                      break;
+        default: data[ii] = (short)(seed >> 12);        break;
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    static const struct option options[] = {
+        { "kernels",  required_argument, NULL, 'k' },
+        { "widths",   required_argument, NULL, 'w' },
+        { "aligns",   required_argument, NULL, 'a' },
+        { "reps",     required_argument, NULL, 'n' },
+        { "warmup",   required_argument, NULL, 'W' },
+        { "min-time", required_argument, NULL, 't' },
+        { "ghz",      required_argument, NULL, 'g' },
+        { "variant",  required_argument, NULL, 'v' },
+        { "csv",      no_argument,       NULL, 'c' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    bench_config cfg = {
+        .kernels = { 4, 8, 15, 16, 31, 32, 64, 128 }, .kernelCount = 8,
+        .widths  = { 64, 256, 1024, 2560, 16384 },    .widthCount  = 5,
+        .aligns  = { 0, 1, 8 },                       .alignCount  = 3,
+        .reps = 15, .warmup = 3, .minRunNs = 2e6, .ghz = 0., .csv = 0, .only = NULL,
+    };
+    int opt, maxKernel = 0, maxWidth = 0, maxAlign = 0;
+    int ki, wi, ai, vi, variantCount, failures = 0, cyclesFd;
+    short *inputBase, *outputBase, *expected, *kernel;
+    double *samples, *cycleSamples;
+
+    while ((opt = getopt_long(argc, argv, "k:w:a:n:W:t:g:v:ch", options, NULL)) != -1) {
+        switch (opt) {
+        case 'k':
+            if (parse_list(optarg, cfg.kernels, &cfg.kernelCount)) goto BAD_ARG;
+            break;
+        case 'w':
+            if (parse_list(optarg, cfg.widths, &cfg.widthCount)) goto BAD_ARG;
+            break;
+        case 'a':
+            if (parse_list(optarg, cfg.aligns, &cfg.alignCount)) goto BAD_ARG;
+            break;
+        case 'n': cfg.reps = atoi(optarg);              break;
+        case 'W': cfg.warmup = atoi(optarg);            break;
+        case 't': cfg.minRunNs = atof(optarg) * 1e3;    break;
+        case 'g': cfg.ghz = atof(optarg);               break;
+        case 'v': cfg.only = optarg;                    break;
+        case 'c': cfg.csv = 1;                          break;
+        case 'h': usage(argv[0]);                       return 0;
+        default:
+        BAD_ARG:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.reps < 1)
+        cfg.reps = 1;
+
+    for (ki = 0; ki < cfg.kernelCount; ki++)
+        if (cfg.kernels[ki] > maxKernel) maxKernel = cfg.kernels[ki];
+    for (wi = 0; wi < cfg.widthCount; wi++)
+        if (cfg.widths[wi] > maxWidth) maxWidth = cfg.widths[wi];
+    for (ai = 0; ai < cfg.alignCount; ai++)
+        if (cfg.aligns[ai] > maxAlign) maxAlign = cfg.aligns[ai];
+    if (maxKernel < 1) {
+        fprintf(stderr, "kernel sizes must be positive\n");
+        return 2;
+    }
+
+    {
+        size_t inputCount  = (size_t)maxWidth + maxKernel + maxAlign + 2 * BUF_PAD;
+        size_t outputCount = (size_t)maxWidth + maxAlign + BUF_PAD;
+        if (posix_memalign((void**)&inputBase,  64, inputCount  * sizeof(short)) ||
+            posix_memalign((void**)&outputBase, 64, outputCount * sizeof(short)) ||
+            posix_memalign((void**)&expected,   64, outputCount * sizeof(short)) ||
+            posix_memalign((void**)&kernel,     64, (size_t)maxKernel * sizeof(short))) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        fill_random(inputBase, (int)inputCount, 0x1234u);
+    }
+    samples = malloc(sizeof(double) * (size_t)cfg.reps);
+    cycleSamples = malloc(sizeof(double) * (size_t)cfg.reps);
+
+    cyclesFd = cycles_open();
+    fir_engine_init();
+    variantCount = fir_engine_variant_count();
+
+    if (cfg.csv) {
+        printf("variant,block,kernel,width,align,ns_per_call,ns_per_sample,gb_per_s,cycles_per_sample,ok\n");
+    } else {
+        printf("FIR engine benchmark: %d variants, dispatcher selects \"%s\", cycles from %s\n",
+               variantCount, fir_engine_selected()->name,
+               cyclesFd >= 0 ? "perf" : (cfg.ghz > 0. ? "--ghz" : "nowhere"));
+    }
+
+    for (ki = 0; ki < cfg.kernelCount; ki++) {
+        int kernelSize = cfg.kernels[ki];
+        if (kernelSize < 1)
+            continue;
+        fill_random(kernel, kernelSize, 0xbeefu + (uint32_t)kernelSize);
+
+        for (wi = 0; wi < cfg.widthCount; wi++) {
+            int width = cfg.widths[wi];
+            /* input + output bytes of one call */
+            double bytes = (double)(width + kernelSize - 1 + width) * sizeof(short);
+
+            for (ai = 0; ai < cfg.alignCount; ai++) {
+                int align = cfg.aligns[ai];
+                const short* input = inputBase + BUF_PAD + align + kernelSize/2;
+                short* output = outputBase + align;
+
+                fir_filter_c(expected + align, input, kernel, width, kernelSize);
+                if (!cfg.csv) {
+                    printf("\nkernel %d, width %d, align %d\n"
+                           "  %-10s %12s %10s %10s %10s\n",
+                           kernelSize, width, align,
+                           "variant", "ns/call", "ns/sample", "GB/s", "cyc/sample");
+                }
+
+                for (vi = 0; vi < variantCount; vi++) {
+                    const fir_variant* v = fir_engine_variant(vi);
+                    int ok, rr, calls = 1;
+                    double median, cycles = -1.;
+
+                    /* correctness first, with a canary right behind the output */
+                    memset(outputBase, 0x5a, (size_t)(maxWidth + maxAlign + BUF_PAD) * sizeof(short));
+                    v->func(output, input, kernel, width, kernelSize);
+                    ok = memcmp(output, expected + align, (size_t)width * sizeof(short)) == 0 &&
+                         output[width] == 0x5a5a;
+                    if (!ok) {
+                        failures++;
+                        fprintf(stderr, "MISMATCH: %s kernel %d width %d align %d\n",
+                                v->name, kernelSize, width, align);
+                    }
+                    if (cfg.only && strcmp(cfg.only, v->name) != 0)
+                        continue;
+
+                    /* size one run so it lasts at least minRunNs */
+                    for (;;) {
+                        uint64_t t0 = now_ns();
+                        for (rr = 0; rr < calls; rr++)
+                            v->func(output, input, kernel, width, kernelSize);
+                        if ((double)(now_ns() - t0) >= cfg.minRunNs / 4 || calls >= (1 << 24))
+                            break;
+                        calls *= 2;
+                    }
+                    calls *= 4;
+
+                    for (rr = 0; rr < cfg.warmup; rr++) {
+                        int cc;
+                        for (cc = 0; cc < calls; cc++)
+                            v->func(output, input, kernel, width, kernelSize);
+                    }
+                    for (rr = 0; rr < cfg.reps; rr++) {
+                        uint64_t c0 = cycles_read(cyclesFd);
+                        uint64_t t0 = now_ns();
+                        int cc;
+                        for (cc = 0; cc < calls; cc++)
+                            v->func(output, input, kernel, width, kernelSize);
+                        samples[rr] = (double)(now_ns() - t0) / calls;
+                        if (cyclesFd >= 0)
+                            cycleSamples[rr] = (double)(cycles_read(cyclesFd) - c0) / calls;
+                    }
+                    qsort(samples, (size_t)cfg.reps, sizeof(double), compare_double);
+                    median = samples[cfg.reps / 2];
+                    /* cycles get their own median: a sample per run, sorted the same way */
+                    if (cyclesFd >= 0) {
+                        qsort(cycleSamples, (size_t)cfg.reps, sizeof(double), compare_double);
+                        cycles = cycleSamples[cfg.reps / 2];
+                    }
+                    if (cyclesFd < 0 && cfg.ghz > 0.)
+                        cycles = median * cfg.ghz;
+
+                    if (cfg.csv) {
+                        printf("%s,%d,%d,%d,%d,%.1f,%.4f,%.3f,", v->name, v->block,
+                               kernelSize, width, align, median,
+                               width ? median / width : 0., bytes / median);
+                        if (cycles >= 0.)
+                            printf("%.3f", width ? cycles / width : 0.);
+                        printf(",%d\n", ok);
+                    } else {
+                        char cyc[32] = "-";
+                        if (cycles >= 0.)
+                            snprintf(cyc, sizeof cyc, "%.3f", width ? cycles / width : 0.);
+                        printf("  %-10s %12.1f %10.4f %10.3f %10s%s\n", v->name, median,
+                               width ? median / width : 0., bytes / median, cyc,
+                               ok ? "" : "  MISMATCH");
+                    }
+                }
+            }
+        }
+    }
+
+    if (!cfg.csv)
+        printf("\n%s: %d mismatch%s\n", failures ? "FAILED" : "OK",
+               failures, failures == 1 ? "" : "es");
+    if (cyclesFd >= 0)
+        close(cyclesFd);
+    free(samples);
+    free(cycleSamples);
+    free(kernel);
+    free(expected);
+    free(outputBase);
+    free(inputBase);
+    return failures ? 1 : 0;
+}
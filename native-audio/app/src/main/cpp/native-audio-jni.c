@@ -40,6 +40,10 @@
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 
+#include "recorder_stream.h"
+#include "resampler.h"
+#include "wav_writer.h"
+
 // pre-recorded sound clips, both are 8 kHz mono 16-bit signed little endian
 static const char hello[] =
 #include "hello_clip.h"
@@ -66,7 +70,6 @@ static SLMuteSoloItf bqPlayerMuteSolo;
 static SLVolumeItf bqPlayerVolume;
 static SLmilliHertz bqPlayerSampleRate = 0;
 static jint   bqPlayerBufSize = 0;
-static short *resampleBuf = NULL;
 // a mutext to guard against re-entrance to record & playback
 // as well as make recording and playing back to be mutually exclusive
 // this is to avoid crash at situations like:
@@ -102,15 +105,52 @@ static SLAndroidSimpleBufferQueueItf recorderBufferQueue;
 #define SAWTOOTH_FRAMES 8000
 static short sawtoothBuffer[SAWTOOTH_FRAMES];
 
-// 5 seconds of recorded audio at 16 kHz mono, 16-bit signed little endian
-#define RECORDER_FRAMES (16000 * 5)
+// the last 5 seconds of the recording at 16 kHz mono, 16-bit signed little endian, for playback
+#define RECORDER_RATE 16000
+#define RECORDER_FRAMES (RECORDER_RATE * 5)
 static short recorderBuffer[RECORDER_FRAMES];
 static unsigned recorderSize = 0;
+static unsigned recorderPos;        // while recording, recorderBuffer is a ring written here
+static uint64_t recordedFrames;
 
-// pointer and size of the next player buffer to enqueue, and number of remaining buffers
-static short *nextBuffer;
-static unsigned nextSize;
-static int nextCount;
+/*
+ * Recording streams until stopped: 20 ms buffers cycle between the recorder and a consumer
+ * thread, which keeps the playback clip and writes the optional file. Two buffers are with the
+ * recorder, the others cover a consumer stall of up to 280 ms before audio is dropped.
+ */
+#define RECORDER_BUF_FRAMES (RECORDER_RATE / 50)
+#define RECORDER_BUF_COUNT 16
+#define RECORDER_DEVICE_BUFS 2
+static RecorderStream *recorderStream = NULL;
+static WavWriter *recorderFile = NULL;
+static int recording = 0;
+
+// the clip being played, the position in it, and the number of times it is still to be played
+static const short *clipData;
+static unsigned clipFrames;
+static unsigned clipPos;
+static int clipCount;
+static unsigned clipTail;   // zero frames still to push through, for the resampler's tail
+
+/*
+ * Clips are streamed to the player through a resampler, a device sized block at a time:
+ * playback starts after one block, and nothing is allocated per clip. One resampler per
+ * source rate, filters designed when the player is created.
+ */
+#define PLAYER_BLOCK_COUNT 2
+#define DEFAULT_BLOCK_FRAMES 1024
+static Resampler *resampler8k = NULL;
+static Resampler *resampler16k = NULL;
+static Resampler *clipResampler;
+static short *playerBlocks[PLAYER_BLOCK_COUNT];
+static unsigned blockFrames;
+static int nextBlock;
+// blocks with the player; updated from the callback thread as well, so
+// always through __atomic builtins. Whoever takes it to 0 unlocks the engine.
+static int blocksQueued;
+// held by selectClip while it enqueues the first blocks, and by the callback around its
+// refill, so a block that plays out early is not refilled ahead of the ones still to go out
+static pthread_mutex_t playerQueueLock = PTHREAD_MUTEX_INITIALIZER;
 
 
 // synthesize a mono sawtooth wave and place it into a buffer (called automatically on load)
@@ -122,75 +162,58 @@ __attribute__((constructor)) static void onDlOpen(void)
     }
 }
 
-void releaseResampleBuf(void) {
-    if( 0 == bqPlayerSampleRate) {
-        /*
-         * we are not using fast path, so we were not creating buffers, nothing to do
-         */
-        return;
-    }
-
-    free(resampleBuf);
-    resampleBuf = NULL;
-}
-
 /*
- * Only support up-sampling
+ * Resample the next block of the current clip into block, looping the clip clipCount times
+ * and flushing the resampler's tail at the very end.
+ * @return number of frames written, 0 when the clip is over
  */
-short* createResampledBuf(uint32_t idx, uint32_t srcRate, unsigned *size) {
-    short  *src = NULL;
-    short  *workBuf;
-    int    upSampleRate;
-    int32_t srcSampleCount = 0;
-
-    if(0 == bqPlayerSampleRate) {
-        return NULL;
-    }
-    if(bqPlayerSampleRate % srcRate) {
-        /*
-         * simple up-sampling, must be divisible
-         */
-        return NULL;
-    }
-    upSampleRate = bqPlayerSampleRate / srcRate;
-
-    switch (idx) {
-        case 0:
-            return NULL;
-        case 1: // HELLO_CLIP
-            srcSampleCount = sizeof(hello) >> 1;
-            src = (short*)hello;
-            break;
-        case 2: // ANDROID_CLIP
-            srcSampleCount = sizeof(android) >> 1;
-            src = (short*) android;
-            break;
-        case 3: // SAWTOOTH_CLIP
-            srcSampleCount = SAWTOOTH_FRAMES;
-            src = sawtoothBuffer;
-            break;
-        case 4: // captured frames
-            srcSampleCount = recorderSize / sizeof(short);
-            src =  recorderBuffer;
+static unsigned fillBlock(short *block)
+{
+    static const short silence[RESAMPLER_TAPS];
+    unsigned frames = 0;
+    while (frames < blockFrames) {
+        if (clipPos == clipFrames && clipCount > 1) {
+            clipCount--;
+            clipPos = 0;
+        }
+        const short *src;
+        uint32_t avail;
+        if (clipPos < clipFrames) {
+            src = clipData + clipPos;
+            avail = clipFrames - clipPos;
+        } else if (clipTail) {
+            src = silence;
+            avail = clipTail;
+        } else {
             break;
-        default:
-            assert(0);
-            return NULL;
+        }
+        uint32_t taken = avail;
+        frames += resampler_process_i16(clipResampler, src, &taken, block + frames,
+                                        blockFrames - frames);
+        if (src == silence) {
+            clipTail -= taken;
+        } else {
+            clipPos += taken;
+        }
     }
+    return frames;
+}
 
-    resampleBuf = (short*) malloc((srcSampleCount * upSampleRate) << 1);
-    if(resampleBuf == NULL) {
-        return resampleBuf;
+// resample the next block and hand it to the player
+static SLresult enqueueNextBlock(void)
+{
+    short *block = playerBlocks[nextBlock];
+    unsigned frames = fillBlock(block);
+    if (!frames) {
+        return SL_RESULT_BUFFER_INSUFFICIENT;
     }
-    workBuf = resampleBuf;
-    for(int sample=0; sample < srcSampleCount; sample++) {
-        for(int dup = 0; dup  < upSampleRate; dup++) {
-            *workBuf++ = src[sample];
-        }
+    SLresult result = (*bqPlayerBufferQueue)->Enqueue(bqPlayerBufferQueue, block,
+                                                      frames * sizeof(short));
+    if (SL_RESULT_SUCCESS == result) {
+        nextBlock = (nextBlock + 1) % PLAYER_BLOCK_COUNT;
+        __atomic_add_fetch(&blocksQueued, 1, __ATOMIC_ACQ_REL);
     }
-
-    *size = (srcSampleCount * upSampleRate) << 1;     // sample format is 16 bit
-    return resampleBuf;
+    return result;
 }
 
 // this callback handler is called every time a buffer finishes playing
@@ -198,19 +221,12 @@ void bqPlayerCallback(SLAndroidSimpleBufferQueueItf bq, void *context)
 {
     assert(bq == bqPlayerBufferQueue);
     assert(NULL == context);
-    // for streaming playback, replace this test by logic to find and fill the next buffer
-    if (--nextCount > 0 && NULL != nextBuffer && 0 != nextSize) {
-        SLresult result;
-        // enqueue another buffer
-        result = (*bqPlayerBufferQueue)->Enqueue(bqPlayerBufferQueue, nextBuffer, nextSize);
-        // the most likely other result is SL_RESULT_BUFFER_INSUFFICIENT,
-        // which for this code example would indicate a programming error
-        if (SL_RESULT_SUCCESS != result) {
-            pthread_mutex_unlock(&audioEngineLock);
-        }
-        (void)result;
-    } else {
-        releaseResampleBuf();
+    // the finished block is free again: refill and enqueue it, until the clip runs out;
+    // count the refill before the finished block so the count never dips to 0 in between
+    pthread_mutex_lock(&playerQueueLock);
+    enqueueNextBlock();
+    pthread_mutex_unlock(&playerQueueLock);
+    if (0 == __atomic_sub_fetch(&blocksQueued, 1, __ATOMIC_ACQ_REL)) {
         pthread_mutex_unlock(&audioEngineLock);
     }
 }
@@ -221,14 +237,75 @@ void bqRecorderCallback(SLAndroidSimpleBufferQueueItf bq, void *context)
 {
     assert(bq == recorderBufferQueue);
     assert(NULL == context);
-    // for streaming recording, here we would call Enqueue to give recorder the next buffer to fill
-    // but instead, this is a one-time buffer so we stop recording
+    // hand the full buffer to the consumer thread and give the recorder the next one to fill
+    recorder_stream_device_buf_done(recorderStream);
+    short *buf = recorder_stream_next_device_buf(recorderStream);
+    assert(NULL != buf);
+    SLresult result;
+    result = (*bq)->Enqueue(bq, buf, recorder_stream_buf_bytes(recorderStream));
+    assert(SL_RESULT_SUCCESS == result);
+    (void)result;
+}
+
+// consumer thread: keep the tail of the recording for playback, stream all of it to the file
+static void recorderSink(void *ctx, const int16_t *frames, uint32_t count)
+{
+    (void)ctx;
+    if (NULL != recorderFile) {
+        wav_writer_write(recorderFile, frames, count);
+    }
+    recordedFrames += count;
+    while (count) {
+        unsigned n = RECORDER_FRAMES - recorderPos;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(recorderBuffer + recorderPos, frames, n * sizeof(short));
+        recorderPos = (recorderPos + n) % RECORDER_FRAMES;
+        frames += n;
+        count -= n;
+    }
+}
+
+static void reverseFrames(short *p, unsigned n)
+{
+    for (unsigned i = 0; i < n / 2; i++) {
+        short t = p[i];
+        p[i] = p[n - 1 - i];
+        p[n - 1 - i] = t;
+    }
+}
+
+/*
+ * Stop the recorder, let the consumer drain and put the playback clip in order.
+ * @return number of buffers dropped because the consumer fell behind
+ */
+static jint stopRecorder(void)
+{
     SLresult result;
     result = (*recorderRecord)->SetRecordState(recorderRecord, SL_RECORDSTATE_STOPPED);
-    if (SL_RESULT_SUCCESS == result) {
+    assert(SL_RESULT_SUCCESS == result);
+    result = (*recorderBufferQueue)->Clear(recorderBufferQueue);
+    assert(SL_RESULT_SUCCESS == result);
+    (void)result;
+    recorder_stream_stop(recorderStream);
+    jint overruns = (jint)recorder_stream_overruns(recorderStream);
+
+    if (NULL != recorderFile) {
+        wav_writer_close(recorderFile);
+        recorderFile = NULL;
+    }
+    if (recordedFrames > RECORDER_FRAMES) {
+        // rotate the ring so the oldest frame comes first
+        reverseFrames(recorderBuffer, recorderPos);
+        reverseFrames(recorderBuffer + recorderPos, RECORDER_FRAMES - recorderPos);
+        reverseFrames(recorderBuffer, RECORDER_FRAMES);
         recorderSize = RECORDER_FRAMES * sizeof(short);
+    } else {
+        recorderSize = (unsigned)recordedFrames * sizeof(short);
     }
-    pthread_mutex_unlock(&audioEngineLock);
+    recording = 0;
+    return overruns;
 }
 
 
@@ -288,14 +365,25 @@ void Java_com_example_nativeaudio_NativeAudio_createBufferQueueAudioPlayer(JNIEn
     if (sampleRate >= 0 && bufSize >= 0 ) {
         bqPlayerSampleRate = sampleRate * 1000;
         /*
-         * device native buffer size is another factor to minimize audio latency, not used in this
-         * sample: we only play one giant buffer here
+         * device native buffer size is another factor to minimize audio latency: clips are
+         * streamed to the player in blocks of this size
          */
         bqPlayerBufSize = bufSize;
     }
 
+    // the clips are 8 kHz, recordings 16 kHz: convert both to the player's rate
+    SLuint32 playerRate = bqPlayerSampleRate ? bqPlayerSampleRate / 1000 : 8000;
+    resampler8k = resampler_create(8000, playerRate);
+    resampler16k = resampler_create(16000, playerRate);
+    blockFrames = bqPlayerBufSize > 0 ? (unsigned)bqPlayerBufSize : DEFAULT_BLOCK_FRAMES;
+    for (int i = 0; i < PLAYER_BLOCK_COUNT; i++) {
+        playerBlocks[i] = (short*)malloc(blockFrames * sizeof(short));
+        assert(NULL != playerBlocks[i]);
+    }
+
     // configure audio source
-    SLDataLocator_AndroidSimpleBufferQueue loc_bufq = {SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, 2};
+    SLDataLocator_AndroidSimpleBufferQueue loc_bufq = {SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE,
+                                                       PLAYER_BLOCK_COUNT};
     SLDataFormat_PCM format_pcm = {SL_DATAFORMAT_PCM, 1, SL_SAMPLINGRATE_8,
         SL_PCMSAMPLEFORMAT_FIXED_16, SL_PCMSAMPLEFORMAT_FIXED_16,
         SL_SPEAKER_FRONT_CENTER, SL_BYTEORDER_LITTLEENDIAN};
@@ -623,7 +711,7 @@ jboolean Java_com_example_nativeaudio_NativeAudio_enableReverb(JNIEnv* env, jcla
     return JNI_TRUE;
 }
 
-// select the desired clip and play count, and enqueue the first buffer if idle
+// select the desired clip and play count, and enqueue the first blocks if idle
 jboolean Java_com_example_nativeaudio_NativeAudio_selectClip(JNIEnv* env, jclass clazz, jint which,
         jint count)
 {
@@ -631,63 +719,78 @@ jboolean Java_com_example_nativeaudio_NativeAudio_selectClip(JNIEnv* env, jclass
         // If we could not acquire audio engine lock, reject this request and client should re-try
         return JNI_FALSE;
     }
+    clipResampler = resampler8k;
     switch (which) {
     case 0:     // CLIP_NONE
-        nextBuffer = (short *) NULL;
-        nextSize = 0;
+        clipData = NULL;
+        clipFrames = 0;
         break;
     case 1:     // CLIP_HELLO
-        nextBuffer = createResampledBuf(1, SL_SAMPLINGRATE_8, &nextSize);
-        if(!nextBuffer) {
-            nextBuffer = (short*)hello;
-            nextSize  = sizeof(hello);
-        }
+        clipData = (const short*)hello;
+        clipFrames = sizeof(hello) / sizeof(short);
         break;
     case 2:     // CLIP_ANDROID
-        nextBuffer = createResampledBuf(2, SL_SAMPLINGRATE_8, &nextSize);
-        if(!nextBuffer) {
-            nextBuffer = (short*)android;
-            nextSize  = sizeof(android);
-        }
+        clipData = (const short*)android;
+        clipFrames = sizeof(android) / sizeof(short);
         break;
     case 3:     // CLIP_SAWTOOTH
-        nextBuffer = createResampledBuf(3, SL_SAMPLINGRATE_8, &nextSize);
-        if(!nextBuffer) {
-            nextBuffer = (short*)sawtoothBuffer;
-            nextSize  = sizeof(sawtoothBuffer);
-        }
+        clipData = sawtoothBuffer;
+        clipFrames = SAWTOOTH_FRAMES;
         break;
     case 4:     // CLIP_PLAYBACK
-        nextBuffer = createResampledBuf(4, SL_SAMPLINGRATE_16, &nextSize);
-        // we recorded at 16 kHz, but are playing buffers at 8 Khz, so do a primitive down-sample
-        if(!nextBuffer) {
-            unsigned i;
-            for (i = 0; i < recorderSize; i += 2 * sizeof(short)) {
-                recorderBuffer[i >> 2] = recorderBuffer[i >> 1];
-            }
-            recorderSize >>= 1;
-            nextBuffer = recorderBuffer;
-            nextSize = recorderSize;
-        }
+        // we recorded at 16 kHz
+        clipData = recorderBuffer;
+        clipFrames = recorderSize / sizeof(short);
+        clipResampler = resampler16k;
         break;
     default:
-        nextBuffer = NULL;
-        nextSize = 0;
+        clipData = NULL;
+        clipFrames = 0;
         break;
     }
-    nextCount = count;
-    if (nextSize > 0) {
-        // here we only enqueue one buffer because it is a long clip,
-        // but for streaming playback we would typically enqueue at least 2 buffers to start
+    clipPos = 0;
+    clipCount = count;
+    clipTail = RESAMPLER_TAPS;
+
+    // fill every block before the first one goes out, and enqueue them all under
+    // playerQueueLock: the callback refilling block 0 may run as soon as it has played
+    unsigned frames[PLAYER_BLOCK_COUNT];
+    int filled = 0;
+    if (clipFrames > 0 && NULL != clipResampler) {
+        resampler_reset(clipResampler);
+        while (filled < PLAYER_BLOCK_COUNT &&
+               (frames[filled] = fillBlock(playerBlocks[filled])) > 0) {
+            filled++;
+        }
+    }
+    nextBlock = 0;
+    __atomic_store_n(&blocksQueued, filled, __ATOMIC_RELEASE);
+    if (0 == filled) {
+        pthread_mutex_unlock(&audioEngineLock);
+        return JNI_TRUE;
+    }
+    pthread_mutex_lock(&playerQueueLock);
+    for (int i = 0; i < filled; i++) {
         SLresult result;
-        result = (*bqPlayerBufferQueue)->Enqueue(bqPlayerBufferQueue, nextBuffer, nextSize);
+        result = (*bqPlayerBufferQueue)->Enqueue(bqPlayerBufferQueue, playerBlocks[i],
+                                                 frames[i] * sizeof(short));
         if (SL_RESULT_SUCCESS != result) {
-            pthread_mutex_unlock(&audioEngineLock);
-            return JNI_FALSE;
+            // the most likely other result is SL_RESULT_BUFFER_INSUFFICIENT,
+            // which for this code example would indicate a programming error
+            if (0 == i) {
+                pthread_mutex_unlock(&playerQueueLock);
+                __atomic_store_n(&blocksQueued, 0, __ATOMIC_RELEASE);
+                pthread_mutex_unlock(&audioEngineLock);
+                return JNI_FALSE;
+            }
+            // blocks already queued may have played out meanwhile
+            if (0 == __atomic_sub_fetch(&blocksQueued, filled - i, __ATOMIC_ACQ_REL)) {
+                pthread_mutex_unlock(&audioEngineLock);
+            }
+            break;
         }
-    } else {
-        pthread_mutex_unlock(&audioEngineLock);
     }
+    pthread_mutex_unlock(&playerQueueLock);
 
     return JNI_TRUE;
 }
@@ -801,8 +904,17 @@ jboolean Java_com_example_nativeaudio_NativeAudio_createAudioRecorder(JNIEnv* en
             SL_DEFAULTDEVICEID_AUDIOINPUT, NULL};
     SLDataSource audioSrc = {&loc_dev, NULL};
 
+    if (NULL == recorderStream) {
+        recorderStream = recorder_stream_create(RECORDER_BUF_FRAMES, RECORDER_BUF_COUNT,
+                                                recorderSink, NULL);
+        if (NULL == recorderStream) {
+            return JNI_FALSE;
+        }
+    }
+
     // configure audio sink
-    SLDataLocator_AndroidSimpleBufferQueue loc_bq = {SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, 2};
+    SLDataLocator_AndroidSimpleBufferQueue loc_bq = {SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE,
+                                                     RECORDER_DEVICE_BUFS};
     SLDataFormat_PCM format_pcm = {SL_DATAFORMAT_PCM, 1, SL_SAMPLINGRATE_16,
         SL_PCMSAMPLEFORMAT_FIXED_16, SL_PCMSAMPLEFORMAT_FIXED_16,
         SL_SPEAKER_FRONT_CENTER, SL_BYTEORDER_LITTLEENDIAN};
@@ -845,13 +957,14 @@ jboolean Java_com_example_nativeaudio_NativeAudio_createAudioRecorder(JNIEnv* en
 }
 
 
-// set the recording state for the audio recorder
-void Java_com_example_nativeaudio_NativeAudio_startRecording(JNIEnv* env, jclass clazz)
+// start streaming from the audio recorder, to the file at path if it is not null
+jboolean Java_com_example_nativeaudio_NativeAudio_startRecording(JNIEnv* env, jclass clazz,
+        jstring path)
 {
     SLresult result;
 
     if (pthread_mutex_trylock(&audioEngineLock)) {
-        return;
+        return JNI_FALSE;
     }
     // in case already recording, stop recording and clear buffer queue
     result = (*recorderRecord)->SetRecordState(recorderRecord, SL_RECORDSTATE_STOPPED);
@@ -863,20 +976,54 @@ void Java_com_example_nativeaudio_NativeAudio_startRecording(JNIEnv* env, jclass
 
     // the buffer is not valid for playback yet
     recorderSize = 0;
+    recorderPos = 0;
+    recordedFrames = 0;
+
+    if (NULL != path) {
+        const char *utf8 = (*env)->GetStringUTFChars(env, path, NULL);
+        assert(NULL != utf8);
+        // without the file, the recording still goes to the playback clip
+        recorderFile = wav_writer_open(utf8, RECORDER_RATE, 1);
+        (*env)->ReleaseStringUTFChars(env, path, utf8);
+    }
+    if (recorder_stream_start(recorderStream)) {
+        if (NULL != recorderFile) {
+            wav_writer_close(recorderFile);
+            recorderFile = NULL;
+        }
+        pthread_mutex_unlock(&audioEngineLock);
+        return JNI_FALSE;
+    }
 
-    // enqueue an empty buffer to be filled by the recorder
-    // (for streaming recording, we would enqueue at least 2 empty buffers to start things off)
-    result = (*recorderBufferQueue)->Enqueue(recorderBufferQueue, recorderBuffer,
-            RECORDER_FRAMES * sizeof(short));
-    // the most likely other result is SL_RESULT_BUFFER_INSUFFICIENT,
-    // which for this code example would indicate a programming error
-    assert(SL_RESULT_SUCCESS == result);
-    (void)result;
+    // enqueue the empty buffers to be filled by the recorder, each is recycled in the callback
+    for (int i = 0; i < RECORDER_DEVICE_BUFS; i++) {
+        result = (*recorderBufferQueue)->Enqueue(recorderBufferQueue,
+                recorder_stream_next_device_buf(recorderStream),
+                recorder_stream_buf_bytes(recorderStream));
+        // the most likely other result is SL_RESULT_BUFFER_INSUFFICIENT,
+        // which for this code example would indicate a programming error
+        assert(SL_RESULT_SUCCESS == result);
+        (void)result;
+    }
 
     // start recording
     result = (*recorderRecord)->SetRecordState(recorderRecord, SL_RECORDSTATE_RECORDING);
     assert(SL_RESULT_SUCCESS == result);
     (void)result;
+    recording = 1;
+    return JNI_TRUE;
+}
+
+
+// stop recording; returns the number of buffers dropped, or -1 if not recording
+jint Java_com_example_nativeaudio_NativeAudio_stopRecording(JNIEnv* env, jclass clazz)
+{
+    if (!recording) {
+        return -1;
+    }
+    jint overruns = stopRecorder();
+    pthread_mutex_unlock(&audioEngineLock);
+    return overruns;
 }
 
 
@@ -894,6 +1041,13 @@ void Java_com_example_nativeaudio_NativeAudio_shutdown(JNIEnv* env, jclass clazz
         bqPlayerMuteSolo = NULL;
         bqPlayerVolume = NULL;
     }
+    resampler_destroy(resampler8k);
+    resampler_destroy(resampler16k);
+    resampler8k = resampler16k = NULL;
+    for (int i = 0; i < PLAYER_BLOCK_COUNT; i++) {
+        free(playerBlocks[i]);
+        playerBlocks[i] = NULL;
+    }
 
     // destroy file descriptor audio player object, and invalidate all associated interfaces
     if (fdPlayerObject != NULL) {
@@ -916,12 +1070,18 @@ void Java_com_example_nativeaudio_NativeAudio_shutdown(JNIEnv* env, jclass clazz
     }
 
     // destroy audio recorder object, and invalidate all associated interfaces
+    if (recording) {
+        stopRecorder();
+        pthread_mutex_unlock(&audioEngineLock);
+    }
     if (recorderObject != NULL) {
         (*recorderObject)->Destroy(recorderObject);
         recorderObject = NULL;
         recorderRecord = NULL;
         recorderBufferQueue = NULL;
     }
+    recorder_stream_destroy(recorderStream);
+    recorderStream = NULL;
 
     // destroy output mix object, and invalidate all associated interfaces
     if (outputMixObject != NULL) {
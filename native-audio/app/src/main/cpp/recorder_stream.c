@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// for sem_t and pthreads under -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include "recorder_stream.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+
+/*
+ * Single producer / single consumer queue of buffer indices. head and tail
+ * run freely, the capacity is a power of two; the producer publishes a slot
+ * with a release store of tail, the consumer frees it with one of head.
+ */
+typedef struct {
+    uint16_t *slots;
+    uint32_t  mask;
+    uint32_t  head;
+    uint32_t  tail;
+} IndexQueue;
+
+static int queue_init(IndexQueue *q, uint32_t count) {
+    uint32_t cap = 1;
+    while (cap < count) {
+        cap <<= 1;
+    }
+    q->slots = (uint16_t*)malloc(cap * sizeof(uint16_t));
+    q->mask = cap - 1;
+    q->head = q->tail = 0;
+    return q->slots != NULL;
+}
+
+static int queue_push(IndexQueue *q, uint16_t idx) {
+    uint32_t tail = q->tail;
+    if (tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) > q->mask) {
+        return 0;
+    }
+    q->slots[tail & q->mask] = idx;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int queue_pop(IndexQueue *q, uint16_t *idx) {
+    uint32_t head = q->head;
+    if (head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    *idx = q->slots[head & q->mask];
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int queue_empty(IndexQueue *q) {
+    return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) ==
+           __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
+
+struct RecorderStream {
+    int16_t     *samples;   // bufCount x bufFrames, one allocation
+    uint32_t     bufFrames;
+    uint32_t     bufCount;
+    RecorderSink sink;
+    void        *ctx;
+
+    IndexQueue   filled;    // callback -> consumer
+    IndexQueue   free;      // consumer -> callback
+    sem_t        ready;
+    pthread_t    thread;
+    int          running;
+    int          stopping;
+
+    // callback thread only: buffers with the device, oldest first
+    uint16_t    *devFifo;
+    uint32_t     devHead;
+    uint32_t     devCount;
+    int          spare;     // a dropped buffer to give the device next, or -1
+
+    uint32_t     overruns;
+};
+
+static void reclaim_all(RecorderStream *rs) {
+    rs->filled.head = rs->filled.tail = 0;
+    rs->free.head = rs->free.tail = 0;
+    for (uint32_t i = 0; i < rs->bufCount; i++) {
+        queue_push(&rs->free, (uint16_t)i);
+    }
+    rs->devHead = rs->devCount = 0;
+    rs->spare = -1;
+}
+
+RecorderStream* recorder_stream_create(uint32_t bufFrames, uint32_t bufCount,
+                                       RecorderSink sink, void *ctx) {
+    assert(bufFrames && bufCount && bufCount <= UINT16_MAX && sink);
+    RecorderStream *rs = (RecorderStream*)calloc(1, sizeof(*rs));
+    if (!rs) {
+        return NULL;
+    }
+    rs->bufFrames = bufFrames;
+    rs->bufCount = bufCount;
+    rs->sink = sink;
+    rs->ctx = ctx;
+    rs->samples = (int16_t*)malloc((size_t)bufFrames * bufCount * sizeof(int16_t));
+    rs->devFifo = (uint16_t*)malloc(bufCount * sizeof(uint16_t));
+    if (!rs->samples || !rs->devFifo || !queue_init(&rs->filled, bufCount) ||
+        !queue_init(&rs->free, bufCount) || sem_init(&rs->ready, 0, 0)) {
+        free(rs->samples);
+        free(rs->devFifo);
+        free(rs->filled.slots);
+        free(rs->free.slots);
+        free(rs);
+        return NULL;
+    }
+    reclaim_all(rs);
+    return rs;
+}
+
+void recorder_stream_destroy(RecorderStream* rs) {
+    if (!rs) {
+        return;
+    }
+    recorder_stream_stop(rs);
+    sem_destroy(&rs->ready);
+    free(rs->samples);
+    free(rs->devFifo);
+    free(rs->filled.slots);
+    free(rs->free.slots);
+    free(rs);
+}
+
+uint32_t recorder_stream_buf_bytes(const RecorderStream* rs) {
+    return rs->bufFrames * sizeof(int16_t);
+}
+
+static void* consumer_main(void *arg) {
+    RecorderStream *rs = (RecorderStream*)arg;
+    for (;;) {
+        while (sem_wait(&rs->ready)) {
+            // EINTR
+        }
+        uint16_t idx;
+        if (!queue_pop(&rs->filled, &idx)) {
+            if (__atomic_load_n(&rs->stopping, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            continue;
+        }
+        rs->sink(rs->ctx, rs->samples + (size_t)idx * rs->bufFrames, rs->bufFrames);
+        queue_push(&rs->free, idx);
+    }
+    return NULL;
+}
+
+int recorder_stream_start(RecorderStream* rs) {
+    assert(!rs->running);
+    rs->overruns = 0;
+    rs->stopping = 0;
+    if (pthread_create(&rs->thread, NULL, consumer_main, rs)) {
+        return -1;
+    }
+    rs->running = 1;
+    return 0;
+}
+
+void recorder_stream_stop(RecorderStream* rs) {
+    if (!rs->running) {
+        return;
+    }
+    // everything filled so far was posted before this: it all gets consumed
+    __atomic_store_n(&rs->stopping, 1, __ATOMIC_RELEASE);
+    sem_post(&rs->ready);
+    pthread_join(rs->thread, NULL);
+    rs->running = 0;
+    reclaim_all(rs);
+}
+
+int16_t* recorder_stream_next_device_buf(RecorderStream* rs) {
+    uint16_t idx;
+    if (rs->spare >= 0) {
+        idx = (uint16_t)rs->spare;
+        rs->spare = -1;
+    } else if (!queue_pop(&rs->free, &idx)) {
+        return NULL;
+    }
+    assert(rs->devCount < rs->bufCount);
+    rs->devFifo[(rs->devHead + rs->devCount++) % rs->bufCount] = idx;
+    return rs->samples + (size_t)idx * rs->bufFrames;
+}
+
+void recorder_stream_device_buf_done(RecorderStream* rs) {
+    assert(rs->devCount);
+    uint16_t idx = rs->devFifo[rs->devHead];
+    rs->devHead = (rs->devHead + 1) % rs->bufCount;
+    rs->devCount--;
+    // the consumer only ever adds free buffers: not empty now, not empty at
+    // the next recorder_stream_next_device_buf()
+    if (queue_empty(&rs->free)) {
+        rs->spare = idx;
+        __atomic_add_fetch(&rs->overruns, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    queue_push(&rs->filled, idx);
+    sem_post(&rs->ready);
+}
+
+uint32_t recorder_stream_overruns(const RecorderStream* rs) {
+    return __atomic_load_n(&rs->overruns, __ATOMIC_RELAXED);
+}
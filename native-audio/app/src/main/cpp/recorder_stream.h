@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef NATIVE_AUDIO_RECORDER_STREAM_H
+#define NATIVE_AUDIO_RECORDER_STREAM_H
+
+#include <stdint.h>
+
+/*
+ * Continuous capture through a fixed ring of recorder buffers.
+ *
+ * All buffers are allocated once. Each one cycles device -> consumer ->
+ * free -> device: the recorder callback takes the oldest device buffer,
+ * hands it to a consumer thread and gives the device a free one. The two
+ * hand-offs are single producer / single consumer index queues, so the
+ * callback never takes a lock; the consumer thread sleeps on a semaphore.
+ *
+ * When the consumer is behind and no buffer is free, the callback gives the
+ * device back the buffer it has just filled, dropping its audio, and counts
+ * an overrun: memory stays bounded whatever the capture length.
+ */
+
+typedef struct RecorderStream RecorderStream;
+
+// called on the consumer thread, in capture order
+typedef void (*RecorderSink)(void *ctx, const int16_t *frames, uint32_t count);
+
+// bufCount buffers of bufFrames mono frames; NULL when out of memory
+RecorderStream* recorder_stream_create(uint32_t bufFrames, uint32_t bufCount,
+                                       RecorderSink sink, void *ctx);
+void recorder_stream_destroy(RecorderStream* rs);
+
+uint32_t recorder_stream_buf_bytes(const RecorderStream* rs);
+
+// start the consumer thread; 0 on success
+int recorder_stream_start(RecorderStream* rs);
+/*
+ * With the device stopped and its queue cleared: let the consumer finish
+ * the buffers already handed over, join it and take every buffer back.
+ */
+void recorder_stream_stop(RecorderStream* rs);
+
+/*
+ * Device side, on the recorder callback thread ( or before the recorder
+ * starts ): the next buffer to enqueue, remembered in device order, and the
+ * notification that the oldest enqueued buffer is full.
+ */
+int16_t* recorder_stream_next_device_buf(RecorderStream* rs);
+void recorder_stream_device_buf_done(RecorderStream* rs);
+
+// buffers dropped because the consumer was behind, since the last start
+uint32_t recorder_stream_overruns(const RecorderStream* rs);
+
+#endif  // NATIVE_AUDIO_RECORDER_STREAM_H
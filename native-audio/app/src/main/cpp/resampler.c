@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// for posix_memalign() under -std=c99
+#define _POSIX_C_SOURCE 200112L
+
+#include "resampler.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESAMPLER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLER_SSE2 1
+#endif
+
+#define MAX_PHASES 1024
+// input frames buffered per refill, on top of the filter history
+#define CHUNK_FRAMES 256
+// pass band edge, as a fraction of the lower of the two Nyquist rates
+#define PASS_BAND 0.9
+#define KAISER_BETA 7.0
+
+struct Resampler {
+    uint32_t up;        // L
+    uint32_t down;      // M
+    uint32_t phase;     // next output's phase, 0 .. L-1
+    uint32_t pos;       // next output's first tap in buf
+    uint32_t bufLen;
+    float   *coefF;     // L phases x RESAMPLER_TAPS, 16-byte aligned
+    int16_t *coefQ15;   // the same in Q15, each phase summing to 1.0
+    int16_t  buf[RESAMPLER_TAPS + CHUNK_FRAMES];
+};
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// zeroth order modified Bessel function of the first kind, for the window
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/*
+ * Design the prototype low-pass at L x srcRate and deal it out into the
+ * L phases; phase p, tap i weighs input sample ( window start + i ).
+ */
+static void designFilter(Resampler *rs) {
+    const double pi = 3.14159265358979323846;
+    uint32_t L = rs->up;
+    uint32_t length = L * RESAMPLER_TAPS;
+    double center = (length - 1) / 2.0;
+    double cutoff = 0.5 * PASS_BAND / (L > rs->down ? L : rs->down);
+    double norm = besselI0(KAISER_BETA);
+
+    for (uint32_t p = 0; p < L; p++) {
+        float *phaseF = rs->coefF + p * RESAMPLER_TAPS;
+        double sum = 0.0;
+        for (uint32_t i = 0; i < RESAMPLER_TAPS; i++) {
+            uint32_t j = p + (RESAMPLER_TAPS - 1 - i) * L;
+            double t = j - center;
+            double x = 2.0 * cutoff * t;
+            double sinc = t == 0.0 ? 1.0 : sin(pi * x) / (pi * x);
+            double r = 2.0 * j / (length - 1) - 1.0;
+            double w = besselI0(KAISER_BETA * sqrt(fmax(0.0, 1.0 - r * r))) / norm;
+            phaseF[i] = (float)(sinc * w);
+            sum += phaseF[i];
+        }
+
+        // unity gain for every phase, then the Q15 copy with the rounding
+        // error put on the biggest tap so the gain stays exact
+        int16_t *phaseQ = rs->coefQ15 + p * RESAMPLER_TAPS;
+        int32_t sumQ = 0;
+        uint32_t peak = 0;
+        for (uint32_t i = 0; i < RESAMPLER_TAPS; i++) {
+            phaseF[i] = (float)(phaseF[i] / sum);
+            long q = lround(phaseF[i] * 32768.0);
+            q = q > 32767 ? 32767 : (q < -32768 ? -32768 : q);
+            phaseQ[i] = (int16_t)q;
+            sumQ += phaseQ[i];
+            if (abs(phaseQ[i]) > abs(phaseQ[peak])) {
+                peak = i;
+            }
+        }
+        int32_t fixed = phaseQ[peak] + (32768 - sumQ);
+        phaseQ[peak] = (int16_t)(fixed > 32767 ? 32767 : fixed);
+    }
+}
+
+Resampler* resampler_create(uint32_t srcRate, uint32_t dstRate) {
+    if (!srcRate || !dstRate) {
+        return NULL;
+    }
+    uint32_t g = gcd(srcRate, dstRate);
+    if (dstRate / g > MAX_PHASES) {
+        return NULL;
+    }
+
+    Resampler *rs = (Resampler*)calloc(1, sizeof(*rs));
+    if (!rs) {
+        return NULL;
+    }
+    rs->up = dstRate / g;
+    rs->down = srcRate / g;
+    size_t count = (size_t)rs->up * RESAMPLER_TAPS;
+    void *coefF = NULL, *coefQ15 = NULL;
+    if (posix_memalign(&coefF, 16, count * sizeof(float)) ||
+        posix_memalign(&coefQ15, 16, count * sizeof(int16_t))) {
+        free(coefF);
+        free(rs);
+        return NULL;
+    }
+    rs->coefF = (float*)coefF;
+    rs->coefQ15 = (int16_t*)coefQ15;
+    if (rs->up != rs->down) {
+        designFilter(rs);
+    }
+    resampler_reset(rs);
+    return rs;
+}
+
+void resampler_destroy(Resampler* rs) {
+    if (!rs) {
+        return;
+    }
+    free(rs->coefF);
+    free(rs->coefQ15);
+    free(rs);
+}
+
+void resampler_reset(Resampler* rs) {
+    // start on a silent history
+    memset(rs->buf, 0, sizeof(rs->buf));
+    rs->bufLen = RESAMPLER_TAPS - 1;
+    rs->pos = 0;
+    rs->phase = 0;
+}
+
+static int32_t dotQ15(const int16_t *coef, const int16_t *x) {
+#if defined(RESAMPLER_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (int i = 0; i < RESAMPLER_TAPS; i += 8) {
+        int16x8_t c = vld1q_s16(coef + i);
+        int16x8_t v = vld1q_s16(x + i);
+        acc = vmlal_s16(acc, vget_low_s16(c), vget_low_s16(v));
+        acc = vmlal_s16(acc, vget_high_s16(c), vget_high_s16(v));
+    }
+    int64x2_t sum = vpaddlq_s32(acc);
+    return (int32_t)(vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1));
+#elif defined(RESAMPLER_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (int i = 0; i < RESAMPLER_TAPS; i += 8) {
+        __m128i c = _mm_load_si128((const __m128i*)(coef + i));
+        __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(c, v));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+#else
+    int32_t acc = 0;
+    for (int i = 0; i < RESAMPLER_TAPS; i++) {
+        acc += coef[i] * x[i];
+    }
+    return acc;
+#endif
+}
+
+static float dotF32(const float *coef, const int16_t *x) {
+#if defined(RESAMPLER_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int i = 0; i < RESAMPLER_TAPS; i += 8) {
+        int16x8_t v = vld1q_s16(x + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        acc = vmlaq_f32(acc, vld1q_f32(coef + i), lo);
+        acc = vmlaq_f32(acc, vld1q_f32(coef + i + 4), hi);
+    }
+    float32x2_t sum = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+#elif defined(RESAMPLER_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (int i = 0; i < RESAMPLER_TAPS; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(coef + i), lo));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(coef + i + 4), hi));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    float acc = 0.0f;
+    for (int i = 0; i < RESAMPLER_TAPS; i++) {
+        acc += coef[i] * x[i];
+    }
+    return acc;
+#endif
+}
+
+/*
+ * Move the unread part of buf to the front and top it up from in.
+ * @return the number of input frames taken
+ */
+static uint32_t refill(Resampler *rs, const int16_t *in, uint32_t avail) {
+    uint32_t taken = 0;
+    if (rs->pos <= rs->bufLen) {
+        rs->bufLen -= rs->pos;
+        memmove(rs->buf, rs->buf + rs->pos, rs->bufLen * sizeof(int16_t));
+        rs->pos = 0;
+    } else {
+        // decimating past the end of what we have: skip input
+        uint32_t skip = rs->pos - rs->bufLen;
+        taken = skip < avail ? skip : avail;
+        rs->pos = skip - taken;
+        rs->bufLen = 0;
+    }
+    uint32_t room = RESAMPLER_TAPS + CHUNK_FRAMES - rs->bufLen;
+    uint32_t count = avail - taken < room ? avail - taken : room;
+    if (!rs->pos) {
+        memcpy(rs->buf + rs->bufLen, in + taken, count * sizeof(int16_t));
+        rs->bufLen += count;
+        taken += count;
+    }
+    return taken;
+}
+
+static void advance(Resampler *rs) {
+    rs->phase += rs->down;
+    rs->pos += rs->phase / rs->up;
+    rs->phase %= rs->up;
+}
+
+uint32_t resampler_process_i16(Resampler* rs, const int16_t* in,
+                               uint32_t* inFrames, int16_t* out,
+                               uint32_t outFrames) {
+    uint32_t consumed = 0, produced = 0;
+    if (rs->up == rs->down) {
+        produced = *inFrames < outFrames ? *inFrames : outFrames;
+        memcpy(out, in, produced * sizeof(int16_t));
+        *inFrames = produced;
+        return produced;
+    }
+    for (;;) {
+        while (produced < outFrames && rs->pos + RESAMPLER_TAPS <= rs->bufLen) {
+            int32_t acc = dotQ15(rs->coefQ15 + rs->phase * RESAMPLER_TAPS,
+                                 rs->buf + rs->pos);
+            acc = (acc + (1 << 14)) >> 15;
+            out[produced++] = (int16_t)(acc > 32767 ? 32767 :
+                                        (acc < -32768 ? -32768 : acc));
+            advance(rs);
+        }
+        if (produced == outFrames || consumed == *inFrames) {
+            break;
+        }
+        consumed += refill(rs, in + consumed, *inFrames - consumed);
+    }
+    *inFrames = consumed;
+    return produced;
+}
+
+uint32_t resampler_process_f32(Resampler* rs, const int16_t* in,
+                               uint32_t* inFrames, float* out,
+                               uint32_t outFrames) {
+    const float scale = 1.0f / 32768.0f;
+    uint32_t consumed = 0, produced = 0;
+    if (rs->up == rs->down) {
+        produced = *inFrames < outFrames ? *inFrames : outFrames;
+        for (uint32_t i = 0; i < produced; i++) {
+            out[i] = in[i] * scale;
+        }
+        *inFrames = produced;
+        return produced;
+    }
+    for (;;) {
+        while (produced < outFrames && rs->pos + RESAMPLER_TAPS <= rs->bufLen) {
+            out[produced++] = dotF32(rs->coefF + rs->phase * RESAMPLER_TAPS,
+                                     rs->buf + rs->pos) * scale;
+            advance(rs);
+        }
+        if (produced == outFrames || consumed == *inFrames) {
+            break;
+        }
+        consumed += refill(rs, in + consumed, *inFrames - consumed);
+    }
+    *inFrames = consumed;
+    return produced;
+}
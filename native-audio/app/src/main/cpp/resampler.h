@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef NATIVE_AUDIO_RESAMPLER_H
+#define NATIVE_AUDIO_RESAMPLER_H
+
+#include <stdint.h>
+
+/*
+ * Streaming polyphase sample rate converter for mono 16-bit audio.
+ *
+ * The rate ratio dstRate / srcRate is reduced to L / M ( 8 kHz -> 48 kHz is
+ * 6 / 1, 44.1 kHz -> 48 kHz is 160 / 147 ); a Kaiser windowed sinc low-pass
+ * with RESAMPLER_TAPS taps per phase is designed for it once, at create
+ * time, and split into L phases. Every output sample is then one dot
+ * product of a phase with the last RESAMPLER_TAPS input samples ( NEON or
+ * SSE2 when available ).
+ *
+ * Audio goes through block by block, between caller buffers: a call takes
+ * as much input and produces as much output as fits, and keeps the filter
+ * history for the next call. Output lags the input by RESAMPLER_TAPS / 2
+ * input samples; feed RESAMPLER_TAPS zeros at the end of a stream to get
+ * its tail out.
+ */
+#define RESAMPLER_TAPS 32
+
+typedef struct Resampler Resampler;
+
+// NULL if the ratio needs more than 1024 phases or memory is short
+Resampler* resampler_create(uint32_t srcRate, uint32_t dstRate);
+void resampler_destroy(Resampler* rs);
+
+// forget the history, as for a new stream
+void resampler_reset(Resampler* rs);
+
+/*
+ * Convert from in ( *inFrames available ) into out ( room for outFrames ).
+ * On return *inFrames holds the number of input frames consumed; the
+ * number of frames written to out is returned. Stops when either side
+ * runs out.
+ */
+uint32_t resampler_process_i16(Resampler* rs, const int16_t* in,
+                               uint32_t* inFrames, int16_t* out,
+                               uint32_t outFrames);
+// same, with float output scaled by 1/32768 and not clamped: filter
+// overshoot on full scale input can take it slightly past [-1, 1)
+uint32_t resampler_process_f32(Resampler* rs, const int16_t* in,
+                               uint32_t* inFrames, float* out,
+                               uint32_t outFrames);
+
+#endif  // NATIVE_AUDIO_RESAMPLER_H
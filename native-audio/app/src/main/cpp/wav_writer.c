@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "wav_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAV_HEADER_BYTES 44
+#define WRITE_BUF_BYTES (64 * 1024)
+
+struct WavWriter {
+    FILE    *file;
+    int      wav;
+    int      failed;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint64_t dataBytes;
+    char     buf[WRITE_BUF_BYTES];
+};
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static int writeHeader(WavWriter *w) {
+    // RIFF sizes are 32 bits: a longer recording keeps the largest valid ones
+    uint32_t data = w->dataBytes > UINT32_MAX - WAV_HEADER_BYTES ?
+                    UINT32_MAX - WAV_HEADER_BYTES : (uint32_t)w->dataBytes;
+    uint8_t h[WAV_HEADER_BYTES];
+    memcpy(h, "RIFF", 4);
+    put32(h + 4, WAV_HEADER_BYTES - 8 + data);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put32(h + 16, 16);                                  // fmt chunk size
+    put16(h + 20, 1);                                   // PCM
+    put16(h + 22, (uint16_t)w->channels);
+    put32(h + 24, w->sampleRate);
+    put32(h + 28, w->sampleRate * w->channels * 2);     // byte rate
+    put16(h + 32, (uint16_t)(w->channels * 2));         // block align
+    put16(h + 34, 16);                                  // bits per sample
+    memcpy(h + 36, "data", 4);
+    put32(h + 40, data);
+    return fwrite(h, sizeof(h), 1, w->file) == 1 ? 0 : -1;
+}
+
+WavWriter* wav_writer_open(const char *path, uint32_t sampleRate, uint32_t channels) {
+    WavWriter *w = (WavWriter*)calloc(1, sizeof(*w));
+    if (!w) {
+        return NULL;
+    }
+    w->file = fopen(path, "wb");
+    if (!w->file) {
+        free(w);
+        return NULL;
+    }
+    setvbuf(w->file, w->buf, _IOFBF, sizeof(w->buf));
+    size_t len = strlen(path);
+    w->wav = len >= 4 && 0 == strcmp(path + len - 4, ".wav");
+    w->sampleRate = sampleRate;
+    w->channels = channels;
+    // sizes are filled in on close
+    if (w->wav && writeHeader(w)) {
+        w->failed = 1;
+    }
+    return w;
+}
+
+int wav_writer_write(WavWriter* w, const int16_t *frames, uint32_t count) {
+    if (w->failed) {
+        return -1;
+    }
+    // Android ABIs are all little endian, samples go out as they are
+    size_t samples = (size_t)count * w->channels;
+    if (fwrite(frames, sizeof(int16_t), samples, w->file) != samples) {
+        w->failed = 1;
+        return -1;
+    }
+    w->dataBytes += samples * sizeof(int16_t);
+    return 0;
+}
+
+int wav_writer_close(WavWriter* w) {
+    int failed = w->failed;
+    if (w->wav && !failed) {
+        failed = fseek(w->file, 0, SEEK_SET) || writeHeader(w);
+    }
+    failed |= fclose(w->file) != 0;
+    free(w);
+    return failed ? -1 : 0;
+}
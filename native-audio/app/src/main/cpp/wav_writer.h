@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef NATIVE_AUDIO_WAV_WRITER_H
+#define NATIVE_AUDIO_WAV_WRITER_H
+
+#include <stdint.h>
+
+/*
+ * Streams 16-bit little endian PCM to a file, through one fixed size stdio
+ * buffer: memory does not grow with the length of the recording. A ".wav"
+ * path gets a RIFF header, patched with the final sizes on close; any other
+ * path gets the raw samples.
+ */
+typedef struct WavWriter WavWriter;
+
+// NULL if the file cannot be created
+WavWriter* wav_writer_open(const char *path, uint32_t sampleRate, uint32_t channels);
+// 0 on success; after a failure further writes are ignored
+int wav_writer_write(WavWriter* w, const int16_t *frames, uint32_t count);
+// finish the header and close; 0 if everything was written
+int wav_writer_close(WavWriter* w);
+
+#endif  // NATIVE_AUDIO_WAV_WRITER_H
@@ -37,6 +37,8 @@ import android.widget.SeekBar.OnSeekBarChangeListener;
 import android.widget.Spinner;
 import android.widget.Toast;
 
+import java.io.File;
+
 public class NativeAudio extends Activity
         implements ActivityCompat.OnRequestPermissionsResultCallback {
 
@@ -289,6 +291,10 @@ public class NativeAudio extends Activity
 
         ((Button) findViewById(R.id.record)).setOnClickListener(new OnClickListener() {
             public void onClick(View view) {
+                if (isRecording) {
+                    stopRecordingAudio();
+                    return;
+                }
                 int status = ActivityCompat.checkSelfPermission(NativeAudio.this,
                         Manifest.permission.RECORD_AUDIO);
                 if (status != PackageManager.PERMISSION_GRANTED) {
@@ -313,12 +319,29 @@ public class NativeAudio extends Activity
 
     // Single out recording for run-permission needs
     static boolean created = false;
+    static boolean isRecording = false;
     private void recordAudio() {
         if (!created) {
             created = createAudioRecorder();
         }
         if (created) {
-            startRecording();
+            // recording streams until stopped, the whole of it goes to the file
+            File file = new File(getFilesDir(), "recording.wav");
+            isRecording = startRecording(file.getAbsolutePath());
+            if (isRecording) {
+                ((Button) findViewById(R.id.record)).setText(R.string.stop_recording);
+            }
+        }
+    }
+
+    private void stopRecordingAudio() {
+        int dropped = stopRecording();
+        isRecording = false;
+        ((Button) findViewById(R.id.record)).setText(R.string.record);
+        if (dropped > 0) {
+            Toast.makeText(NativeAudio.this,
+                    getString(R.string.recording_overruns, dropped),
+                    Toast.LENGTH_SHORT).show();
         }
     }
 
@@ -327,6 +350,9 @@ public class NativeAudio extends Activity
     protected void onPause()
     {
         // turn off all audio
+        if (isRecording) {
+            stopRecordingAudio();
+        }
         selectClip(CLIP_NONE, 0);
         isPlayingAsset = false;
         setPlayingAssetAudioPlayer(false);
@@ -393,7 +419,8 @@ public class NativeAudio extends Activity
     public static native boolean selectClip(int which, int count);
     public static native boolean enableReverb(boolean enabled);
     public static native boolean createAudioRecorder();
-    public static native void startRecording();
+    public static native boolean startRecording(String path);
+    public static native int stopRecording();
     public static native void shutdown();
 
     /** Load jni .so on initialization */
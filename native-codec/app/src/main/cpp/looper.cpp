@@ -19,15 +19,16 @@
 #include <assert.h>
 #include <jni.h>
 #include <pthread.h>
+#include <poll.h>
+#include <sched.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 #include <errno.h>
-#include <limits.h>
-#include <semaphore.h>
+#include <algorithm>
 
 // for __android_log_print(ANDROID_LOG_INFO, "YourApp", "formatted message");
 #include <android/log.h>
@@ -41,10 +42,26 @@ typedef struct loopermessage loopermessage;
 struct loopermessage {
     int what;
     void *obj;
-    loopermessage *next;
+    std::atomic<loopermessage*> next;
     bool quit;
+    bool heap;                // allocated as the pool was empty
+    bool coalesced;           // holds its bit of pendingmask
+    bool delayed;
+    uint32_t epoch;
+    int64_t when;             // posted, or due for delayed messages
+    std::atomic<bool> used;   // pool messages only
 };
 
+static int64_t nanotime() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// timer heap order: the earliest message on top
+static bool later(const loopermessage *a, const loopermessage *b) {
+    return a->when > b->when;
+}
 
 
 void* looper::trampoline(void* p) {
@@ -52,14 +69,27 @@ void* looper::trampoline(void* p) {
     return NULL;
 }
 
-looper::looper() {
-    sem_init(&headdataavailable, 0, 0);
-    sem_init(&headwriteprotect, 0, 1);
+looper::looper() :
+        nextfree(0), epoch(0), coalescemask(0), pendingmask(0),
+        sleeping(false), posted(0), coalesced(0), overflowed(0),
+        handled(0), dropped(0), lastlatency(0), maxlatency(0),
+        totallatency(0) {
+    pool = new loopermessage[kPoolSize];
+    for (int i = 0; i < kPoolSize; i++) {
+        pool[i].used.store(false, std::memory_order_relaxed);
+    }
+    stub = new loopermessage();
+    stub->next.store(NULL, std::memory_order_relaxed);
+    head = stub;
+    tail.store(stub);
+    timers.reserve(kPoolSize);
+    wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    assert(wakefd >= 0);
+
     pthread_attr_t attr;
     pthread_attr_init(&attr);
-
-    pthread_create(&worker, &attr, trampoline, this);
     running = true;
+    pthread_create(&worker, &attr, trampoline, this);
 }
 
 
@@ -68,85 +98,277 @@ looper::~looper() {
         LOGV("Looper deleted while still running. Some messages will not be processed");
         quit();
     }
+    close(wakefd);
+    delete stub;
+    delete[] pool;
 }
 
-void looper::post(int what, void *data, bool flush) {
+void looper::coalesce(int what) {
+    assert(what >= 0 && what < 32);
+    coalescemask |= 1u << what;
+}
+
+looperstats looper::stats() {
+    looperstats s;
+    s.posted = posted.load();
+    s.coalesced = coalesced.load();
+    s.overflowed = overflowed.load();
+    s.handled = handled.load();
+    s.dropped = dropped.load();
+    s.lastlatency = lastlatency.load();
+    s.maxlatency = maxlatency.load();
+    s.totallatency = totallatency.load();
+    return s;
+}
+
+/*
+ * Claim a free pool message; from any thread. Only the looper thread
+ * gives them back, so a message claimed here is never claimed twice.
+ */
+loopermessage *looper::alloc() {
+    for (int i = 0; i < kPoolSize; i++) {
+        loopermessage *msg = &pool[nextfree.fetch_add(1, std::memory_order_relaxed) % kPoolSize];
+        bool expected = false;
+        if (!msg->used.load(std::memory_order_relaxed) &&
+                msg->used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            msg->heap = false;
+            return msg;
+        }
+    }
+    overflowed++;
     loopermessage *msg = new loopermessage();
+    msg->heap = true;
+    return msg;
+}
+
+void looper::release(loopermessage *msg) {
+    if (msg->heap) {
+        delete msg;
+    } else {
+        msg->used.store(false, std::memory_order_release);
+    }
+}
+
+void looper::post(int what, void *data, bool flush) {
+    posted++;
+    bool coalescing = what >= 0 && what < 32 && (coalescemask & (1u << what));
+    // a flushing post is never coalesced; addmsg() hands it the bit
+    if (coalescing && !flush &&
+            (pendingmask.fetch_or(1u << what) & (1u << what))) {
+        coalesced++;
+        return;
+    }
+    loopermessage *msg = alloc();
     msg->what = what;
     msg->obj = data;
-    msg->next = NULL;
     msg->quit = false;
+    msg->coalesced = coalescing;
+    msg->delayed = false;
+    msg->when = nanotime();
     addmsg(msg, flush);
 }
 
-void looper::addmsg(loopermessage *msg, bool flush) {
-    sem_wait(&headwriteprotect);
-    loopermessage *h = head;
+void looper::postdelayed(int what, void *data, int64_t delayns) {
+    posted++;
+    loopermessage *msg = alloc();
+    msg->what = what;
+    msg->obj = data;
+    msg->quit = false;
+    msg->coalesced = false;
+    msg->delayed = true;
+    msg->when = nanotime() + std::max<int64_t>(delayns, 0);
+    addmsg(msg, false);
+}
 
+/*
+ * Append msg: swap it in as the tail, then link the old tail to it.
+ * Between the two a consumer sees the list end early, and waits for
+ * the link. A flushing post moves to a new epoch: messages of older
+ * ones are dropped instead of handled. msg takes the epoch once it is
+ * in place, so a flush queued ahead of it has always moved on by then.
+ * Dropped messages leave their pendingmask bits alone, so a flush
+ * clears them all, bar its own: a coalesced post pending behind it
+ * must not lose its bit to an older message being dropped.
+ */
+void looper::addmsg(loopermessage *msg, bool flush) {
     if (flush) {
-        while(h) {
-            loopermessage *next = h->next;
-            delete h;
-            h = next;
+        epoch.fetch_add(1);
+        pendingmask.store(msg->coalesced ? 1u << msg->what : 0);
+    }
+    msg->next.store(NULL, std::memory_order_relaxed);
+    loopermessage *prev = tail.exchange(msg);
+    msg->epoch = epoch.load();
+    prev->next.store(msg, std::memory_order_release);
+    if (sleeping.exchange(false)) {
+        uint64_t one = 1;
+        while (write(wakefd, &one, sizeof(one)) < 0 && errno == EINTR) {
         }
-        h = NULL;
     }
-    if (h) {
-        while (h->next) {
-            h = h->next;
+}
+
+/*
+ * Take the oldest message off the list; looper thread only.
+ * NULL when there is none, or the next one is not linked in yet.
+ */
+loopermessage *looper::pop() {
+    loopermessage *h = head;
+    loopermessage *next = h->next.load(std::memory_order_acquire);
+    if (h == stub) {
+        if (!next) {
+            return NULL;
         }
-        h->next = msg;
-    } else {
-        head = msg;
+        head = next;
+        h = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        head = next;
+        return h;
+    }
+    if (h != tail.load()) {
+        return NULL;
+    }
+    // h is the last one: leave the stub behind it to take it off
+    stub->next.store(NULL, std::memory_order_relaxed);
+    loopermessage *prev = tail.exchange(stub);
+    prev->next.store(stub, std::memory_order_release);
+    next = h->next.load(std::memory_order_acquire);
+    if (next) {
+        head = next;
+        return h;
+    }
+    return NULL;
+}
+
+bool looper::empty() {
+    return head == stub && tail.load() == stub;
+}
+
+/*
+ * Handle msg, or drop it if a flush came after it, and give it back
+ * return true for the quit message
+ */
+bool looper::dispatch(loopermessage *msg) {
+    if (msg->quit) {
+        LOGV("quitting");
+        release(msg);
+        return true;
+    }
+    if (msg->epoch != epoch.load()) {
+        dropped++;
+        release(msg);
+        return false;
     }
-    LOGV("post msg %d", msg->what);
-    sem_post(&headwriteprotect);
-    sem_post(&headdataavailable);
+    if (msg->coalesced) {
+        pendingmask.fetch_and(~(1u << msg->what));
+    }
+    int64_t latency = nanotime() - msg->when;
+    lastlatency.store(latency, std::memory_order_relaxed);
+    if (latency > maxlatency.load(std::memory_order_relaxed)) {
+        maxlatency.store(latency, std::memory_order_relaxed);
+    }
+    totallatency.fetch_add(latency, std::memory_order_relaxed);
+    handled++;
+    handle(msg->what, msg->obj);
+    release(msg);
+    return false;
+}
+
+/*
+ * Drop delayed messages flushed while they waited, or all of them
+ */
+void looper::purgetimers(bool all) {
+    uint32_t current = epoch.load();
+    auto end = std::remove_if(timers.begin(), timers.end(),
+            [this, all, current](loopermessage *msg) {
+                if (!all && msg->epoch == current) {
+                    return false;
+                }
+                dropped++;
+                release(msg);
+                return true;
+            });
+    timers.erase(end, timers.end());
+    std::make_heap(timers.begin(), timers.end(), later);
 }
 
 void looper::loop() {
+    uint32_t seenepoch = epoch.load();
     while(true) {
-        // wait for available message
-        sem_wait(&headdataavailable);
-
-        // get next available message
-        sem_wait(&headwriteprotect);
-        loopermessage *msg = head;
-        if (msg == NULL) {
-            LOGV("no msg");
-            sem_post(&headwriteprotect);
+        if (seenepoch != epoch.load()) {
+            seenepoch = epoch.load();
+            purgetimers(false);
+        }
+
+        int64_t now = nanotime();
+        if (!timers.empty() && timers.front()->when <= now) {
+            std::pop_heap(timers.begin(), timers.end(), later);
+            loopermessage *msg = timers.back();
+            timers.pop_back();
+            dispatch(msg);
+            continue;
+        }
+
+        loopermessage *msg = pop();
+        if (msg) {
+            if (msg->delayed && msg->when > now) {
+                timers.push_back(msg);
+                std::push_heap(timers.begin(), timers.end(), later);
+            } else if (dispatch(msg)) {
+                purgetimers(true);
+                return;
+            }
+            continue;
+        }
+        if (!empty()) {
+            // a post is half way through linking its message
+            sched_yield();
             continue;
         }
-        head = msg->next;
-        sem_post(&headwriteprotect);
 
-        if (msg->quit) {
-            LOGV("quitting");
-            delete msg;
-            return;
+        // sleep until a post wakes us, or the next timer is due
+        sleeping.store(true);
+        if (empty()) {
+            pollfd pfd = { wakefd, POLLIN, 0 };
+            if (timers.empty()) {
+                ppoll(&pfd, 1, NULL, NULL);
+            } else {
+                int64_t wait = timers.front()->when - now;
+                timespec timeout = { (time_t)(wait / 1000000000LL),
+                                     (long)(wait % 1000000000LL) };
+                ppoll(&pfd, 1, &timeout, NULL);
+            }
+        }
+        sleeping.store(false);
+        uint64_t count;
+        while (read(wakefd, &count, sizeof(count)) < 0 && errno == EINTR) {
         }
-        LOGV("processing msg %d", msg->what);
-        handle(msg->what, msg->obj);
-        delete msg;
     }
 }
 
 void looper::quit() {
     LOGV("quit");
-    loopermessage *msg = new loopermessage();
+    loopermessage *msg = alloc();
     msg->what = 0;
     msg->obj = NULL;
-    msg->next = NULL;
     msg->quit = true;
+    msg->coalesced = false;
+    msg->delayed = false;
+    msg->when = nanotime();
     addmsg(msg, false);
     void *retval;
     pthread_join(worker, &retval);
-    sem_destroy(&headdataavailable);
-    sem_destroy(&headwriteprotect);
     running = false;
+
+    looperstats s = stats();
+    LOGV("%lld handled, %lld coalesced, %lld dropped, %lld overflowed; "
+         "latency avg %lld max %lld ns",
+         (long long)s.handled, (long long)s.coalesced, (long long)s.dropped,
+         (long long)s.overflowed,
+         (long long)(s.handled ? s.totallatency / s.handled : 0),
+         (long long)s.maxlatency);
 }
 
 void looper::handle(int what, void* obj) {
     LOGV("dropping msg %d %p", what, obj);
 }
-
@@ -15,10 +15,34 @@
  */
 
 #include <pthread.h>
-#include <semaphore.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
 
 struct loopermessage;
 
+/*
+ * Counters since the looper was created; times in nanoseconds, from a
+ * message being posted (or falling due) to its handle() call
+ */
+struct looperstats {
+    int64_t posted;
+    int64_t coalesced;   // posts dropped as one of their kind was pending
+    int64_t overflowed;  // posts that found the message pool empty
+    int64_t handled;
+    int64_t dropped;     // flushed before they were handled
+    int64_t lastlatency;
+    int64_t maxlatency;
+    int64_t totallatency;
+};
+
+/*
+ * Messages are taken from a pool allocated with the looper and queued
+ * on an intrusive multi-producer, single-consumer list: post() is an
+ * atomic exchange on the tail, and wakes the looper thread through an
+ * eventfd only when it is asleep. Delayed messages wait in a timer heap
+ * kept by the looper thread.
+ */
 class looper {
     public:
         looper();
@@ -27,17 +51,47 @@ class looper {
         virtual ~looper();
 
         void post(int what, void *data, bool flush = false);
+        void postdelayed(int what, void *data, int64_t delayns);
         void quit();
 
+        // posts of what while one is pending are dropped, data with them;
+        // what < 32, set up before the first post
+        void coalesce(int what);
+
+        looperstats stats();
+
         virtual void handle(int what, void *data);
 
     private:
+        static const int kPoolSize = 64;
+
+        loopermessage *alloc();
+        void release(loopermessage *msg);
         void addmsg(loopermessage *msg, bool flush);
+        loopermessage *pop();
+        bool empty();
+        bool dispatch(loopermessage *msg);
+        void purgetimers(bool all);
         static void* trampoline(void* p);
         void loop();
-        loopermessage *head;
+
+        loopermessage *pool;
+        std::atomic<uint32_t> nextfree;
+        loopermessage *stub;
+        loopermessage *head;                 // looper thread only
+        std::atomic<loopermessage*> tail;
+        std::vector<loopermessage*> timers;  // heap, earliest first
+
+        std::atomic<uint32_t> epoch;         // bumped by flushing posts
+        uint32_t coalescemask;
+        std::atomic<uint32_t> pendingmask;   // coalesced whats queued
+
+        int wakefd;
+        std::atomic<bool> sleeping;
         pthread_t worker;
-        sem_t headwriteprotect;
-        sem_t headdataavailable;
         bool running;
+
+        std::atomic<int64_t> posted, coalesced, overflowed;
+        std::atomic<int64_t> handled, dropped;
+        std::atomic<int64_t> lastlatency, maxlatency, totallatency;
 };
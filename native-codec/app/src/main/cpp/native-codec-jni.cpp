@@ -76,7 +76,14 @@ enum {
 
 
 class mylooper: public looper {
-    virtual void handle(int what, void* obj);
+    public:
+        mylooper() {
+            // resume, seek and the buffer itself may all ask for more work:
+            // one pending kMsgCodecBuffer does it
+            coalesce(kMsgCodecBuffer);
+        }
+    private:
+        virtual void handle(int what, void* obj);
 };
 
 static mylooper *mlooper = NULL;
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stress test for the native-codec looper:
+ *   - FIFO order per producer with several producers, pool overflow included
+ *   - delayed messages fire in due order, never early
+ *   - coalescing, and coalesced whats across flushes
+ *   - flushes drop what was queued before them, and nothing queued after
+ *
+ *   looper_test [posts-per-producer]
+ *
+ * Exits non-zero if any check fails.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+#include <android/log.h>
+#include "looper.h"
+
+namespace {
+
+const int kProducers = 4;
+
+enum {
+    kMsgGate = 0,       // holds the looper until the gate opens
+    kMsgSeq = 1,        // .. kMsgSeq + kProducers - 1; data is a sequence
+    kMsgTimer = 10,     // data is the delay in ms
+    kMsgFlush = 11,
+    kMsgCoalesced = 12,
+};
+
+int64_t nanotime() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// poll until done() or timeoutms have passed; return done()
+template <typename F>
+bool waitfor(F done, int timeoutms) {
+    int64_t end = nanotime() + timeoutms * 1000000LL;
+    while (!done()) {
+        if (nanotime() > end) {
+            return done();
+        }
+        usleep(100);
+    }
+    return true;
+}
+
+class testlooper : public looper {
+    public:
+        testlooper() : gateopen(true), ingate(false), seqcount(0),
+                timerbase(0), flushes(0), droppedatflush(0),
+                coalescedcount(0), coalescedsleepus(0) {
+            coalesce(kMsgCoalesced);
+        }
+
+        // stop the looper thread in a handler until open()
+        void shut() {
+            gateopen.store(false);
+            post(kMsgGate, NULL);
+            while (!ingate.load()) {
+                usleep(100);
+            }
+        }
+        void open() {
+            gateopen.store(true);
+        }
+
+        void handle(int what, void *data) override {
+            if (what == kMsgGate) {
+                ingate.store(true);
+                while (!gateopen.load()) {
+                    usleep(100);
+                }
+                ingate.store(false);
+            } else if (what >= kMsgSeq && what < kMsgSeq + kProducers) {
+                seq[what - kMsgSeq].push_back((long)data);
+                seqcount++;
+            } else if (what == kMsgTimer) {
+                timers.push_back({(long)data, nanotime() - timerbase});
+            } else if (what == kMsgFlush) {
+                // everything queued ahead of this flush is gone by now
+                droppedatflush.store(stats().dropped);
+                flushes++;
+            } else if (what == kMsgCoalesced) {
+                coalescedcount++;
+                if (coalescedsleepus) {
+                    usleep(coalescedsleepus);
+                }
+            }
+        }
+
+        std::atomic<bool> gateopen, ingate;
+        // looper thread only, until quit()
+        std::vector<long> seq[kProducers];
+        std::atomic<long> seqcount;
+        struct timerfire {
+            long delayms;
+            int64_t firedns;    // since timerbase
+        };
+        std::vector<timerfire> timers;
+        int64_t timerbase;
+        std::atomic<int> flushes;
+        std::atomic<int64_t> droppedatflush;
+        std::atomic<int> coalescedcount;
+        int coalescedsleepus;
+};
+
+int check(bool ok, const char *what) {
+    if (!ok) {
+        printf("  FAILED: %s\n", what);
+    }
+    return ok ? 0 : 1;
+}
+
+int testfifo(long posts) {
+    testlooper l;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&l, p, posts] {
+            for (long i = 0; i < posts; i++) {
+                l.post(kMsgSeq + p, (void *)i);
+            }
+        });
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    int bad = check(waitfor([&l, posts] {
+        return l.seqcount.load() == kProducers * posts;
+    }, 10000), "every message handled");
+    l.quit();
+
+    for (int p = 0; p < kProducers; p++) {
+        bool inorder = (long)l.seq[p].size() == posts;
+        for (long i = 0; inorder && i < posts; i++) {
+            inorder = l.seq[p][i] == i;
+        }
+        bad += check(inorder, "FIFO order per producer");
+    }
+    looperstats s = l.stats();
+    printf("fifo: %d x %ld posts, %lld overflowed the pool, "
+           "latency avg %lld max %lld ns\n", kProducers, posts,
+           (long long)s.overflowed,
+           (long long)(s.handled ? s.totallatency / s.handled : 0),
+           (long long)s.maxlatency);
+    return bad;
+}
+
+int testdelayed() {
+    testlooper l;
+    const long delays[] = { 50, 10, 30, 20, 40, 5 };
+    const size_t count = sizeof(delays) / sizeof(delays[0]);
+    l.timerbase = nanotime();
+    for (long d : delays) {
+        l.postdelayed(kMsgTimer, (void *)d, d * 1000000LL);
+    }
+    usleep(120000);
+    l.quit();
+
+    int bad = check(l.timers.size() == count, "every delayed message fired");
+    int64_t maxlate = 0;
+    for (size_t i = 0; i < l.timers.size(); i++) {
+        int64_t late = l.timers[i].firedns - l.timers[i].delayms * 1000000LL;
+        bad += check(late >= 0, "delayed message not early");
+        bad += check(!i || l.timers[i - 1].delayms <= l.timers[i].delayms,
+                     "delayed messages in due order");
+        maxlate = std::max(maxlate, late);
+    }
+    printf("delayed: %zu fired, at most %lld us late\n", l.timers.size(),
+           (long long)maxlate / 1000);
+    return bad;
+}
+
+int testcoalesce() {
+    testlooper l;
+    const int posts = 100000;
+    l.coalescedsleepus = 100;
+    for (int i = 0; i < posts; i++) {
+        l.post(kMsgCoalesced, NULL);
+    }
+    // the quit message queues behind the last of them
+    l.quit();
+    looperstats s = l.stats();
+    int bad = check(l.coalescedcount.load() + s.coalesced == posts,
+                    "each post handled or coalesced");
+    bad += check(l.coalescedcount.load() < posts / 100, "posts coalesced");
+    printf("coalesce: %d handled of %d posts\n", l.coalescedcount.load(),
+           posts);
+    return bad;
+}
+
+int testflush() {
+    int bad = 0;
+    {
+        // drops the messages and timers queued before it
+        testlooper l;
+        l.shut();
+        for (long i = 0; i < 50; i++) {
+            l.post(kMsgSeq, (void *)i);
+        }
+        l.postdelayed(kMsgTimer, (void *)20L, 20000000LL);
+        l.post(kMsgFlush, NULL, true);
+        l.open();
+        usleep(40000);
+        l.quit();
+        bad += check(l.seq[0].empty() && l.timers.empty(),
+                     "flush drops older messages and timers");
+        bad += check(l.flushes.load() == 1, "flushing message handled");
+        bad += check(l.stats().dropped == 51, "dropped count");
+    }
+    {
+        // a flushing post of a coalesced what takes over its pending bit
+        testlooper l;
+        l.shut();
+        l.post(kMsgCoalesced, NULL);
+        l.post(kMsgCoalesced, NULL, true);
+        l.post(kMsgCoalesced, NULL);
+        l.open();
+        bad += check(waitfor([&l] { return l.coalescedcount.load() == 1; },
+                             1000), "flushing post of a coalesced what");
+        usleep(10000);
+        bad += check(l.coalescedcount.load() == 1 && l.stats().coalesced == 1,
+                     "post behind it coalesced");
+        l.post(kMsgCoalesced, NULL);
+        bad += check(waitfor([&l] { return l.coalescedcount.load() == 2; },
+                             1000), "coalesced what posted again");
+        l.quit();
+    }
+    {
+        // a coalesced message dropped by another flush leaves no bit set
+        testlooper l;
+        l.shut();
+        l.post(kMsgCoalesced, NULL);
+        l.post(kMsgFlush, NULL, true);
+        l.open();
+        waitfor([&l] { return l.flushes.load() == 1; }, 1000);
+        l.post(kMsgCoalesced, NULL);
+        bad += check(waitfor([&l] { return l.coalescedcount.load() == 1; },
+                             1000), "coalesced what posted after its drop");
+        l.quit();
+    }
+    printf("flush: %s\n", bad ? "failed" : "ok");
+    return bad;
+}
+
+/*
+ * Producers post without pause while flushes come in from another thread:
+ * whatever a flush drops must have been queued ahead of it, so the drop
+ * count stays put between a flush being handled and the next one.
+ */
+int testflushrace() {
+    const int rounds = 500;
+    testlooper l;
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&l, &stop, p] {
+            for (long i = 0; !stop.load(); i++) {
+                l.post(kMsgSeq + p, (void *)i);
+                if (!(i & 15)) {
+                    l.post(kMsgCoalesced, NULL);
+                }
+            }
+        });
+    }
+
+    int bad = 0, late = 0;
+    for (int r = 0; r < rounds && !bad; r++) {
+        l.post(kMsgFlush, NULL, true);
+        bad += check(waitfor([&l, r] { return l.flushes.load() == r + 1; },
+                             5000), "flushing message handled");
+        usleep(200);
+        late += l.stats().dropped != l.droppedatflush.load();
+    }
+    stop.store(true);
+    for (auto &t : producers) {
+        t.join();
+    }
+    bad += check(!late, "no message queued behind a flush dropped");
+
+    // drained: a coalesced what must still get through
+    usleep(10000);
+    int before = l.coalescedcount.load();
+    l.post(kMsgCoalesced, NULL);
+    bad += check(waitfor([&l, before] {
+        return l.coalescedcount.load() > before;
+    }, 1000), "no pending bit left behind");
+    l.quit();
+
+    for (int p = 0; p < kProducers; p++) {
+        bool inorder = true;
+        for (size_t i = 1; inorder && i < l.seq[p].size(); i++) {
+            inorder = l.seq[p][i - 1] < l.seq[p][i];
+        }
+        bad += check(inorder, "FIFO order per producer across flushes");
+    }
+    looperstats s = l.stats();
+    printf("flush race: %d flushes, %lld handled, %lld dropped, "
+           "%lld coalesced, %d dropped late\n", rounds, (long long)s.handled,
+           (long long)s.dropped, (long long)s.coalesced, late);
+    return bad;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    long posts = argc > 1 ? atol(argv[1]) : 200000;
+    if (posts <= 0) {
+        fprintf(stderr, "usage: %s [posts-per-producer]\n", argv[0]);
+        return 2;
+    }
+    // the looper logs each quit
+    AndroidLogHostMinPriority() = ANDROID_LOG_INFO;
+
+    int bad = testfifo(posts);
+    bad += testdelayed();
+    bad += testcoalesce();
+    bad += testflush();
+    bad += testflushrace();
+    printf("%s\n", bad ? "FAILED" : "PASSED");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <smmintrin.h>
+#include "plasma-kernels.h"
+
+/*
+ * SSE4.1 kernel, 8 pixels per iteration: the palette index is worked out
+ * in two registers of 32-bit lanes ( abs and min_epi32 are SSSE3 / SSE4.1 ),
+ * packed to 16-bit lanes and turned into RGB565 there.
+ */
+static inline __m128i
+palette_565(__m128i idx)
+{
+    const __m128i c255 = _mm_set1_epi16(255);
+    __m128i seg  = _mm_srli_epi16(idx, 6);
+    /* jj = (idx % 64) * 4 * 255 / 256, at most 64260 before the shift */
+    __m128i jj   = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(idx, _mm_set1_epi16(63)),
+                                                  _mm_set1_epi16(1020)), 8);
+    __m128i inv  = _mm_sub_epi16(c255, jj);
+    __m128i s0   = _mm_cmpeq_epi16(seg, _mm_setzero_si128());
+    __m128i s1   = _mm_cmpeq_epi16(seg, _mm_set1_epi16(1));
+    __m128i s2   = _mm_cmpeq_epi16(seg, _mm_set1_epi16(2));
+    __m128i s3   = _mm_cmpeq_epi16(seg, _mm_set1_epi16(3));
+
+    /* ramps: (255, jj, inv) (inv, 255, jj) (0, inv, 255) (jj, 0, 255) */
+    __m128i r = _mm_or_si128(_mm_or_si128(_mm_and_si128(s0, c255), _mm_and_si128(s1, inv)),
+                             _mm_and_si128(s3, jj));
+    __m128i g = _mm_or_si128(_mm_or_si128(_mm_and_si128(s0, jj), _mm_and_si128(s1, c255)),
+                             _mm_and_si128(s2, inv));
+    __m128i b = _mm_or_si128(_mm_or_si128(_mm_and_si128(s0, inv), _mm_and_si128(s1, jj)),
+                             _mm_and_si128(_mm_or_si128(s2, s3), c255));
+
+    r = _mm_and_si128(_mm_slli_epi16(r, 8), _mm_set1_epi16((short)0xf800));
+    g = _mm_and_si128(_mm_slli_epi16(g, 3), _mm_set1_epi16(0x07e0));
+    b = _mm_srli_epi16(b, 3);
+    return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+/* swap the pixels of each 32-bit word */
+static inline __m128i
+swap_pairs(__m128i px)
+{
+    return _mm_or_si128(_mm_slli_epi32(px, 16), _mm_srli_epi32(px, 16));
+}
+
+static inline __m128i
+palette_index(const int32_t* xsum, __m128i base)
+{
+    const __m128i clamp = _mm_set1_epi32(0xffff);
+    __m128i v = _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)xsum), base), 2);
+    return _mm_srli_epi32(_mm_min_epi32(_mm_abs_epi32(v), clamp), 8);
+}
+
+int
+plasma_row_sse41_x8(uint16_t* line, const int32_t* xsum, int32_t base, int width)
+{
+    const __m128i vbase = _mm_set1_epi32(base);
+    int nn;
+
+    for (nn = 0; nn + 8 <= width; nn += 8) {
+        __m128i idx = _mm_packs_epi32(palette_index(xsum + nn, vbase),
+                                      palette_index(xsum + nn + 4, vbase));
+        _mm_storeu_si128((__m128i*)(line + nn), swap_pairs(palette_565(idx)));
+    }
+    return nn;
+}
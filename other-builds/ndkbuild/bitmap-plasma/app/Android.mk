@@ -19,12 +19,45 @@ LOCAL_PATH := $(call my-dir)
 PROJECT_DIR :=bitmap-plasma
 JNI_SRC_PATH := $(call abspath_wa, $(LOCAL_PATH)/../../../../$(PROJECT_DIR)/app/src/main/cpp)
 
+# ndk-build has no per-file flags, so the x86 row kernels get modules of their
+# own; plasma.c only dispatches to them when cpufeatures reports the ISA
+ifeq ($(TARGET_ARCH_ABI),$(filter $(TARGET_ARCH_ABI), x86 x86_64))
+include $(CLEAR_VARS)
+LOCAL_MODULE    := plasma-kernels-sse41
+LOCAL_SRC_FILES := $(JNI_SRC_PATH)/plasma-kernels-sse41.c
+LOCAL_CFLAGS    := -Wall -Werror -msse4.1 -DHAVE_PLASMA_SSE41=1 -DHAVE_PLASMA_AVX2=1
+include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE    := plasma-kernels-avx2
+LOCAL_SRC_FILES := $(JNI_SRC_PATH)/plasma-kernels-avx2.c
+LOCAL_CFLAGS    := -Wall -Werror -mavx2 -DHAVE_PLASMA_SSE41=1 -DHAVE_PLASMA_AVX2=1
+include $(BUILD_STATIC_LIBRARY)
+endif
+
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := plasma
 LOCAL_SRC_FILES := $(JNI_SRC_PATH)/plasma.c
+LOCAL_C_INCLUDES := $(call abspath_wa, $(LOCAL_PATH)/../../../../common/frame_stats)
 LOCAL_LDLIBS    := -lm -llog -ljnigraphics
 LOCAL_CFLAGS    := -Wall -Werror -Wno-unused-function
+LOCAL_STATIC_LIBRARIES := cpufeatures
+
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+    LOCAL_CFLAGS    += -DHAVE_PLASMA_NEON=1
+    LOCAL_SRC_FILES += $(JNI_SRC_PATH)/plasma-kernels-neon.c.neon
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+    LOCAL_CFLAGS    += -DHAVE_PLASMA_NEON=1
+    LOCAL_SRC_FILES += $(JNI_SRC_PATH)/plasma-kernels-neon.c
+endif
+ifeq ($(TARGET_ARCH_ABI),$(filter $(TARGET_ARCH_ABI), x86 x86_64))
+    LOCAL_CFLAGS    += -DHAVE_PLASMA_SSE41=1 -DHAVE_PLASMA_AVX2=1
+    LOCAL_STATIC_LIBRARIES += plasma-kernels-sse41 plasma-kernels-avx2
+endif
 
 NDK_TOOLCHAIN_VERSION := clang
 include $(BUILD_SHARED_LIBRARY)
+
+$(call import-module,android/cpufeatures)
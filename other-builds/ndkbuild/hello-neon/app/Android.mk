@@ -3,11 +3,21 @@ abspath_wa = $(join $(filter %:,$(subst :,: ,$1)),$(abspath $(filter-out %:,$(su
 LOCAL_PATH := $(call my-dir)
 JNI_SRC_PATH := $(call abspath_wa, $(LOCAL_PATH)/../../../../hello-neon/app/src/main/cpp)
 
+# ndk-build has no per-file flags, so the AVX2 FIR kernel lives in its own module
+ifeq ($(TARGET_ARCH_ABI),$(filter $(TARGET_ARCH_ABI), x86 x86_64))
+include $(CLEAR_VARS)
+LOCAL_MODULE := fir-avx2
+LOCAL_SRC_FILES := $(JNI_SRC_PATH)/fir-kernels-avx2.c
+LOCAL_CFLAGS := -mavx2 -DHAVE_FIR_SSE2=1 -DHAVE_FIR_AVX2=1
+include $(BUILD_STATIC_LIBRARY)
+endif
+
 include $(CLEAR_VARS)
 
 LOCAL_MODULE := hello-neon
 
-LOCAL_SRC_FILES := $(JNI_SRC_PATH)/helloneon.c
+LOCAL_SRC_FILES := $(JNI_SRC_PATH)/helloneon.c \
+                   $(JNI_SRC_PATH)/fir-engine.c
 
 ifeq ($(TARGET_ARCH_ABI),$(filter $(TARGET_ARCH_ABI), armeabi-v7a x86))
     LOCAL_CFLAGS := -DHAVE_NEON=1
@@ -17,7 +27,23 @@ endif
     LOCAL_SRC_FILES += $(JNI_SRC_PATH)/helloneon-intrinsics.c.neon
 endif
 
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+    LOCAL_CFLAGS += -DHAVE_FIR_NEON=1
+    LOCAL_SRC_FILES += $(JNI_SRC_PATH)/fir-kernels-neon.c.neon
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+    LOCAL_CFLAGS += -DHAVE_FIR_NEON=1
+    LOCAL_SRC_FILES += $(JNI_SRC_PATH)/fir-kernels-neon.c
+endif
+ifeq ($(TARGET_ARCH_ABI),$(filter $(TARGET_ARCH_ABI), x86 x86_64))
+    LOCAL_CFLAGS += -DHAVE_FIR_SSE2=1 -DHAVE_FIR_AVX2=1
+    LOCAL_SRC_FILES += $(JNI_SRC_PATH)/fir-kernels-sse2.c
+endif
+
 LOCAL_STATIC_LIBRARIES := cpufeatures
+ifeq ($(TARGET_ARCH_ABI),$(filter $(TARGET_ARCH_ABI), x86 x86_64))
+LOCAL_STATIC_LIBRARIES += fir-avx2
+endif
 
 LOCAL_LDLIBS := -llog
 
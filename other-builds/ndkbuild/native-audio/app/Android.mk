@@ -20,7 +20,10 @@ JNI_SRC_PATH := $(call abspath_wa, $(LOCAL_PATH)/../../../../native-audio/app/sr
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := native-audio-jni
-LOCAL_SRC_FILES := $(JNI_SRC_PATH)/native-audio-jni.c
+LOCAL_SRC_FILES := $(JNI_SRC_PATH)/native-audio-jni.c \
+                   $(JNI_SRC_PATH)/resampler.c \
+                   $(JNI_SRC_PATH)/recorder_stream.c \
+                   $(JNI_SRC_PATH)/wav_writer.c
 # for native audio
 LOCAL_LDLIBS    += -lOpenSLES
 # for logging
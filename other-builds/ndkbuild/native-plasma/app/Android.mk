@@ -16,12 +16,43 @@ abspath_wa = $(join $(filter %:,$(subst :,: ,$1)),$(abspath $(filter-out %:,$(su
 
 LOCAL_PATH := $(call my-dir)
 JNI_SRC_PATH := $(call abspath_wa, $(LOCAL_PATH)/../../../../native-plasma/app/src/main/cpp)
+
+# ndk-build has no per-file flags, so the x86 row kernels get modules of their
+# own; plasma.c only dispatches to them when cpufeatures reports the ISA
+ifeq ($(TARGET_ARCH_ABI),$(filter $(TARGET_ARCH_ABI), x86 x86_64))
+include $(CLEAR_VARS)
+LOCAL_MODULE    := plasma-kernels-sse41
+LOCAL_SRC_FILES := $(JNI_SRC_PATH)/plasma-kernels-sse41.c
+LOCAL_CFLAGS    := -msse4.1 -DHAVE_PLASMA_SSE41=1 -DHAVE_PLASMA_AVX2=1
+include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE    := plasma-kernels-avx2
+LOCAL_SRC_FILES := $(JNI_SRC_PATH)/plasma-kernels-avx2.c
+LOCAL_CFLAGS    := -mavx2 -DHAVE_PLASMA_SSE41=1 -DHAVE_PLASMA_AVX2=1
+include $(BUILD_STATIC_LIBRARY)
+endif
+
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := native-plasma
 LOCAL_SRC_FILES := $(JNI_SRC_PATH)/plasma.c
+LOCAL_C_INCLUDES := $(call abspath_wa, $(LOCAL_PATH)/../../../../common/frame_stats)
 LOCAL_LDLIBS    := -lm -llog -landroid
-LOCAL_STATIC_LIBRARIES := android_native_app_glue
+LOCAL_STATIC_LIBRARIES := android_native_app_glue cpufeatures
+
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+    LOCAL_CFLAGS    += -DHAVE_PLASMA_NEON=1
+    LOCAL_SRC_FILES += $(JNI_SRC_PATH)/plasma-kernels-neon.c.neon
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+    LOCAL_CFLAGS    += -DHAVE_PLASMA_NEON=1
+    LOCAL_SRC_FILES += $(JNI_SRC_PATH)/plasma-kernels-neon.c
+endif
+ifeq ($(TARGET_ARCH_ABI),$(filter $(TARGET_ARCH_ABI), x86 x86_64))
+    LOCAL_CFLAGS    += -DHAVE_PLASMA_SSE41=1 -DHAVE_PLASMA_AVX2=1
+    LOCAL_STATIC_LIBRARIES += plasma-kernels-sse41 plasma-kernels-avx2
+endif
 
 # Force export ANativeActivity_onCreate(), 
 # Refer to: https://github.com/android-ndk/ndk/issues/381.
@@ -31,3 +62,4 @@ LOCAL_LDFLAGS   := -u ANativeActivity_onCreate
 include $(BUILD_SHARED_LIBRARY)
 
 $(call import-module,android/native_app_glue)
+$(call import-module,android/cpufeatures)
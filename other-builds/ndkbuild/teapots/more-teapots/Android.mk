@@ -21,7 +21,8 @@ LOCAL_SRC_FILES := $(JNI_SRC_PATH)/MoreTeapotsNativeActivity.cpp \
                    $(NDK_HELPER_SRC)/shader.cpp \
                    $(NDK_HELPER_SRC)/gl3stub.c
 
-LOCAL_C_INCLUDES := $(JNI_SRC_PATH) $(NDK_HELPER_SRC)
+FRAME_STATS_DIR := $(call abspath_wa, $(LOCAL_PATH)/../../../../common/frame_stats)
+LOCAL_C_INCLUDES := $(JNI_SRC_PATH) $(NDK_HELPER_SRC) $(FRAME_STATS_DIR)
 LOCAL_CPPFLAGS += -std=c++11
 
 LOCAL_LDLIBS    := -llog -landroid -lEGL -lGLESv2 -latomic
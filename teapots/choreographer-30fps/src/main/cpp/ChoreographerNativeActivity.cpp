@@ -193,6 +193,10 @@ void Engine::CheckAPISupport() {
 
 void Engine::StartFPSThrottle() {
   api_mode_ = original_api_mode_;
+  // Count jank against the throttled frame period when there is one.
+  monitor_.SetTargetFrameTime(api_mode_ == kAPINone
+                                  ? 1.0 / 60.0
+                                  : kFPSThrottlePresentationInterval * 1e-9);
   if (api_mode_ == kAPINativeChoreographer) {
     // Initiate choreographer callback.
     StartChoreographer();
@@ -210,6 +214,7 @@ void Engine::StopFPSThrottle() {
     StopJavaChoreographer();
   }
   api_mode_ = kAPINone;
+  monitor_.SetTargetFrameTime(1.0 / 60.0);
 }
 
 void Engine::DoSwap() {
@@ -510,6 +515,8 @@ void Engine::HandleCmd(struct android_app* app, int32_t cmd) {
       // Also stop animating.
       eng->has_focus_ = false;
       eng->DrawFrame();
+      // The next frame comes after the pause, not one frame period later.
+      eng->monitor_.Reset();
       break;
     case APP_CMD_LOW_MEMORY:
       // Free up GL resources
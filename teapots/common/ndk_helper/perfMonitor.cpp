@@ -18,38 +18,26 @@
 
 namespace ndk_helper {
 
-PerfMonitor::PerfMonitor()
-    : current_FPS_(0),
-      tv_last_sec_(0),
-      last_tick_(0.f),
-      tickindex_(0),
-      ticksum_(0) {
-  for (int32_t i = 0; i < kNumSamples; ++i) ticklist_[i] = 0;
+const int64_t kReportPeriod = 1000000000LL;
+
+PerfMonitor::PerfMonitor() : current_FPS_(0), header_logged_(false) {
+  frame_stats_init(&stats_, FRAME_STATS_60HZ_NS, kReportPeriod);
 }
 
 PerfMonitor::~PerfMonitor() {}
 
-double PerfMonitor::UpdateTick(double currentTick) {
-  ticksum_ -= ticklist_[tickindex_];
-  ticksum_ += currentTick;
-  ticklist_[tickindex_] = currentTick;
-  tickindex_ = (tickindex_ + 1) % kNumSamples;
-
-  return ((double)ticksum_ / kNumSamples);
-}
-
 bool PerfMonitor::Update(float &fFPS) {
-  struct timeval Time;
-  gettimeofday(&Time, NULL);
-
-  double time = Time.tv_sec + Time.tv_usec * 1.0 / 1000000.0;
-  double tick = time - last_tick_;
-  double d = UpdateTick(tick);
-  last_tick_ = time;
-
-  if (Time.tv_sec - tv_last_sec_ >= 1) {
-    current_FPS_ = 1.f / d;
-    tv_last_sec_ = Time.tv_sec;
+  if (frame_stats_tick(&stats_)) {
+    FrameStatsSnapshot snapshot;
+    char row[512];
+    frame_stats_snapshot(&stats_, &snapshot);
+    current_FPS_ = static_cast<float>(frame_stats_fps(&snapshot));
+    if (!header_logged_) {
+      LOGI("frame stats: %s", FRAME_STATS_CSV_HEADER);
+      header_logged_ = true;
+    }
+    frame_stats_csv(&snapshot, row, sizeof(row));
+    LOGI("frame stats: %s", row);
     fFPS = current_FPS_;
     return true;
   } else {
@@ -58,4 +46,14 @@ bool PerfMonitor::Update(float &fFPS) {
   }
 }
 
+void PerfMonitor::SetTargetFrameTime(double seconds) {
+  frame_stats_set_target(&stats_, static_cast<int64_t>(seconds * 1e9));
+}
+
+void PerfMonitor::Reset() { frame_stats_reset_clock(&stats_); }
+
+bool PerfMonitor::GetSnapshot(FrameStatsSnapshot *snapshot) const {
+  return frame_stats_snapshot(&stats_, snapshot) != 0;
+}
+
 }  // namespace ndkHelper
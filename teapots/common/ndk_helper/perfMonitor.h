@@ -21,25 +21,22 @@
 #include <errno.h>
 #include <time.h>
 #include "JNIHelper.h"
+#include "frame_stats.h"
 
 namespace ndk_helper {
 
-const int32_t kNumSamples = 100;
-
 /******************************************************************
  * Helper class for a performance monitoring and get current tick time
+ *
+ * Frame intervals go into a FrameStats from frame_stats.h: once a second
+ * Update() reports the FPS and logs the period's frame time percentiles
+ * and jank count as a CSV row.
  */
 class PerfMonitor {
  private:
   float current_FPS_;
-  time_t tv_last_sec_;
-
-  double last_tick_;
-  int32_t tickindex_;
-  double ticksum_;
-  double ticklist_[kNumSamples];
-
-  double UpdateTick(double current_tick);
+  bool header_logged_;
+  FrameStats stats_;
 
  public:
   PerfMonitor();
@@ -47,12 +44,14 @@ class PerfMonitor {
 
   bool Update(float &fFPS);
 
-  static double GetCurrentTime() {
-    struct timeval time;
-    gettimeofday(&time, NULL);
-    double ret = time.tv_sec + time.tv_usec * 1.0 / 1000000.0;
-    return ret;
-  }
+  // Frame period that jank is counted against, 60Hz by default.
+  void SetTargetFrameTime(double seconds);
+  // Forget the last frame, e.g. on resume, so a pause is not a janky frame.
+  void Reset();
+  // Last published report, readable from any thread. False before the first.
+  bool GetSnapshot(FrameStatsSnapshot *snapshot) const;
+
+  static double GetCurrentTime() { return frame_stats_now_ns() * 1e-9; }
 };
 
 }  // namespace ndkHelper
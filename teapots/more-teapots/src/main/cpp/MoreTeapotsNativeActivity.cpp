@@ -293,6 +293,8 @@ void Engine::HandleCmd(struct android_app* app, int32_t cmd) {
       // Also stop animating.
       eng->has_focus_ = false;
       eng->DrawFrame();
+      // The next frame comes after the pause, not one frame period later.
+      eng->monitor_.Reset();
       break;
     case APP_CMD_LOW_MEMORY:
       // Free up GL resources
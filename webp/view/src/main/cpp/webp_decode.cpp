@@ -14,38 +14,70 @@
  * limitations under the License.
  */
 #include <cassert>
-#include <pthread.h>
 #include <webp/decode.h>
 #include "webp_decode.h"
 
 WebpDecoder::WebpDecoder(const char** files, uint32_t count,
                          DecodeSurfaceDescriptor* frameBuf,
-                         AAssetManager* assetMgr)
-    : assetMgr_(assetMgr),
-      buf_(nullptr), stopPending_(false),
-      state_(state_idle), worker_(nullptr) {
-    for (auto i = 0; i < count; i++) {
-        files_.push(files[i]);
-    }
-    if (count && assetMgr && frameBuf) {
-        bufInfo_ = *frameBuf;
-        switch (bufInfo_.format_) {
-            case SurfaceFormat::SURFACE_FORMAT_RGB_565:
-                bytePerPix_ = 2;
-                break;
-            case SurfaceFormat::SURFACE_FORMAT_RGBA_8888:
-            case SurfaceFormat::SURFACE_FORMAT_RGBX_8888:
-                bytePerPix_ = 4;
-                break;
-            default:
-                assert(0);
-                return;
+                         AAssetManager* assetMgr, ANativeWindow* window)
+    : nextFile_(0), frameCount_(kFrameCount), decodeIdx_(0), displayIdx_(0),
+      stopPending_(false), window_(nullptr), windowLocked_(false),
+      bytePerPix_(0) {
+    for (auto& frame : frames_) {
+        frame.buf_ = nullptr;
+        frame.stride_ = 0;
+        frame.state_ = state_idle;
+    }
+    if (!count || !assetMgr || !frameBuf) {
+        return;
+    }
+    bufInfo_ = *frameBuf;
+    switch (bufInfo_.format_) {
+        case SurfaceFormat::SURFACE_FORMAT_RGB_565:
+            bytePerPix_ = 2;
+            break;
+        case SurfaceFormat::SURFACE_FORMAT_RGBA_8888:
+        case SurfaceFormat::SURFACE_FORMAT_RGBX_8888:
+            bytePerPix_ = 4;
+            break;
+        default:
+            assert(0);
+            return;
+    }
+
+    // read every picture once; they are decoded from memory from now on
+    for (uint32_t i = 0; i < count; i++) {
+        AAsset* file = AAssetManager_open(assetMgr, files[i], AASSET_MODE_BUFFER);
+        assert(file != NULL);
+        if (!file) continue;
+        std::vector<uint8_t> data(AAsset_getLength(file));
+        int len = AAsset_read(file, data.data(), data.size());
+        AAsset_close(file);
+        assert(len > 0);
+        if (len > 0) {
+            data.resize(len);
+            files_.push_back(std::move(data));
         }
-        // allocate a private decode buffer
+    }
+    if (files_.empty()) {
+        return;
+    }
+
+    if (window) {
+        // the window's buffers are the frames, locked one at a time
+        window_ = window;
+        ANativeWindow_acquire(window_);
+        frameCount_ = 1;
+    } else {
+        // allocate the private decode buffers
         uint32_t size = bufInfo_.height_ * bufInfo_.stride_ * bytePerPix_;
-        buf_ = new uint8_t [size];
-        assert(buf_);
+        for (auto& frame : frames_) {
+            frame.buf_ = new uint8_t [size];
+            frame.stride_ = bufInfo_.stride_;
+            assert(frame.buf_);
+        }
     }
+    worker_ = std::thread(&WebpDecoder::DecodeFrameInternal, this);
 }
 
 /*
@@ -53,44 +85,71 @@ WebpDecoder::WebpDecoder(const char** files, uint32_t count,
  *                     return nullptr otherwise
  */
 uint8_t* WebpDecoder::GetDecodedFrame(void) {
-    return (state_ == state_ready ? buf_ : nullptr);
+    std::lock_guard<std::mutex> guard(lock_);
+    Frame& frame = frames_[displayIdx_];
+    return (frame.state_ == state_ready ? frame.buf_ : nullptr);
 }
 
 /*
- * DecodeFrame():
- *    thread function to decode a picture
- *    directly pass through to internal decoding function
+ * DecodeFrameInternal():
+ *    Decoding thread: decode the next picture whenever the frame after the
+ *    last decoded one is free, until the decoder is destroyed
  */
-void* DecodeFrame(void * decoder) {
-    reinterpret_cast<WebpDecoder*>(decoder)->DecodeFrameInternal();
-    return nullptr;
+void WebpDecoder::DecodeFrameInternal() {
+    uint32_t failures = 0;
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+        frameFree_.wait(guard, [this] {
+            return stopPending_ || frames_[decodeIdx_].state_ == state_idle;
+        });
+        if (stopPending_) {
+            return;
+        }
+        Frame& frame = frames_[decodeIdx_];
+        const std::vector<uint8_t>& file = files_[nextFile_];
+        nextFile_ = (nextFile_ + 1) % files_.size();
+        frame.state_ = state_decoding;
+
+        guard.unlock();
+        bool decoded = (!window_ || LockWindow(&frame)) &&
+                       DecodeFile(file, frame.buf_, frame.stride_);
+        guard.lock();
+
+        if (decoded) {
+            frame.state_ = state_ready;
+            decodeIdx_ = (decodeIdx_ + 1) % frameCount_;
+            failures = 0;
+        } else {
+            // skip the picture; give up once none of them decodes
+            frame.state_ = state_idle;
+            if (++failures == files_.size()) {
+                return;
+            }
+        }
+    }
 }
 
 /*
- * DecodeFrameInternal():
- *    Main decoding function from app side, and executing inside its own thread
+ * DecodeFile():
+ *    Decode one compressed picture into dst, a frame buffer or a locked window
+ *    buffer. The memory layout is the same as andriod native window, so
+ *    frames copy row by row. The pictures are scaled up/down by webp
+ *    decoder to fit the display window size.
  */
-void WebpDecoder::DecodeFrameInternal() {
-    const char * webpFile = files_.front();
-    files_.pop();
-    files_.push(webpFile);
-
-    AAsset* frameFile = AAssetManager_open(assetMgr_, webpFile, AASSET_MODE_BUFFER);
-    assert(frameFile != NULL);
-    int32_t len = AAsset_getLength(frameFile);
-    uint8_t *buf = new uint8_t[len];
-    assert(buf);
-    len = AAsset_read(frameFile, buf, len);
-    assert(len > 0);
-    AAsset_close(frameFile);
-
+bool WebpDecoder::DecodeFile(const std::vector<uint8_t>& file, uint8_t* dst,
+                             int32_t dstStride) {
     WebPDecoderConfig config;
     if (!WebPInitDecoderConfig(&config)) {
         assert(0);
+        return false;
     }
 
-    VP8StatusCode  status = WebPGetFeatures(buf, len, &config.input);
+    VP8StatusCode  status = WebPGetFeatures(file.data(), file.size(),
+                                            &config.input);
     assert(status == VP8_STATUS_OK);
+    if (status != VP8_STATUS_OK) {
+        return false;
+    }
 
     // let's decode it into a buffer ...
     config.options.bypass_filtering = 1;
@@ -112,81 +171,120 @@ void WebpDecoder::DecodeFrameInternal() {
             break;
         default:
             assert( 0 );
-            delete  [] buf;
-            return;
+            return false;
     }
     config.output.width = bufInfo_.width_;
     config.output.height = bufInfo_.height_;
     config.output.is_external_memory = 1;
-    config.output.private_memory = reinterpret_cast<uint8_t*>(buf_);
-    config.output.u.RGBA.stride = bufInfo_.stride_ * bytePerPix_;
+    config.output.private_memory = dst;
+    config.output.u.RGBA.stride = dstStride * bytePerPix_;
     config.output.u.RGBA.rgba  = config.output.private_memory;
     config.output.u.RGBA.size  = config.output.height *
                                  config.output.u.RGBA.stride;
 
-    status = WebPDecode(buf, len, &config);
+    status = WebPDecode(file.data(), file.size(), &config);
     WebPFreeDecBuffer(&config.output);
-    delete [] buf;
 
-    // only change state when it is decoded OK. Our small decoder engine will be
-    // in decoding state when error happens
     assert(status == VP8_STATUS_OK);
-    if (status == VP8_STATUS_OK) {
-        state_ = state_ready;
-    }
+    return (status == VP8_STATUS_OK);
+}
 
-    delete worker_;
-    worker_ = nullptr;
+/*
+ * LockWindow():
+ *    Decoding thread: lock the window buffer the next picture goes into,
+ *    unless a picture that failed to decode left it locked. False if it
+ *    cannot be locked or does not have the decoder's size and format.
+ */
+bool WebpDecoder::LockWindow(Frame* frame) {
+    if (windowLocked_) {
+        return frame->buf_ != nullptr;
+    }
+    ANativeWindow_Buffer buf;
+    if (ANativeWindow_lock(window_, &buf, nullptr) < 0) {
+        return false;
+    }
+    windowLocked_ = true;
+    DecodeSurfaceDescriptor desc;
+    if (!DescribeBuffer(buf, &desc) || desc.width_ != bufInfo_.width_ ||
+        desc.height_ != bufInfo_.height_ || desc.format_ != bufInfo_.format_) {
+        frame->buf_ = nullptr;
+        return false;
+    }
+    frame->buf_ = reinterpret_cast<uint8_t*>(buf.bits);
+    frame->stride_ = buf.stride;
+    return true;
+}
 
-    // if we were asked to release while we are busy decoding (at this point,
-    // this is dangling pointer), we perform the release here to complete the
-    // request.
-    if (stopPending_) {
-        stopPending_ = false;
-        delete  this;
+/*
+ * DescribeBuffer(): the decoder's view of a window buffer
+ */
+bool WebpDecoder::DescribeBuffer(const ANativeWindow_Buffer& buf,
+                                 DecodeSurfaceDescriptor* desc) {
+    switch (buf.format) {
+        case  WINDOW_FORMAT_RGB_565:
+            desc->format_ = SurfaceFormat::SURFACE_FORMAT_RGB_565;
+            break;
+        case WINDOW_FORMAT_RGBX_8888:
+            desc->format_ = SurfaceFormat::SURFACE_FORMAT_RGBX_8888;
+            break;
+        case WINDOW_FORMAT_RGBA_8888:
+            desc->format_ = SurfaceFormat::SURFACE_FORMAT_RGBA_8888;
+            break;
+        default:
+            return false;
     }
+    desc->width_  = buf.width;
+    desc->height_ = buf.height;
+    desc->stride_ = buf.stride;
+    return true;
 }
 
 /*
  * DecodeFrame(void):
- *     Start to decode a picture into internal frame memory
- *     The internal memory layout and size are the same as andriod native
- *     window to save copying when possible.
- *
- *     The decoded frames are scaled up/down by webp decoder to fix the display
- *     window size.
+ *     Release the picture GetDecodedFrame() returned, so the decoding thread
+ *     decodes a picture after the ones already decoded into its buffer.
+ *     A window buffer is posted, and the thread locks the next one.
  */
 bool WebpDecoder::DecodeFrame(void) {
-    if (state_ == state_decoding)
-        return false;
-    pthread_t       worker_;
-    pthread_attr_t  attrib;
-    pthread_attr_init( &attrib);
-    pthread_attr_setdetachstate(&attrib, PTHREAD_CREATE_DETACHED);
-    int status = pthread_create(&worker_, &attrib, ::DecodeFrame, this);
-    pthread_attr_destroy(&attrib);
-
-    if (status == 0) {
-        state_ = state_decoding;
-        return true;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        Frame& frame = frames_[displayIdx_];
+        if (frame.state_ != state_ready) {
+            return false;
+        }
+        if (window_) {
+            // the thread waits for this frame: the window is ours meanwhile
+            ANativeWindow_unlockAndPost(window_);
+            windowLocked_ = false;
+        }
+        frame.state_ = state_idle;
+        displayIdx_ = (displayIdx_ + 1) % frameCount_;
     }
-
-    // create thread failed...
-    assert(false);
-    return false;
+    frameFree_.notify_one();
+    return true;
 }
 
 /*
  * DestroyDecoder(void):
- *     Self-delete if decoder is idle
- *     Otherwise set up a flag to let decoding thread perform self-delete when
- *     it finishes. Upon returning from the function, the class pointer is invalid
+ *     Stop the decoding thread, once it finishes the picture it may be
+ *     decoding, and self-delete. A window buffer still locked is posted as
+ *     it is. Upon returning from the function, the class pointer is invalid
  *     and should not be used
  */
 bool WebpDecoder::DestroyDecoder(void) {
-    if (state_ == state_decoding) {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
         stopPending_ = true;
-        return false;
+    }
+    frameFree_.notify_one();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    if (window_) {
+        if (windowLocked_) {
+            ANativeWindow_unlockAndPost(window_);
+        }
+        ANativeWindow_release(window_);
     }
 
     delete this;
@@ -197,7 +295,11 @@ bool WebpDecoder::DestroyDecoder(void) {
  * private destructor prevent object directly call delete
  */
 WebpDecoder::~WebpDecoder() {
-    if (buf_)  delete [] buf_;
-    buf_ = nullptr;
+    if (window_) {
+        return;  // the frames point into the window
+    }
+    for (auto& frame : frames_) {
+        if (frame.buf_)  delete [] frame.buf_;
+        frame.buf_ = nullptr;
+    }
 }
-
@@ -15,8 +15,13 @@
  */
 #ifndef __WEBP_DECODE_H__
 #define __WEBP_DECODE_H__
-#include <queue>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <android/asset_manager.h>
+#include <android/native_window.h>
 
 enum DecodeState { state_idle, state_decoding, state_ready};
 enum class SurfaceFormat : unsigned int {
@@ -33,11 +38,19 @@ struct DecodeSurfaceDescriptor {
 
 /*
  * Webp decoder wrapper:
- *     Select a picture to decode in its own thread. The thread is deleted
- *     once a picture is decoded into its internal memory. The next picture
- *     will be decoded when:
- *       - the decoded frame is retrieved
- *       - Another DecodeFrame() is called [this is trigger]
+ *     The webp files are read from assets once, when the decoder is created,
+ *     and kept compressed in memory. One decoder thread lives as long as the
+ *     decoder and decodes the pictures, in order and round robin, into a ring
+ *     of kFrameCount frame buffers, so up to kFrameCount pictures are ready
+ *     ahead of the one on display:
+ *       - GetDecodedFrame() returns the oldest decoded picture
+ *       - DecodeFrame() hands that picture's buffer back to the thread, which
+ *         decodes the next picture into it
+ *     Given a window, the thread decodes into the window's own buffers
+ *     instead: it locks the next one and decodes the picture into it ahead
+ *     of time, and DecodeFrame() posts it. There is no frame buffer and no
+ *     copy, and the display thread never decodes or holds the lock; only one
+ *     window buffer can be locked at a time, so just one picture is ahead.
  *    when display format changes, call DestroyDecoder() to release this decoder
  *    and allocate a new deocder object.
  */
@@ -45,32 +58,58 @@ class WebpDecoder {
   public:
     explicit WebpDecoder(const char** files, uint32_t count,
                          DecodeSurfaceDescriptor* surfDesc,
-                         AAssetManager* assetMgr);
-    // Start decode a picture
+                         AAssetManager* assetMgr,
+                         ANativeWindow* window = nullptr);
+    // Done with the picture from GetDecodedFrame(), decode another one into
+    // its buffer; false if there was none. Decoding into a window, this
+    // posts the picture to the window first.
     bool     DecodeFrame(void);
 
-    // Poll to see if a picture is decoded and ready to be used/displayed
+    // Poll to see if a picture is decoded and ready to be used/displayed;
+    // it stays valid until DecodeFrame() or DestroyDecoder()
     uint8_t *GetDecodedFrame(void);
 
-    // WebpDecoder internal decoding function, no called from user
+    // The decoder's view of a window buffer; false for unsupported formats
+    static bool DescribeBuffer(const ANativeWindow_Buffer& buf,
+                               DecodeSurfaceDescriptor* desc);
+
+    // WebpDecoder internal decoding thread, no called from user
     void     DecodeFrameInternal(void);
 
     // Release this decoder after usage
     bool     DestroyDecoder(void);
 
   private:
+    static const int kFrameCount = 3;
+
+    struct Frame {
+        uint8_t*    buf_;
+        int32_t     stride_;  // in pixels
+        DecodeState state_;
+    };
+
     DecodeSurfaceDescriptor bufInfo_;
-    AAssetManager*          assetMgr_;
-    std::queue<const char*> files_;
-    uint8_t*  buf_;
+    std::vector<std::vector<uint8_t>> files_;  // compressed, in display order
+    uint32_t  nextFile_;   // the next one to decode
+    Frame     frames_[kFrameCount];
+    int       frameCount_; // frames in the ring, 1 when decoding into window_
+    int       decodeIdx_;  // frame the thread decodes into next
+    int       displayIdx_; // frame GetDecodedFrame() returns
     bool      stopPending_;
-    DecodeState state_;
+    ANativeWindow* window_;
+    bool      windowLocked_;  // a window buffer is locked by the decoder
 
     uint32_t   bytePerPix_;
-    pthread_t* worker_;
+    std::mutex lock_;
+    std::condition_variable frameFree_;
+    std::thread worker_;
+
+    bool DecodeFile(const std::vector<uint8_t>& file, uint8_t* dst,
+                    int32_t dstStride);
+    bool LockWindow(Frame* frame);
     /*
      * private destructor prevent object directly call delete
      */
     ~WebpDecoder();
 };
-#endif // __WEBP_DECODE_H__
\ No newline at end of file
+#endif // __WEBP_DECODE_H__
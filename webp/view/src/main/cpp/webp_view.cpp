@@ -38,6 +38,10 @@ const char * frames[] = {
 };
 const int kFRAME_COUNT = sizeof(frames) / sizeof(frames[0]);
 const int kFRAME_DISPLAY_TIME = 2;
+// the decoder decodes ahead into the window's own buffers, which are then
+// only posted: no frame buffers and no copy. Otherwise it decodes into its
+// frame buffers and the pictures are copied into the window.
+const bool kDECODE_INTO_WINDOW = true;
 
 /*
  * main object handles Android window frame update, and use webp to decode
@@ -57,7 +61,14 @@ class Engine {
     struct android_app* AndroidApp(void) const { return app_; }
     void StartAnimation(bool start) { animating_ = start; }
     bool IsAnimating(void) const { return animating_; }
-    void TerminateDisplay(void) { StartAnimation(false); }
+    // the decoder may hold a window buffer: done with it before the window
+    void TerminateDisplay(void) {
+        StartAnimation(false);
+        if (decoder_) {
+            decoder_->DestroyDecoder();
+            decoder_ = nullptr;
+        }
+    }
 
      // PrepareDrawing(): Initialize the Engine with current native window geometry
      //   and blank current screen to avoid garbbage displaying on device
@@ -171,6 +182,7 @@ bool Engine::PrepareDrawing(void) {
     // create decoder
     if (decoder_) {
         decoder_->DestroyDecoder();
+        decoder_ = nullptr;
     }
     ANativeWindow_Buffer buf;
     if (ANativeWindow_lock(app_->window, &buf, NULL) < 0) {
@@ -180,38 +192,28 @@ bool Engine::PrepareDrawing(void) {
     UpdateFrameBuffer(&buf, nullptr);
     ANativeWindow_unlockAndPost(app_->window);
     DecodeSurfaceDescriptor descriptor;
-    switch (buf.format) {
-        case  WINDOW_FORMAT_RGB_565:
-            descriptor.format_ = SurfaceFormat::SURFACE_FORMAT_RGB_565;
-            break;
-        case WINDOW_FORMAT_RGBX_8888:
-            descriptor.format_ = SurfaceFormat::SURFACE_FORMAT_RGBX_8888;
-            break;
-        case WINDOW_FORMAT_RGBA_8888:
-            descriptor.format_ = SurfaceFormat::SURFACE_FORMAT_RGBA_8888;
-        default:
-            return false;
+    if (!WebpDecoder::DescribeBuffer(buf, &descriptor)) {
+        return false;
     }
-    descriptor.width_  = buf.width;
-    descriptor.height_ = buf.height;
-    descriptor.stride_ = buf.stride;
 
     decoder_ = new WebpDecoder(frames, kFRAME_COUNT, &descriptor,
-                               app_->activity->assetManager);
+                               app_->activity->assetManager,
+                               kDECODE_INTO_WINDOW ? app_->window : nullptr);
     assert(decoder_);
     if (!decoder_) {
         return false;
     }
-    decoder_->DecodeFrame();
+    // the decoder starts decoding ahead on its own thread
 
     return true;
 }
 
 /*
- * Only copy decoded webp picture when:
- *  - current frame has been on for kFrame_DISPLAY_TIME seconds
- *  - a new picture is decoded
- * After copying, start decoding the next frame
+ * Only update the window when the current frame has been on for
+ * kFrame_DISPLAY_TIME seconds and the next picture is decoded, then
+ *  - post it, when the decoder decoded it into the window buffer, or
+ *  - copy it into the window
+ * and hand its buffer back for the decoder to refill
  */
 bool Engine::UpdateDisplay(void) {
     if (!app_->window || !decoder_) {
@@ -229,16 +231,19 @@ bool Engine::UpdateDisplay(void) {
     if (!frame)
         return false;
 
-    ANativeWindow_Buffer buffer;
-    if (ANativeWindow_lock(app_->window, &buffer, nullptr) < 0) {
-        LOGW("Unable to lock window buffer");
-        return false;
+    if (!kDECODE_INTO_WINDOW) {
+        ANativeWindow_Buffer buffer;
+        if (ANativeWindow_lock(app_->window, &buffer, nullptr) < 0) {
+            LOGW("Unable to lock window buffer");
+            return false;
+        }
+        UpdateFrameBuffer(&buffer, frame);
+        ANativeWindow_unlockAndPost(app_->window);
     }
-    UpdateFrameBuffer(&buffer, frame);
-    ANativeWindow_unlockAndPost(app_->window);
     clock_gettime(CLOCK_MONOTONIC, &frameStartTime_);
 
-    // start decoding next frame
+    // done with this picture ( posting it from a window buffer ); its
+    // buffer takes the next one
     decoder_->DecodeFrame();
     return true;
 }